@@ -44,6 +44,7 @@
 // To support installation of headers for analysis tools into a single
 // separate directory we omit common/ here and rely on -I.
 #include "memref.h"
+#include <iostream>
 #include <string>
 
 /**
@@ -62,7 +63,9 @@
  * trace entry for that shard.  The concurrency model used guarantees that all
  * entries from any one shard are processed by the same single worker thread, so no
  * synchronization is needed inside the parallel_ functions.  A single worker thread
- * invokes print_results() as well.
+ * invokes print_results() as well.  The analyzer delivers shard entries in batches
+ * through parallel_shard_memref_batch(), whose default implementation forwards each
+ * entry to parallel_shard_memref().
  *
  * For serial operation, process_memref(), operates on a trace entry in a single,
  * sorted, interleaved stream of trace entries.  In the default mode of operation,
@@ -207,12 +210,61 @@ public:
     {
         return false;
     }
+    /**
+     * Processes a batch of \p count consecutive trace entries from one shard, stored
+     * contiguously in \p memrefs.  In parallel mode the analyzer decodes a block of
+     * entries once and hands the whole block to each tool via this routine, rather
+     * than calling parallel_shard_memref() per entry.  The default implementation
+     * simply invokes parallel_shard_memref() on each entry in turn; tools whose
+     * per-entry work is small can override this to process the block in a tight
+     * loop without a virtual call per entry.  The \p memrefs array is only valid
+     * for the duration of this call.  The same concurrency guarantees as for
+     * parallel_shard_memref() apply.  The return value indicates whether this
+     * function was successful. On failure, parallel_shard_error() returns a
+     * descriptive message.
+     */
+    virtual bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                size_t count)
+    {
+        for (size_t i = 0; i < count; ++i) {
+            if (!parallel_shard_memref(shard_data, memrefs[i]))
+                return false;
+        }
+        return true;
+    }
     /** Returns a description of the last error for this shard. */
     virtual std::string
     parallel_shard_error(void *shard_data)
     {
         return "";
     }
+    /**
+     * Writes the tool's analysis state to \p out, so that a later run can continue
+     * the analysis from the same point in the trace by passing what was written to
+     * load_checkpoint().  This is only invoked during serial analysis, between calls
+     * to process_memref().  The return value indicates whether the tool supports
+     * checkpoints and was successful.  On failure, get_error_string() returns a
+     * descriptive message.
+     */
+    virtual bool
+    save_checkpoint(std::ostream &out)
+    {
+        error_string = "Checkpoints are not supported by this tool";
+        return false;
+    }
+    /**
+     * Replaces the tool's analysis state with what save_checkpoint() wrote to \p in.
+     * This is invoked before the first call to process_memref().  The return value
+     * indicates whether this function was successful.  On failure,
+     * get_error_string() returns a descriptive message.
+     */
+    virtual bool
+    load_checkpoint(std::istream &in)
+    {
+        error_string = "Checkpoints are not supported by this tool";
+        return false;
+    }
 
 protected:
     bool success;
@@ -30,46 +30,81 @@
  * DAMAGE.
  */
 
+#include <algorithm>
+#include <chrono>
+#include <fstream>
 #include <iostream>
+#include <sstream>
 #include <thread>
+#include <unordered_map>
 #include "analysis_tool.h"
 #include "analyzer.h"
 #include "reader/file_reader.h"
 #ifdef HAS_ZLIB
+#    include "reader/columnar_file_reader.h"
 #    include "reader/compressed_file_reader.h"
 #endif
 #ifdef HAS_SNAPPY
 #    include "reader/snappy_file_reader.h"
 #endif
+#ifdef UNIX
+#    include "reader/mmap_file_reader.h"
+#endif
 #include "common/utils.h"
 
 #ifdef HAS_ZLIB
 // Even if the file is uncompressed, zlib's gzip interface is faster than
-// file_reader_t's fstream in our measurements, so we always use it when
-// available.
+// file_reader_t's fstream in our measurements, so we use it when available
+// for files we cannot map (see get_reader()).
 typedef compressed_file_reader_t default_file_reader_t;
 #else
 typedef file_reader_t<std::ifstream *> default_file_reader_t;
 #endif
 
+const size_t analyzer_t::kMemrefBatchSize;
+
 analyzer_t::analyzer_t()
     : success(true)
     , num_tools(0)
     , tools(NULL)
     , parallel(true)
     , worker_count(0)
+    , shard_queue_next(0)
 {
     /* Nothing else: child class needs to initialize. */
 }
 
-#ifdef HAS_SNAPPY
+#ifdef UNIX
+// Returns whether path is a trace file, or a directory of trace files, none of
+// which is gzip-compressed.  Such files can be mapped and read in place.
 static bool
-ends_with(const std::string &str, const std::string &with)
+is_uncompressed_trace(const std::string &path)
 {
-    size_t pos = str.rfind(with);
-    if (pos == std::string::npos)
+    std::vector<std::string> files;
+    if (directory_iterator_t::is_directory(path)) {
+        directory_iterator_t end;
+        directory_iterator_t iter(path);
+        if (!iter)
+            return false;
+        for (; iter != end; ++iter) {
+            std::string fname = *iter;
+            if (fname == "." || fname == ".." ||
+                ends_with(fname, "." TRACE_INDEX_SUFFIX))
+                continue;
+            files.push_back(path + DIRSEP + fname);
+        }
+    } else
+        files.push_back(path);
+    if (files.empty())
         return false;
-    return (pos + with.size() == str.size());
+    for (const std::string &file : files) {
+        std::ifstream stream(file, std::ifstream::binary);
+        unsigned char magic[2];
+        if (!stream.read(reinterpret_cast<char *>(magic), sizeof(magic)) ||
+            (magic[0] == 0x1f && magic[1] == 0x8b))
+            return false;
+    }
+    return true;
 }
 #endif
 
@@ -96,10 +131,57 @@ get_reader(const std::string &path, int verbosity)
         }
     }
 #endif
-    // No snappy support, or didn't find a .sz file, try the default reader.
+#ifdef HAS_ZLIB
+    if (ends_with(path, "." TRACE_COLUMNAR_SUFFIX))
+        return std::unique_ptr<reader_t>(new columnar_file_reader_t(path, verbosity));
+    // If path is a directory holding columnar files, return a columnar reader.
+    if (directory_iterator_t::is_directory(path)) {
+        directory_iterator_t end;
+        directory_iterator_t iter(path);
+        if (!iter) {
+            ERRMSG("Failed to list directory %s: %s", path.c_str(),
+                   iter.error_string().c_str());
+            return nullptr;
+        }
+        for (; iter != end; ++iter) {
+            if (ends_with(*iter, "." TRACE_COLUMNAR_SUFFIX)) {
+                return std::unique_ptr<reader_t>(
+                    new columnar_file_reader_t(path, verbosity));
+            }
+        }
+    }
+#endif
+#ifdef UNIX
+    if (is_uncompressed_trace(path))
+        return std::unique_ptr<reader_t>(new mmap_file_reader_t(path, verbosity));
+#endif
+    // No snappy, columnar, or uncompressed files found, so try the default reader.
     return std::unique_ptr<reader_t>(new default_file_reader_t(path, verbosity));
 }
 
+static uint64_t
+get_file_size(const std::string &path)
+{
+    std::ifstream file(path, std::ifstream::binary | std::ifstream::ate);
+    if (!file)
+        return 0;
+    std::streampos size = file.tellg();
+    return size < 0 ? 0 : static_cast<uint64_t>(size);
+}
+
+void
+analyzer_t::init_parallel()
+{
+    for (int i = 0; i < num_tools; ++i) {
+        if (parallel && !tools[i]->parallel_shard_supported()) {
+            parallel = false;
+            break;
+        }
+    }
+    if (worker_count <= 0)
+        worker_count = std::thread::hardware_concurrency();
+}
+
 bool
 analyzer_t::init_file_reader(const std::string &trace_path, int verbosity_in)
 {
@@ -108,12 +190,7 @@ analyzer_t::init_file_reader(const std::string &trace_path, int verbosity_in)
         ERRMSG("Trace file name is empty\n");
         return false;
     }
-    for (int i = 0; i < num_tools; ++i) {
-        if (parallel && !tools[i]->parallel_shard_supported()) {
-            parallel = false;
-            break;
-        }
-    }
+    init_parallel();
     if (parallel && directory_iterator_t::is_directory(trace_path)) {
         directory_iterator_t end;
         directory_iterator_t iter(trace_path);
@@ -124,29 +201,37 @@ analyzer_t::init_file_reader(const std::string &trace_path, int verbosity_in)
         }
         for (; iter != end; ++iter) {
             const std::string fname = *iter;
-            if (fname == "." || fname == "..")
+            if (fname == "." || fname == ".." ||
+                ends_with(fname, "." TRACE_INDEX_SUFFIX))
                 continue;
             const std::string path = trace_path + DIRSEP + fname;
             std::unique_ptr<reader_t> reader = get_reader(path, verbosity);
             if (!reader) {
                 return false;
             }
-            thread_data.push_back(analyzer_shard_data_t(
-                static_cast<int>(thread_data.size()), std::move(reader), path));
+            thread_data.push_back(
+                analyzer_shard_data_t(static_cast<int>(thread_data.size()),
+                                      std::move(reader), path, get_file_size(path)));
             VPRINT(this, 2, "Opened reader for %s\n", path.c_str());
         }
-        // Like raw2trace, we use a simple round-robin static work assigment.  This
-        // could be improved later with dynamic work queue for better load balancing.
-        if (worker_count <= 0)
-            worker_count = std::thread::hardware_concurrency();
-        worker_tasks.resize(worker_count);
-        int worker = 0;
-        for (size_t i = 0; i < thread_data.size(); ++i) {
-            VPRINT(this, 2, "Worker %d assigned trace shard %zd\n", worker, i);
-            worker_tasks[worker].push_back(&thread_data[i]);
-            thread_data[i].worker = worker;
-            worker = (worker + 1) % worker_count;
+        // Rather than a static round-robin assignment, which leaves workers idle
+        // while one of them grinds through a large shard, workers pull shards
+        // from a shared queue.  We order the queue largest-first so the longest
+        // shards start early and the small ones fill in the gaps at the end.
+        shard_queue.reserve(thread_data.size());
+        for (size_t i = 0; i < thread_data.size(); ++i)
+            shard_queue.push_back(&thread_data[i]);
+        std::stable_sort(shard_queue.begin(), shard_queue.end(),
+                         [](const analyzer_shard_data_t *a,
+                            const analyzer_shard_data_t *b) {
+                             return a->file_size > b->file_size;
+                         });
+#ifdef DEBUG
+        for (analyzer_shard_data_t *tdata : shard_queue) {
+            VPRINT(this, 2, "Queued trace shard %d (%s) of size %llu\n", tdata->index,
+                   tdata->trace_file.c_str(), (unsigned long long)tdata->file_size);
         }
+#endif
     } else {
         parallel = false;
         serial_trace_iter = get_reader(trace_path, verbosity);
@@ -168,6 +253,7 @@ analyzer_t::analyzer_t(const std::string &trace_path, analysis_tool_t **tools_in
     , tools(tools_in)
     , parallel(true)
     , worker_count(worker_count_in)
+    , shard_queue_next(0)
 {
     for (int i = 0; i < num_tools; ++i) {
         if (tools[i] == NULL || !*tools[i]) {
@@ -195,6 +281,7 @@ analyzer_t::analyzer_t(const std::string &trace_path)
     // This external-iterator interface does not support parallel analysis.
     , parallel(false)
     , worker_count(0)
+    , shard_queue_next(0)
 {
     if (!init_file_reader(trace_path))
         success = false;
@@ -228,36 +315,59 @@ analyzer_t::start_reading()
         ERRMSG("Failed to read from trace\n");
         return false;
     }
+    if (skip_instrs > 0)
+        serial_trace_iter->skip_instructions(skip_instrs);
     return true;
 }
 
+analyzer_t::analyzer_shard_data_t *
+analyzer_t::next_shard()
+{
+    size_t next = shard_queue_next.fetch_add(1, std::memory_order_relaxed);
+    if (next >= shard_queue.size())
+        return nullptr;
+    return shard_queue[next];
+}
+
 void
-analyzer_t::process_tasks(std::vector<analyzer_shard_data_t *> *tasks)
+analyzer_t::process_tasks(int worker)
 {
-    if (tasks->empty()) {
-        VPRINT(this, 1, "Worker has no tasks\n");
-        return;
-    }
-    VPRINT(this, 1, "Worker %d assigned %zd task(s)\n", (*tasks)[0]->worker,
-           tasks->size());
-    std::vector<void *> worker_data(num_tools);
+    analyzer_worker_data_t &wdata = worker_data[worker];
+    std::vector<void *> tool_worker_data(num_tools);
     for (int i = 0; i < num_tools; ++i)
-        worker_data[i] = tools[i]->parallel_worker_init((*tasks)[0]->worker);
-    for (analyzer_shard_data_t *tdata : *tasks) {
+        tool_worker_data[i] = tools[i]->parallel_worker_init(worker);
+    // Reused across shards to avoid reallocating.
+    std::vector<memref_t> batch(kMemrefBatchSize);
+    for (analyzer_shard_data_t *tdata = next_shard(); tdata != nullptr;
+         tdata = next_shard()) {
+        tdata->worker = worker;
+        ++wdata.shard_count;
         VPRINT(this, 1, "Worker %d starting on trace shard %d\n", tdata->worker,
                tdata->index);
+        auto start = std::chrono::steady_clock::now();
         if (!tdata->iter->init()) {
             tdata->error = "Failed to read from trace" + tdata->trace_file;
             return;
         }
+        if (skip_instrs > 0)
+            tdata->iter->skip_instructions(skip_instrs);
         std::vector<void *> shard_data(num_tools);
-        for (int i = 0; i < num_tools; ++i)
-            shard_data[i] = tools[i]->parallel_shard_init(tdata->index, worker_data[i]);
+        for (int i = 0; i < num_tools; ++i) {
+            shard_data[i] =
+                tools[i]->parallel_shard_init(tdata->index, tool_worker_data[i]);
+        }
         VPRINT(this, 1, "shard_data[0] is %p\n", shard_data[0]);
-        for (; *tdata->iter != *trace_end; ++(*tdata->iter)) {
+        while (*tdata->iter != *trace_end) {
+            // We decode a block of entries once and then let each tool walk the
+            // whole block, which avoids a virtual call per entry per tool and keeps
+            // each tool's working set hot across the block.
+            size_t count = 0;
+            for (; count < kMemrefBatchSize && *tdata->iter != *trace_end;
+                 ++(*tdata->iter))
+                batch[count++] = **tdata->iter;
             for (int i = 0; i < num_tools; ++i) {
-                const memref_t &memref = **tdata->iter;
-                if (!tools[i]->parallel_shard_memref(shard_data[i], memref)) {
+                if (!tools[i]->parallel_shard_memref_batch(shard_data[i], batch.data(),
+                                                           count)) {
                     tdata->error = tools[i]->parallel_shard_error(shard_data[i]);
                     VPRINT(this, 1,
                            "Worker %d hit shard memref error %s on trace shard %d\n",
@@ -276,26 +386,216 @@ analyzer_t::process_tasks(std::vector<analyzer_shard_data_t *> *tasks)
                 return;
             }
         }
+        wdata.busy_usec += std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
+    }
+    if (wdata.shard_count == 0) {
+        VPRINT(this, 1, "Worker %d found no tasks\n", worker);
+    }
+    for (int i = 0; i < num_tools; ++i) {
+        const std::string error = tools[i]->parallel_worker_exit(tool_worker_data[i]);
+        if (!error.empty()) {
+            wdata.error = error;
+            VPRINT(this, 1, "Worker %d hit worker exit error %s\n", worker,
+                   error.c_str());
+            return;
+        }
+    }
+}
+
+void
+analyzer_t::process_routed_tasks(int worker)
+{
+    analyzer_worker_data_t &wdata = worker_data[worker];
+    routed_queue_t &queue = *routed_queues[worker];
+    std::vector<void *> tool_worker_data(num_tools);
+    for (int i = 0; i < num_tools; ++i)
+        tool_worker_data[i] = tools[i]->parallel_worker_init(worker);
+    while (true) {
+        routed_batch_t batch;
+        {
+            std::unique_lock<std::mutex> lock(queue.lock);
+            queue.cond.wait(lock,
+                            [&queue] { return queue.done || !queue.batches.empty(); });
+            if (queue.batches.empty())
+                break;
+            batch = std::move(queue.batches.front());
+            queue.batches.pop_front();
+        }
+        // Wake the routing thread if it is waiting for room.
+        queue.cond.notify_all();
+        // After an error we keep draining the queue so the routing thread is not
+        // left waiting on us.
+        if (!wdata.error.empty())
+            continue;
+        auto start = std::chrono::steady_clock::now();
+        routed_shard_t *shard = batch.shard;
+        if (shard->shard_data.empty()) {
+            VPRINT(this, 1, "Worker %d starting on routed shard %d\n", worker,
+                   shard->index);
+            ++wdata.shard_count;
+            shard->shard_data.resize(num_tools);
+            for (int i = 0; i < num_tools; ++i) {
+                shard->shard_data[i] =
+                    tools[i]->parallel_shard_init(shard->index, tool_worker_data[i]);
+            }
+        }
+        for (int i = 0; i < num_tools && wdata.error.empty(); ++i) {
+            if (!tools[i]->parallel_shard_memref_batch(
+                    shard->shard_data[i], batch.memrefs.data(), batch.memrefs.size()) ||
+                (batch.last && !tools[i]->parallel_shard_exit(shard->shard_data[i])))
+                wdata.error = tools[i]->parallel_shard_error(shard->shard_data[i]);
+        }
+        if (!wdata.error.empty()) {
+            VPRINT(this, 1, "Worker %d hit error %s on routed shard %d\n", worker,
+                   wdata.error.c_str(), shard->index);
+            routed_error = true;
+        } else if (batch.last) {
+            VPRINT(this, 1, "Worker %d finished routed shard %d\n", worker,
+                   shard->index);
+        }
+        wdata.busy_usec += std::chrono::duration_cast<std::chrono::microseconds>(
+                               std::chrono::steady_clock::now() - start)
+                               .count();
     }
+    if (!wdata.error.empty())
+        return;
     for (int i = 0; i < num_tools; ++i) {
-        const std::string error = tools[i]->parallel_worker_exit(worker_data[i]);
+        const std::string error = tools[i]->parallel_worker_exit(tool_worker_data[i]);
         if (!error.empty()) {
-            (*tasks)[0]->error = error;
-            VPRINT(this, 1, "Worker %d hit worker exit error %s\n", (*tasks)[0]->worker,
+            wdata.error = error;
+            VPRINT(this, 1, "Worker %d hit worker exit error %s\n", worker,
                    error.c_str());
             return;
         }
     }
 }
 
+bool
+analyzer_t::route_batch(routed_shard_t *shard, bool last)
+{
+    routed_queue_t &queue = *routed_queues[shard->worker];
+    std::unique_lock<std::mutex> lock(queue.lock);
+    queue.cond.wait(lock, [this, &queue] {
+        return queue.batches.size() < kMaxRoutedBatches || routed_error;
+    });
+    if (routed_error)
+        return false;
+    routed_batch_t batch;
+    batch.shard = shard;
+    batch.memrefs.swap(shard->pending);
+    batch.last = last;
+    queue.batches.push_back(std::move(batch));
+    lock.unlock();
+    queue.cond.notify_all();
+    shard->pending.reserve(kMemrefBatchSize);
+    return true;
+}
+
+bool
+analyzer_t::run_routed()
+{
+    if (!start_reading())
+        return false;
+    VPRINT(this, 1, "Creating %d worker threads for routed shards\n", worker_count);
+    routed_error = false;
+    worker_data.clear();
+    worker_data.resize(worker_count);
+    routed_queues.clear();
+    for (int i = 0; i < worker_count; ++i)
+        routed_queues.emplace_back(new routed_queue_t);
+    std::vector<std::thread> threads;
+    threads.reserve(worker_count);
+    for (int i = 0; i < worker_count; ++i)
+        threads.emplace_back(std::thread(&analyzer_t::process_routed_tasks, this, i));
+    // Each thread gets a new shard, assigned round-robin to the workers.  A tid
+    // seen again after its thread exited is a new thread.
+    std::unordered_map<memref_tid_t, routed_shard_t *> live_shards;
+    for (; *serial_trace_iter != *trace_end && !routed_error; ++(*serial_trace_iter)) {
+        const memref_t &memref = **serial_trace_iter;
+        routed_shard_t *shard;
+        auto it = live_shards.find(memref.data.tid);
+        if (it != live_shards.end())
+            shard = it->second;
+        else {
+            int index = static_cast<int>(routed_shards.size());
+            routed_shards.emplace_back(new routed_shard_t(index, index % worker_count));
+            shard = routed_shards.back().get();
+            shard->pending.reserve(kMemrefBatchSize);
+            live_shards[memref.data.tid] = shard;
+            VPRINT(this, 2, "Routing thread %lld to shard %d on worker %d\n",
+                   (long long)memref.data.tid, index, shard->worker);
+        }
+        shard->pending.push_back(memref);
+        if (memref.exit.type == TRACE_TYPE_THREAD_EXIT) {
+            live_shards.erase(memref.data.tid);
+            route_batch(shard, true);
+        } else if (shard->pending.size() >= kMemrefBatchSize)
+            route_batch(shard, false);
+    }
+    // Threads still live at the end of the stream never saw an exit.
+    for (auto &keyval : live_shards)
+        route_batch(keyval.second, true);
+    for (auto &queue : routed_queues) {
+        {
+            std::lock_guard<std::mutex> guard(queue->lock);
+            queue->done = true;
+        }
+        queue->cond.notify_all();
+    }
+    for (std::thread &thread : threads)
+        thread.join();
+    report_worker_balance();
+    for (auto &wdata : worker_data) {
+        if (!wdata.error.empty()) {
+            error_string = wdata.error;
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+analyzer_t::report_worker_balance()
+{
+    if (verbosity < 1 || worker_data.empty())
+        return;
+    uint64_t max_usec = 0;
+    for (const auto &wdata : worker_data)
+        max_usec = std::max(max_usec, wdata.busy_usec);
+    for (size_t i = 0; i < worker_data.size(); ++i) {
+        fprintf(stderr, "%s Worker %zd processed %d shard(s), busy %.3fs (%.1f%%)\n",
+                output_prefix, i, worker_data[i].shard_count,
+                worker_data[i].busy_usec / 1000000.,
+                max_usec == 0 ? 100. : 100. * worker_data[i].busy_usec / max_usec);
+    }
+}
+
 bool
 analyzer_t::run()
 {
     // XXX i#3286: Add a %-completed progress message by looking at the file sizes.
     if (!parallel) {
+        uint64_t records = 0;
+        if (!resume_path.empty() && !read_checkpoint(&records))
+            return false;
         if (!start_reading())
             return false;
+        // We find our place in the trace by reading past what was already
+        // analyzed, which is much cheaper than analyzing it.
+        for (uint64_t i = 0; i < records; ++i, ++(*serial_trace_iter)) {
+            if (*serial_trace_iter == *trace_end) {
+                error_string = "Trace ends before the checkpoint position";
+                return false;
+            }
+        }
+        const uint64_t resumed_records = records;
         for (; *serial_trace_iter != *trace_end; ++(*serial_trace_iter)) {
+            if (checkpoint_interval > 0 && records > resumed_records &&
+                records % checkpoint_interval == 0 && !write_checkpoint(records))
+                return false;
+            ++records;
             for (int i = 0; i < num_tools; ++i) {
                 memref_t memref = **serial_trace_iter;
                 // We short-circuit and exit on an error to avoid confusion over
@@ -312,21 +612,113 @@ analyzer_t::run()
         error_string = "Invalid worker count: must be > 0";
         return false;
     }
+    if (thread_data.empty() && serial_trace_iter)
+        return run_routed();
     std::vector<std::thread> threads;
     VPRINT(this, 1, "Creating %d worker threads\n", worker_count);
     threads.reserve(worker_count);
-    for (int i = 0; i < worker_count; ++i) {
-        threads.emplace_back(
-            std::thread(&analyzer_t::process_tasks, this, &worker_tasks[i]));
-    }
+    shard_queue_next.store(0);
+    worker_data.clear();
+    worker_data.resize(worker_count);
+    for (int i = 0; i < worker_count; ++i)
+        threads.emplace_back(std::thread(&analyzer_t::process_tasks, this, i));
     for (std::thread &thread : threads)
         thread.join();
+    report_worker_balance();
     for (auto &tdata : thread_data) {
         if (!tdata.error.empty()) {
             error_string = tdata.error;
             return false;
         }
     }
+    for (auto &wdata : worker_data) {
+        if (!wdata.error.empty()) {
+            error_string = wdata.error;
+            return false;
+        }
+    }
+    return true;
+}
+
+bool
+analyzer_t::write_checkpoint(uint64_t records)
+{
+    // We write to a temporary file and rename it so that a crash while writing
+    // leaves the previous checkpoint intact.
+    std::string tmp_path = checkpoint_path + ".tmp";
+    {
+        std::ofstream out(tmp_path, std::ofstream::binary);
+        if (!out) {
+            error_string = "Failed to create checkpoint file " + tmp_path;
+            return false;
+        }
+        out << "drmemtrace_checkpoint 1\n"
+            << skip_instrs << " " << records << " " << num_tools << "\n";
+        for (int i = 0; i < num_tools; ++i) {
+            std::ostringstream state;
+            if (!tools[i]->save_checkpoint(state)) {
+                error_string = tools[i]->get_error_string();
+                return false;
+            }
+            const std::string &bytes = state.str();
+            out << bytes.size() << "\n" << bytes << "\n";
+        }
+        if (!out.flush()) {
+            error_string = "Failed to write checkpoint file " + tmp_path;
+            return false;
+        }
+    }
+#ifdef WINDOWS
+    // rename() does not replace an existing file on Windows.
+    std::remove(checkpoint_path.c_str());
+#endif
+    if (std::rename(tmp_path.c_str(), checkpoint_path.c_str()) != 0) {
+        error_string = "Failed to rename checkpoint file to " + checkpoint_path;
+        return false;
+    }
+    VPRINT(this, 1, "Wrote checkpoint after %llu records\n",
+           (unsigned long long)records);
+    return true;
+}
+
+bool
+analyzer_t::read_checkpoint(OUT uint64_t *records)
+{
+    std::ifstream in(resume_path, std::ifstream::binary);
+    if (!in) {
+        error_string = "Failed to open checkpoint file " + resume_path;
+        return false;
+    }
+    std::string magic;
+    int version, tools_in;
+    uint64_t skip_in;
+    if (!(in >> magic >> version >> skip_in >> *records >> tools_in) ||
+        magic != "drmemtrace_checkpoint" || version != 1) {
+        error_string = "Invalid checkpoint file " + resume_path;
+        return false;
+    }
+    if (skip_in != skip_instrs || tools_in != num_tools) {
+        error_string = "Checkpoint was taken with a different -skip_instrs or tools";
+        return false;
+    }
+    for (int i = 0; i < num_tools; ++i) {
+        size_t size;
+        if (!(in >> size) || in.get() != '\n') {
+            error_string = "Invalid checkpoint file " + resume_path;
+            return false;
+        }
+        std::string bytes(size, '\0');
+        if (!in.read(&bytes[0], size)) {
+            error_string = "Truncated checkpoint file " + resume_path;
+            return false;
+        }
+        std::istringstream state(bytes);
+        if (!tools[i]->load_checkpoint(state)) {
+            error_string = tools[i]->get_error_string();
+            return false;
+        }
+    }
+    VPRINT(this, 1, "Resuming after %llu records\n", (unsigned long long)*records);
     return true;
 }
 
@@ -334,6 +726,8 @@ bool
 analyzer_t::print_stats()
 {
     for (int i = 0; i < num_tools; ++i) {
+        if (i < static_cast<int>(tool_labels.size()))
+            std::cerr << tool_labels[i] << ":\n";
         if (!tools[i]->print_results()) {
             error_string = tools[i]->get_error_string();
             return false;
@@ -43,8 +43,12 @@
  * @brief DrMemtrace top-level trace analysis driver.
  */
 
+#include <atomic>
+#include <condition_variable>
+#include <deque>
 #include <iterator>
 #include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 #include "analysis_tool.h"
@@ -113,11 +117,12 @@ protected:
     // analyzed by a single worker thread, eliminating the need for locks.
     struct analyzer_shard_data_t {
         analyzer_shard_data_t(int index_in, std::unique_ptr<reader_t> iter_in,
-                              const std::string &trace_file_in)
+                              const std::string &trace_file_in, uint64_t file_size_in)
             : index(index_in)
             , worker(0)
             , iter(std::move(iter_in))
             , trace_file(trace_file_in)
+            , file_size(file_size_in)
         {
         }
         analyzer_shard_data_t(analyzer_shard_data_t &&src)
@@ -126,6 +131,7 @@ protected:
             worker = src.worker;
             iter = std::move(src.iter);
             trace_file = std::move(src.trace_file);
+            file_size = src.file_size;
             error = std::move(src.error);
         }
 
@@ -133,6 +139,9 @@ protected:
         int worker;
         std::unique_ptr<reader_t> iter;
         std::string trace_file;
+        // The on-disk size is used as a proxy for the work in the shard when
+        // ordering the shard queue.
+        uint64_t file_size;
         std::string error;
 
     private:
@@ -144,13 +153,86 @@ protected:
     bool
     init_file_reader(const std::string &trace_path, int verbosity = 0);
 
+    // Disables parallel analysis unless every tool supports it, and picks the
+    // default worker count.
+    void
+    init_parallel();
+
     // This finalizes the trace_iter setup.  It can block and is meant to be
     // called at the top of run() or begin().
     bool
     start_reading();
 
+    // Per-worker bookkeeping, used for load balance reporting.
+    struct analyzer_worker_data_t {
+        analyzer_worker_data_t()
+            : shard_count(0)
+            , busy_usec(0)
+        {
+        }
+        int shard_count;
+        uint64_t busy_usec;
+        std::string error;
+    };
+
+    // Returns the next shard to process, or nullptr if the queue is exhausted.
+    analyzer_shard_data_t *
+    next_shard();
+
+    void
+    process_tasks(int worker);
+
+    void
+    report_worker_balance();
+
+    // Writes the state of every tool and the serial reader position, counted in
+    // records delivered to the tools, to checkpoint_path.
+    bool
+    write_checkpoint(uint64_t records);
+
+    // Restores the tools from resume_path and returns in "records" how many
+    // records to advance past before resuming analysis.
+    bool
+    read_checkpoint(OUT uint64_t *records);
+
+    // For parallel analysis of a single stream interleaving all threads, as
+    // online traces arrive, we route each thread's memrefs to a shard owned by
+    // one worker.  The worker is fed batches through its queue, in order.
+    struct routed_shard_t {
+        routed_shard_t(int index_in, int worker_in)
+            : index(index_in)
+            , worker(worker_in)
+        {
+        }
+        int index;
+        int worker;
+        // The batch being filled by the routing thread.
+        std::vector<memref_t> pending;
+        // Only touched by the owning worker.
+        std::vector<void *> shard_data;
+    };
+    struct routed_batch_t {
+        routed_shard_t *shard;
+        std::vector<memref_t> memrefs;
+        // The shard's thread exited, or the stream ended.
+        bool last;
+    };
+    struct routed_queue_t {
+        std::mutex lock;
+        std::condition_variable cond;
+        std::deque<routed_batch_t> batches;
+        bool done = false;
+    };
+
+    bool
+    run_routed();
+
+    // Returns false if the workers hit an error.
+    bool
+    route_batch(routed_shard_t *shard, bool last);
+
     void
-    process_tasks(std::vector<analyzer_shard_data_t *> *tasks);
+    process_routed_tasks(int worker);
 
     bool success;
     std::string error_string;
@@ -159,9 +241,35 @@ protected:
     std::unique_ptr<reader_t> trace_end;
     int num_tools;
     analysis_tool_t **tools;
+    // If non-empty, print_stats() prints each tool's label before its results.
+    std::vector<std::string> tool_labels;
     bool parallel;
     int worker_count;
-    std::vector<std::vector<analyzer_shard_data_t *>> worker_tasks;
+    // Shards are handed out dynamically from this queue, largest first, so that
+    // idle workers pick up the remaining work rather than waiting on a static
+    // assignment.
+    std::vector<analyzer_shard_data_t *> shard_queue;
+    std::atomic<size_t> shard_queue_next;
+    std::vector<analyzer_worker_data_t> worker_data;
+    // The number of shard entries decoded at once and passed to each tool's
+    // parallel_shard_memref_batch().
+    static const size_t kMemrefBatchSize = 1024;
+    // For run_routed().
+    std::vector<std::unique_ptr<routed_shard_t>> routed_shards;
+    std::vector<std::unique_ptr<routed_queue_t>> routed_queues;
+    std::atomic<bool> routed_error { false };
+    // The most batches a worker can have queued before the routing thread, and
+    // thus the trace source, waits for it.
+    static const size_t kMaxRoutedBatches = 64;
+    // Instructions skipped by the reader before any tool sees the trace, per
+    // shard in parallel mode.
+    uint64_t skip_instrs = 0;
+    // Serial analysis saves checkpoints to checkpoint_path every
+    // checkpoint_interval records, if both are set, and resumes from resume_path,
+    // if set.
+    std::string checkpoint_path;
+    uint64_t checkpoint_interval = 0;
+    std::string resume_path;
     int verbosity = 0;
     const char *output_prefix = "[analyzer]";
 };
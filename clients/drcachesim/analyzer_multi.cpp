@@ -30,6 +30,7 @@
  * DAMAGE.
  */
 
+#include <sstream>
 #include "analyzer.h"
 #include "analyzer_multi.h"
 #include "analysis_tool_interface.h"
@@ -43,6 +44,7 @@
 #    include "reader/compressed_file_reader.h"
 #endif
 #include "reader/ipc_reader.h"
+#include "simulator/cache_simulator_create.h"
 #ifdef DEBUG
 #    include "tests/trace_invariants.h"
 #endif
@@ -50,12 +52,20 @@
 analyzer_multi_t::analyzer_multi_t()
 {
     worker_count = op_jobs.get_value();
+    skip_instrs = op_skip_instrs.get_value();
     // Initial measurements show it's sometimes faster to keep the parallel model
     // of using single-file readers but use them sequentially, as opposed to
     // the every-file interleaving reader, but the user can specify -jobs 1, so
     // we still keep the serial vs parallel split for 0.
     if (worker_count == 0)
         parallel = false;
+    checkpoint_path = op_checkpoint_file.get_value();
+    if (!checkpoint_path.empty())
+        checkpoint_interval = op_checkpoint_interval.get_value();
+    resume_path = op_resume_checkpoint.get_value();
+    // Checkpoints record a single position in a single stream.
+    if (!checkpoint_path.empty() || !resume_path.empty())
+        parallel = false;
     if (!create_analysis_tools()) {
         success = false;
         error_string = "Failed to create analysis tool: " + error_string;
@@ -99,14 +109,24 @@ analyzer_multi_t::analyzer_multi_t()
         }
         if (needs_processing) {
             raw2trace_directory_t dir(op_verbose.get_value());
-            std::string dir_err = dir.initialize(op_indir.get_value(), "");
+            std::string dir_err = dir.initialize(op_indir.get_value(), "",
+                                                 op_index_interval.get_value() > 0,
+                                                 op_columnar.get_value());
             if (!dir_err.empty()) {
                 success = false;
                 error_string = "Directory setup failed: " + dir_err;
             }
             raw2trace_t raw2trace(dir.modfile_bytes, dir.in_files, dir.out_files, nullptr,
                                   op_verbose.get_value(), op_jobs.get_value());
-            std::string error = raw2trace.do_conversion();
+            std::string error;
+            if (op_index_interval.get_value() > 0) {
+                error = raw2trace.set_index_files(dir.index_files,
+                                                  op_index_interval.get_value());
+            }
+            if (error.empty() && op_raw_split_size.get_value() > 0)
+                error = raw2trace.set_chunk_size(op_raw_split_size.get_value());
+            if (error.empty())
+                error = raw2trace.do_conversion();
             if (!error.empty()) {
                 success = false;
                 error_string = "raw2trace failed: " + error;
@@ -115,10 +135,28 @@ analyzer_multi_t::analyzer_multi_t()
         if (!init_file_reader(tracedir, op_verbose.get_value()))
             success = false;
     } else if (op_infile.get_value().empty()) {
-        // XXX i#3323: Add parallel analysis support for online tools.
-        parallel = false;
-        serial_trace_iter =
-            std::unique_ptr<reader_t>(new ipc_reader_t(op_ipc_name.get_value().c_str()));
+        if (!checkpoint_path.empty() || !resume_path.empty()) {
+            success = false;
+            error_string = "Checkpoints are only supported for offline traces";
+            return;
+        }
+        // If the tools support it, we analyze in parallel by routing each
+        // thread's data to its own shard.
+        verbosity = op_verbose.get_value();
+        init_parallel();
+        if (op_ipc_shm_size.get_value() > 0) {
+#ifdef LINUX
+            serial_trace_iter = std::unique_ptr<reader_t>(new ipc_reader_t(
+                op_ipc_name.get_value().c_str(), op_ipc_shm_size.get_value()));
+#else
+            success = false;
+            error_string = "-ipc_shm_size is only supported on Linux";
+            return;
+#endif
+        } else {
+            serial_trace_iter = std::unique_ptr<reader_t>(
+                new ipc_reader_t(op_ipc_name.get_value().c_str()));
+        }
         trace_end = std::unique_ptr<reader_t>(new ipc_reader_t());
         if (!*serial_trace_iter) {
             success = false;
@@ -150,38 +188,55 @@ analyzer_multi_t::create_analysis_tools()
     /* FIXME i#2006: create a single top-level tool for multi-component
      * tools.
      */
-    tools = new analysis_tool_t *[max_num_tools];
-    tools[0] = drmemtrace_analysis_tool_create();
-    if (tools[0] == NULL)
-        return false;
-    std::string tool_error;
-    if (!*tools[0]) {
-        tool_error = tools[0]->get_error_string();
-        if (tool_error.empty())
-            tool_error = "no error message provided.";
-    } else
-        tool_error = tools[0]->initialize();
-    if (!tool_error.empty()) {
-        error_string = "Tool failed to initialize: " + tool_error;
-        delete tools[0];
-        tools[0] = NULL;
-        return false;
+    // Several cache configurations are simulated by one cache simulator each, all
+    // fed from a single pass over the trace.
+    std::vector<std::string> config_files;
+    if (op_simulator_type.get_value() == CPU_CACHE) {
+        std::stringstream list(op_config_file.get_value());
+        std::string config_file;
+        while (std::getline(list, config_file, ','))
+            config_files.push_back(config_file);
+    }
+    int num_sims = config_files.size() > 1 ? static_cast<int>(config_files.size()) : 1;
+    tools = new analysis_tool_t *[num_sims + max_num_tools];
+    for (int i = 0; i < num_sims; ++i) {
+        if (num_sims > 1) {
+            tools[i] = cache_simulator_create(config_files[i]);
+            tool_labels.push_back("Configuration " + config_files[i]);
+        } else
+            tools[i] = drmemtrace_analysis_tool_create();
+        if (tools[i] == NULL)
+            return false;
+        std::string tool_error;
+        if (!*tools[i]) {
+            tool_error = tools[i]->get_error_string();
+            if (tool_error.empty())
+                tool_error = "no error message provided.";
+        } else
+            tool_error = tools[i]->initialize();
+        if (!tool_error.empty()) {
+            error_string = "Tool failed to initialize: " + tool_error;
+            delete tools[i];
+            tools[i] = NULL;
+            return false;
+        }
+        num_tools = i + 1;
     }
-    num_tools = 1;
 #ifdef DEBUG
     if (op_test_mode.get_value()) {
-        tools[1] = new trace_invariants_t(op_offline.get_value(), op_verbose.get_value());
-        if (tools[1] == NULL)
+        tools[num_tools] =
+            new trace_invariants_t(op_offline.get_value(), op_verbose.get_value());
+        if (tools[num_tools] == NULL)
             return false;
-        if (!!*tools[1])
-            tools[1]->initialize();
-        if (!*tools[1]) {
-            error_string = tools[1]->get_error_string();
-            delete tools[1];
-            tools[1] = NULL;
+        if (!!*tools[num_tools])
+            tools[num_tools]->initialize();
+        if (!*tools[num_tools]) {
+            error_string = tools[num_tools]->get_error_string();
+            delete tools[num_tools];
+            tools[num_tools] = NULL;
             return false;
         }
-        num_tools = 2;
+        ++num_tools;
     }
 #endif
     return true;
@@ -0,0 +1,133 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* columnar_ostream_t: an output stream that encodes the trace_entry_t records
+ * written to it into the gzip-compressed columnar trace format described in
+ * columnar_trace.h, for raw2trace.  Seeking is not supported, so neither is
+ * writing a trace index.
+ */
+
+#ifndef _COLUMNAR_OSTREAM_H_
+#define _COLUMNAR_OSTREAM_H_ 1
+
+#ifndef HAS_ZLIB
+#    error HAS_ZLIB is required
+#endif
+#include <fstream>
+#include <string.h>
+#include <zlib.h>
+#include "columnar_trace.h"
+
+// The stream buffer holds one block's worth of records.  Whenever it fills we
+// encode the whole records in it as a block and keep any trailing partial record
+// for the next one.
+class columnar_streambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    columnar_streambuf_t(const std::string &path)
+    {
+        file = gzopen(path.c_str(), "wb");
+        if (file == nullptr)
+            return;
+        columnar_file_header_t header = { COLUMNAR_TRACE_MAGIC, COLUMNAR_TRACE_VERSION };
+        if (gzwrite(file, &header, sizeof(header)) != sizeof(header)) {
+            gzclose(file);
+            file = nullptr;
+            return;
+        }
+        buf = new char[buffer_size];
+        // We leave an extra slot for extra_char on overflow.
+        setp(buf, buf + buffer_size - 1);
+    }
+    virtual ~columnar_streambuf_t() override
+    {
+        overflow(traits_type::eof());
+        delete[] buf;
+        if (file != nullptr)
+            gzclose(file);
+    }
+    virtual int
+    overflow(int extra_char) override
+    {
+        if (file == nullptr)
+            return traits_type::eof();
+        if (extra_char != traits_type::eof()) {
+            // Put the extra char into the buffer.  We left an extra slot for it.
+            *pptr() = traits_type::to_char_type(extra_char);
+            pbump(1);
+        }
+        int res = traits_type::not_eof(extra_char);
+        const size_t pending = pptr() - pbase();
+        const size_t count = pending / sizeof(trace_entry_t);
+        if (count > 0) {
+            block.clear();
+            columnar_encode_block(reinterpret_cast<trace_entry_t *>(pbase()),
+                                  static_cast<uint32_t>(count), &block);
+            if (gzwrite(file, block.data(), static_cast<unsigned>(block.size())) !=
+                static_cast<int>(block.size()))
+                res = traits_type::eof();
+        }
+        const size_t leftover = pending - count * sizeof(trace_entry_t);
+        memmove(buf, buf + count * sizeof(trace_entry_t), leftover);
+        setp(buf, buf + buffer_size - 1);
+        pbump(static_cast<int>(leftover));
+        return res;
+    }
+    virtual int
+    sync() override
+    {
+        if (overflow(traits_type::eof()) == traits_type::eof())
+            return -1;
+        return 0;
+    }
+
+private:
+    static const int buffer_size = COLUMNAR_BLOCK_ENTRIES * sizeof(trace_entry_t) + 1;
+    gzFile file = nullptr;
+    char *buf = nullptr;
+    std::string block;
+};
+
+class columnar_ostream_t : public std::ostream {
+public:
+    explicit columnar_ostream_t(const std::string &path)
+        : std::ostream(new columnar_streambuf_t(path))
+    {
+        if (!rdbuf())
+            setstate(std::ios::badbit);
+    }
+    virtual ~columnar_ostream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+#endif /* _COLUMNAR_OSTREAM_H_ */
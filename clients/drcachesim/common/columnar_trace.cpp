@@ -0,0 +1,220 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <string.h>
+#include "columnar_trace.h"
+
+// Predicts each entry's addr field from the entries before it in the block.  The
+// encoder and decoder make identical calls so their predictions always agree.
+class addr_predictor_t {
+public:
+    addr_predictor_t()
+        : next_pc(0)
+        , last_data(0)
+    {
+        memset(last_other, 0, sizeof(last_other));
+    }
+
+    static bool
+    is_pc(unsigned short type)
+    {
+        return type_is_instr(static_cast<trace_type_t>(type)) ||
+            type == TRACE_TYPE_INSTR_NO_FETCH || type == TRACE_TYPE_INSTR_MAYBE_FETCH;
+    }
+
+    // Only the type and size of entry are used.
+    uint64_t
+    predict(const trace_entry_t &entry)
+    {
+        if (is_pc(entry.type))
+            return next_pc;
+        if (is_data(entry.type))
+            return last_data;
+        return last_other[other_index(entry)];
+    }
+
+    void
+    update(const trace_entry_t &entry)
+    {
+        const uint64_t addr = entry.addr;
+        if (is_pc(entry.type))
+            next_pc = addr + entry.size;
+        else if (is_data(entry.type))
+            last_data = addr;
+        else {
+            last_other[other_index(entry)] = addr;
+            if (entry.type == TRACE_TYPE_INSTR_BUNDLE) {
+                // The bundled instructions follow on from the previous one.
+                for (int i = 0; i < entry.size && i < (int)sizeof(entry.length); ++i)
+                    next_pc += entry.length[i];
+            }
+        }
+    }
+
+private:
+    static bool
+    is_data(unsigned short type)
+    {
+        return type == TRACE_TYPE_READ || type == TRACE_TYPE_WRITE ||
+            type_is_prefetch(static_cast<trace_type_t>(type));
+    }
+    static size_t
+    other_index(const trace_entry_t &entry)
+    {
+        return (entry.type * 31 + entry.size) & (kOtherEntries - 1);
+    }
+
+    static const size_t kOtherEntries = 64;
+
+    uint64_t next_pc;
+    uint64_t last_data;
+    uint64_t last_other[kOtherEntries];
+};
+
+static void
+append_varint(uint64_t value, std::string *out)
+{
+    while (value >= 0x80) {
+        out->push_back(static_cast<char>((value & 0x7f) | 0x80));
+        value >>= 7;
+    }
+    out->push_back(static_cast<char>(value));
+}
+
+static bool
+read_varint(const char **cur, const char *end, uint64_t *value)
+{
+    uint64_t result = 0;
+    for (int shift = 0; shift < 64 && *cur < end; shift += 7) {
+        const unsigned char byte = static_cast<unsigned char>(*(*cur)++);
+        result |= static_cast<uint64_t>(byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0) {
+            *value = result;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+columnar_encode_block(const trace_entry_t *entries, uint32_t count, std::string *out)
+{
+    std::string types, sizes, pcs, addrs;
+    types.reserve(count);
+    sizes.reserve(count);
+    pcs.reserve(count);
+    addrs.reserve(count);
+    addr_predictor_t predictor;
+    for (uint32_t i = 0; i < count; ++i) {
+        const trace_entry_t &entry = entries[i];
+        if (entry.type < 0xff)
+            types.push_back(static_cast<char>(entry.type));
+        else {
+            types.push_back(static_cast<char>(0xff));
+            types.push_back(static_cast<char>(entry.type & 0xff));
+            types.push_back(static_cast<char>(entry.type >> 8));
+        }
+        append_varint(entry.size, &sizes);
+        const uint64_t delta =
+            static_cast<uint64_t>(entry.addr) - predictor.predict(entry);
+        // Zigzag encoding so that small negative deltas are small too.
+        append_varint((delta << 1) ^ (0 - (delta >> 63)),
+                      addr_predictor_t::is_pc(entry.type) ? &pcs : &addrs);
+        predictor.update(entry);
+    }
+    columnar_block_header_t header = { count, static_cast<uint32_t>(types.size()),
+                                       static_cast<uint32_t>(sizes.size()),
+                                       static_cast<uint32_t>(pcs.size()),
+                                       static_cast<uint32_t>(addrs.size()) };
+    out->append(reinterpret_cast<const char *>(&header), sizeof(header));
+    out->append(types);
+    out->append(sizes);
+    out->append(pcs);
+    out->append(addrs);
+}
+
+bool
+columnar_block_header_valid(const columnar_block_header_t &header)
+{
+    // Each entry takes at most 3 type bytes, 3 size bytes, and 10 address bytes.
+    return header.entry_count > 0 && header.entry_count <= COLUMNAR_BLOCK_ENTRIES &&
+        header.type_bytes >= header.entry_count &&
+        header.type_bytes <= header.entry_count * 3 &&
+        header.size_bytes >= header.entry_count &&
+        header.size_bytes <= header.entry_count * 3 &&
+        (uint64_t)header.pc_bytes + header.addr_bytes >= header.entry_count &&
+        (uint64_t)header.pc_bytes + header.addr_bytes <= header.entry_count * 10;
+}
+
+bool
+columnar_decode_block(const columnar_block_header_t &header, const char *columns,
+                      trace_entry_t *entries)
+{
+    if (!columnar_block_header_valid(header))
+        return false;
+    const char *type_cur = columns;
+    const char *const type_end = type_cur + header.type_bytes;
+    const char *size_cur = type_end;
+    const char *const size_end = size_cur + header.size_bytes;
+    const char *pc_cur = size_end;
+    const char *const pc_end = pc_cur + header.pc_bytes;
+    const char *addr_cur = pc_end;
+    const char *const addr_end = addr_cur + header.addr_bytes;
+    addr_predictor_t predictor;
+    for (uint32_t i = 0; i < header.entry_count; ++i) {
+        trace_entry_t &entry = entries[i];
+        if (type_cur >= type_end)
+            return false;
+        entry.type = static_cast<unsigned char>(*type_cur++);
+        if (entry.type == 0xff) {
+            if (type_end - type_cur < 2)
+                return false;
+            entry.type = static_cast<unsigned char>(type_cur[0]) |
+                (static_cast<unsigned char>(type_cur[1]) << 8);
+            type_cur += 2;
+        }
+        uint64_t value;
+        if (!read_varint(&size_cur, size_end, &value) || value > 0xffff)
+            return false;
+        entry.size = static_cast<unsigned short>(value);
+        bool ok = addr_predictor_t::is_pc(entry.type)
+            ? read_varint(&pc_cur, pc_end, &value)
+            : read_varint(&addr_cur, addr_end, &value);
+        if (!ok)
+            return false;
+        const uint64_t delta = (value >> 1) ^ (0 - (value & 1));
+        entry.addr = static_cast<addr_t>(predictor.predict(entry) + delta);
+        predictor.update(entry);
+    }
+    return type_cur == type_end && size_cur == size_end && pc_cur == pc_end &&
+        addr_cur == addr_end;
+}
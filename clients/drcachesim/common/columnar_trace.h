@@ -0,0 +1,94 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* columnar_trace: an alternate on-disk encoding of the trace_entry_t stream that
+ * compresses to roughly half the size of the default gzipped records.
+ *
+ * A columnar trace file begins with a columnar_file_header_t and is followed by
+ * blocks of up to COLUMNAR_BLOCK_ENTRIES entries.  Each block is a
+ * columnar_block_header_t followed by four columns:
+ * + types: one byte per entry, or 0xff followed by the 2-byte type if it does not
+ *   fit in a byte;
+ * + sizes: each size field as an unsigned LEB128 varint;
+ * + pcs: the addr field of each instruction as a zigzag varint of its difference
+ *   from the pc just past the previous instruction;
+ * + addresses: the addr field of every other entry as a zigzag varint of its
+ *   difference from the previous data address, for data references, or else from
+ *   the last value of the same type and size.
+ * Storing like fields together, and small deltas in place of absolute addresses,
+ * gives gzip much more to work with.  The prediction state starts afresh in each
+ * block, so each block can be decoded without the ones before it.
+ * The whole file is gzip-compressed.
+ */
+
+#ifndef _COLUMNAR_TRACE_H_
+#define _COLUMNAR_TRACE_H_ 1
+
+#include <string>
+#include "trace_entry.h"
+
+#define TRACE_COLUMNAR_SUFFIX "ctrace.gz"
+// The bytes "drcolumn" in little-endian order.
+#define COLUMNAR_TRACE_MAGIC 0x6e6d756c6f637264ULL
+#define COLUMNAR_TRACE_VERSION 1
+#define COLUMNAR_BLOCK_ENTRIES 4096
+
+typedef struct _columnar_file_header_t {
+    uint64_t magic;   // COLUMNAR_TRACE_MAGIC.
+    uint64_t version; // COLUMNAR_TRACE_VERSION.
+} columnar_file_header_t;
+
+typedef struct _columnar_block_header_t {
+    uint32_t entry_count; // At most COLUMNAR_BLOCK_ENTRIES.
+    uint32_t type_bytes;
+    uint32_t size_bytes;
+    uint32_t pc_bytes;
+    uint32_t addr_bytes;
+} columnar_block_header_t;
+
+// Appends a block holding the encoding of the count entries starting at entries,
+// header included, to out.  count must not exceed COLUMNAR_BLOCK_ENTRIES.
+void
+columnar_encode_block(const trace_entry_t *entries, uint32_t count, std::string *out);
+
+// Returns whether header describes a block that columnar_decode_block() could
+// accept, so that a reader can bound the column bytes it reads.
+bool
+columnar_block_header_valid(const columnar_block_header_t &header);
+
+// Decodes the columns that follow header in a block into header.entry_count
+// entries.  Returns false if the columns are malformed.
+bool
+columnar_decode_block(const columnar_block_header_t &header, const char *columns,
+                      trace_entry_t *entries);
+
+#endif /* _COLUMNAR_TRACE_H_ */
@@ -0,0 +1,118 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* gzip_istream_t: a wrapper around zlib gzFile to match the parts of the
+ * std::istream interface we use for raw2trace.  zlib reads uncompressed files
+ * transparently.  Seeking is limited to relative moves within the current
+ * buffer and to querying the position.
+ */
+
+#ifndef _GZIP_ISTREAM_H_
+#define _GZIP_ISTREAM_H_ 1
+
+#ifndef HAS_ZLIB
+#    error HAS_ZLIB is required
+#endif
+#include <fstream>
+#include <zlib.h>
+
+/* We need to override the stream buffer class which is where the file
+ * reads happen.  The stream buffer base class reads from eback()..egptr()
+ * with the next slot at gptr().
+ */
+class gzip_istreambuf_t : public std::basic_streambuf<char, std::char_traits<char>> {
+public:
+    gzip_istreambuf_t(const std::string &path)
+    {
+        file = gzopen(path.c_str(), "rb");
+        if (file != nullptr) {
+            buf = new char[buffer_size];
+            setg(buf, buf, buf);
+        }
+    }
+    virtual ~gzip_istreambuf_t() override
+    {
+        delete[] buf;
+        if (file != nullptr)
+            gzclose(file);
+    }
+    bool
+    is_open() const
+    {
+        return file != nullptr;
+    }
+    virtual int
+    underflow() override
+    {
+        if (file == nullptr)
+            return traits_type::eof();
+        if (gptr() < egptr())
+            return traits_type::to_int_type(*gptr());
+        int len = gzread(file, buf, buffer_size);
+        if (len <= 0)
+            return traits_type::eof();
+        setg(buf, buf, buf + len);
+        return traits_type::to_int_type(*gptr());
+    }
+    virtual pos_type
+    seekoff(off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::in) override
+    {
+        if (file == nullptr || dir != std::ios_base::cur || off > egptr() - gptr() ||
+            off < eback() - gptr())
+            return pos_type(off_type(-1));
+        gbump((int)off);
+        // gztell() returns the uncompressed offset of the next gzread().
+        return pos_type(gztell(file) - (egptr() - gptr()));
+    }
+
+private:
+    static const int buffer_size = 64 * 1024;
+    gzFile file = nullptr;
+    char *buf = nullptr;
+};
+
+class gzip_istream_t : public std::istream {
+public:
+    explicit gzip_istream_t(const std::string &path)
+        : std::istream(new gzip_istreambuf_t(path))
+    {
+        if (!static_cast<gzip_istreambuf_t *>(rdbuf())->is_open())
+            setstate(std::ios::failbit);
+    }
+    virtual ~gzip_istream_t() override
+    {
+        delete rdbuf();
+    }
+};
+
+#endif /* _GZIP_ISTREAM_H_ */
@@ -32,7 +32,9 @@
 
 /* gzip_ostream_t: a wrapper around zlib gzFile to match the parts of the
  * std::ostream interface we use for raw2trace and file_reader_t.
- * Seeking is not supported.
+ * Seeking is not supported.  Flushing ends the current gzip member so that the
+ * data written afterward can be decompressed on its own starting at the offset
+ * returned by tellp(), which is the offset in the compressed file.
  */
 
 #ifndef _GZIP_OSTREAM_H_
@@ -62,7 +64,8 @@ public:
     }
     virtual ~gzip_streambuf_t() override
     {
-        sync();
+        // We avoid sync() to not leave an empty gzip member at the end.
+        overflow(traits_type::eof());
         delete[] buf;
         if (file != nullptr)
             gzclose(file);
@@ -89,7 +92,23 @@ public:
     virtual int
     sync() override
     {
-        return overflow(traits_type::eof());
+        if (overflow(traits_type::eof()) == traits_type::eof())
+            return -1;
+        // Subsequent writes start a new gzip member.
+        if (gzflush(file, Z_FINISH) != Z_OK)
+            return -1;
+        return 0;
+    }
+    virtual pos_type
+    seekoff(off_type off, std::ios_base::seekdir dir,
+            std::ios_base::openmode which = std::ios_base::out) override
+    {
+        // We only support querying the position, which is only precise right
+        // after a flush.
+        if (file == nullptr || off != 0 || dir != std::ios_base::cur ||
+            pptr() > pbase())
+            return pos_type(off_type(-1));
+        return pos_type(gzoffset(file));
     }
 
 private:
@@ -52,6 +52,17 @@ droption_t<std::string> op_ipc_name(
     "for each instance of the simulator being run at any one time.  On Windows, the name "
     "is limited to 247 characters.");
 
+droption_t<bytesize_t> op_ipc_shm_size(
+    DROPTION_SCOPE_ALL, "ipc_shm_size", 0,
+    "Size of a shared-memory ring to use instead of a pipe",
+    "For online tracing and simulation, if non-zero, the target application processes "
+    "send trace data to the simulator through a shared-memory ring buffer of roughly "
+    "this many bytes rather than through the named pipe.  This avoids a system call "
+    "per write and lets the simulator process the data in place, which helps keep up "
+    "with applications producing trace data at high rates.  The ring is a file named "
+    "after -ipc_name with a .shm suffix, in /dev/shm unless -ipc_name is an absolute "
+    "path.  A size of 16M or more is recommended.  This is only supported on Linux.");
+
 droption_t<std::string> op_outdir(
     DROPTION_SCOPE_ALL, "outdir", ".", "Target directory for offline trace files",
     "For the offline analysis mode (when -offline is requested), specifies the path "
@@ -82,11 +93,40 @@ droption_t<std::string> op_infile(
 droption_t<int> op_jobs(
     DROPTION_SCOPE_ALL, "jobs", -1, "Number of parallel jobs",
     "By default, both post-processing of offline raw trace files and analysis of trace "
-    "files is parallelized.  This option controls the number of concurrent jobs.  0 "
+    "files is parallelized.  For online analysis, each traced thread is routed to "
+    "one of the jobs.  This option controls the number of concurrent jobs.  0 "
     "disables concurrency and uses a single thread to perform all operations.  A "
     "negative value sets the job count to the number of hardware threads, "
     "with a cap of 16.");
 
+droption_t<bytesize_t> op_index_interval(
+    DROPTION_SCOPE_FRONTEND, "index_interval", 0,
+    "Instructions between trace index points",
+    "If non-zero, post-processing of offline raw trace files also writes an index "
+    "file next to each trace file, dividing the trace into chunks of roughly this "
+    "many instructions that can each be decompressed on their own.  Readers use the "
+    "index to implement -skip_instrs without decoding the skipped chunks.  Smaller "
+    "values allow more precise seeking at a small cost in compression ratio.");
+
+droption_t<bytesize_t> op_raw_split_size(
+    DROPTION_SCOPE_FRONTEND, "raw_split_size", 0,
+    "Bytes per piece when converting raw files in parallel",
+    "If non-zero, post-processing of offline raw trace files splits each raw file "
+    "into pieces of roughly this many bytes, at the boundaries between the tracer's "
+    "buffers, and converts the pieces in parallel.  By default each raw file is "
+    "converted by a single job, so a trace dominated by one or two threads is "
+    "converted almost serially.  The output is identical either way.  Up to one piece "
+    "per job is held in memory along with its output.  This is not supported with "
+    "-index_interval.");
+
+droption_t<bool> op_columnar(
+    DROPTION_SCOPE_FRONTEND, "columnar", false, "Write traces in the columnar format",
+    "If true, post-processing of offline raw trace files writes each trace file in a "
+    "columnar format that stores entry types, sizes, and addresses separately, with "
+    "addresses as small differences from predicted values.  The files are typically "
+    "half the size of the default format and are read by the same tools.  This "
+    "requires zlib and is not supported with -index_interval.");
+
 droption_t<std::string> op_module_file(
     DROPTION_SCOPE_ALL, "module_file", "", "Path to modules.log for opcode_mix tool",
     "The opcode_mix tool needs the modules.log file (generated by the offline "
@@ -172,6 +212,16 @@ droption_t<bool> op_coherence(
     DROPTION_SCOPE_FRONTEND, "coherence", false, "Model coherence for private caches",
     "Writes to cache lines will invalidate other private caches that hold that line.");
 
+droption_t<unsigned int> op_sim_threads(
+    DROPTION_SCOPE_FRONTEND, "sim_threads", 0,
+    "Number of threads for simulating private caches",
+    "If non-zero, the cache simulator runs each core's private caches (those not "
+    "shared with another core) on this many worker threads, while the shared caches "
+    "are simulated on the main thread in the original trace order, producing results "
+    "identical to serial simulation.  This is only supported when no shared cache can "
+    "change the contents of a private cache: it is ignored when modeling coherence, "
+    "with an inclusive shared cache, or with -warmup_fraction.");
+
 droption_t<bool> op_use_physical(
     DROPTION_SCOPE_CLIENT, "use_physical", false, "Use physical addresses if possible",
     "If available, the default virtual addresses will be translated to physical.  "
@@ -204,6 +254,38 @@ droption_t<bytesize_t> op_max_trace_size(
     "of one internal buffer.  Once reached, instrumentation continues for that thread, "
     "but no further data is recorded.");
 
+droption_t<unsigned int> op_writer_threads(
+    DROPTION_SCOPE_CLIENT, "writer_threads", 0, 0, 64,
+    "Number of background threads writing offline trace files",
+    "By default, each application thread writes out its own full trace buffers "
+    "synchronously, stalling the application on file i/o.  If non-zero, this option "
+    "creates the specified number of background threads to which full buffers are "
+    "handed off for writing, letting the application thread continue with a fresh "
+    "buffer.  Each application thread is assigned to one writer thread.  This is only "
+    "supported with -offline and has no effect when a buffer handoff callback is "
+    "registered via drmemtrace_buffer_handoff().  See also -writer_max_pending.");
+
+droption_t<unsigned int> op_writer_max_pending(
+    DROPTION_SCOPE_CLIENT, "writer_max_pending", 2, 1, 64,
+    "Cap on each thread's buffers queued for -writer_threads",
+    "When -writer_threads is enabled, this limits the number of full buffers each "
+    "application thread may have waiting to be written.  Once the limit is reached, "
+    "the application thread takes its queued buffers back and writes them itself.  "
+    "The per-thread buffer memory is thus bounded by one more than this value times "
+    "the buffer size.");
+
+droption_t<std::string> op_raw_compress(
+    DROPTION_SCOPE_CLIENT, "raw_compress", "none",
+    "Compression for offline raw files: \"none\" or \"gzip\"",
+    "Specifies the compression applied to each thread's raw file in -offline mode. "
+    "The default, \"none\", writes the raw data as-is.  \"gzip\" compresses each "
+    "thread's stream with zlib at its fastest level, trading tracer CPU time for a "
+    "large reduction in disk space and bandwidth.  Compressed files use the suffix "
+    ".raw.gz and are read directly by raw2trace.  When combined with "
+    "-writer_threads the compression is performed on the writer threads.  This "
+    "option is ignored when the buffers are handed off via "
+    "drmemtrace_buffer_handoff().  It is only available when built with zlib.");
+
 droption_t<bytesize_t> op_trace_after_instrs(
     DROPTION_SCOPE_CLIENT, "trace_after_instrs", 0,
     "Do not start tracing until N instructions",
@@ -212,6 +294,27 @@ droption_t<bytesize_t> op_trace_after_instrs(
     "executions are observed.  At that point, regular tracing is put into place.  Use "
     "-max_trace_size to set a limit on the subsequent trace length.");
 
+droption_t<bytesize_t> op_trace_for_instrs(
+    DROPTION_SCOPE_CLIENT, "trace_for_instrs", 0,
+    "After tracing N instructions, stop tracing",
+    "If non-zero, this stops tracing once this many dynamic instruction executions "
+    "have been traced, after the -trace_after_instrs delay if any.  Tracing is "
+    "disabled by flushing the code cache and returning to uninstrumented execution, "
+    "unless -retrace_every_instrs is set.  The instruction count is approximate and is "
+    "checked when each thread's trace buffer is written out.  Each trace buffer is "
+    "labeled with a marker of type TRACE_MARKER_TYPE_WINDOW_ID holding the ordinal of "
+    "its tracing window.");
+
+droption_t<bytesize_t> op_retrace_every_instrs(
+    DROPTION_SCOPE_CLIENT, "retrace_every_instrs", 0,
+    "Trace for -trace_for_instrs every N instructions",
+    "This option only applies when -trace_for_instrs is non-zero.  It causes each "
+    "tracing window to be followed by a phase of counting this many instructions "
+    "without tracing, after which another window of -trace_for_instrs instructions is "
+    "traced.  This repeats until the application exits.  Each window is labeled with "
+    "a new TRACE_MARKER_TYPE_WINDOW_ID marker value, allowing analyzers to separate "
+    "the windows.");
+
 droption_t<bytesize_t> op_exit_after_tracing(
     DROPTION_SCOPE_CLIENT, "exit_after_tracing", 0,
     "Exit the process after tracing N references",
@@ -278,12 +381,14 @@ droption_t<std::string>
 droption_t<std::string> op_simulator_type(DROPTION_SCOPE_FRONTEND, "simulator_type",
                                           CPU_CACHE,
                                           "Simulator type (" CPU_CACHE ", " MISS_ANALYZER
-                                          ", " TLB ", " REUSE_DIST ", " REUSE_TIME
-                                          ", " HISTOGRAM ", or " BASIC_COUNTS ").",
+                                          ", " MISS_CURVE ", " TLB ", " REUSE_DIST
+                                          ", " REUSE_TIME ", " HISTOGRAM
+                                          ", or " BASIC_COUNTS ").",
                                           "Specifies the type of the simulator. "
                                           "Supported types: " CPU_CACHE ", " MISS_ANALYZER
-                                          ", " TLB ", " REUSE_DIST ", " REUSE_TIME
-                                          ", " HISTOGRAM "or " BASIC_COUNTS ".");
+                                          ", " MISS_CURVE ", " TLB ", " REUSE_DIST
+                                          ", " REUSE_TIME ", " HISTOGRAM
+                                          "or " BASIC_COUNTS ".");
 
 droption_t<unsigned int> op_verbose(DROPTION_SCOPE_ALL, "verbose", 0, 0, 64,
                                     "Verbosity level",
@@ -323,6 +428,43 @@ droption_t<bytesize_t>
                  "in the beginning of the application execution. "
                  "These memory references are dropped instead of being simulated.");
 
+droption_t<bytesize_t> op_skip_instrs(
+    DROPTION_SCOPE_FRONTEND, "skip_instrs", 0,
+    "Number of instructions to skip before analysis",
+    "Specifies the number of instruction fetches to skip at the start of the trace "
+    "before any records are passed to the analysis tools.  In parallel mode the "
+    "count applies to each trace shard separately.  When the trace was "
+    "post-processed with -index_interval, the reader seeks directly to the target "
+    "region rather than decoding the whole prefix.  Unlike -skip_refs, this is "
+    "applied by the reader, so the skipped records are not seen by any tool.");
+
+droption_t<std::string> op_checkpoint_file(
+    DROPTION_SCOPE_FRONTEND, "checkpoint_file", "",
+    "File to periodically save the analysis state to",
+    "If non-empty, serial analysis of an offline trace periodically saves the state "
+    "of the analysis tools, together with the position in the trace, to this file, "
+    "replacing the previous checkpoint.  Pass the file to -resume_checkpoint to "
+    "continue the analysis from that point after a crash or preemption.  See "
+    "-checkpoint_interval.  Setting this option disables parallel analysis.  Only "
+    "the cache simulator and the reuse distance tool support checkpoints.");
+
+droption_t<bytesize_t> op_checkpoint_interval(
+    DROPTION_SCOPE_FRONTEND, "checkpoint_interval", 100000000,
+    "Trace records between checkpoints",
+    "The number of trace records passed to the analysis tools between each "
+    "checkpoint written to -checkpoint_file.");
+
+droption_t<std::string> op_resume_checkpoint(
+    DROPTION_SCOPE_FRONTEND, "resume_checkpoint", "",
+    "File to resume the analysis from",
+    "If non-empty, the analysis tools are restored from this file written by "
+    "-checkpoint_file, and analysis of the trace continues from the position at "
+    "which the checkpoint was taken.  The trace, -skip_instrs, and the tool "
+    "configuration must match those of the run that wrote the checkpoint, except "
+    "that the cache simulator accepts different -sim_refs and -warmup_refs values.  "
+    "This allows several simulations to start from one warmed-up checkpoint.  "
+    "Setting this option disables parallel analysis.");
+
 droption_t<bytesize_t> op_warmup_refs(
     DROPTION_SCOPE_FRONTEND, "warmup_refs", 0,
     "Number of memory references to warm caches up",
@@ -355,7 +497,31 @@ droption_t<std::string>
 droption_t<std::string>
     op_config_file(DROPTION_SCOPE_FRONTEND, "config_file", "",
                    "Cache hierarchy configuration file",
-                   "The full path to the cache hierarchy configuration file.");
+                   "The full path to the cache hierarchy configuration file.  Several "
+                   "paths separated by commas simulate each configuration in turn on "
+                   "every record of a single pass over the trace, rather than reading "
+                   "the trace once per configuration.");
+
+droption_t<bytesize_t> op_miss_curve_min_size(
+    DROPTION_SCOPE_FRONTEND, "miss_curve_min_size", 4 * 1024,
+    "Smallest cache size for the miss curve",
+    "For -simulator_type " MISS_CURVE ", the smallest cache size to report.  Every "
+    "power of two from this size to -miss_curve_max_size is reported.  Must be a "
+    "power of two.");
+
+droption_t<bytesize_t> op_miss_curve_max_size(
+    DROPTION_SCOPE_FRONTEND, "miss_curve_max_size", 8 * 1024 * 1024,
+    "Largest cache size for the miss curve",
+    "For -simulator_type " MISS_CURVE ", the largest cache size to report.  Must be "
+    "a power of two.  The memory used grows with this size times the number of "
+    "associativities.");
+
+droption_t<std::string> op_miss_curve_assoc(
+    DROPTION_SCOPE_FRONTEND, "miss_curve_assoc", "1,2,4,8,16,0",
+    "Associativities for the miss curve",
+    "For -simulator_type " MISS_CURVE ", a comma-separated list of the "
+    "associativities to report, each a power of two, where 0 denotes a fully "
+    "associative cache.");
 
 // XXX: if we separate histogram + reuse_distance we should move this with them.
 droption_t<unsigned int>
@@ -363,6 +529,17 @@ droption_t<unsigned int>
                   "Number of top results to be reported",
                   "Specifies the number of top results to be reported.");
 
+// XXX: if we separate histogram + reuse_distance we should move this with them.
+droption_t<double> op_histogram_error(
+    DROPTION_SCOPE_FRONTEND, "histogram_error", 0.,
+    "Error bound for approximate histogram counts.",
+    "When non-zero, the histogram tool estimates its results in bounded memory rather "
+    "than counting every cache line exactly.  Each shard tracks only the most-referenced "
+    "lines, up to the inverse of this value, and a reported count exceeds the true "
+    "count by at most this fraction of the references; the possible overcount is "
+    "printed for each line.  The number of unique cache lines is also estimated, "
+    "typically within a few percent.");
+
 // XXX: if we separate histogram + reuse_distance we should move these with them.
 droption_t<unsigned int> op_reuse_distance_threshold(
     DROPTION_SCOPE_FRONTEND, "reuse_distance_threshold", 100,
@@ -388,6 +565,31 @@ droption_t<bool> op_reuse_verify_skip(
     "Verifies every skip list-calculated reuse distance with a full list walk. "
     "This incurs significant additional overhead.  This option is only available "
     "in debug builds.");
+droption_t<bool> op_reuse_distance_tree(
+    DROPTION_SCOPE_FRONTEND, "reuse_distance_tree", false,
+    "Use a tree to compute exact reuse distances in logarithmic time.",
+    "Computes each reuse distance by counting the distinct cache lines accessed since "
+    "the previous access with a Fenwick tree indexed by access time, in place of the "
+    "default skip list.  The cost of each access is logarithmic in the number of "
+    "distinct cache lines regardless of the distance, which is faster than the skip "
+    "list for large working sets with long reuse distances.  The results are "
+    "identical.  -reuse_skip_dist and -reuse_verify_skip do not apply.");
+droption_t<double> op_reuse_sample_rate(
+    DROPTION_SCOPE_FRONTEND, "reuse_sample_rate", 1.,
+    "Fraction of cache lines to sample for approximate reuse distances.",
+    "When below 1, only a pseudo-randomly chosen subset of cache lines, selected by "
+    "hashing their addresses, is tracked, and the reuse distances measured among "
+    "them are scaled up by the inverse of this rate.  This reduces the time and memory "
+    "used at the cost of accuracy, and implies -reuse_distance_tree.  The histogram "
+    "counts and the per-line statistics only cover the sampled lines.");
+droption_t<unsigned int> op_reuse_sample_max_lines(
+    DROPTION_SCOPE_FRONTEND, "reuse_sample_max_lines", 0,
+    "Maximum number of cache lines to track per shard, via sampling.",
+    "When non-zero, bounds the number of distinct cache lines tracked per shard by "
+    "lowering the sampling rate as needed: once the limit is exceeded, the lines with "
+    "the largest address hashes stop being tracked.  The memory used is thus bounded "
+    "no matter how large the working set.  This starts from -reuse_sample_rate and "
+    "implies -reuse_distance_tree.");
 
 #define OP_RECORD_FUNC_ITEM_SEP "&"
 // XXX i#3048: replace function return address with function callstack
@@ -44,6 +44,7 @@
 #define CPU_CACHE "cache"
 #define MISS_ANALYZER "miss_analyzer"
 #define TLB "TLB"
+#define MISS_CURVE "miss_curve"
 #define HISTOGRAM "histogram"
 #define REUSE_DIST "reuse_distance"
 #define REUSE_TIME "reuse_time"
@@ -60,10 +61,14 @@
 
 extern droption_t<bool> op_offline;
 extern droption_t<std::string> op_ipc_name;
+extern droption_t<bytesize_t> op_ipc_shm_size;
 extern droption_t<std::string> op_outdir;
 extern droption_t<std::string> op_subdir_prefix;
 extern droption_t<std::string> op_infile;
 extern droption_t<std::string> op_indir;
+extern droption_t<bytesize_t> op_index_interval;
+extern droption_t<bytesize_t> op_raw_split_size;
+extern droption_t<bool> op_columnar;
 extern droption_t<std::string> op_module_file;
 extern droption_t<unsigned int> op_num_cores;
 extern droption_t<unsigned int> op_line_size;
@@ -78,11 +83,17 @@ extern droption_t<bytesize_t> op_L0I_size;
 extern droption_t<bool> op_L0_filter;
 extern droption_t<bytesize_t> op_L0D_size;
 extern droption_t<bool> op_coherence;
+extern droption_t<unsigned int> op_sim_threads;
 extern droption_t<bool> op_use_physical;
 extern droption_t<unsigned int> op_virt2phys_freq;
 extern droption_t<bool> op_cpu_scheduling;
 extern droption_t<bytesize_t> op_max_trace_size;
+extern droption_t<unsigned int> op_writer_threads;
+extern droption_t<unsigned int> op_writer_max_pending;
+extern droption_t<std::string> op_raw_compress;
 extern droption_t<bytesize_t> op_trace_after_instrs;
+extern droption_t<bytesize_t> op_trace_for_instrs;
+extern droption_t<bytesize_t> op_retrace_every_instrs;
 extern droption_t<bytesize_t> op_exit_after_tracing;
 extern droption_t<bool> op_online_instr_types;
 extern droption_t<std::string> op_replace_policy;
@@ -107,15 +118,26 @@ extern droption_t<std::string> op_dr_ops;
 extern droption_t<std::string> op_tracer;
 extern droption_t<std::string> op_tracer_ops;
 extern droption_t<bytesize_t> op_skip_refs;
+extern droption_t<bytesize_t> op_skip_instrs;
+extern droption_t<std::string> op_checkpoint_file;
+extern droption_t<bytesize_t> op_checkpoint_interval;
+extern droption_t<std::string> op_resume_checkpoint;
 extern droption_t<bytesize_t> op_warmup_refs;
 extern droption_t<double> op_warmup_fraction;
 extern droption_t<bytesize_t> op_sim_refs;
 extern droption_t<std::string> op_config_file;
+extern droption_t<bytesize_t> op_miss_curve_min_size;
+extern droption_t<bytesize_t> op_miss_curve_max_size;
+extern droption_t<std::string> op_miss_curve_assoc;
 extern droption_t<unsigned int> op_report_top;
+extern droption_t<double> op_histogram_error;
 extern droption_t<unsigned int> op_reuse_distance_threshold;
 extern droption_t<bool> op_reuse_distance_histogram;
 extern droption_t<unsigned int> op_reuse_skip_dist;
 extern droption_t<bool> op_reuse_verify_skip;
+extern droption_t<bool> op_reuse_distance_tree;
+extern droption_t<double> op_reuse_sample_rate;
+extern droption_t<unsigned int> op_reuse_sample_max_lines;
 extern droption_t<std::string> op_view_syntax;
 extern droption_t<std::string> op_record_function;
 extern droption_t<bool> op_record_heap;
@@ -0,0 +1,175 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* shm_ring: a shared-memory ring buffer carrying trace data from the traced
+ * processes to the simulator, as a faster alternative to named_pipe_t.
+ */
+
+#ifndef _SHM_RING_H_
+#define _SHM_RING_H_ 1
+
+#include <atomic>
+#include <stdint.h>
+#include <string>
+#include <sys/types.h> // for ssize_t
+
+#ifndef OUT
+#    define OUT // nothing
+#endif
+#ifndef IN
+#    define IN // nothing
+#endif
+
+// The region is a file mapped by the simulator and by every traced process.  It
+// holds a bounded multi-producer single-consumer queue of fixed-size slots, each
+// holding one write of up to get_atomic_write_size() bytes.  Writers claim slots
+// with a compare-and-swap and publish them via per-slot sequence numbers, so no
+// lock is ever held.  Futexes let an idle reader or a writer facing a full ring
+// sleep until woken.
+//
+// Usage is as follows, mirroring named_pipe_t:
+// + The reader calls create() up front (and at the end destroy()).
+// + It then calls acquire() for each write, in claim order, which returns a
+//   pointer into the region that stays valid until release().
+// + Each writer process calls open_for_write() (and close() when done).
+//   acquire() returns nullptr once every writer that opened the region is gone
+//   and all writes have been consumed.
+//
+// Only Linux is supported.
+class shm_ring_t {
+public:
+    shm_ring_t();
+    explicit shm_ring_t(const char *name);
+    ~shm_ring_t();
+    bool
+    set_name(const char *name);
+    std::string
+    get_name() const;
+
+    // Creates the region with room for about region_size bytes of writes.
+    bool
+    create(size_t region_size);
+    bool
+    destroy();
+
+    // Maps the region created by the reader and registers this process.
+    bool
+    open_for_write();
+
+    // Rather than calling open_for_write(), the caller can map the file at
+    // get_name() itself, shared and writable, and pass the mapping here, followed
+    // by register_writer().  This is used by the tracer to keep the mapping
+    // isolated from the application.
+    bool
+    set_region(void *base, size_t size);
+    // Must be called once in each writer process, including in a child after a
+    // fork.
+    bool
+    register_writer(pid_t pid);
+
+    // For a writer, unregisters the process.  Unmaps the region if we mapped it.
+    bool
+    close();
+
+    // Copies the data into the next slot, waiting for the reader if the ring is
+    // full.  Returns false on an error or if the reader has gone away.
+    bool
+    write(const void *buf IN, size_t sz);
+
+    // Blocks until the next write is available and returns it, or returns nullptr
+    // at the end of the stream.  The data may be modified in place until
+    // release() is called.
+    void *
+    acquire(OUT size_t *sz);
+    void
+    release();
+
+    ssize_t
+    get_atomic_write_size() const;
+
+private:
+    struct slot_t {
+        // The slot is free for the write at position p when seq == p, and holds
+        // that write when seq == p + 1.
+        std::atomic<uint64_t> seq;
+        uint64_t size;
+        char data[1];
+    };
+    static const int kMaxWriters = 256;
+    struct header_t {
+        uint64_t magic;
+        uint64_t slot_count;
+        uint64_t slot_stride;
+        uint64_t slot_capacity;
+        pid_t reader_pid;
+        // Set once any writer has registered.
+        std::atomic<uint32_t> had_writer;
+        // The next position for writers to claim.
+        alignas(64) std::atomic<uint64_t> head;
+        // The next position for the reader to consume.  Only the reader writes it.
+        alignas(64) std::atomic<uint64_t> tail;
+        // Bumped when a write is published, for the reader to wait on.
+        alignas(64) std::atomic<uint32_t> data_futex;
+        std::atomic<uint32_t> reader_waiting;
+        // Bumped when a slot is released, for writers to wait on.
+        alignas(64) std::atomic<uint32_t> space_futex;
+        std::atomic<uint32_t> writers_waiting;
+        // The registered writer processes, with zero for unused entries.
+        alignas(64) std::atomic<pid_t> writer_pids[kMaxWriters];
+    };
+
+    slot_t *
+    get_slot(uint64_t pos) const
+    {
+        return reinterpret_cast<slot_t *>(reinterpret_cast<char *>(header) +
+                                          first_slot_offset +
+                                          (pos % header->slot_count) *
+                                              header->slot_stride);
+    }
+    bool
+    map_region(int fd, size_t size);
+    bool
+    any_writer_alive();
+    bool
+    is_reader_alive() const;
+
+    std::string name;
+    header_t *header = nullptr;
+    size_t region_size = 0;
+    // Whether we created or mapped the region and so must unmap it.
+    bool own_mapping = false;
+    pid_t writer_pid = 0;
+    bool holding_slot = false;
+    static const size_t first_slot_offset = 4096;
+};
+
+#endif /* _SHM_RING_H_ */
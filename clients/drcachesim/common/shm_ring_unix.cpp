@@ -0,0 +1,359 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <errno.h>
+#include <fcntl.h>
+#include <limits.h>
+#include <linux/futex.h>
+#include <signal.h>
+#include <stddef.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <time.h>
+#include <unistd.h>
+#include <new>
+#include <string>
+#include "shm_ring.h"
+
+#define SHM_RING_MAGIC 0x676e69726d656d64ULL /* "dmemring" */
+#define SHM_RING_PERMS 0666
+// Each slot holds one full tracer buffer so writes are rarely split.
+#define SHM_RING_SLOT_STRIDE (64 * 1024)
+// How often a waiting reader or writer checks whether the other side is gone.
+#define SHM_RING_POLL_NS (100 * 1000 * 1000)
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "shared-memory atomics must be lock-free");
+
+static const char *
+shm_dir()
+{
+    // FIXME i#1703: check TMPDIR, TEMP, and TMP env vars first.
+#ifdef ANDROID
+    return "/data/local/tmp";
+#else
+    return "/dev/shm";
+#endif
+}
+
+static void
+futex_wait(std::atomic<uint32_t> *word, uint32_t val)
+{
+    struct timespec timeout = { 0, SHM_RING_POLL_NS };
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAIT, val, &timeout,
+            nullptr, 0);
+}
+
+static void
+futex_wake(std::atomic<uint32_t> *word, int count)
+{
+    syscall(SYS_futex, reinterpret_cast<uint32_t *>(word), FUTEX_WAKE, count, nullptr,
+            nullptr, 0);
+}
+
+static bool
+is_process_alive(pid_t pid)
+{
+    return kill(pid, 0) == 0 || errno != ESRCH;
+}
+
+shm_ring_t::shm_ring_t()
+{
+    // empty
+}
+
+shm_ring_t::shm_ring_t(const char *name)
+{
+    set_name(name); // guaranteed to succeed
+}
+
+shm_ring_t::~shm_ring_t()
+{
+    close();
+}
+
+bool
+shm_ring_t::set_name(const char *name_in)
+{
+    if (header != nullptr)
+        return false;
+    if (name_in[0] == '/')
+        name = std::string(name_in) + ".shm";
+    else
+        name = std::string(shm_dir()) + "/" + name_in + ".shm";
+    return true;
+}
+
+std::string
+shm_ring_t::get_name() const
+{
+    return name;
+}
+
+bool
+shm_ring_t::map_region(int fd, size_t size)
+{
+    void *base = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (base == MAP_FAILED)
+        return false;
+    header = reinterpret_cast<header_t *>(base);
+    region_size = size;
+    own_mapping = true;
+    return true;
+}
+
+bool
+shm_ring_t::create(size_t size)
+{
+    static_assert(sizeof(header_t) <= first_slot_offset, "header too large");
+    uint64_t slot_count = 2;
+    if (size > first_slot_offset + 2 * SHM_RING_SLOT_STRIDE)
+        slot_count = (size - first_slot_offset) / SHM_RING_SLOT_STRIDE;
+    size = first_slot_offset + slot_count * SHM_RING_SLOT_STRIDE;
+    umask(0);
+    int fd = ::open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, SHM_RING_PERMS);
+    if (fd < 0)
+        return false;
+    bool ok = ftruncate(fd, size) == 0 && map_region(fd, size);
+    ::close(fd);
+    if (!ok) {
+        unlink(name.c_str());
+        return false;
+    }
+    // The file starts out zeroed, so we only need to set the non-zero fields.
+    header = new (header) header_t();
+    header->slot_count = slot_count;
+    header->slot_stride = SHM_RING_SLOT_STRIDE;
+    header->slot_capacity = SHM_RING_SLOT_STRIDE - offsetof(slot_t, data);
+    header->reader_pid = getpid();
+    for (uint64_t pos = 0; pos < slot_count; ++pos)
+        get_slot(pos)->seq.store(pos, std::memory_order_relaxed);
+    // Writers check the magic value last.
+    std::atomic_thread_fence(std::memory_order_release);
+    header->magic = SHM_RING_MAGIC;
+    return true;
+}
+
+bool
+shm_ring_t::destroy()
+{
+    close();
+    return unlink(name.c_str()) == 0;
+}
+
+bool
+shm_ring_t::open_for_write()
+{
+    int fd = ::open(name.c_str(), O_RDWR);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && map_region(fd, st.st_size);
+    ::close(fd);
+    if (!ok)
+        return false;
+    if (!set_region(header, region_size) || !register_writer(getpid())) {
+        close();
+        return false;
+    }
+    return true;
+}
+
+bool
+shm_ring_t::set_region(void *base, size_t size)
+{
+    if (size < first_slot_offset)
+        return false;
+    header_t *region = reinterpret_cast<header_t *>(base);
+    if (region->magic != SHM_RING_MAGIC ||
+        size < first_slot_offset + region->slot_count * region->slot_stride)
+        return false;
+    std::atomic_thread_fence(std::memory_order_acquire);
+    header = region;
+    region_size = size;
+    return true;
+}
+
+bool
+shm_ring_t::register_writer(pid_t pid)
+{
+    if (header == nullptr)
+        return false;
+    for (int i = 0; i < kMaxWriters; ++i) {
+        pid_t empty = 0;
+        if (header->writer_pids[i].compare_exchange_strong(empty, pid)) {
+            writer_pid = pid;
+            header->had_writer.store(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+bool
+shm_ring_t::close()
+{
+    if (header == nullptr)
+        return true;
+    if (writer_pid != 0) {
+        for (int i = 0; i < kMaxWriters; ++i) {
+            pid_t pid = writer_pid;
+            if (header->writer_pids[i].compare_exchange_strong(pid, 0))
+                break;
+        }
+        writer_pid = 0;
+        // Wake the reader so it notices promptly.
+        header->data_futex.fetch_add(1);
+        futex_wake(&header->data_futex, 1);
+    }
+    if (own_mapping)
+        munmap(header, region_size);
+    header = nullptr;
+    own_mapping = false;
+    holding_slot = false;
+    return true;
+}
+
+bool
+shm_ring_t::is_reader_alive() const
+{
+    return is_process_alive(header->reader_pid);
+}
+
+bool
+shm_ring_t::any_writer_alive()
+{
+    bool alive = false;
+    for (int i = 0; i < kMaxWriters; ++i) {
+        pid_t pid = header->writer_pids[i].load();
+        if (pid == 0)
+            continue;
+        if (is_process_alive(pid))
+            alive = true;
+        else {
+            // The process died without unregistering.
+            header->writer_pids[i].compare_exchange_strong(pid, 0);
+        }
+    }
+    return alive;
+}
+
+bool
+shm_ring_t::write(const void *buf IN, size_t sz)
+{
+    if (header == nullptr || sz > header->slot_capacity)
+        return false;
+    uint64_t pos = header->head.load(std::memory_order_relaxed);
+    slot_t *slot;
+    while (true) {
+        slot = get_slot(pos);
+        uint64_t seq = slot->seq.load(std::memory_order_acquire);
+        int64_t diff = static_cast<int64_t>(seq - pos);
+        if (diff == 0) {
+            if (header->head.compare_exchange_weak(pos, pos + 1,
+                                                   std::memory_order_relaxed))
+                break;
+        } else if (diff < 0) {
+            // The ring is full: wait for the reader to release this slot.
+            uint32_t val = header->space_futex.load();
+            header->writers_waiting.fetch_add(1);
+            if (static_cast<int64_t>(slot->seq.load() - pos) < 0)
+                futex_wait(&header->space_futex, val);
+            header->writers_waiting.fetch_sub(1);
+            if (!is_reader_alive())
+                return false;
+            pos = header->head.load(std::memory_order_relaxed);
+        } else
+            pos = header->head.load(std::memory_order_relaxed);
+    }
+    memcpy(slot->data, buf, sz);
+    slot->size = sz;
+    slot->seq.store(pos + 1, std::memory_order_release);
+    header->data_futex.fetch_add(1);
+    if (header->reader_waiting.load() != 0)
+        futex_wake(&header->data_futex, 1);
+    return true;
+}
+
+void *
+shm_ring_t::acquire(OUT size_t *sz)
+{
+    if (header == nullptr)
+        return nullptr;
+    if (holding_slot)
+        release();
+    uint64_t pos = header->tail.load(std::memory_order_relaxed);
+    slot_t *slot = get_slot(pos);
+    while (slot->seq.load(std::memory_order_acquire) != pos + 1) {
+        uint32_t val = header->data_futex.load();
+        header->reader_waiting.store(1);
+        if (slot->seq.load() == pos + 1)
+            break;
+        if (header->had_writer.load() != 0 && !any_writer_alive()) {
+            header->reader_waiting.store(0);
+            // A write published before its writer went away is still consumed.
+            if (slot->seq.load(std::memory_order_acquire) == pos + 1)
+                break;
+            return nullptr;
+        }
+        futex_wait(&header->data_futex, val);
+    }
+    header->reader_waiting.store(0);
+    holding_slot = true;
+    *sz = static_cast<size_t>(slot->size);
+    return slot->data;
+}
+
+void
+shm_ring_t::release()
+{
+    if (!holding_slot)
+        return;
+    holding_slot = false;
+    uint64_t pos = header->tail.load(std::memory_order_relaxed);
+    get_slot(pos)->seq.store(pos + header->slot_count, std::memory_order_release);
+    header->tail.store(pos + 1, std::memory_order_relaxed);
+    header->space_futex.fetch_add(1);
+    if (header->writers_waiting.load() != 0)
+        futex_wake(&header->space_futex, INT_MAX);
+}
+
+ssize_t
+shm_ring_t::get_atomic_write_size() const
+{
+    if (header == nullptr)
+        return 0;
+    return static_cast<ssize_t>(header->slot_capacity);
+}
@@ -225,6 +225,14 @@ typedef enum {
      */
     TRACE_MARKER_TYPE_FUNC_RETVAL,
 
+    /**
+     * The marker value contains the ordinal of the tracing window that the
+     * subsequent entries belong to, when tracing periodic windows via the
+     * -trace_for_instrs and -retrace_every_instrs options.  It follows the
+     * timestamp and cpu markers at the start of each buffer of a thread's trace.
+     */
+    TRACE_MARKER_TYPE_WINDOW_ID,
+
     // ...
     // These values are reserved for future built-in marker types.
     // ...
@@ -284,6 +292,50 @@ struct _trace_entry_t {
 } END_PACKED_STRUCTURE;
 typedef struct _trace_entry_t trace_entry_t;
 
+///////////////////////////////////////////////////////////////////////////
+//
+// Trace index format
+
+// raw2trace can write an index file next to each trace file, named by appending
+// "." TRACE_INDEX_SUFFIX to the trace file's name.  The trace file is divided into
+// chunks which each begin with a timestamp marker and, for compressed traces, are
+// separate gzip members that can be decompressed on their own.  The index file
+// holds a trace_index_header_t followed by one trace_index_entry_t per chunk in file
+// order, and then a final entry with a timestamp of TRACE_INDEX_END_TIMESTAMP whose
+// instr_count is the file's total.  Readers use it to seek forward without decoding
+// the chunks in between.
+
+#define TRACE_INDEX_SUFFIX "idx"
+#define TRACE_INDEX_VERSION 1
+#define TRACE_INDEX_END_TIMESTAMP (~(uint64_t)0)
+
+typedef struct _trace_index_header_t {
+    uint64_t version;  // TRACE_INDEX_VERSION.
+    uint64_t interval; // The requested instruction count between chunks.
+} trace_index_header_t;
+
+typedef struct _trace_index_entry_t {
+    uint64_t file_offset; // The chunk's offset in the trace file as stored on disk.
+    uint64_t instr_count; // The number of instructions in the file before the chunk.
+    uint64_t timestamp;   // The value of the timestamp marker starting the chunk.
+} trace_index_entry_t;
+
+// Returns the number of instruction fetches represented by trace_entry_t records
+// in [start, end), where each instruction in a bundle counts separately.  This matches
+// the number of instruction memref_t records that reader_t produces from them.
+static inline uint64_t
+trace_entry_instr_count(const trace_entry_t *start, const trace_entry_t *end)
+{
+    uint64_t count = 0;
+    for (const trace_entry_t *entry = start; entry < end; ++entry) {
+        if (entry->type == TRACE_TYPE_INSTR_BUNDLE)
+            count += entry->size;
+        else if (type_is_instr((trace_type_t)entry->type) && entry->size > 0)
+            ++count;
+    }
+    return count;
+}
+
 ///////////////////////////////////////////////////////////////////////////
 //
 // Offline trace format
@@ -121,4 +121,13 @@ to_hex_string(T integer)
     return sstream.str();
 }
 
+static inline bool
+ends_with(const std::string &str, const std::string &with)
+{
+    size_t pos = str.rfind(with);
+    if (pos == std::string::npos)
+        return false;
+    return (pos + with.size() == str.size());
+}
+
 #endif /* _UTILS_H_ */
@@ -0,0 +1,129 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "columnar_file_reader.h"
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<columnar_reader_t>::~file_reader_t<columnar_reader_t>()
+{
+    stop_read_ahead();
+    for (auto &file : input_files)
+        gzclose(file.file);
+    delete[] thread_eof;
+}
+
+template <>
+bool
+file_reader_t<columnar_reader_t>::open_single_file(const std::string &path)
+{
+    gzFile file = gzopen(path.c_str(), "rb");
+    if (file == nullptr)
+        return false;
+    columnar_file_header_t header;
+    if (gzread(file, &header, sizeof(header)) != sizeof(header) ||
+        header.magic != COLUMNAR_TRACE_MAGIC ||
+        header.version != COLUMNAR_TRACE_VERSION) {
+        ERRMSG("%s is not a version %d columnar trace file\n", path.c_str(),
+               COLUMNAR_TRACE_VERSION);
+        gzclose(file);
+        return false;
+    }
+    VPRINT(this, 1, "Opened columnar input file %s\n", path.c_str());
+    input_files.emplace_back(file);
+    return true;
+}
+
+template <>
+bool
+file_reader_t<columnar_reader_t>::read_next_thread_entry(size_t thread_index,
+                                                         OUT trace_entry_t *entry,
+                                                         OUT bool *eof)
+{
+    columnar_reader_t &reader = input_files[thread_index];
+    if (reader.cur_buf >= reader.max_buf) {
+        columnar_block_header_t header;
+        int len = gzread(reader.file, &header, sizeof(header));
+        if (len != (int)sizeof(header)) {
+            // As for plain files, a partial block header at the end counts as the
+            // end of the file.
+            *eof = (len >= 0);
+            reader.buf.reset();
+            reader.cur_buf = nullptr;
+            reader.max_buf = nullptr;
+            return false;
+        }
+        *eof = false;
+        if (!columnar_block_header_valid(header)) {
+            ERRMSG("Invalid columnar trace block header in thread #%zd\n",
+                   thread_index);
+            return false;
+        }
+        size_t column_bytes = (size_t)header.type_bytes + header.size_bytes +
+            header.pc_bytes + header.addr_bytes;
+        reader.columns.resize(column_bytes);
+        if (gzread(reader.file, reader.columns.data(), (unsigned)column_bytes) !=
+            (int)column_bytes) {
+            ERRMSG("Truncated columnar trace block in thread #%zd\n", thread_index);
+            return false;
+        }
+        if (!reader.buf)
+            reader.buf.reset(new trace_entry_t[COLUMNAR_BLOCK_ENTRIES]);
+        if (!columnar_decode_block(header, reader.columns.data(), reader.buf.get())) {
+            ERRMSG("Corrupt columnar trace block in thread #%zd\n", thread_index);
+            return false;
+        }
+        reader.cur_buf = reader.buf.get();
+        reader.max_buf = reader.cur_buf + header.entry_count;
+    }
+    *entry = *reader.cur_buf++;
+    VPRINT(this, 4, "Read from thread #%zd file: type=%d, size=%d, addr=%zu\n",
+           thread_index, entry->type, entry->size, entry->addr);
+    return true;
+}
+
+template <>
+bool
+file_reader_t<columnar_reader_t>::seek_thread_file(size_t thread_index, uint64_t offset)
+{
+    // Trace indices are not produced for columnar files.
+    return false;
+}
+
+template <>
+bool
+file_reader_t<columnar_reader_t>::is_complete()
+{
+    // Not supported, similar to the gzip reader.
+    return false;
+}
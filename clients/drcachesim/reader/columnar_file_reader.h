@@ -0,0 +1,68 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* columnar_file_reader: reads trace files in the columnar format described in
+ * common/columnar_trace.h.
+ */
+
+#ifndef _COLUMNAR_FILE_READER_H_
+#define _COLUMNAR_FILE_READER_H_ 1
+
+#include <memory>
+#include <vector>
+#include <zlib.h>
+#include "columnar_trace.h"
+#include "file_reader.h"
+
+// A columnar trace file along with its most recently decoded block.
+struct columnar_reader_t {
+    columnar_reader_t()
+        : file(nullptr)
+    {
+    }
+    explicit columnar_reader_t(gzFile file)
+        : file(file)
+    {
+    }
+    gzFile file;
+    // The encoded columns of the block being decoded.
+    std::vector<char> columns;
+    // The buffer is allocated on the first read and freed at the end of the file.
+    std::unique_ptr<trace_entry_t[]> buf;
+    // The entries from cur_buf up to max_buf have not yet been returned.
+    trace_entry_t *cur_buf = nullptr;
+    trace_entry_t *max_buf = nullptr;
+};
+
+typedef file_reader_t<columnar_reader_t> columnar_file_reader_t;
+
+#endif /* _COLUMNAR_FILE_READER_H_ */
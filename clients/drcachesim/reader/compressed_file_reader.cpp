@@ -30,41 +30,62 @@
  * DAMAGE.
  */
 
+#include <fcntl.h>
+#ifdef WINDOWS
+#    include <io.h>
+#else
+#    include <unistd.h>
+#endif
 #include "compressed_file_reader.h"
 
 /* clang-format off */ /* (make vera++ newline-after-type check happy) */
 template <>
 /* clang-format on */
-file_reader_t<gzFile>::~file_reader_t<gzFile>()
+file_reader_t<gzip_reader_t>::~file_reader_t<gzip_reader_t>()
 {
-    for (auto file : input_files)
-        gzclose(file);
+    stop_read_ahead();
+    for (auto &file : input_files)
+        gzclose(file.file);
     delete[] thread_eof;
 }
 
 template <>
 bool
-file_reader_t<gzFile>::open_single_file(const std::string &path)
+file_reader_t<gzip_reader_t>::open_single_file(const std::string &path)
 {
     gzFile file = gzopen(path.c_str(), "rb");
     if (file == nullptr)
         return false;
     VPRINT(this, 1, "Opened input file %s\n", path.c_str());
-    input_files.push_back(file);
+    input_files.emplace_back(file);
     return true;
 }
 
 template <>
 bool
-file_reader_t<gzFile>::read_next_thread_entry(size_t thread_index,
-                                              OUT trace_entry_t *entry, OUT bool *eof)
+file_reader_t<gzip_reader_t>::read_next_thread_entry(size_t thread_index,
+                                                     OUT trace_entry_t *entry,
+                                                     OUT bool *eof)
 {
-    int len = gzread(input_files[thread_index], (char *)entry, sizeof(*entry));
-    // Returns less than asked-for for end of file, or –1 for error.
-    if (len < (int)sizeof(*entry)) {
-        *eof = (len >= 0);
-        return false;
+    gzip_reader_t &reader = input_files[thread_index];
+    if (reader.cur_buf >= reader.max_buf) {
+        if (!reader.buf)
+            reader.buf.reset(new trace_entry_t[gzip_reader_t::kBufferEntries]);
+        int len = gzread(reader.file, reader.buf.get(),
+                         gzip_reader_t::kBufferEntries * sizeof(trace_entry_t));
+        // Returns less than asked-for for end of file, or –1 for error.
+        // We drop a partial entry at the end, as a read of just that entry would.
+        if (len < (int)sizeof(*entry)) {
+            *eof = (len >= 0);
+            reader.buf.reset();
+            reader.cur_buf = nullptr;
+            reader.max_buf = nullptr;
+            return false;
+        }
+        reader.cur_buf = reader.buf.get();
+        reader.max_buf = reader.cur_buf + (len / sizeof(trace_entry_t));
     }
+    *entry = *reader.cur_buf++;
     VPRINT(this, 4, "Read from thread #%zd file: type=%d, size=%d, addr=%zu\n",
            thread_index, entry->type, entry->size, entry->addr);
     return true;
@@ -72,7 +93,48 @@ file_reader_t<gzFile>::read_next_thread_entry(size_t thread_index,
 
 template <>
 bool
-file_reader_t<gzFile>::is_complete()
+file_reader_t<gzip_reader_t>::seek_thread_file(size_t thread_index, uint64_t offset)
+{
+    // gzseek() decompresses everything up to the target.  Instead, we reopen the
+    // file at the offset, which the index guarantees is the start of a gzip member.
+#ifdef WINDOWS
+    int fd = _open(input_file_paths[thread_index].c_str(), _O_RDONLY | _O_BINARY);
+    if (fd < 0)
+        return false;
+    if (_lseeki64(fd, offset, SEEK_SET) != (__int64)offset) {
+        _close(fd);
+        return false;
+    }
+#else
+    int fd = open(input_file_paths[thread_index].c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    if (lseek(fd, offset, SEEK_SET) != (off_t)offset) {
+        close(fd);
+        return false;
+    }
+#endif
+    gzFile file = gzdopen(fd, "rb");
+    if (file == nullptr) {
+#ifdef WINDOWS
+        _close(fd);
+#else
+        close(fd);
+#endif
+        return false;
+    }
+    gzip_reader_t &reader = input_files[thread_index];
+    gzclose(reader.file);
+    reader.file = file;
+    // Drop any entries buffered from before the seek.
+    reader.cur_buf = nullptr;
+    reader.max_buf = nullptr;
+    return true;
+}
+
+template <>
+bool
+file_reader_t<gzip_reader_t>::is_complete()
 {
     // The gzip reading interface does not support seeking to SEEK_END so there
     // is no efficient way to read the footer.
@@ -35,9 +35,31 @@
 #ifndef _COMPRESSED_FILE_READER_H_
 #define _COMPRESSED_FILE_READER_H_ 1
 
+#include <memory>
 #include <zlib.h>
 #include "file_reader.h"
 
-typedef file_reader_t<gzFile> compressed_file_reader_t;
+// A gzip file along with a buffer of decompressed entries, so that we call into
+// zlib once per block of entries rather than once per entry.
+struct gzip_reader_t {
+    gzip_reader_t()
+        : file(nullptr)
+    {
+    }
+    explicit gzip_reader_t(gzFile file)
+        : file(file)
+    {
+    }
+    gzFile file;
+    // The buffer is allocated on the first read and freed at the end of the file.
+    std::unique_ptr<trace_entry_t[]> buf;
+    // The entries from cur_buf up to max_buf have not yet been returned.
+    trace_entry_t *cur_buf = nullptr;
+    trace_entry_t *max_buf = nullptr;
+    // Large enough that zlib decompresses directly into our buffer.
+    static const int kBufferEntries = 4096;
+};
+
+typedef file_reader_t<gzip_reader_t> compressed_file_reader_t;
 
 #endif /* _COMPRESSED_FILE_READER_H_ */
@@ -143,6 +143,12 @@ config_reader_t::configure(const std::string &config_file, cache_simulator_knobs
                 ERRMSG("Error reading verbose from the configuration file\n");
                 return false;
             }
+        } else if (param == "sim_threads") {
+            // Number of private cache simulation threads.
+            if (!(fin >> knobs.sim_threads)) {
+                ERRMSG("Error reading sim_threads from the configuration file\n");
+                return false;
+            }
         } else if (param == "coherence") {
             // Whether to simulate coherence
             std::string bool_val;
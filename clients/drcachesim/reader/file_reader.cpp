@@ -38,6 +38,7 @@ template <>
 /* clang-format on */
 file_reader_t<std::ifstream *>::~file_reader_t()
 {
+    stop_read_ahead();
     for (auto fstream : input_files) {
         delete fstream;
     }
@@ -71,6 +72,14 @@ file_reader_t<std::ifstream *>::read_next_thread_entry(size_t thread_index,
     return true;
 }
 
+template <>
+bool
+file_reader_t<std::ifstream *>::seek_thread_file(size_t thread_index, uint64_t offset)
+{
+    input_files[thread_index]->clear();
+    return !!input_files[thread_index]->seekg(offset);
+}
+
 template <>
 bool
 file_reader_t<std::ifstream *>::is_complete()
@@ -39,8 +39,15 @@
 #define _FILE_READER_H_ 1
 
 #include <string.h>
+#include <algorithm>
+#include <condition_variable>
+#include <deque>
 #include <fstream>
+#include <functional>
+#include <mutex>
 #include <queue>
+#include <thread>
+#include <utility>
 #include <vector>
 #include "reader.h"
 #include "memref.h"
@@ -91,12 +98,21 @@ public:
         if (!open_input_files())
             return false;
         ++*this;
+        can_seek = true;
         return true;
     }
 
     virtual bool
     is_complete();
 
+    virtual reader_t &
+    skip_instructions(uint64_t instruction_count)
+    {
+        if (can_seek && instruction_count > 0)
+            instruction_count -= seek_using_index(instruction_count);
+        return reader_t::skip_instructions(instruction_count);
+    }
+
 protected:
     virtual bool
     read_next_thread_entry(size_t thread_index, OUT trace_entry_t *entry, OUT bool *eof);
@@ -104,6 +120,11 @@ protected:
     virtual bool
     open_single_file(const std::string &path);
 
+    // Repositions the given thread's file at the given offset as recorded in a
+    // trace index.  Returns false if unsupported or on failure.
+    virtual bool
+    seek_thread_file(size_t thread_index, uint64_t offset);
+
     virtual bool
     open_input_files()
     {
@@ -113,6 +134,7 @@ protected:
                     ERRMSG("Failed to open %s\n", path.c_str());
                     return false;
                 }
+                input_file_paths.push_back(path);
             }
         } else if (directory_iterator_t::is_directory(input_path)) {
             VPRINT(this, 1, "Iterating directory %s\n", input_path.c_str());
@@ -125,19 +147,22 @@ protected:
             }
             for (; iter != end; ++iter) {
                 std::string fname = *iter;
-                if (fname == "." || fname == "..")
+                if (fname == "." || fname == ".." ||
+                    ends_with(fname, "." TRACE_INDEX_SUFFIX))
                     continue;
                 VPRINT(this, 2, "Found file %s\n", fname.c_str());
                 if (!open_single_file(input_path + DIRSEP + fname)) {
                     ERRMSG("Failed to open %s\n", fname.c_str());
                     return false;
                 }
+                input_file_paths.push_back(input_path + DIRSEP + fname);
             }
         } else {
             if (!open_single_file(input_path)) {
                 ERRMSG("Failed to open %s\n", input_path.c_str());
                 return false;
             }
+            input_file_paths.push_back(input_path);
         }
         if (input_files.empty()) {
             ERRMSG("No thread files found.");
@@ -188,37 +213,49 @@ protected:
         // a single interleaved stream in timestamp order.
         // When a thread file runs out we leave its times[] entry as 0 and its file at
         // eof.
+        if (can_seek && input_files.size() > 1) {
+            // We can no longer seek, so we can start reading ahead.
+            start_read_ahead();
+        }
+        can_seek = false;
         while (thread_count > 0) {
             if (index >= input_files.size()) {
-                // Pick the next thread by looking for the smallest timestamp.
-                uint64_t min_time = 0xffffffffffffffff;
-                size_t next_index = 0;
-                for (size_t i = 0; i < times.size(); ++i) {
-                    if (times[i] == 0 && !thread_eof[i]) {
-                        if (!read_next_thread_entry(i, &timestamps[i], &thread_eof[i])) {
-                            ERRMSG("Failed to read from input file #%zu\n", i);
-                            return nullptr;
+                if (!times_queued) {
+                    // Read each thread's first timestamp.
+                    for (size_t i = 0; i < times.size(); ++i) {
+                        if (times[i] == 0 && !thread_eof[i]) {
+                            if (!next_thread_entry(i, &timestamps[i], &thread_eof[i])) {
+                                ERRMSG("Failed to read from input file #%zu\n", i);
+                                return nullptr;
+                            }
+                            if (timestamps[i].type != TRACE_TYPE_MARKER &&
+                                timestamps[i].size != TRACE_MARKER_TYPE_TIMESTAMP) {
+                                ERRMSG("Missing timestamp entry in input file #%zu\n",
+                                       i);
+                                return nullptr;
+                            }
+                            times[i] = timestamps[i].addr;
+                            VPRINT(this, 3,
+                                   "Thread #%zu timestamp is @0x" ZHEX64_FORMAT_STRING
+                                   "\n",
+                                   i, times[i]);
                         }
-                        if (timestamps[i].type != TRACE_TYPE_MARKER &&
-                            timestamps[i].size != TRACE_MARKER_TYPE_TIMESTAMP) {
-                            ERRMSG("Missing timestamp entry in input file #%zu\n", i);
-                            return nullptr;
-                        }
-                        times[i] = timestamps[i].addr;
-                        VPRINT(this, 3,
-                               "Thread #%zu timestamp is @0x" ZHEX64_FORMAT_STRING "\n",
-                               i, times[i]);
-                    }
-                    if (times[i] != 0 && times[i] < min_time) {
-                        min_time = times[i];
-                        next_index = i;
+                        if (times[i] != 0)
+                            next_times.push(std::make_pair(times[i], i));
                     }
+                    times_queued = true;
                 }
+                if (next_times.empty()) {
+                    ERRMSG("No input file has a pending timestamp\n");
+                    return nullptr;
+                }
+                // Pick the next thread with the smallest timestamp.
+                index = next_times.top().second;
+                next_times.pop();
                 VPRINT(this, 2,
                        "Next thread in timestamp order is #%zu @0x" ZHEX64_FORMAT_STRING
                        "\n",
-                       next_index, times[next_index]);
-                index = next_index;
+                       index, times[index]);
                 times[index] = 0; // Read from file for this thread's next timestamp.
                 // If the queue is not empty, it should contain the initial tid;pid.
                 if ((queues[index].empty() ||
@@ -235,7 +272,8 @@ protected:
                 return &entry_copy;
             }
             VPRINT(this, 4, "About to read thread #%zu\n", index);
-            if (!read_next_thread_entry(index, &entry_copy, &thread_eof[index])) {
+            trace_entry_t *entry = next_thread_entry_in_place(index, &thread_eof[index]);
+            if (entry == nullptr) {
                 if (thread_eof[index]) {
                     VPRINT(this, 2, "Thread #%zu at eof\n", index);
                     --thread_count;
@@ -252,24 +290,289 @@ protected:
                     return nullptr;
                 }
             }
-            if (entry_copy.type == TRACE_TYPE_MARKER &&
-                entry_copy.size == TRACE_MARKER_TYPE_TIMESTAMP) {
+            if (entry->type == TRACE_TYPE_MARKER &&
+                entry->size == TRACE_MARKER_TYPE_TIMESTAMP) {
                 VPRINT(this, 3, "Thread #%zu timestamp 0x" ZHEX64_FORMAT_STRING "\n",
-                       index, (uint64_t)entry_copy.addr);
-                times[index] = entry_copy.addr;
-                timestamps[index] = entry_copy;
+                       index, (uint64_t)entry->addr);
+                times[index] = entry->addr;
+                timestamps[index] = *entry;
+                next_times.push(std::make_pair(times[index], index));
                 index = input_files.size(); // Request thread scan.
                 continue;
             }
-            return &entry_copy;
+            return entry;
         }
         return nullptr;
     }
 
+    bool
+    read_index(const std::string &path, OUT std::vector<trace_index_entry_t> *index)
+    {
+        std::ifstream file(path, std::ifstream::binary);
+        if (!file)
+            return false;
+        trace_index_header_t header;
+        if (!file.read((char *)&header, sizeof(header)) ||
+            header.version != TRACE_INDEX_VERSION)
+            return false;
+        trace_index_entry_t entry;
+        while (file.read((char *)&entry, sizeof(entry)))
+            index->push_back(entry);
+        // Without the end entry the index is incomplete.
+        return !index->empty() && index->back().timestamp == TRACE_INDEX_END_TIMESTAMP;
+    }
+
+    // If every thread file has an index, picks the latest chunk timestamp T such
+    // that at most instruction_count instructions precede T in the merged stream.
+    // Each thread is then repositioned at its first timestamp at or after T by
+    // seeking to its last chunk starting at or before T and discarding the rest of
+    // that chunk before T.  The merged stream then resumes exactly where it would
+    // have after all records prior to T.  Returns the number of instructions
+    // skipped, which is 0 if the index could not be used.
+    uint64_t
+    seek_using_index(uint64_t instruction_count)
+    {
+        std::vector<std::vector<trace_index_entry_t>> indices(input_files.size());
+        std::vector<uint64_t> candidates;
+        for (size_t i = 0; i < input_files.size(); ++i) {
+            if (!read_index(input_file_paths[i] + "." TRACE_INDEX_SUFFIX, &indices[i]))
+                return 0;
+            // A thread with no chunks has no timestamps and thus no records for
+            // us to seek to.
+            if (indices[i].size() < 2)
+                return 0;
+            for (size_t j = 0; j + 1 < indices[i].size(); ++j)
+                candidates.push_back(indices[i][j].timestamp);
+        }
+        auto chunk_before = [](const trace_index_entry_t &chunk, uint64_t timestamp) {
+            return chunk.timestamp < timestamp;
+        };
+        // The instructions before T in any one thread are bounded by the count at
+        // its first chunk at or after T.  This bound only grows with T.
+        std::sort(candidates.begin(), candidates.end());
+        uint64_t target = 0, target_bound = 0;
+        for (uint64_t timestamp : candidates) {
+            uint64_t bound = 0;
+            for (const auto &index : indices) {
+                bound += std::lower_bound(index.begin(), index.end(), timestamp,
+                                          chunk_before)
+                             ->instr_count;
+            }
+            if (bound > instruction_count)
+                break;
+            target = timestamp;
+            target_bound = bound;
+        }
+        if (target_bound == 0)
+            return 0;
+        VPRINT(this, 1, "Seeking to timestamp 0x" ZHEX64_FORMAT_STRING "\n", target);
+        uint64_t skipped = 0;
+        for (size_t i = 0; i < input_files.size(); ++i) {
+            if (thread_eof[i])
+                continue;
+            // The final entry is the end marker so it is never chosen here.
+            auto chunk = std::lower_bound(indices[i].begin(), indices[i].end() - 1,
+                                          target + 1, chunk_before);
+            if (chunk != indices[i].begin())
+                --chunk;
+            if (!seek_thread_file(i, chunk->file_offset)) {
+                ERRMSG("Failed to seek in input file #%zu\n", i);
+                at_eof = true;
+                return 0;
+            }
+            skipped += chunk->instr_count;
+            // Keep the initial tid and pid if they have not been delivered yet.
+            bool header_pending = false;
+            trace_entry_t pid;
+            while (!queues[i].empty()) {
+                if (queues[i].front().type == TRACE_TYPE_PID) {
+                    header_pending = true;
+                    pid = queues[i].front();
+                }
+                queues[i].pop();
+            }
+            if (header_pending) {
+                queues[i].push(tids[i]);
+                queues[i].push(pid);
+            }
+            times[i] = 0;
+            trace_entry_t entry;
+            while (true) {
+                if (!read_next_thread_entry(i, &entry, &thread_eof[i])) {
+                    if (!thread_eof[i]) {
+                        ERRMSG("Failed to read from input file #%zu\n", i);
+                        at_eof = true;
+                        return 0;
+                    }
+                    VPRINT(this, 2, "Thread #%zu at eof\n", i);
+                    --thread_count;
+                    break;
+                }
+                if (entry.type == TRACE_TYPE_MARKER &&
+                    entry.size == TRACE_MARKER_TYPE_TIMESTAMP && entry.addr >= target) {
+                    timestamps[i] = entry;
+                    times[i] = entry.addr;
+                    break;
+                }
+                skipped += trace_entry_instr_count(&entry, &entry + 1);
+            }
+        }
+        VPRINT(this, 1, "Skipped %llu instructions via the index\n",
+               (unsigned long long)skipped);
+        index = input_files.size(); // Request thread scan.
+        next_times = times_queue_t();
+        times_queued = false;
+        if (thread_count == 0)
+            at_eof = true;
+        else
+            ++*this;
+        return skipped;
+    }
+
+    // For the serial merge of multiple files, we read each file's entries in
+    // blocks on background threads so the consumer does not wait for reads and
+    // decompression.  Each file has at most one block being consumed and one
+    // being filled, and is only read once the merge reaches it.
+    struct read_ahead_block_t {
+        std::vector<trace_entry_t> entries;
+        bool eof = false;    // The file ended after these entries.
+        bool failed = false; // A read error occurred after these entries.
+    };
+    struct read_ahead_file_t {
+        read_ahead_block_t current;
+        size_t pos = 0;
+        read_ahead_block_t next;
+        bool next_requested = false;
+        bool next_ready = false;
+    };
+
+    void
+    start_read_ahead()
+    {
+        read_ahead.resize(input_files.size());
+        size_t num_threads = input_files.size();
+        if (num_threads > kReadAheadThreadsMax)
+            num_threads = kReadAheadThreadsMax;
+        VPRINT(this, 1, "Reading ahead with %zu threads\n", num_threads);
+        for (size_t i = 0; i < num_threads; ++i) {
+            read_ahead_threads.push_back(
+                std::thread(&file_reader_t::read_ahead_loop, this));
+        }
+    }
+
+    // Must be called by the destructor before closing the files.
+    void
+    stop_read_ahead()
+    {
+        {
+            std::lock_guard<std::mutex> guard(read_ahead_mutex);
+            read_ahead_exit = true;
+        }
+        read_ahead_request.notify_all();
+        for (std::thread &thread : read_ahead_threads)
+            thread.join();
+        read_ahead_threads.clear();
+    }
+
+    // The caller must hold read_ahead_mutex.
+    void
+    request_read_ahead(size_t thread_index)
+    {
+        read_ahead[thread_index].next_requested = true;
+        read_ahead_queue.push_back(thread_index);
+        read_ahead_request.notify_one();
+    }
+
+    void
+    read_ahead_loop()
+    {
+        std::unique_lock<std::mutex> lock(read_ahead_mutex);
+        while (true) {
+            read_ahead_request.wait(
+                lock, [this] { return read_ahead_exit || !read_ahead_queue.empty(); });
+            if (read_ahead_exit)
+                return;
+            size_t thread_index = read_ahead_queue.front();
+            read_ahead_queue.pop_front();
+            // The consumer does not touch a requested block until it is ready.
+            read_ahead_block_t &block = read_ahead[thread_index].next;
+            lock.unlock();
+            block.entries.reserve(kReadAheadEntries);
+            trace_entry_t entry;
+            while (block.entries.size() < kReadAheadEntries) {
+                bool eof = false;
+                if (!read_next_thread_entry(thread_index, &entry, &eof)) {
+                    block.eof = eof;
+                    block.failed = !eof;
+                    break;
+                }
+                block.entries.push_back(entry);
+            }
+            lock.lock();
+            read_ahead[thread_index].next_ready = true;
+            read_ahead_ready.notify_all();
+        }
+    }
+
+    // Reads the next entry for the given thread, from the read-ahead blocks if
+    // we are reading ahead and otherwise directly from the file.
+    bool
+    next_thread_entry(size_t thread_index, OUT trace_entry_t *entry, OUT bool *eof)
+    {
+        if (read_ahead.empty())
+            return read_next_thread_entry(thread_index, entry, eof);
+        read_ahead_file_t &file = read_ahead[thread_index];
+        if (file.pos >= file.current.entries.size()) {
+            if (file.current.eof || file.current.failed) {
+                *eof = file.current.eof;
+                std::vector<trace_entry_t>().swap(file.current.entries);
+                return false;
+            }
+            std::unique_lock<std::mutex> lock(read_ahead_mutex);
+            if (!file.next_requested)
+                request_read_ahead(thread_index);
+            read_ahead_ready.wait(lock, [&file] { return file.next_ready; });
+            std::swap(file.current, file.next);
+            file.pos = 0;
+            file.next.entries.clear();
+            file.next_requested = false;
+            file.next_ready = false;
+            // Start on the following block while this one is consumed.
+            if (!file.current.eof && !file.current.failed)
+                request_read_ahead(thread_index);
+            lock.unlock();
+            if (file.current.entries.empty())
+                return next_thread_entry(thread_index, entry, eof);
+        }
+        *entry = file.current.entries[file.pos++];
+        return true;
+    }
+
+    // Returns the next entry for the given thread, or nullptr with *eof set as for
+    // next_thread_entry().  The entry is only valid until the next call.  Readers
+    // whose entries are already in memory specialize this to hand them out in place
+    // rather than copying each one.
+    trace_entry_t *
+    next_thread_entry_in_place(size_t thread_index, OUT bool *eof)
+    {
+        if (!next_thread_entry(thread_index, &entry_copy, eof))
+            return nullptr;
+        return &entry_copy;
+    }
+
+    // Enough to amortize the synchronization while keeping the memory for traces
+    // with many threads modest.
+    static const size_t kReadAheadEntries = 4096;
+    static const size_t kReadAheadThreadsMax = 4;
+
 private:
     std::string input_path;
     std::vector<std::string> input_path_list;
     std::vector<T> input_files;
+    std::vector<std::string> input_file_paths;
+    // Whether no records have been read since init(), which is when we can use
+    // a trace index to seek.
+    bool can_seek = false;
     trace_entry_t entry_copy;
     // The current thread we're processing is "index".  If it's set to input_files.size()
     // that means we need to pick a new thread.
@@ -279,7 +582,24 @@ private:
     std::vector<trace_entry_t> tids;
     std::vector<trace_entry_t> timestamps;
     std::vector<uint64_t> times;
+    // The threads waiting to continue and their timestamps, smallest first, with
+    // ties going to the lowest index.
+    typedef std::priority_queue<std::pair<uint64_t, size_t>,
+                                std::vector<std::pair<uint64_t, size_t>>,
+                                std::greater<std::pair<uint64_t, size_t>>>
+        times_queue_t;
+    times_queue_t next_times;
+    // Whether next_times holds every thread with a pending timestamp, which is not
+    // the case before we first read the timestamps or after seeking.
+    bool times_queued = false;
     bool *thread_eof = nullptr;
+    std::vector<read_ahead_file_t> read_ahead;
+    std::vector<std::thread> read_ahead_threads;
+    std::deque<size_t> read_ahead_queue;
+    std::mutex read_ahead_mutex;
+    std::condition_variable read_ahead_request;
+    std::condition_variable read_ahead_ready;
+    bool read_ahead_exit = false;
 };
 
 #endif /* _FILE_READER_H_ */
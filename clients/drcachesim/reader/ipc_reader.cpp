@@ -54,6 +54,16 @@ ipc_reader_t::ipc_reader_t(const char *ipc_name)
     creation_success = pipe.create();
 }
 
+#ifdef LINUX
+ipc_reader_t::ipc_reader_t(const char *ipc_name, size_t shm_size)
+    : ring(ipc_name)
+    , use_ring(true)
+{
+    // As with the pipe, we create the ring before any writer can look for it.
+    creation_success = ring.create(shm_size);
+}
+#endif
+
 // Work around clang-format bug: no newline after return type for single-char operator.
 // clang-format off
 bool
@@ -66,6 +76,10 @@ ipc_reader_t::operator!()
 std::string
 ipc_reader_t::get_pipe_name() const
 {
+#ifdef LINUX
+    if (use_ring)
+        return ring.get_name();
+#endif
     return pipe.get_name();
 }
 
@@ -73,9 +87,16 @@ bool
 ipc_reader_t::init()
 {
     at_eof = false;
-    if (!creation_success || !pipe.open_for_read())
+    if (!creation_success)
         return false;
-    pipe.maximize_buffer();
+#ifdef LINUX
+    if (!use_ring)
+#endif
+    {
+        if (!pipe.open_for_read())
+            return false;
+        pipe.maximize_buffer();
+    }
     cur_buf = buf;
     end_buf = buf;
     ++*this;
@@ -84,6 +105,13 @@ ipc_reader_t::init()
 
 ipc_reader_t::~ipc_reader_t()
 {
+#ifdef LINUX
+    if (use_ring) {
+        if (creation_success)
+            ring.destroy();
+        return;
+    }
+#endif
     pipe.close();
     pipe.destroy();
 }
@@ -91,9 +119,30 @@ ipc_reader_t::~ipc_reader_t()
 trace_entry_t *
 ipc_reader_t::read_next_entry()
 {
+    // The caller reads on past the footer we synthesize at the end.  For a ring,
+    // end_buf points into the last slot, so we must not compare against it.
+    if (at_eof)
+        return NULL;
     ++cur_buf;
     if (cur_buf >= end_buf) {
-        ssize_t sz = pipe.read(buf, sizeof(buf)); // blocking read
+        ssize_t sz;
+#ifdef LINUX
+        if (use_ring) {
+            // We consume the entries in place in the ring, releasing the previous
+            // slot only now that we are done with its entries.
+            size_t slot_size;
+            trace_entry_t *slot =
+                reinterpret_cast<trace_entry_t *>(ring.acquire(&slot_size));
+            if (slot == nullptr)
+                sz = -1;
+            else {
+                sz = static_cast<ssize_t>(slot_size);
+                cur_buf = slot;
+                end_buf = slot + (sz / sizeof(*end_buf));
+            }
+        } else
+#endif
+            sz = pipe.read(buf, sizeof(buf)); // blocking read
         if (sz < 0 || sz % sizeof(*end_buf) != 0) {
             // We aren't able to easily distinguish truncation from a clean
             // end (we could at least ensure the prior entry was a thread exit
@@ -105,8 +154,13 @@ ipc_reader_t::read_next_entry()
             at_eof = true;
             return cur_buf;
         }
-        cur_buf = buf;
-        end_buf = buf + (sz / sizeof(*end_buf));
+#ifdef LINUX
+        if (!use_ring)
+#endif
+        {
+            cur_buf = buf;
+            end_buf = buf + (sz / sizeof(*end_buf));
+        }
     }
     if (cur_buf->type == TRACE_TYPE_FOOTER)
         at_eof = true;
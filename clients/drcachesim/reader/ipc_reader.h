@@ -41,12 +41,19 @@
 #include "reader.h"
 #include "../common/memref.h"
 #include "../common/named_pipe.h"
+#ifdef LINUX
+#    include "../common/shm_ring.h"
+#endif
 #include "../common/trace_entry.h"
 
 class ipc_reader_t : public reader_t {
 public:
     ipc_reader_t();
     explicit ipc_reader_t(const char *ipc_name);
+#ifdef LINUX
+    // Reads from a shared-memory ring of about shm_size bytes instead of a pipe.
+    ipc_reader_t(const char *ipc_name, size_t shm_size);
+#endif
     virtual ~ipc_reader_t();
     virtual bool operator!();
     // This potentially blocks.
@@ -68,6 +75,10 @@ protected:
 
 private:
     named_pipe_t pipe;
+#ifdef LINUX
+    shm_ring_t ring;
+    bool use_ring = false;
+#endif
     bool creation_success;
 
     // For efficiency we want to read large chunks at a time.
@@ -76,6 +87,7 @@ private:
     // time.
     static const int BUF_SIZE = 16 * 1024;
     trace_entry_t buf[BUF_SIZE];
+    // These point into buf, or for a ring, into the ring's current slot.
     trace_entry_t *cur_buf;
     trace_entry_t *end_buf;
 };
@@ -0,0 +1,175 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "mmap_file_reader.h"
+
+/* clang-format off */ /* (make vera++ newline-after-type check happy) */
+template <>
+/* clang-format on */
+file_reader_t<mmap_reader_t>::~file_reader_t<mmap_reader_t>()
+{
+    stop_read_ahead();
+    for (auto &file : input_files) {
+        if (file.map_base != nullptr)
+            munmap(file.map_base, file.map_size);
+    }
+    delete[] thread_eof;
+}
+
+template <>
+bool
+file_reader_t<mmap_reader_t>::open_single_file(const std::string &path)
+{
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0) {
+        close(fd);
+        return false;
+    }
+    mmap_reader_t file;
+    if (st.st_size > 0) {
+        file.map_size = static_cast<size_t>(st.st_size);
+        // The reader rewrites some entries as it delivers them, so we map the file
+        // privately and writably: only the pages it touches are copied.
+        void *map = mmap(nullptr, file.map_size, PROT_READ | PROT_WRITE, MAP_PRIVATE,
+                         fd, 0);
+        if (map == MAP_FAILED) {
+            close(fd);
+            return false;
+        }
+        file.map_base = map;
+        // We read each file front to back exactly once.  These are only hints, so
+        // we ignore failures.
+        madvise(map, file.map_size, MADV_SEQUENTIAL);
+        madvise(map, file.map_size, MADV_WILLNEED);
+#ifdef MADV_HUGEPAGE
+        madvise(map, file.map_size, MADV_HUGEPAGE);
+#endif
+        file.cur = reinterpret_cast<trace_entry_t *>(map);
+        file.end = file.cur + file.map_size / sizeof(trace_entry_t);
+    }
+    // The mapping stays valid after the descriptor is closed.
+    close(fd);
+    VPRINT(this, 1, "Mapped input file %s\n", path.c_str());
+    input_files.push_back(file);
+    return true;
+}
+
+template <>
+bool
+file_reader_t<mmap_reader_t>::read_next_thread_entry(size_t thread_index,
+                                                     OUT trace_entry_t *entry,
+                                                     OUT bool *eof)
+{
+    mmap_reader_t &file = input_files[thread_index];
+    if (file.cur >= file.end) {
+        *eof = true;
+        return false;
+    }
+    *entry = *file.cur++;
+    VPRINT(this, 4, "Read from thread #%zd file: type=%d, size=%d, addr=%zu\n",
+           thread_index, entry->type, entry->size, entry->addr);
+    return true;
+}
+
+template <>
+trace_entry_t *
+file_reader_t<mmap_reader_t>::next_thread_entry_in_place(size_t thread_index,
+                                                         OUT bool *eof)
+{
+    mmap_reader_t &file = input_files[thread_index];
+    if (file.cur >= file.end) {
+        *eof = true;
+        return nullptr;
+    }
+    VPRINT(this, 4, "Read from thread #%zd file: type=%d, size=%d, addr=%zu\n",
+           thread_index, file.cur->type, file.cur->size, file.cur->addr);
+    return file.cur++;
+}
+
+template <>
+void
+file_reader_t<mmap_reader_t>::start_read_ahead()
+{
+    // The kernel reads ahead in the mapping for us.
+}
+
+template <>
+bool
+file_reader_t<mmap_reader_t>::seek_thread_file(size_t thread_index, uint64_t offset)
+{
+    mmap_reader_t &file = input_files[thread_index];
+    if (offset > file.map_size || offset % sizeof(trace_entry_t) != 0)
+        return false;
+    file.cur = reinterpret_cast<trace_entry_t *>(
+        reinterpret_cast<char *>(file.map_base) + offset);
+    return true;
+}
+
+template <>
+bool
+file_reader_t<mmap_reader_t>::is_complete()
+{
+    // As for the ifstream reader, we only support a single file before init().
+    bool opened_temporarily = false;
+    if (input_files.empty()) {
+        opened_temporarily = true;
+        if (!input_path_list.empty() || input_path.empty() ||
+            directory_iterator_t::is_directory(input_path))
+            return false; // Not supported.
+        if (!open_single_file(input_path))
+            return false;
+    }
+    bool res = false;
+    for (auto &file : input_files) {
+        res = file.map_base != nullptr &&
+            file.end > reinterpret_cast<trace_entry_t *>(file.map_base) &&
+            (file.end - 1)->type == TRACE_TYPE_FOOTER;
+        if (!res)
+            break;
+    }
+    if (opened_temporarily) {
+        // Put things back for init().
+        for (auto &file : input_files) {
+            if (file.map_base != nullptr)
+                munmap(file.map_base, file.map_size);
+        }
+        input_files.clear();
+    }
+    return res;
+}
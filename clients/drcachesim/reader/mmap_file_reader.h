@@ -0,0 +1,67 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* mmap_file_reader: reads uncompressed trace files by mapping them into memory
+ * and handing out their entries in place.
+ */
+
+#ifndef _MMAP_FILE_READER_H_
+#define _MMAP_FILE_READER_H_ 1
+
+#include "file_reader.h"
+
+// An uncompressed trace file mapped into memory.
+struct mmap_reader_t {
+    // The whole file is mapped at map_base.  An empty file is not mapped.
+    void *map_base = nullptr;
+    size_t map_size = 0;
+    // The entries from cur up to end have not yet been returned.  A partial
+    // entry at the end of the file is ignored.
+    trace_entry_t *cur = nullptr;
+    trace_entry_t *end = nullptr;
+};
+
+typedef file_reader_t<mmap_reader_t> mmap_file_reader_t;
+
+// The mapping already holds every entry, so we neither read ahead on background
+// threads nor copy entries out of it.  These must be declared before any use
+// instantiates the default versions.
+template <>
+void
+file_reader_t<mmap_reader_t>::start_read_ahead();
+
+template <>
+trace_entry_t *
+file_reader_t<mmap_reader_t>::next_thread_entry_in_place(size_t thread_index,
+                                                         OUT bool *eof);
+
+#endif /* _MMAP_FILE_READER_H_ */
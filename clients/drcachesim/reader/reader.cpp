@@ -198,3 +198,14 @@ reader_t::operator++()
 
     return *this;
 }
+
+reader_t &
+reader_t::skip_instructions(uint64_t instruction_count)
+{
+    while (instruction_count > 0 && !at_eof) {
+        if (type_is_instr(cur_ref.instr.type))
+            --instruction_count;
+        ++*this;
+    }
+    return *this;
+}
@@ -97,6 +97,13 @@ public:
     virtual reader_t &
     operator++();
 
+    // Skips the next instruction_count instruction fetches along with all other
+    // records interleaved with them, leaving the current record as the first one
+    // after the last skipped instruction.  Subclasses may override this to seek
+    // rather than decode the skipped records.  Must be called after init().
+    virtual reader_t &
+    skip_instructions(uint64_t instruction_count);
+
     // Supplied for subclasses that may fail in their constructors.
     virtual bool operator!()
     {
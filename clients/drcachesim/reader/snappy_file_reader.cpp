@@ -215,7 +215,7 @@ template <>
 /* clang-format on */
 file_reader_t<snappy_reader_t>::~file_reader_t<snappy_reader_t>()
 {
-    // Empty.
+    stop_read_ahead();
 }
 
 template <>
@@ -247,6 +247,14 @@ file_reader_t<snappy_reader_t>::read_next_thread_entry(size_t thread_index,
     return true;
 }
 
+template <>
+bool
+file_reader_t<snappy_reader_t>::seek_thread_file(size_t thread_index, uint64_t offset)
+{
+    // Trace indices are not produced for snappy files.
+    return false;
+}
+
 template <>
 bool
 file_reader_t<snappy_reader_t>::is_complete()
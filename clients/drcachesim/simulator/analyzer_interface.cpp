@@ -35,6 +35,7 @@
 #include "../common/options.h"
 #include "../common/utils.h"
 #include "cache_simulator_create.h"
+#include "miss_curve_create.h"
 #include "tlb_simulator_create.h"
 /* XXX i#2006: we include these here for now but it's undecided whether they
  * should be separated and this should only include
@@ -110,6 +111,7 @@ get_cache_simulator_knobs()
     knobs->sim_refs = op_sim_refs.get_value();
     knobs->verbose = op_verbose.get_value();
     knobs->cpu_scheduling = op_cpu_scheduling.get_value();
+    knobs->sim_threads = op_sim_threads.get_value();
     return knobs;
 }
 
@@ -129,6 +131,17 @@ drmemtrace_analysis_tool_create()
         return cache_miss_analyzer_create(*knobs, op_miss_count_threshold.get_value(),
                                           op_miss_frac_threshold.get_value(),
                                           op_confidence_threshold.get_value());
+    } else if (op_simulator_type.get_value() == MISS_CURVE) {
+        miss_curve_knobs_t knobs;
+        knobs.line_size = op_line_size.get_value();
+        knobs.min_size = op_miss_curve_min_size.get_value();
+        knobs.max_size = op_miss_curve_max_size.get_value();
+        knobs.assoc = op_miss_curve_assoc.get_value();
+        knobs.skip_refs = op_skip_refs.get_value();
+        knobs.warmup_refs = op_warmup_refs.get_value();
+        knobs.sim_refs = op_sim_refs.get_value();
+        knobs.verbose = op_verbose.get_value();
+        return miss_curve_create(knobs);
     } else if (op_simulator_type.get_value() == TLB) {
         tlb_simulator_knobs_t knobs;
         knobs.num_cores = op_num_cores.get_value();
@@ -149,7 +162,8 @@ drmemtrace_analysis_tool_create()
         return tlb_simulator_create(knobs);
     } else if (op_simulator_type.get_value() == HISTOGRAM) {
         return histogram_tool_create(op_line_size.get_value(), op_report_top.get_value(),
-                                     op_verbose.get_value());
+                                     op_verbose.get_value(),
+                                     op_histogram_error.get_value());
     } else if (op_simulator_type.get_value() == REUSE_DIST) {
         reuse_distance_knobs_t knobs;
         knobs.line_size = op_line_size.get_value();
@@ -158,6 +172,9 @@ drmemtrace_analysis_tool_create()
         knobs.report_top = op_report_top.get_value();
         knobs.skip_list_distance = op_reuse_skip_dist.get_value();
         knobs.verify_skip = op_reuse_verify_skip.get_value();
+        knobs.use_tree = op_reuse_distance_tree.get_value();
+        knobs.sample_rate = op_reuse_sample_rate.get_value();
+        knobs.sample_max_lines = op_reuse_sample_max_lines.get_value();
         knobs.verbose = op_verbose.get_value();
         return reuse_distance_tool_create(knobs);
     } else if (op_simulator_type.get_value() == REUSE_TIME) {
@@ -178,7 +195,8 @@ drmemtrace_analysis_tool_create()
                                 op_verbose.get_value());
     } else {
         ERRMSG("Usage error: unsupported analyzer type. "
-               "Please choose " CPU_CACHE ", " MISS_ANALYZER ", " TLB ", " HISTOGRAM
+               "Please choose " CPU_CACHE ", " MISS_ANALYZER ", " MISS_CURVE
+               ", " TLB ", " HISTOGRAM
                ", " REUSE_DIST ", " BASIC_COUNTS ", " OPCODE_MIX " or " VIEW ".\n");
         return nullptr;
     }
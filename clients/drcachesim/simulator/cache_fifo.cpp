@@ -57,7 +57,7 @@ cache_fifo_t::init(int associativity_, int block_size_, int total_size,
     // Create a replacement pointer for each set, and
     // initialize it to point to the first block.
     for (int i = 0; i < blocks_per_set; i++) {
-        get_caching_device_block(i << assoc_bits, 0).counter = 1;
+        get_counter(i << assoc_bits, 0) = 1;
     }
     return true;
 }
@@ -75,12 +75,11 @@ cache_fifo_t::replace_which_way(int block_idx)
 {
     // We replace the block whose counter is 1.
     for (int i = 0; i < associativity; i++) {
-        if (get_caching_device_block(block_idx, i).counter == 1) {
+        if (get_counter(block_idx, i) == 1) {
             // clear the counter of the victim block
-            get_caching_device_block(block_idx, i).counter = 0;
+            get_counter(block_idx, i) = 0;
             // set the next block as victim
-            get_caching_device_block(block_idx, (i + 1) & (associativity - 1)).counter =
-                1;
+            get_counter(block_idx, (i + 1) & (associativity - 1)) = 1;
             return i;
         }
     }
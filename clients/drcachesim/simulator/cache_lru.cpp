@@ -40,17 +40,17 @@
 void
 cache_lru_t::access_update(int line_idx, int way)
 {
-    int cnt = get_caching_device_block(line_idx, way).counter;
+    int cnt = get_counter(line_idx, way);
     // Optimization: return early if it is a repeated access.
     if (cnt == 0)
         return;
-    // We inc all the counters that are not larger than cnt for LRU.
-    for (int i = 0; i < associativity; ++i) {
-        if (i != way && get_caching_device_block(line_idx, i).counter <= cnt)
-            get_caching_device_block(line_idx, i).counter++;
-    }
+    // We inc all the counters that are not larger than cnt for LRU.  The counters
+    // for a set are contiguous so this loop has no branches to mispredict.
+    int *set_counters = &get_counter(line_idx, 0);
+    for (int i = 0; i < associativity; ++i)
+        set_counters[i] += set_counters[i] <= cnt;
     // Clear the counter for LRU.
-    get_caching_device_block(line_idx, way).counter = 0;
+    set_counters[way] = 0;
 }
 
 int
@@ -60,16 +60,16 @@ cache_lru_t::replace_which_way(int line_idx)
     int max_counter = 0;
     int max_way = 0;
     for (int way = 0; way < associativity; ++way) {
-        if (get_caching_device_block(line_idx, way).tag == TAG_INVALID) {
+        if (get_tag(line_idx, way) == TAG_INVALID) {
             max_way = way;
             break;
         }
-        if (get_caching_device_block(line_idx, way).counter > max_counter) {
-            max_counter = get_caching_device_block(line_idx, way).counter;
+        if (get_counter(line_idx, way) > max_counter) {
+            max_counter = get_counter(line_idx, way);
             max_way = way;
         }
     }
     // Set to non-zero for later access_update optimization on repeated access
-    get_caching_device_block(line_idx, max_way).counter = 1;
+    get_counter(line_idx, max_way) = 1;
     return max_way;
 }
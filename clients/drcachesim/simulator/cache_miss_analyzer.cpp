@@ -174,12 +174,28 @@ cache_miss_analyzer_t::cache_miss_analyzer_t(const cache_simulator_knobs_t &knob
 std::vector<prefetching_recommendation_t *>
 cache_miss_analyzer_t::generate_recommendations()
 {
+    drain_sim_workers();
     return ll_stats->generate_recommendations();
 }
 
+bool
+cache_miss_analyzer_t::save_checkpoint(std::ostream &out)
+{
+    error_string = "Checkpoints are not supported by the cache miss analyzer";
+    return false;
+}
+
+bool
+cache_miss_analyzer_t::load_checkpoint(std::istream &in)
+{
+    error_string = "Checkpoints are not supported by the cache miss analyzer";
+    return false;
+}
+
 bool
 cache_miss_analyzer_t::print_results()
 {
+    drain_sim_workers();
     std::vector<prefetching_recommendation_t *> recommendations =
         ll_stats->generate_recommendations();
 
@@ -150,6 +150,13 @@ public:
     virtual bool
     print_results();
 
+    // The per-load miss records are not part of a checkpoint, so checkpoints
+    // are refused rather than silently losing them.
+    virtual bool
+    save_checkpoint(std::ostream &out);
+    virtual bool
+    load_checkpoint(std::istream &in);
+
 private:
     cache_miss_stats_t *ll_stats;
 
@@ -0,0 +1,370 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include "cache_sim_workers.h"
+#include <assert.h>
+
+// Counts a private cache's hits that would have been passed to its shared parent's
+// statistics.
+class link_stats_t : public caching_device_stats_t {
+public:
+    link_stats_t()
+        : caching_device_stats_t("")
+        , hits(0)
+    {
+    }
+    void
+    access(const memref_t &memref, bool hit, caching_device_block_t *cache_block) override
+    {
+        assert(false); // Only a child's accesses should get here.
+    }
+    void
+    child_access(const memref_t &memref, bool hit,
+                 caching_device_block_t *cache_block) override
+    {
+        if (hit)
+            ++hits;
+    }
+    int_least64_t hits;
+};
+
+// The per-worker state.  The shared events for each batch go into the event list
+// selected by the batch's generation, so that the workers can fill one while the
+// feeding thread replays the other.
+class cache_sim_worker_t {
+public:
+    cache_sim_worker_t()
+        : index(0)
+        , generation(0)
+    {
+    }
+    void
+    record(shared_event_t::type_t type, caching_device_t *target,
+           const memref_t &memref, int_least64_t count = 0)
+    {
+        events[generation & 1].emplace_back(index, type, target, memref, count);
+    }
+    // The batch position of the entry being simulated.
+    uint32_t index;
+    uint64_t generation;
+    std::vector<shared_event_t> events[2];
+    std::vector<cache_link_t *> links;
+    std::vector<caching_device_t *> caches;
+};
+
+cache_link_t::cache_link_t(cache_sim_worker_t *worker_, caching_device_t *target_)
+    : worker(worker_)
+    , target(target_)
+{
+    set_stats(new link_stats_t);
+}
+
+cache_link_t::~cache_link_t()
+{
+    delete get_stats();
+}
+
+void
+cache_link_t::request(const memref_t &memref)
+{
+    worker->record(shared_event_t::REQUEST, target, memref);
+}
+
+void
+cache_link_t::flush(const memref_t &memref)
+{
+    worker->record(shared_event_t::FLUSH, target, memref);
+}
+
+void
+cache_link_t::record_child_hits()
+{
+    link_stats_t *link_stats = static_cast<link_stats_t *>(get_stats());
+    if (link_stats->hits == 0)
+        return;
+    worker->record(shared_event_t::CHILD_HITS, target, memref_t(), link_stats->hits);
+    link_stats->hits = 0;
+}
+
+const uint16_t cache_sim_workers_t::RESET_OWNER;
+const uint32_t cache_sim_workers_t::BATCH_SIZE;
+
+cache_sim_workers_t::cache_sim_workers_t()
+    : filling(&batches[0])
+    , in_flight(nullptr)
+    , generation(0)
+    , num_done(0)
+    , exiting(false)
+{
+}
+
+cache_sim_workers_t::~cache_sim_workers_t()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        exiting = true;
+    }
+    work_ready.notify_all();
+    for (std::thread &thread : threads)
+        thread.join();
+    for (cache_link_t *link : links)
+        delete link;
+    for (cache_sim_worker_t *worker : workers)
+        delete worker;
+}
+
+bool
+cache_sim_workers_t::init(unsigned int num_threads, unsigned int num_cores,
+                          cache_t **l1_icaches, cache_t **l1_dcaches,
+                          const std::unordered_map<std::string, cache_t *> &all_caches,
+                          std::string &error)
+{
+    // Find the single core whose L1 caches each cache serves, if there is one.
+    const int SHARED = -1;
+    std::unordered_map<caching_device_t *, int> cache_core;
+    for (unsigned int core = 0; core < num_cores; ++core) {
+        for (caching_device_t *cache = l1_icaches[core]; cache != nullptr;
+             cache = cache->get_parent()) {
+            auto it = cache_core.find(cache);
+            if (it == cache_core.end())
+                cache_core[cache] = core;
+            else if (it->second != (int)core)
+                it->second = SHARED;
+        }
+        for (caching_device_t *cache = l1_dcaches[core]; cache != nullptr;
+             cache = cache->get_parent()) {
+            auto it = cache_core.find(cache);
+            if (it == cache_core.end())
+                cache_core[cache] = core;
+            else if (it->second != (int)core)
+                it->second = SHARED;
+        }
+    }
+    for (const auto &it : all_caches) {
+        auto core_it = cache_core.find(it.second);
+        if (core_it == cache_core.end() || core_it->second == SHARED) {
+            // An inclusive cache invalidates its children's lines when it evicts.
+            if (it.second->is_inclusive()) {
+                error = "shared cache " + it.first + " is inclusive";
+                return false;
+            }
+            shared_caches.push_back(it.second);
+        }
+    }
+
+    if (num_threads > num_cores)
+        num_threads = num_cores;
+    for (unsigned int i = 0; i < num_threads; ++i)
+        workers.push_back(new cache_sim_worker_t);
+    core_worker.resize(num_cores);
+    for (unsigned int core = 0; core < num_cores; ++core) {
+        core_worker[core] = (uint16_t)(core % num_threads);
+        icaches.push_back(l1_icaches[core]);
+        dcaches.push_back(l1_dcaches[core]);
+    }
+    for (const auto &it : cache_core) {
+        if (it.second == SHARED)
+            continue;
+        caching_device_t *cache = it.first;
+        cache_sim_worker_t *worker = workers[core_worker[it.second]];
+        worker->caches.push_back(cache);
+        caching_device_t *parent = cache->get_parent();
+        if (parent != nullptr && cache_core[parent] == SHARED) {
+            cache_link_t *link = new cache_link_t(worker, parent);
+            links.push_back(link);
+            worker->links.push_back(link);
+            cache->set_parent(link);
+        }
+    }
+    for (batch_t &batch : batches)
+        batch.entries.resize(num_threads);
+    for (unsigned int i = 0; i < num_threads; ++i)
+        threads.emplace_back(&cache_sim_workers_t::worker_main, this, i);
+    return true;
+}
+
+void
+cache_sim_workers_t::add_entry(int core, entry_type_t type, caching_device_t *cache,
+                               const memref_t &memref)
+{
+    uint16_t owner = core_worker[core];
+    filling->entries[owner].push_back(
+        { (uint32_t)filling->owner.size(), type, cache, memref });
+    filling->owner.push_back(owner);
+    if (filling->owner.size() >= BATCH_SIZE)
+        dispatch();
+}
+
+void
+cache_sim_workers_t::request(int core, bool icache, const memref_t &memref)
+{
+    add_entry(core, ENTRY_REQUEST, icache ? icaches[core] : dcaches[core], memref);
+}
+
+void
+cache_sim_workers_t::flush(int core, bool icache, const memref_t &memref)
+{
+    add_entry(core, ENTRY_FLUSH, icache ? icaches[core] : dcaches[core], memref);
+}
+
+void
+cache_sim_workers_t::reset_stats()
+{
+    uint32_t index = (uint32_t)filling->owner.size();
+    for (std::vector<entry_t> &entries : filling->entries)
+        entries.push_back({ index, ENTRY_RESET, nullptr, memref_t() });
+    filling->owner.push_back(RESET_OWNER);
+    if (filling->owner.size() >= BATCH_SIZE)
+        dispatch();
+}
+
+void
+cache_sim_workers_t::wait_for_workers()
+{
+    std::unique_lock<std::mutex> guard(lock);
+    work_done.wait(guard, [this] { return num_done == workers.size(); });
+}
+
+void
+cache_sim_workers_t::dispatch()
+{
+    batch_t *finished = in_flight;
+    uint64_t finished_generation = generation;
+    if (finished != nullptr)
+        wait_for_workers();
+    in_flight = filling;
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        ++generation;
+        num_done = 0;
+    }
+    work_ready.notify_all();
+    // Replay the previous batch while the workers simulate this one.
+    if (finished != nullptr) {
+        replay(*finished, finished_generation);
+        filling = finished;
+    } else
+        filling = in_flight == &batches[0] ? &batches[1] : &batches[0];
+    for (std::vector<entry_t> &entries : filling->entries)
+        entries.clear();
+    filling->owner.clear();
+}
+
+void
+cache_sim_workers_t::drain()
+{
+    if (in_flight == nullptr && filling->owner.empty())
+        return;
+    dispatch();
+    wait_for_workers();
+    replay(*in_flight, generation);
+    in_flight = nullptr;
+}
+
+void
+cache_sim_workers_t::replay(batch_t &batch, uint64_t batch_generation)
+{
+    std::vector<size_t> cursor(workers.size(), 0);
+    auto replay_worker = [&](unsigned int w, uint32_t index) {
+        const std::vector<shared_event_t> &events =
+            workers[w]->events[batch_generation & 1];
+        for (; cursor[w] < events.size() && events[cursor[w]].index <= index;
+             ++cursor[w]) {
+            const shared_event_t &event = events[cursor[w]];
+            switch (event.type) {
+            case shared_event_t::REQUEST: event.target->request(event.memref); break;
+            case shared_event_t::FLUSH:
+                static_cast<cache_t *>(event.target)->flush(event.memref);
+                break;
+            case shared_event_t::CHILD_HITS:
+                event.target->get_stats()->child_hits(event.count);
+                break;
+            }
+        }
+    };
+    for (uint32_t index = 0; index < batch.owner.size(); ++index) {
+        if (batch.owner[index] == RESET_OWNER) {
+            for (unsigned int w = 0; w < workers.size(); ++w)
+                replay_worker(w, index);
+            for (caching_device_t *cache : shared_caches)
+                cache->get_stats()->reset();
+        } else
+            replay_worker(batch.owner[index], index);
+    }
+    // Finally, the child hits recorded at the end of the batch.
+    for (unsigned int w = 0; w < workers.size(); ++w)
+        replay_worker(w, UINT32_MAX);
+}
+
+void
+cache_sim_workers_t::worker_main(unsigned int worker_index)
+{
+    cache_sim_worker_t *worker = workers[worker_index];
+    uint64_t last_generation = 0;
+    while (true) {
+        batch_t *batch;
+        {
+            std::unique_lock<std::mutex> guard(lock);
+            work_ready.wait(guard,
+                            [&] { return exiting || generation != last_generation; });
+            if (exiting)
+                return;
+            last_generation = generation;
+            batch = in_flight;
+        }
+        worker->generation = last_generation;
+        worker->events[last_generation & 1].clear();
+        for (const entry_t &entry : batch->entries[worker_index]) {
+            worker->index = entry.index;
+            switch (entry.type) {
+            case ENTRY_REQUEST: entry.cache->request(entry.memref); break;
+            case ENTRY_FLUSH:
+                static_cast<cache_t *>(entry.cache)->flush(entry.memref);
+                break;
+            case ENTRY_RESET:
+                for (cache_link_t *link : worker->links)
+                    link->record_child_hits();
+                for (caching_device_t *cache : worker->caches)
+                    cache->get_stats()->reset();
+                break;
+            }
+        }
+        worker->index = UINT32_MAX;
+        for (cache_link_t *link : worker->links)
+            link->record_child_hits();
+        {
+            std::lock_guard<std::mutex> guard(lock);
+            ++num_done;
+        }
+        work_done.notify_one();
+    }
+}
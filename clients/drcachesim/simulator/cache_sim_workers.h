@@ -0,0 +1,197 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* cache_sim_workers: simulates private caches on worker threads for -sim_threads.
+ */
+
+#ifndef _CACHE_SIM_WORKERS_H_
+#define _CACHE_SIM_WORKERS_H_ 1
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+#include "cache.h"
+#include "memref.h"
+
+// Each core's private caches, meaning those whose subtree holds the L1 caches of
+// that core alone, are simulated on one of a set of worker threads.  Caches shared
+// by several cores are simulated on the thread that feeds us memrefs, which
+// replays the shared-cache events that the workers record in the original trace
+// order.  Memrefs are handed out in batches: the workers simulate one batch while
+// the feeding thread replays the previous batch's shared events and gathers the
+// next batch, so the private and shared caches run concurrently.
+//
+// This produces identical results to serial simulation only if nothing flows from a
+// shared cache back into a private cache.
+
+class cache_sim_worker_t;
+
+// One of the events the workers record for replay on a shared cache.
+struct shared_event_t {
+    enum type_t {
+        REQUEST,
+        FLUSH,
+        CHILD_HITS,
+    };
+    shared_event_t(uint32_t index_, type_t type_, caching_device_t *target_,
+                   const memref_t &memref_, int_least64_t count_)
+        : index(index_)
+        , type(type_)
+        , target(target_)
+        , memref(memref_)
+        , count(count_)
+    {
+    }
+    // The position within the batch of the memref that caused this event.
+    uint32_t index;
+    type_t type;
+    caching_device_t *target;
+    memref_t memref;
+    int_least64_t count;
+};
+
+// A stand-in parent for a private cache whose real parent is shared.  It records
+// what would have been passed to the real parent for later replay.
+class cache_link_t : public cache_t {
+public:
+    cache_link_t(cache_sim_worker_t *worker, caching_device_t *target);
+    ~cache_link_t() override;
+    void
+    request(const memref_t &memref) override;
+    void
+    flush(const memref_t &memref) override;
+    // Records the child hits counted since the last call, if any.
+    void
+    record_child_hits();
+
+protected:
+    void
+    init_blocks() override
+    {
+    }
+
+private:
+    cache_sim_worker_t *worker;
+    caching_device_t *target;
+};
+
+class cache_sim_workers_t {
+public:
+    cache_sim_workers_t();
+    ~cache_sim_workers_t();
+
+    // Splits the hierarchy at the boundary between private and shared caches and
+    // starts the worker threads.  The caller must rule out coherence and
+    // -warmup_fraction, which read or write private caches from shared ones.  Returns
+    // false and sets "error" if the hierarchy cannot otherwise be split without
+    // changing the simulation results, leaving the hierarchy untouched.
+    bool
+    init(unsigned int num_threads, unsigned int num_cores, cache_t **l1_icaches,
+         cache_t **l1_dcaches,
+         const std::unordered_map<std::string, cache_t *> &all_caches,
+         std::string &error);
+
+    // These queue up an operation on one of a core's L1 caches.
+    void
+    request(int core, bool icache, const memref_t &memref);
+    void
+    flush(int core, bool icache, const memref_t &memref);
+    // Queues up a reset of the statistics for all caches.
+    void
+    reset_stats();
+
+    // Completes all queued operations.  This must be called before examining the
+    // state of any cache.
+    void
+    drain();
+
+private:
+    enum entry_type_t {
+        ENTRY_REQUEST,
+        ENTRY_FLUSH,
+        ENTRY_RESET,
+    };
+    struct entry_t {
+        uint32_t index;
+        entry_type_t type;
+        caching_device_t *cache;
+        memref_t memref;
+    };
+    // A batch is split into a per-worker list of entries, plus the order in which to
+    // visit the workers when replaying shared events.  A reset is sent to every
+    // worker and is marked with "owner" value of RESET_OWNER.
+    struct batch_t {
+        std::vector<std::vector<entry_t>> entries;
+        std::vector<uint16_t> owner;
+    };
+    static const uint16_t RESET_OWNER = 0xffff;
+    static const uint32_t BATCH_SIZE = 16 * 1024;
+
+    void
+    add_entry(int core, entry_type_t type, caching_device_t *cache,
+              const memref_t &memref);
+    void
+    dispatch();
+    void
+    wait_for_workers();
+    void
+    replay(batch_t &batch, uint64_t batch_generation);
+    void
+    worker_main(unsigned int worker_index);
+
+    std::vector<cache_sim_worker_t *> workers;
+    std::vector<std::thread> threads;
+    std::vector<cache_link_t *> links;
+    // Caches simulated on this thread, for reset_stats().
+    std::vector<caching_device_t *> shared_caches;
+    // Per-core L1 caches and owning worker.
+    std::vector<caching_device_t *> icaches;
+    std::vector<caching_device_t *> dcaches;
+    std::vector<uint16_t> core_worker;
+
+    // We fill one batch while the workers simulate the other.
+    batch_t batches[2];
+    batch_t *filling;
+    batch_t *in_flight;
+
+    std::mutex lock;
+    std::condition_variable work_ready;
+    std::condition_variable work_done;
+    uint64_t generation;
+    unsigned int num_done;
+    bool exiting;
+};
+
+#endif /* _CACHE_SIM_WORKERS_H_ */
@@ -32,6 +32,7 @@
 
 #include <iostream>
 #include <iterator>
+#include <map>
 #include <string>
 #include <assert.h>
 #include <limits.h>
@@ -156,6 +157,7 @@ cache_simulator_t::cache_simulator_t(const cache_simulator_knobs_t &knobs_)
         success = false;
         return;
     }
+    init_sim_workers();
 }
 
 cache_simulator_t::cache_simulator_t(const std::string &config_file)
@@ -348,10 +350,46 @@ cache_simulator_t::cache_simulator_t(const std::string &config_file)
         success = false;
         return;
     }
+    init_sim_workers();
+}
+
+void
+cache_simulator_t::init_sim_workers()
+{
+    if (knobs.sim_threads == 0)
+        return;
+    // Both coherence and the loaded fraction check read private cache state while
+    // simulating shared caches.
+    std::string reason;
+    if (knobs.model_coherence)
+        reason = "coherence is modeled";
+    else if (knobs.warmup_fraction > 0.0)
+        reason = "-warmup_fraction is set";
+    else {
+        sim_workers = new cache_sim_workers_t;
+        if (sim_workers->init(knobs.sim_threads, knobs.num_cores, l1_icaches,
+                              l1_dcaches, all_caches, reason))
+            return;
+        delete sim_workers;
+        sim_workers = nullptr;
+    }
+    if (knobs.verbose >= 1) {
+        std::cerr << "Simulating serially as " << reason
+                  << ": -sim_threads is not supported\n";
+    }
+}
+
+void
+cache_simulator_t::drain_sim_workers()
+{
+    if (sim_workers != nullptr)
+        sim_workers->drain();
 }
 
 cache_simulator_t::~cache_simulator_t()
 {
+    // The workers refer to the caches, so they must go first.
+    delete sim_workers;
     for (auto &caches_it : all_caches) {
         cache_t *cache = caches_it.second;
         delete cache->get_stats();
@@ -431,7 +469,10 @@ cache_simulator_t::process_memref(const memref_t &memref)
                       << " @" << (void *)memref.instr.addr << " instr x"
                       << memref.instr.size << "\n";
         }
-        l1_icaches[core]->request(memref);
+        if (sim_workers != nullptr)
+            sim_workers->request(core, true, memref);
+        else
+            l1_icaches[core]->request(memref);
     } else if (memref.data.type == TRACE_TYPE_READ ||
                memref.data.type == TRACE_TYPE_WRITE ||
                // We may potentially handle prefetches differently.
@@ -443,21 +484,30 @@ cache_simulator_t::process_memref(const memref_t &memref)
                       << trace_type_names[memref.data.type] << " "
                       << (void *)memref.data.addr << " x" << memref.data.size << "\n";
         }
-        l1_dcaches[core]->request(memref);
+        if (sim_workers != nullptr)
+            sim_workers->request(core, false, memref);
+        else
+            l1_dcaches[core]->request(memref);
     } else if (memref.flush.type == TRACE_TYPE_INSTR_FLUSH) {
         if (knobs.verbose >= 3) {
             std::cerr << "::" << memref.data.pid << "." << memref.data.tid << ":: "
                       << " @" << (void *)memref.data.pc << " iflush "
                       << (void *)memref.data.addr << " x" << memref.data.size << "\n";
         }
-        l1_icaches[core]->flush(memref);
+        if (sim_workers != nullptr)
+            sim_workers->flush(core, true, memref);
+        else
+            l1_icaches[core]->flush(memref);
     } else if (memref.flush.type == TRACE_TYPE_DATA_FLUSH) {
         if (knobs.verbose >= 3) {
             std::cerr << "::" << memref.data.pid << "." << memref.data.tid << ":: "
                       << " @" << (void *)memref.data.pc << " dflush "
                       << (void *)memref.data.addr << " x" << memref.data.size << "\n";
         }
-        l1_dcaches[core]->flush(memref);
+        if (sim_workers != nullptr)
+            sim_workers->flush(core, false, memref);
+        else
+            l1_dcaches[core]->flush(memref);
     } else if (memref.exit.type == TRACE_TYPE_THREAD_EXIT) {
         handle_thread_exit(memref.exit.tid);
         last_thread = 0;
@@ -475,9 +525,13 @@ cache_simulator_t::process_memref(const memref_t &memref)
 
     // reset cache stats when warming up is completed
     if (!is_warmed_up && check_warmed_up()) {
-        for (auto &cache_it : all_caches) {
-            cache_t *cache = cache_it.second;
-            cache->get_stats()->reset();
+        if (sim_workers != nullptr)
+            sim_workers->reset_stats();
+        else {
+            for (auto &cache_it : all_caches) {
+                cache_t *cache = cache_it.second;
+                cache->get_stats()->reset();
+            }
         }
         if (knobs.verbose >= 1) {
             std::cerr << "Cache simulation warmed up\n";
@@ -489,6 +543,82 @@ cache_simulator_t::process_memref(const memref_t &memref)
     return true;
 }
 
+bool
+cache_simulator_t::save_checkpoint(std::ostream &out)
+{
+    // The caches must be quiescent for their state to be consistent.
+    drain_sim_workers();
+    // We record how many references each phase has consumed rather than how many
+    // remain, so that a resumed run can ask for a different -sim_refs than the run
+    // which wrote the checkpoint.
+    out << "cache_simulator 1\n"
+        << knob_skip_refs - knobs.skip_refs << " " << knob_warmup_refs - knobs.warmup_refs
+        << " " << knob_sim_refs - knobs.sim_refs << " " << is_warmed_up << "\n";
+    if (!save_core_state(out)) {
+        error_string = "Failed to write the core state";
+        return false;
+    }
+    // Write the caches in name order so that the file does not depend on hash order.
+    std::map<std::string, cache_t *> sorted(all_caches.begin(), all_caches.end());
+    out << sorted.size() << "\n";
+    for (auto &cache_it : sorted) {
+        out << cache_it.first << "\n";
+        if (!cache_it.second->save_state(out) ||
+            !cache_it.second->get_stats()->save_state(out)) {
+            error_string = "Failed to write the state of the cache " + cache_it.first;
+            return false;
+        }
+    }
+    if (knobs.model_coherence && !snoop_filter->save_state(out)) {
+        error_string = "Failed to write the snoop filter state";
+        return false;
+    }
+    return true;
+}
+
+bool
+cache_simulator_t::load_checkpoint(std::istream &in)
+{
+    std::string magic;
+    int version;
+    if (!(in >> magic >> version) || magic != "cache_simulator" || version != 1) {
+        error_string = "Checkpoint was not written by this cache simulator version";
+        return false;
+    }
+    uint64_t skipped, warmed, simulated;
+    if (!(in >> skipped >> warmed >> simulated >> is_warmed_up) || !load_core_state(in)) {
+        error_string = "Checkpoint core state does not match the configuration";
+        return false;
+    }
+    knobs.skip_refs = knob_skip_refs > skipped ? knob_skip_refs - skipped : 0;
+    knobs.warmup_refs = knob_warmup_refs > warmed ? knob_warmup_refs - warmed : 0;
+    knobs.sim_refs = knob_sim_refs > simulated ? knob_sim_refs - simulated : 0;
+    size_t num_caches;
+    if (!(in >> num_caches) || num_caches != all_caches.size()) {
+        error_string = "Checkpoint cache hierarchy does not match the configuration";
+        return false;
+    }
+    for (size_t i = 0; i < num_caches; i++) {
+        std::string name;
+        if (!(in >> name) || all_caches.find(name) == all_caches.end()) {
+            error_string = "Checkpoint cache hierarchy does not match the configuration";
+            return false;
+        }
+        cache_t *cache = all_caches[name];
+        if (!cache->load_state(in) || !cache->get_stats()->load_state(in)) {
+            error_string = "Checkpoint state does not match the configuration of the "
+                           "cache " +
+                name;
+            return false;
+        }
+    }
+    if (knobs.model_coherence && !snoop_filter->load_state(in)) {
+        error_string = "Checkpoint snoop filter state does not match the configuration";
+        return false;
+    }
+    return true;
+}
+
 // Return true if the number of warmup references have been executed or if
 // specified fraction of the llcaches has been loaded. Also return true if the
 // cache has already been warmed up. When there are multiple last level caches
@@ -533,6 +663,7 @@ cache_simulator_t::check_warmed_up()
 bool
 cache_simulator_t::print_results()
 {
+    drain_sim_workers();
     std::cerr << "Cache simulation results:\n";
     // Print core and associated L1 cache stats first.
     for (unsigned int i = 0; i < knobs.num_cores; i++) {
@@ -41,6 +41,7 @@
 #include "cache_simulator_create.h"
 #include "cache_stats.h"
 #include "cache.h"
+#include "cache_sim_workers.h"
 #include "snoop_filter.h"
 
 class cache_simulator_t : public simulator_t {
@@ -59,6 +60,10 @@ public:
     process_memref(const memref_t &memref);
     virtual bool
     print_results();
+    virtual bool
+    save_checkpoint(std::ostream &out);
+    virtual bool
+    load_checkpoint(std::istream &in);
 
     // Exposed to make it easy to test
     bool
@@ -71,6 +76,14 @@ protected:
     virtual cache_t *
     create_cache(const std::string &policy);
 
+    // Starts -sim_threads parallel simulation if requested and possible.
+    void
+    init_sim_workers();
+    // Completes any parallel simulation in progress, so that cache state and
+    // statistics can be examined.
+    void
+    drain_sim_workers();
+
     cache_simulator_knobs_t knobs;
 
     // Implement a set of ICaches and DCaches with pointer arrays.
@@ -91,6 +104,9 @@ protected:
     // Snoop filter tracks ownership of cache lines across private caches.
     snoop_filter_t *snoop_filter = nullptr;
 
+    // Simulates private caches on separate threads for -sim_threads.
+    cache_sim_workers_t *sim_workers = nullptr;
+
 private:
     bool is_warmed_up;
 };
@@ -68,6 +68,7 @@ struct cache_simulator_knobs_t {
         , sim_refs(1ULL << 63)
         , cpu_scheduling(false)
         , verbose(0)
+        , sim_threads(0)
     {
     }
     unsigned int num_cores;
@@ -88,6 +89,7 @@ struct cache_simulator_knobs_t {
     uint64_t sim_refs;
     bool cpu_scheduling;
     unsigned int verbose;
+    unsigned int sim_threads;
 };
 
 /** Creates an instance of a cache simulator with a 2-level hierarchy. */
@@ -93,3 +93,20 @@ cache_stats_t::reset()
     num_prefetch_hits = 0;
     num_prefetch_misses = 0;
 }
+
+bool
+cache_stats_t::save_state(std::ostream &out) const
+{
+    if (!caching_device_stats_t::save_state(out))
+        return false;
+    out << num_flushes << " " << num_prefetch_hits << " " << num_prefetch_misses
+        << "\n";
+    return !!out;
+}
+
+bool
+cache_stats_t::load_state(std::istream &in)
+{
+    return caching_device_stats_t::load_state(in) &&
+        (in >> num_flushes >> num_prefetch_hits >> num_prefetch_misses);
+}
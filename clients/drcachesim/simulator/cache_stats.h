@@ -56,6 +56,12 @@ public:
     virtual void
     reset();
 
+    virtual bool
+    save_state(std::ostream &out) const;
+
+    virtual bool
+    load_state(std::istream &in);
+
 protected:
     // In addition to caching_device_stats_t::print_counts,
     // cache_stats_t::print_counts prints stats for flushes and
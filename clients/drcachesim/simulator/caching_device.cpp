@@ -39,7 +39,9 @@
 #include <assert.h>
 
 caching_device_t::caching_device_t()
-    : blocks(NULL)
+    : tags(NULL)
+    , counters(NULL)
+    , blocks(NULL)
     , stats(NULL)
     , prefetcher(NULL)
 {
@@ -48,6 +50,8 @@ caching_device_t::caching_device_t()
 
 caching_device_t::~caching_device_t()
 {
+    delete[] tags;
+    delete[] counters;
     if (blocks == NULL)
         return;
     for (int i = 0; i < num_blocks; i++)
@@ -88,7 +92,16 @@ caching_device_t::init(int associativity_, int block_size_, int num_blocks_,
     snoop_filter = snoop_filter_;
     coherent_cache = coherent_cache_;
 
-    blocks = new caching_device_block_t *[num_blocks];
+    tags = new addr_t[num_blocks];
+    counters = new int[num_blocks];
+    // Initializing counters to 0 is just to be safe and to make it easier to write
+    // new replacement algorithms without errors, as we expect any use of a counter to
+    // only occur *after* a valid tag is put in place, where for the current
+    // replacement code we also set the counter at that time.
+    for (int i = 0; i < num_blocks; i++) {
+        tags[i] = TAG_INVALID;
+        counters[i] = 0;
+    }
     init_blocks();
 
     last_tag = TAG_INVALID; // sentinel
@@ -115,9 +128,9 @@ caching_device_t::request(const memref_t &memref_in)
     // Optimization: check last tag if single-block
     if (tag == final_tag && tag == last_tag && memref_in.data.type != TRACE_TYPE_WRITE) {
         // Make sure last_tag is properly in sync.
+        assert(tag != TAG_INVALID && tag == get_tag(last_block_idx, last_way));
         caching_device_block_t *cache_block =
-            &get_caching_device_block(last_block_idx, last_way);
-        assert(tag != TAG_INVALID && tag == cache_block->tag);
+            get_caching_device_block(last_block_idx, last_way);
         stats->access(memref_in, true /*hit*/, cache_block);
         if (parent != NULL)
             parent->stats->child_access(memref_in, true, cache_block);
@@ -134,18 +147,12 @@ caching_device_t::request(const memref_t &memref_in)
         if (tag + 1 <= final_tag)
             memref.data.size = ((tag + 1) << block_size_bits) - memref.data.addr;
 
-        for (way = 0; way < associativity; ++way) {
-            caching_device_block_t *cache_block =
-                &get_caching_device_block(block_idx, way);
-            if (cache_block->tag == tag) {
-                break;
-            }
-        }
+        way = find_way(block_idx, tag);
 
         if (way != associativity) {
             // Access is a hit.
             caching_device_block_t *cache_block =
-                &get_caching_device_block(block_idx, way);
+                get_caching_device_block(block_idx, way);
             stats->access(memref, true /*hit*/, cache_block);
             if (parent != NULL)
                 parent->stats->child_access(memref, true, cache_block);
@@ -163,7 +170,7 @@ caching_device_t::request(const memref_t &memref_in)
             // Access is a miss.
             way = replace_which_way(block_idx);
             caching_device_block_t *cache_block =
-                &get_caching_device_block(block_idx, way);
+                get_caching_device_block(block_idx, way);
 
             stats->access(memref, false /*miss*/, cache_block);
             missed = true;
@@ -177,7 +184,7 @@ caching_device_t::request(const memref_t &memref_in)
                 snoop_filter->snoop(tag, id, (memref.data.type == TRACE_TYPE_WRITE));
             }
 
-            addr_t victim_tag = cache_block->tag;
+            addr_t victim_tag = get_tag(block_idx, way);
             // Check if we are inserting a new block, if we are then increment
             // the block loaded count.
             if (victim_tag == TAG_INVALID) {
@@ -214,7 +221,7 @@ caching_device_t::request(const memref_t &memref_in)
                     }
                 }
             }
-            cache_block->tag = tag;
+            get_tag(block_idx, way) = tag;
         }
 
         access_update(block_idx, way);
@@ -241,7 +248,7 @@ void
 caching_device_t::access_update(int block_idx, int way)
 {
     // We just inc the counter for LFU.  We live with any blip on overflow.
-    get_caching_device_block(block_idx, way).counter++;
+    get_counter(block_idx, way)++;
 }
 
 int
@@ -253,17 +260,17 @@ caching_device_t::replace_which_way(int block_idx)
     int min_counter = 0; /* avoid "may be used uninitialized" with GCC 4.4.7 */
     int min_way = 0;
     for (int way = 0; way < associativity; ++way) {
-        if (get_caching_device_block(block_idx, way).tag == TAG_INVALID) {
+        if (get_tag(block_idx, way) == TAG_INVALID) {
             min_way = way;
             break;
         }
-        if (way == 0 || get_caching_device_block(block_idx, way).counter < min_counter) {
-            min_counter = get_caching_device_block(block_idx, way).counter;
+        if (way == 0 || get_counter(block_idx, way) < min_counter) {
+            min_counter = get_counter(block_idx, way);
             min_way = way;
         }
     }
     // Clear the counter for LFU.
-    get_caching_device_block(block_idx, min_way).counter = 0;
+    get_counter(block_idx, min_way) = 0;
     return min_way;
 }
 
@@ -272,24 +279,21 @@ caching_device_t::invalidate(addr_t tag, invalidation_type_t invalidation_type_)
 {
     int block_idx = compute_block_idx(tag);
 
-    for (int way = 0; way < associativity; ++way) {
-        auto &cache_block = get_caching_device_block(block_idx, way);
-        if (cache_block.tag == tag) {
-            cache_block.tag = TAG_INVALID;
-            cache_block.counter = 0;
-            stats->invalidate(invalidation_type_);
-            // Invalidate last_tag if it was this tag.
-            if (last_tag == tag) {
-                last_tag = TAG_INVALID;
-            }
-            // Invalidate the block in the children's caches.
-            if (invalidation_type_ == INVALIDATION_INCLUSIVE && inclusive &&
-                !children.empty()) {
-                for (auto &child : children) {
-                    child->invalidate(tag, invalidation_type_);
-                }
+    int way = find_way(block_idx, tag);
+    if (way != associativity) {
+        get_tag(block_idx, way) = TAG_INVALID;
+        get_counter(block_idx, way) = 0;
+        stats->invalidate(invalidation_type_);
+        // Invalidate last_tag if it was this tag.
+        if (last_tag == tag) {
+            last_tag = TAG_INVALID;
+        }
+        // Invalidate the block in the children's caches.
+        if (invalidation_type_ == INVALIDATION_INCLUSIVE && inclusive &&
+            !children.empty()) {
+            for (auto &child : children) {
+                child->invalidate(tag, invalidation_type_);
             }
-            break;
         }
     }
     // If this is a coherence invalidation, we must invalidate children caches.
@@ -305,11 +309,8 @@ bool
 caching_device_t::contains_tag(addr_t tag)
 {
     int block_idx = compute_block_idx(tag);
-    for (int way = 0; way < associativity; way++) {
-        if (get_caching_device_block(block_idx, way).tag == tag) {
-            return true;
-        }
-    }
+    if (find_way(block_idx, tag) != associativity)
+        return true;
     if (children.empty()) {
         return false;
     }
@@ -328,11 +329,8 @@ caching_device_t::propagate_eviction(addr_t tag, const caching_device_t *request
 {
     // Check our own cache for this line.
     int block_idx = compute_block_idx(tag);
-    for (int way = 0; way < associativity; way++) {
-        if (get_caching_device_block(block_idx, way).tag == tag) {
-            return;
-        }
-    }
+    if (find_way(block_idx, tag) != associativity)
+        return;
 
     // Check if other children contain this line.
     if (children.size() != 1) {
@@ -374,3 +372,33 @@ caching_device_t::propagate_write(addr_t tag, const caching_device_t *requester)
         parent->propagate_write(tag, this);
     }
 }
+
+bool
+caching_device_t::save_state(std::ostream &out) const
+{
+    if (blocks != NULL)
+        return false;
+    out << associativity << " " << block_size << " " << num_blocks << " "
+        << loaded_blocks << " " << last_tag << " " << last_way << " " << last_block_idx
+        << "\n";
+    for (int i = 0; i < num_blocks; i++)
+        out << tags[i] << " " << counters[i] << "\n";
+    return !!out;
+}
+
+bool
+caching_device_t::load_state(std::istream &in)
+{
+    int assoc_in, block_size_in, num_blocks_in;
+    if (blocks != NULL || !(in >> assoc_in >> block_size_in >> num_blocks_in) ||
+        assoc_in != associativity || block_size_in != block_size ||
+        num_blocks_in != num_blocks)
+        return false;
+    if (!(in >> loaded_blocks >> last_tag >> last_way >> last_block_idx))
+        return false;
+    for (int i = 0; i < num_blocks; i++) {
+        if (!(in >> tags[i] >> counters[i]))
+            return false;
+    }
+    return true;
+}
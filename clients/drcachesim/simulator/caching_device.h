@@ -36,7 +36,12 @@
 #ifndef _CACHING_DEVICE_H_
 #define _CACHING_DEVICE_H_ 1
 
+#include <iostream>
 #include <vector>
+#if (defined(__x86_64__) && defined(__SSE2__)) || defined(_M_X64)
+#    include <emmintrin.h>
+#    define CACHING_DEVICE_SSE2_TAGS 1
+#endif
 
 #include "caching_device_block.h"
 #include "caching_device_stats.h"
@@ -73,6 +78,13 @@ public:
     propagate_eviction(addr_t tag, const caching_device_t *requester);
     void
     propagate_write(addr_t tag, const caching_device_t *requester);
+    // Writes the block contents and replacement state, but not the statistics, to
+    // out.  load_state() reads them back into a device of the same geometry.
+    // Devices that keep per-block objects are not supported.
+    virtual bool
+    save_state(std::ostream &out) const;
+    virtual bool
+    load_state(std::istream &in);
 
     caching_device_stats_t *
     get_stats() const
@@ -94,6 +106,16 @@ public:
     {
         return parent;
     }
+    void
+    set_parent(caching_device_t *parent_)
+    {
+        parent = parent_;
+    }
+    bool
+    is_inclusive() const
+    {
+        return inclusive;
+    }
     inline double
     get_loaded_fraction() const
     {
@@ -116,12 +138,55 @@ protected:
     {
         return (tag & blocks_per_set_mask) << assoc_bits;
     }
-    inline caching_device_block_t &
+    // The tag and replacement counter of each block are kept in flat arrays where
+    // each set's ways are adjacent, so a lookup touches just one or two cache lines.
+    inline addr_t &
+    get_tag(int block_idx, int way)
+    {
+        return tags[block_idx + way];
+    }
+    inline int &
+    get_counter(int block_idx, int way)
+    {
+        return counters[block_idx + way];
+    }
+    // Returns the way holding "tag" in the set starting at block_idx, or
+    // associativity if it is not present.  Tags are unique within a set.
+    inline int
+    find_way(int block_idx, addr_t tag) const
+    {
+        const addr_t *set_tags = tags + block_idx;
+#ifdef CACHING_DEVICE_SSE2_TAGS
+        if (associativity >= 2) {
+            // Compare two 64-bit tags at a time.  SSE2 lacks a 64-bit compare, so
+            // we require both 32-bit halves to match.
+            __m128i key = _mm_set1_epi64x((long long)tag);
+            for (int way = 0; way < associativity; way += 2) {
+                __m128i eq = _mm_cmpeq_epi32(
+                    _mm_loadu_si128((const __m128i *)(set_tags + way)), key);
+                eq = _mm_and_si128(eq, _mm_shuffle_epi32(eq, _MM_SHUFFLE(2, 3, 0, 1)));
+                int mask = _mm_movemask_pd(_mm_castsi128_pd(eq));
+                if (mask != 0)
+                    return way + ((mask & 1) != 0 ? 0 : 1);
+            }
+            return associativity;
+        }
+#endif
+        for (int way = 0; way < associativity; ++way) {
+            if (set_tags[way] == tag)
+                return way;
+        }
+        return associativity;
+    }
+    // Returns the per-block object for subclasses that keep additional per-block
+    // state, or nullptr.
+    inline caching_device_block_t *
     get_caching_device_block(int block_idx, int way)
     {
-        return *(blocks[block_idx + way]);
+        return blocks == nullptr ? nullptr : blocks[block_idx + way];
     }
-    // a pure virtual function for subclasses to initialize their own block array
+    // Subclasses that keep per-block state beyond the tag and counter allocate
+    // "blocks" and fill it with their own block objects here.
     virtual void
     init_blocks() = 0;
 
@@ -144,9 +209,14 @@ protected:
     // If true, this device is inclusive of its children.
     bool inclusive;
 
+    // One entry per block, indexed by block_idx + way.
+    addr_t *tags;
+    // XXX: using int_least64_t here results in a ~4% slowdown for 32-bit apps.
+    // A 32-bit counter should be sufficient but we may want to revisit.
+    int *counters; // for use by replacement policies
     // This should be an array of caching_device_block_t pointers, otherwise
     // an extended block class which has its own member variables cannot be indexed
-    // correctly by base class pointers.
+    // correctly by base class pointers.  It is null unless a subclass needs it.
     caching_device_block_t **blocks;
     int blocks_per_set;
     // Optimization fields for fast bit operations
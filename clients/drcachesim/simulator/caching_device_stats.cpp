@@ -101,6 +101,12 @@ caching_device_stats_t::child_access(const memref_t &memref, bool hit,
     // else being computed in access()
 }
 
+void
+caching_device_stats_t::child_hits(int_least64_t count)
+{
+    num_child_hits += count;
+}
+
 void
 caching_device_stats_t::dump_miss(const memref_t &memref)
 {
@@ -215,3 +221,21 @@ caching_device_stats_t::invalidate(invalidation_type_t invalidation_type_)
         num_coherence_invalidates++;
     }
 }
+
+bool
+caching_device_stats_t::save_state(std::ostream &out) const
+{
+    out << num_hits << " " << num_misses << " " << num_child_hits << " "
+        << num_inclusive_invalidates << " " << num_coherence_invalidates << " "
+        << num_hits_at_reset << " " << num_misses_at_reset << " "
+        << num_child_hits_at_reset << "\n";
+    return !!out;
+}
+
+bool
+caching_device_stats_t::load_state(std::istream &in)
+{
+    return !!(in >> num_hits >> num_misses >> num_child_hits >>
+              num_inclusive_invalidates >> num_coherence_invalidates >>
+              num_hits_at_reset >> num_misses_at_reset >> num_child_hits_at_reset);
+}
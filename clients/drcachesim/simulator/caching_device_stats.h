@@ -37,6 +37,7 @@
 #define _CACHING_DEVICE_STATS_H_ 1
 
 #include "caching_device_block.h"
+#include <iostream>
 #include <string>
 #include <stdint.h>
 #ifdef HAS_ZLIB
@@ -59,6 +60,7 @@ public:
     // Called on each access.
     // A multi-block memory reference invokes this routine
     // separately for each block touched.
+    // The cache_block is null unless the caching device keeps per-block objects.
     virtual void
     access(const memref_t &memref, bool hit, caching_device_block_t *cache_block);
 
@@ -66,6 +68,11 @@ public:
     virtual void
     child_access(const memref_t &memref, bool hit, caching_device_block_t *cache_block);
 
+    // Called in place of child_access() for a run of hits by a child caching device
+    // whose accesses were simulated separately, as with -sim_threads.
+    virtual void
+    child_hits(int_least64_t count);
+
     virtual void
     print_stats(std::string prefix);
 
@@ -81,6 +88,12 @@ public:
     virtual void
     invalidate(invalidation_type_t invalidation_type_);
 
+    // Writes the counters to out, for load_state() to read back.
+    virtual bool
+    save_state(std::ostream &out) const;
+    virtual bool
+    load_state(std::istream &in);
+
 protected:
     bool success;
 
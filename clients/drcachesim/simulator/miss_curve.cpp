@@ -0,0 +1,357 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <stdint.h>
+#include <stdlib.h>
+#include "../common/memref.h"
+#include "../common/utils.h"
+#include "miss_curve.h"
+
+const uint64_t miss_curve_t::line_stack_t::INITIAL_SLOTS;
+
+// Marks an empty way or slot.  Tags are shifted addresses, so no real tag has
+// every bit set.
+static const addr_t EMPTY_TAG = ~static_cast<addr_t>(0);
+
+analysis_tool_t *
+miss_curve_create(const miss_curve_knobs_t &knobs)
+{
+    return new miss_curve_t(knobs);
+}
+
+// Returns log2 of a power of two.
+static unsigned int
+log2_of_pow2(uint64_t value)
+{
+    unsigned int log = 0;
+    while ((value >> log) > 1)
+        ++log;
+    return log;
+}
+
+miss_curve_t::set_stacks_t::set_stacks_t(uint64_t num_sets, unsigned int depth_in)
+    : set_mask(num_sets - 1)
+    , depth(depth_in)
+    , tags(num_sets * depth_in, EMPTY_TAG)
+    , hits(depth_in, 0)
+{
+}
+
+void
+miss_curve_t::set_stacks_t::access(addr_t tag, bool count)
+{
+    addr_t *set = &tags[(tag & set_mask) * depth];
+    unsigned int way = 0;
+    while (way < depth && set[way] != tag)
+        ++way;
+    if (way < depth) {
+        if (count)
+            ++hits[way];
+    } else
+        way = depth - 1;
+    // Move the line to the top of the stack, evicting the bottom line on a miss.
+    for (; way > 0; --way)
+        set[way] = set[way - 1];
+    set[0] = tag;
+}
+
+miss_curve_t::line_stack_t::line_stack_t()
+    : slot_tag(INITIAL_SLOTS, EMPTY_TAG)
+    , tree(INITIAL_SLOTS + 1, 0)
+    , next_slot(0)
+    , hits(65, 0)
+{
+}
+
+void
+miss_curve_t::line_stack_t::update(uint64_t slot, int_least64_t delta)
+{
+    for (uint64_t i = slot + 1; i < tree.size(); i += i & (~i + 1))
+        tree[i] += delta;
+}
+
+int_least64_t
+miss_curve_t::line_stack_t::prefix_count(uint64_t slot) const
+{
+    int_least64_t count = 0;
+    for (uint64_t i = slot + 1; i > 0; i -= i & (~i + 1))
+        count += tree[i];
+    return count;
+}
+
+// Renumbers the occupied slots to be contiguous from 0 and leaves at least as
+// many free slots, so this linear-time pass is amortized across as many accesses
+// as there are lines.
+void
+miss_curve_t::line_stack_t::compact()
+{
+    uint64_t count = 0;
+    for (uint64_t i = 0; i < next_slot; ++i) {
+        if (slot_tag[i] == EMPTY_TAG)
+            continue;
+        slot_tag[count] = slot_tag[i];
+        line_slot[slot_tag[count]] = count;
+        ++count;
+    }
+    uint64_t size = 2 * count;
+    if (size < INITIAL_SLOTS)
+        size = INITIAL_SLOTS;
+    slot_tag.resize(size);
+    for (uint64_t i = count; i < size; ++i)
+        slot_tag[i] = EMPTY_TAG;
+    tree.assign(size + 1, 0);
+    for (uint64_t i = 1; i <= size; ++i) {
+        if (i <= count)
+            ++tree[i];
+        uint64_t parent = i + (i & (~i + 1));
+        if (parent <= size)
+            tree[parent] += tree[i];
+    }
+    next_slot = count;
+}
+
+void
+miss_curve_t::line_stack_t::access(addr_t tag, bool count)
+{
+    // Repeated accesses to the most recent line are common and change nothing.
+    if (next_slot > 0 && slot_tag[next_slot - 1] == tag) {
+        if (count)
+            ++hits[0];
+        return;
+    }
+    auto it = line_slot.find(tag);
+    if (it != line_slot.end()) {
+        uint64_t slot = it->second;
+        if (count) {
+            // The distance is the number of lines in later slots.
+            uint64_t dist = line_slot.size() - prefix_count(slot);
+            unsigned int bits = 0;
+            for (; dist != 0; dist >>= 1)
+                ++bits;
+            ++hits[bits];
+        }
+        slot_tag[slot] = EMPTY_TAG;
+        update(slot, -1);
+    } else
+        it = line_slot.insert(std::make_pair(tag, 0)).first;
+    if (next_slot == slot_tag.size())
+        compact();
+    slot_tag[next_slot] = tag;
+    update(next_slot, 1);
+    it->second = next_slot;
+    ++next_slot;
+}
+
+void
+miss_curve_t::stream_t::access(addr_t tag, bool count)
+{
+    if (count)
+        ++refs;
+    for (set_stacks_t &stacks : set_stacks)
+        stacks.access(tag, count);
+    full.access(tag, count);
+}
+
+miss_curve_t::miss_curve_t(const miss_curve_knobs_t &knobs_)
+    : knobs(knobs_)
+    , istream("Instruction fetches")
+    , dstream("Data references")
+    , ustream("All references")
+{
+    if (!IS_POWER_OF_2(knobs.line_size) || !IS_POWER_OF_2(knobs.min_size) ||
+        !IS_POWER_OF_2(knobs.max_size) || knobs.min_size < knobs.line_size ||
+        knobs.min_size > knobs.max_size) {
+        error_string = "Usage error: the line size and the minimum and maximum cache "
+                       "sizes must be powers of two, in increasing order";
+        success = false;
+        return;
+    }
+    line_size_bits = log2_of_pow2(knobs.line_size);
+    std::stringstream list(knobs.assoc);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        char *end;
+        unsigned long assoc = strtoul(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || (assoc != 0 && !IS_POWER_OF_2(assoc))) {
+            error_string = "Usage error: invalid associativity '" + item +
+                "': must be a power of two or 0 for fully associative";
+            success = false;
+            return;
+        }
+        assocs.push_back(static_cast<unsigned int>(assoc));
+    }
+    if (assocs.empty()) {
+        error_string = "Usage error: no associativities were specified";
+        success = false;
+        return;
+    }
+    // Each number of sets needs a stack as deep as the largest associativity
+    // that uses it.
+    unsigned int max_log = log2_of_pow2(knobs.max_size >> line_size_bits);
+    std::vector<unsigned int> depth(max_log + 1, 0);
+    for (uint64_t size = knobs.min_size; size <= knobs.max_size; size *= 2) {
+        uint64_t lines = size >> line_size_bits;
+        for (unsigned int assoc : assocs) {
+            if (assoc == 0 || assoc > lines)
+                continue;
+            unsigned int sets_log = log2_of_pow2(lines / assoc);
+            if (assoc > depth[sets_log])
+                depth[sets_log] = assoc;
+        }
+    }
+    stack_index.resize(max_log + 1, -1);
+    for (unsigned int sets_log = 0; sets_log <= max_log; ++sets_log) {
+        if (depth[sets_log] == 0)
+            continue;
+        stack_index[sets_log] = static_cast<int>(istream.set_stacks.size());
+        for (stream_t *stream : { &istream, &dstream, &ustream }) {
+            stream->set_stacks.emplace_back(1ULL << sets_log, depth[sets_log]);
+        }
+    }
+}
+
+miss_curve_t::~miss_curve_t()
+{
+}
+
+void
+miss_curve_t::access(stream_t &stream, addr_t addr, size_t size, bool count)
+{
+    addr_t last = (addr + (size == 0 ? 0 : size - 1)) >> line_size_bits;
+    for (addr_t tag = addr >> line_size_bits; tag <= last; ++tag)
+        stream.access(tag, count);
+}
+
+bool
+miss_curve_t::process_memref(const memref_t &memref)
+{
+    if (knobs.skip_refs > 0) {
+        knobs.skip_refs--;
+        return true;
+    }
+    // Warmup references update the caches without being counted.
+    bool count;
+    if (knobs.warmup_refs > 0) {
+        knobs.warmup_refs--;
+        count = false;
+    } else if (knobs.sim_refs > 0) {
+        knobs.sim_refs--;
+        count = true;
+    } else
+        return true;
+    if (type_is_instr(memref.instr.type)) {
+        access(istream, memref.instr.addr, memref.instr.size, count);
+        access(ustream, memref.instr.addr, memref.instr.size, count);
+    } else if (memref.data.type == TRACE_TYPE_READ ||
+               memref.data.type == TRACE_TYPE_WRITE ||
+               type_is_prefetch(memref.data.type)) {
+        access(dstream, memref.data.addr, memref.data.size, count);
+        access(ustream, memref.data.addr, memref.data.size, count);
+    }
+    return true;
+}
+
+uint64_t
+miss_curve_t::stream_hits(const stream_t &stream, uint64_t size,
+                          unsigned int assoc) const
+{
+    uint64_t lines = size >> line_size_bits;
+    uint64_t hits = 0;
+    if (assoc == 0) {
+        // Lines at distances below the capacity hit.
+        for (unsigned int bits = 0; bits <= log2_of_pow2(lines); ++bits)
+            hits += stream.full.hits[bits];
+        return hits;
+    }
+    const set_stacks_t &stacks =
+        stream.set_stacks[stack_index[log2_of_pow2(lines / assoc)]];
+    for (unsigned int way = 0; way < assoc; ++way)
+        hits += stacks.hits[way];
+    return hits;
+}
+
+static std::string
+size_string(uint64_t size)
+{
+    std::stringstream str;
+    if (size % (1024 * 1024) == 0)
+        str << size / (1024 * 1024) << "M";
+    else if (size % 1024 == 0)
+        str << size / 1024 << "K";
+    else
+        str << size;
+    return str.str();
+}
+
+bool
+miss_curve_t::print_stream(const stream_t &stream)
+{
+    std::cerr << stream.name << ": " << stream.refs << " line accesses\n";
+    std::cerr << std::setw(8) << "size";
+    for (unsigned int assoc : assocs) {
+        if (assoc == 0)
+            std::cerr << std::setw(10) << "full";
+        else
+            std::cerr << std::setw(9) << assoc << "w";
+    }
+    std::cerr << "\n";
+    for (uint64_t size = knobs.min_size; size <= knobs.max_size; size *= 2) {
+        std::cerr << std::setw(8) << size_string(size);
+        for (unsigned int assoc : assocs) {
+            if (assoc > (size >> line_size_bits)) {
+                std::cerr << std::setw(10) << "-";
+                continue;
+            }
+            uint64_t misses = stream.refs - stream_hits(stream, size, assoc);
+            std::stringstream rate;
+            rate << std::fixed << std::setprecision(2)
+                 << (stream.refs == 0 ? 0. : 100. * misses / stream.refs) << "%";
+            std::cerr << std::setw(10) << rate.str();
+        }
+        std::cerr << "\n";
+    }
+    return true;
+}
+
+bool
+miss_curve_t::print_results()
+{
+    std::cerr << "LRU miss rates for " << knobs.line_size << "-byte lines:\n";
+    print_stream(istream);
+    print_stream(dstream);
+    print_stream(ustream);
+    return true;
+}
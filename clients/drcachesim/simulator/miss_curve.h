@@ -0,0 +1,133 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* miss_curve: computes LRU miss rates for many cache sizes and associativities
+ * in one pass, using the stack property of LRU replacement.
+ */
+
+#ifndef _MISS_CURVE_H_
+#define _MISS_CURVE_H_ 1
+
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "analysis_tool.h"
+#include "memref.h"
+#include "miss_curve_create.h"
+
+// LRU is a stack algorithm: a cache with N ways holds the N most recently used
+// lines of each set, so the depth at which a line is found in the recency stack
+// of its set tells whether it hits for every associativity at once.  Caches of
+// different sizes but the same number of sets share one stack per set, and a
+// fully associative cache of any size needs only the number of distinct lines
+// used since the previous access to the same line.
+class miss_curve_t : public analysis_tool_t {
+public:
+    miss_curve_t(const miss_curve_knobs_t &knobs);
+    virtual ~miss_curve_t();
+    virtual bool
+    process_memref(const memref_t &memref);
+    virtual bool
+    print_results();
+
+protected:
+    // The recency stacks of every set for one number of sets, deep enough for
+    // the largest associativity that uses this number of sets.
+    struct set_stacks_t {
+        set_stacks_t(uint64_t num_sets, unsigned int depth_in);
+        void
+        access(addr_t tag, bool count);
+        uint64_t set_mask;
+        unsigned int depth;
+        // num_sets * depth tags, most recently used first within each set.
+        std::vector<addr_t> tags;
+        // The number of hits found at each depth.
+        std::vector<uint64_t> hits;
+    };
+
+    // Exact LRU stack distances over all lines, for fully associative caches.  As
+    // in the reuse distance tool's tree, each line occupies the slot of its most
+    // recent access in a Fenwick tree that counts the occupied slots.
+    struct line_stack_t {
+        line_stack_t();
+        void
+        access(addr_t tag, bool count);
+        void
+        update(uint64_t slot, int_least64_t delta);
+        int_least64_t
+        prefix_count(uint64_t slot) const;
+        void
+        compact();
+        std::unordered_map<addr_t, uint64_t> line_slot;
+        std::vector<addr_t> slot_tag;
+        std::vector<int_least64_t> tree;
+        uint64_t next_slot;
+        // hits[k] counts hits at distances of bit length k, i.e., in
+        // [2^(k-1), 2^k), so those at distances below 2^k sum hits[0..k].
+        std::vector<uint64_t> hits;
+        static const uint64_t INITIAL_SLOTS = 1024;
+    };
+
+    // The caches of every configuration for one stream of references.
+    struct stream_t {
+        explicit stream_t(const std::string &name_in)
+            : name(name_in)
+        {
+        }
+        void
+        access(addr_t tag, bool count);
+        std::string name;
+        uint64_t refs = 0;
+        std::vector<set_stacks_t> set_stacks;
+        line_stack_t full;
+    };
+
+    void
+    access(stream_t &stream, addr_t addr, size_t size, bool count);
+    bool
+    print_stream(const stream_t &stream);
+    // Returns the hits of the cache of the given size and associativity, where an
+    // associativity of 0 is fully associative.
+    uint64_t
+    stream_hits(const stream_t &stream, uint64_t size, unsigned int assoc) const;
+
+    miss_curve_knobs_t knobs;
+    unsigned int line_size_bits;
+    std::vector<unsigned int> assocs;
+    stream_t istream;
+    stream_t dstream;
+    stream_t ustream;
+    // Indexed by log2 of the number of sets, or -1 where no stack is kept.
+    std::vector<int> stack_index;
+};
+
+#endif /* _MISS_CURVE_H_ */
@@ -0,0 +1,82 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* miss curve simulator creation */
+
+#ifndef _MISS_CURVE_CREATE_H_
+#define _MISS_CURVE_CREATE_H_ 1
+
+#include <string>
+#include "analysis_tool.h"
+
+/**
+ * @file drmemtrace/miss_curve_create.h
+ * @brief DrMemtrace LRU miss curve simulator creation.
+ */
+
+/**
+ * The options for miss_curve_create().
+ * The options are currently documented in \ref sec_drcachesim_ops.
+ */
+// The options are currently documented in ../common/options.cpp.
+struct miss_curve_knobs_t {
+    miss_curve_knobs_t()
+        : line_size(64)
+        , min_size(4 * 1024)
+        , max_size(8 * 1024 * 1024)
+        , assoc("1,2,4,8,16,0")
+        , skip_refs(0)
+        , warmup_refs(0)
+        , sim_refs(1ULL << 63)
+        , verbose(0)
+    {
+    }
+    unsigned int line_size;
+    uint64_t min_size;
+    uint64_t max_size;
+    // A comma-separated list of associativities, where 0 is fully associative.
+    std::string assoc;
+    uint64_t skip_refs;
+    uint64_t warmup_refs;
+    uint64_t sim_refs;
+    unsigned int verbose;
+};
+
+/**
+ * Creates an instance of a simulator that computes the miss rates of LRU caches
+ * of every power-of-two size between the min_size and max_size knobs, at each of
+ * the requested associativities, in a single pass over the trace.
+ */
+analysis_tool_t *
+miss_curve_create(const miss_curve_knobs_t &knobs);
+
+#endif /* _MISS_CURVE_CREATE_H_ */
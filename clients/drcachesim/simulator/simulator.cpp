@@ -163,6 +163,56 @@ simulator_t::handle_thread_exit(memref_tid_t tid)
     thread2core.erase(tid);
 }
 
+bool
+simulator_t::save_core_state(std::ostream &out) const
+{
+    out << knob_num_cores << " " << last_thread << " " << last_core << "\n";
+    for (unsigned int i = 0; i < knob_num_cores; i++) {
+        out << cpu_counts[i] << " " << thread_counts[i] << " " << thread_ever_counts[i]
+            << "\n";
+    }
+    out << cpu2core.size() << "\n";
+    for (const auto &keyval : cpu2core)
+        out << keyval.first << " " << keyval.second << "\n";
+    out << thread2core.size() << "\n";
+    for (const auto &keyval : thread2core)
+        out << keyval.first << " " << keyval.second << "\n";
+    return !!out;
+}
+
+bool
+simulator_t::load_core_state(std::istream &in)
+{
+    unsigned int num_cores;
+    if (!(in >> num_cores >> last_thread >> last_core) || num_cores != knob_num_cores)
+        return false;
+    for (unsigned int i = 0; i < knob_num_cores; i++) {
+        if (!(in >> cpu_counts[i] >> thread_counts[i] >> thread_ever_counts[i]))
+            return false;
+    }
+    size_t count;
+    if (!(in >> count))
+        return false;
+    cpu2core.clear();
+    for (size_t i = 0; i < count; i++) {
+        int cpu, core;
+        if (!(in >> cpu >> core))
+            return false;
+        cpu2core[cpu] = core;
+    }
+    if (!(in >> count))
+        return false;
+    thread2core.clear();
+    for (size_t i = 0; i < count; i++) {
+        memref_tid_t tid;
+        int core;
+        if (!(in >> tid >> core))
+            return false;
+        thread2core[tid] = core;
+    }
+    return true;
+}
+
 void
 simulator_t::print_core(int core) const
 {
@@ -70,6 +70,11 @@ protected:
     core_for_thread(memref_tid_t tid);
     virtual void
     handle_thread_exit(memref_tid_t tid);
+    // Write and read the mapping of threads and cpus to cores, for checkpoints.
+    bool
+    save_core_state(std::ostream &out) const;
+    bool
+    load_core_state(std::istream &in);
 
     unsigned int knob_num_cores;
     uint64_t knob_skip_refs;
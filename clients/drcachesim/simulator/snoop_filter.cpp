@@ -135,3 +135,43 @@ snoop_filter_t::print_stats(void)
               << std::right << num_writebacks << std::endl;
     std::cerr.imbue(std::locale("C")); // Reset to avoid affecting later prints.
 }
+
+bool
+snoop_filter_t::save_state(std::ostream &out) const
+{
+    out << num_snooped_caches << " " << num_writes << " " << num_writebacks << " "
+        << num_invalidates << " " << coherence_table.size() << "\n";
+    for (const auto &entry : coherence_table) {
+        // The sharers are written as one character each after a prefix, which keeps
+        // an empty vector a readable token.
+        out << entry.first << " " << entry.second.dirty << " s";
+        for (bool sharer : entry.second.sharers)
+            out << (sharer ? '1' : '0');
+        out << "\n";
+    }
+    return !!out;
+}
+
+bool
+snoop_filter_t::load_state(std::istream &in)
+{
+    int num_caches;
+    size_t num_entries;
+    if (!(in >> num_caches >> num_writes >> num_writebacks >> num_invalidates >>
+          num_entries) ||
+        num_caches != num_snooped_caches)
+        return false;
+    coherence_table.clear();
+    for (size_t i = 0; i < num_entries; ++i) {
+        addr_t tag;
+        bool dirty;
+        std::string sharers;
+        if (!(in >> tag >> dirty >> sharers) || sharers.empty() || sharers[0] != 's')
+            return false;
+        coherence_table_entry_t &entry = coherence_table[tag];
+        entry.dirty = dirty;
+        for (size_t j = 1; j < sharers.size(); ++j)
+            entry.sharers.push_back(sharers[j] == '1');
+    }
+    return true;
+}
@@ -56,6 +56,12 @@ public:
     snoop_eviction(addr_t tag, int id_in);
     void
     print_stats(void);
+    // Writes the coherence table and counters to out, for load_state() to read
+    // back into a filter over the same number of caches.
+    bool
+    save_state(std::ostream &out) const;
+    bool
+    load_state(std::istream &in);
 
 protected:
     // XXX: This initial coherence implementation uses a perfect snoop filter.
@@ -37,6 +37,9 @@
 void
 tlb_t::init_blocks()
 {
+    // We keep the pid in a per-block object.  Lookups only consult it once the tag
+    // matches.
+    blocks = new caching_device_block_t *[num_blocks];
     for (int i = 0; i < num_blocks; i++) {
         blocks[i] = new tlb_entry_t;
     }
@@ -65,8 +68,8 @@ tlb_t::request(const memref_t &memref_in)
     if (tag == final_tag && tag == last_tag && pid == last_pid) {
         // Make sure last_tag and pid are properly in sync.
         caching_device_block_t *tlb_entry =
-            &get_caching_device_block(last_block_idx, last_way);
-        assert(tag != TAG_INVALID && tag == tlb_entry->tag &&
+            get_caching_device_block(last_block_idx, last_way);
+        assert(tag != TAG_INVALID && tag == get_tag(last_block_idx, last_way) &&
                pid == ((tlb_entry_t *)tlb_entry)->pid);
         stats->access(memref_in, true /*hit*/, tlb_entry);
         if (parent != NULL)
@@ -83,9 +86,12 @@ tlb_t::request(const memref_t &memref_in)
         if (tag + 1 <= final_tag)
             memref.data.size = ((tag + 1) << block_size_bits) - memref.data.addr;
 
+        // Unlike a cache, a TLB set can hold the same tag for several pids.
         for (way = 0; way < associativity; ++way) {
-            caching_device_block_t *tlb_entry = &get_caching_device_block(block_idx, way);
-            if (tlb_entry->tag == tag && ((tlb_entry_t *)tlb_entry)->pid == pid) {
+            if (get_tag(block_idx, way) != tag)
+                continue;
+            caching_device_block_t *tlb_entry = get_caching_device_block(block_idx, way);
+            if (((tlb_entry_t *)tlb_entry)->pid == pid) {
                 stats->access(memref, true /*hit*/, tlb_entry);
                 if (parent != NULL)
                     parent->get_stats()->child_access(memref, true, tlb_entry);
@@ -95,7 +101,7 @@ tlb_t::request(const memref_t &memref_in)
 
         if (way == associativity) {
             way = replace_which_way(block_idx);
-            caching_device_block_t *tlb_entry = &get_caching_device_block(block_idx, way);
+            caching_device_block_t *tlb_entry = get_caching_device_block(block_idx, way);
 
             stats->access(memref, false /*miss*/, tlb_entry);
             // If no parent we assume we get the data from main memory
@@ -106,7 +112,7 @@ tlb_t::request(const memref_t &memref_in)
 
             // XXX: do we need to handle TLB coherency?
 
-            tlb_entry->tag = tag;
+            get_tag(block_idx, way) = tag;
             ((tlb_entry_t *)tlb_entry)->pid = pid;
         }
 
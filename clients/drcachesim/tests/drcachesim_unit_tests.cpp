@@ -31,10 +31,38 @@
  */
 
 // Unit tests for drcachesim
+#include <algorithm>
+#include <cmath>
 #include <iostream>
 #include <cstdlib>
+#include <list>
+#include <memory>
+#include <sstream>
+#include <vector>
+#include <string.h>
 #include "simulator/cache_simulator.h"
+#include "simulator/miss_curve.h"
+#include "tools/reuse_distance.h"
 #include "../common/memref.h"
+#ifdef LINUX
+#    include <thread>
+#    include <unistd.h>
+#    include <vector>
+#    include "dr_api.h" // For thread_id_t and process_id_t.
+#    include "common/shm_ring.h"
+#    include "reader/ipc_reader.h"
+#endif
+#ifdef HAS_ZLIB
+#    include "common/columnar_ostream.h"
+#    include "common/directory_iterator.h"
+#    include "common/gzip_ostream.h"
+#    include "reader/columnar_file_reader.h"
+#    include "reader/compressed_file_reader.h"
+#    ifdef UNIX
+#        include "reader/mmap_file_reader.h"
+#    endif
+#    include "tests/trace_invariants.h"
+#endif
 
 static cache_simulator_knobs_t
 make_test_knobs()
@@ -135,11 +163,816 @@ unit_test_sim_refs()
     }
 }
 
+// Runs a pseudo-random multi-threaded stream through a 4-core simulator and returns
+// the printed results.
+static std::string
+simulate_for_sim_threads(unsigned int sim_threads)
+{
+    cache_simulator_knobs_t knobs;
+    knobs.num_cores = 4;
+    knobs.L1I_size = 4 * 64;
+    knobs.L1D_size = 8 * 64;
+    knobs.L1I_assoc = 2;
+    knobs.L1D_assoc = 2;
+    knobs.LL_size = 64 * 64;
+    knobs.LL_assoc = 4;
+    knobs.warmup_refs = 5000;
+    knobs.sim_threads = sim_threads;
+    cache_simulator_t cache_sim(knobs);
+    uint64_t rand_state = 42;
+    for (int i = 0; i < 100000; i++) {
+        rand_state = rand_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t rand = rand_state >> 33;
+        memref_t ref;
+        ref.data.pid = 1;
+        ref.data.tid = 1 + (rand % 6);
+        ref.data.pc = 0;
+        ref.data.size = 1 + ((rand >> 8) % 16);
+        ref.data.addr = ((rand >> 12) % 512) * 16;
+        switch ((rand >> 24) % 8) {
+        case 0: ref.data.type = TRACE_TYPE_INSTR; break;
+        case 1: ref.data.type = TRACE_TYPE_WRITE; break;
+        case 2:
+            ref.data.type = i % 64 == 0 ? TRACE_TYPE_DATA_FLUSH : TRACE_TYPE_READ;
+            break;
+        default: ref.data.type = TRACE_TYPE_READ; break;
+        }
+        if (!cache_sim.process_memref(ref)) {
+            std::cerr << "drcachesim unit_test_sim_threads failed: "
+                      << cache_sim.get_error_string() << "\n";
+            exit(1);
+        }
+    }
+    std::stringstream results;
+    std::streambuf *prev_buf = std::cerr.rdbuf(results.rdbuf());
+    cache_sim.print_results();
+    std::cerr.rdbuf(prev_buf);
+    return results.str();
+}
+
+void
+unit_test_sim_threads()
+{
+    std::string serial = simulate_for_sim_threads(0);
+    for (unsigned int sim_threads = 1; sim_threads <= 4; sim_threads++) {
+        std::string parallel = simulate_for_sim_threads(sim_threads);
+        if (parallel != serial) {
+            std::cerr << "drcachesim unit_test_sim_threads failed for " << sim_threads
+                      << " threads:\n"
+                      << serial << "vs\n"
+                      << parallel;
+            exit(1);
+        }
+    }
+}
+
+// Feeds the same pseudo-random multi-threaded stream to "tool" for references
+// [start, end).
+static void
+feed_checkpoint_stream(analysis_tool_t &tool, int start, int end)
+{
+    uint64_t rand_state = 42;
+    for (int i = 0; i < end; i++) {
+        rand_state = rand_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        if (i < start)
+            continue;
+        uint64_t rand = rand_state >> 33;
+        memref_t ref;
+        ref.data.pid = 1;
+        ref.data.tid = 1 + (rand % 6);
+        ref.data.pc = 0;
+        ref.data.size = 1 + ((rand >> 8) % 16);
+        ref.data.addr = ((rand >> 12) % 2048) * 16;
+        ref.data.type = (rand >> 24) % 8 == 0
+            ? TRACE_TYPE_INSTR
+            : ((rand >> 24) % 8 == 1 ? TRACE_TYPE_WRITE : TRACE_TYPE_READ);
+        if (!tool.process_memref(ref)) {
+            std::cerr << "drcachesim unit_test_checkpoint failed: "
+                      << tool.get_error_string() << "\n";
+            exit(1);
+        }
+    }
+}
+
+static std::string
+checkpoint_tool_results(analysis_tool_t &tool)
+{
+    std::stringstream results;
+    std::streambuf *prev_buf = std::cerr.rdbuf(results.rdbuf());
+    tool.print_results();
+    std::cerr.rdbuf(prev_buf);
+    return results.str();
+}
+
+// Checks that a tool checkpointed partway through the stream and resumed in a new
+// instance prints the same results as one which saw the whole stream.
+template <typename tool_t, typename knobs_t>
+static void
+check_checkpoint_resume(const knobs_t &knobs, const char *name)
+{
+    const int kRefs = 60000;
+    const int kCheckpointAt = 25000;
+    tool_t full(knobs);
+    feed_checkpoint_stream(full, 0, kRefs);
+    tool_t first(knobs);
+    feed_checkpoint_stream(first, 0, kCheckpointAt);
+    std::stringstream state;
+    tool_t resumed(knobs);
+    if (!first.save_checkpoint(state) || !resumed.load_checkpoint(state)) {
+        std::cerr << "drcachesim unit_test_checkpoint failed for " << name << ": "
+                  << first.get_error_string() << resumed.get_error_string() << "\n";
+        exit(1);
+    }
+    feed_checkpoint_stream(resumed, kCheckpointAt, kRefs);
+    std::string expect = checkpoint_tool_results(full);
+    std::string actual = checkpoint_tool_results(resumed);
+    if (expect != actual) {
+        std::cerr << "drcachesim unit_test_checkpoint failed for " << name << ":\n"
+                  << expect << "vs\n"
+                  << actual;
+        exit(1);
+    }
+}
+
+void
+unit_test_checkpoint()
+{
+    cache_simulator_knobs_t cache_knobs;
+    cache_knobs.num_cores = 4;
+    cache_knobs.L1I_size = 4 * 64;
+    cache_knobs.L1D_size = 8 * 64;
+    cache_knobs.L1I_assoc = 2;
+    cache_knobs.L1D_assoc = 2;
+    cache_knobs.LL_size = 64 * 64;
+    cache_knobs.LL_assoc = 4;
+    cache_knobs.warmup_refs = 5000;
+    cache_knobs.model_coherence = true;
+    check_checkpoint_resume<cache_simulator_t>(cache_knobs, "cache_simulator");
+    // A checkpoint taken during warmup resumes into a run with a different budget.
+    cache_knobs.sim_refs = 30000;
+    check_checkpoint_resume<cache_simulator_t>(cache_knobs, "cache_simulator sim_refs");
+
+    reuse_distance_knobs_t reuse_knobs;
+    reuse_knobs.distance_threshold = 64;
+    reuse_knobs.skip_list_distance = 20;
+    reuse_knobs.report_histogram = true;
+    check_checkpoint_resume<reuse_distance_t>(reuse_knobs, "reuse_distance");
+    reuse_knobs.use_tree = true;
+    check_checkpoint_resume<reuse_distance_t>(reuse_knobs, "reuse_distance tree");
+    reuse_knobs.sample_max_lines = 100;
+    check_checkpoint_resume<reuse_distance_t>(reuse_knobs, "reuse_distance sampled");
+}
+
+// Exposes the miss counts of a miss curve for comparison.
+class test_miss_curve_t : public miss_curve_t {
+public:
+    explicit test_miss_curve_t(const miss_curve_knobs_t &knobs)
+        : miss_curve_t(knobs)
+    {
+    }
+    uint64_t
+    data_misses(uint64_t size, unsigned int assoc) const
+    {
+        return dstream.refs - stream_hits(dstream, size, assoc);
+    }
+};
+
+void
+unit_test_miss_curve()
+{
+    // Compare every point of the curve against a separately simulated LRU cache.
+    miss_curve_knobs_t knobs;
+    knobs.min_size = 1024;
+    knobs.max_size = 32 * 1024;
+    knobs.assoc = "1,2,4,8,0";
+    test_miss_curve_t curve(knobs);
+    // A plain LRU cache with a recency list per set.
+    struct config_t {
+        uint64_t size;
+        unsigned int assoc;
+        std::vector<std::list<addr_t>> sets;
+        uint64_t misses = 0;
+    };
+    std::vector<config_t> configs;
+    for (uint64_t size = knobs.min_size; size <= knobs.max_size; size *= 2) {
+        for (unsigned int assoc : { 1, 2, 4, 8, 0 }) {
+            config_t config;
+            config.size = size;
+            config.assoc = assoc;
+            uint64_t ways = assoc == 0 ? size / 64 : assoc;
+            config.sets.resize(size / 64 / ways);
+            configs.push_back(config);
+        }
+    }
+    uint64_t rand_state = 7;
+    for (int i = 0; i < 50000; i++) {
+        rand_state = rand_state * 6364136223846793005ULL + 1442695040888963407ULL;
+        uint64_t rand = rand_state >> 33;
+        memref_t ref;
+        ref.data.pid = 1;
+        ref.data.tid = 1;
+        ref.data.pc = 0;
+        ref.data.type = TRACE_TYPE_READ;
+        ref.data.size = 1 + (rand % 16);
+        // Mostly a small working set, with a tail that exceeds the largest cache.
+        ref.data.addr = ((rand >> 8) % 4 == 0 ? (rand >> 12) % 2048 : (rand >> 12) % 96) *
+            64 + ((rand >> 4) % 64);
+        curve.process_memref(ref);
+        for (addr_t tag = ref.data.addr / 64;
+             tag <= (ref.data.addr + ref.data.size - 1) / 64; ++tag) {
+            for (config_t &config : configs) {
+                std::list<addr_t> &set = config.sets[tag % config.sets.size()];
+                auto it = std::find(set.begin(), set.end(), tag);
+                if (it != set.end())
+                    set.erase(it);
+                else {
+                    ++config.misses;
+                    if (set.size() == config.size / 64 / config.sets.size())
+                        set.pop_back();
+                }
+                set.push_front(tag);
+            }
+        }
+    }
+    for (config_t &config : configs) {
+        uint64_t actual = curve.data_misses(config.size, config.assoc);
+        if (config.misses != actual) {
+            std::cerr << "drcachesim unit_test_miss_curve failed for size "
+                      << config.size << " assoc " << config.assoc << ": " << actual
+                      << " vs " << config.misses << "\n";
+            exit(1);
+        }
+    }
+}
+
+#ifdef HAS_ZLIB
+// Writes a thread file with the layout raw2trace produces along with an index that
+// starts a chunk at every third timestamp.  Each thread's timestamps are offset so
+// the merged order is unambiguous.
+static void
+write_indexed_thread_file(const std::string &dir, int tid, bool compressed = true)
+{
+    const int kSegments = 40;
+    const int kInstrsPerSegment = 5;
+    std::string path = dir + DIRSEP + "thread." + std::to_string(tid) +
+        (compressed ? ".trace.gz" : ".trace");
+    std::unique_ptr<std::ostream> out_stream(
+        compressed ? static_cast<std::ostream *>(new gzip_ostream_t(path))
+                   : new std::ofstream(path, std::ofstream::binary));
+    std::ostream &out = *out_stream;
+    std::ofstream index(path + "." TRACE_INDEX_SUFFIX, std::ofstream::binary);
+    trace_index_header_t header = { TRACE_INDEX_VERSION, 0 };
+    index.write((char *)&header, sizeof(header));
+    auto write_entry = [&out](unsigned short type, unsigned short size, addr_t addr) {
+        trace_entry_t entry;
+        entry.type = type;
+        entry.size = size;
+        entry.addr = addr;
+        out.write((char *)&entry, sizeof(entry));
+    };
+    write_entry(TRACE_TYPE_HEADER, 0, TRACE_ENTRY_VERSION);
+    write_entry(TRACE_TYPE_THREAD, 0, tid);
+    write_entry(TRACE_TYPE_PID, 0, 1);
+    uint64_t instr_count = 0;
+    for (int seg = 0; seg < kSegments; ++seg) {
+        uint64_t timestamp = 1000 + seg * 10 + tid;
+        if (seg % 3 == 0) {
+            out.flush();
+            trace_index_entry_t chunk = { static_cast<uint64_t>(out.tellp()),
+                                          instr_count, timestamp };
+            index.write((char *)&chunk, sizeof(chunk));
+        }
+        write_entry(TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_TIMESTAMP, timestamp);
+        for (int i = 0; i < kInstrsPerSegment; ++i) {
+            write_entry(TRACE_TYPE_INSTR, 4, tid * 0x10000 + seg * 0x100 + i * 4);
+            write_entry(TRACE_TYPE_READ, 8, seg * 0x100 + i);
+            ++instr_count;
+        }
+    }
+    write_entry(TRACE_TYPE_THREAD_EXIT, 0, tid);
+    write_entry(TRACE_TYPE_FOOTER, 0, 0);
+    trace_index_entry_t end = { 0, instr_count, TRACE_INDEX_END_TIMESTAMP };
+    index.write((char *)&end, sizeof(end));
+}
+
+// Checks that skipping via a trace index lands on exactly the same record as
+// skipping by decoding.
+void
+unit_test_skip_instructions_index()
+{
+    const std::string dir = "drcachesim_unit_tests_index";
+    if (!directory_iterator_t::is_directory(dir) &&
+        !directory_iterator_t::create_directory(dir)) {
+        std::cerr << "drcachesim unit_test_skip_instructions_index failed to create "
+                  << dir << "\n";
+        exit(1);
+    }
+    for (int tid = 1; tid <= 3; ++tid)
+        write_indexed_thread_file(dir, tid);
+    for (uint64_t skip : { 1, 17, 100, 299, 600 }) {
+        compressed_file_reader_t indexed(dir);
+        compressed_file_reader_t decoded(dir);
+        compressed_file_reader_t end;
+        if (!indexed.init() || !decoded.init()) {
+            std::cerr << "drcachesim unit_test_skip_instructions_index failed to read\n";
+            exit(1);
+        }
+        indexed.skip_instructions(skip);
+        decoded.reader_t::skip_instructions(skip);
+        for (; decoded != end; ++decoded, ++indexed) {
+            if (indexed == end || (*indexed).instr.type != (*decoded).instr.type ||
+                (*indexed).instr.tid != (*decoded).instr.tid ||
+                (*indexed).instr.addr != (*decoded).instr.addr) {
+                std::cerr << "drcachesim unit_test_skip_instructions_index failed "
+                          << "for skip " << skip << "\n";
+                exit(1);
+            }
+        }
+        if (indexed != end) {
+            std::cerr << "drcachesim unit_test_skip_instructions_index failed: "
+                      << "extra records for skip " << skip << "\n";
+            exit(1);
+        }
+    }
+}
+
+#    ifdef UNIX
+// Checks that the mmap reader delivers the same records as the fstream reader for
+// uncompressed thread files, both from the start and after skipping via the index.
+void
+unit_test_mmap_file_reader()
+{
+    const std::string dir = "drcachesim_unit_tests_mmap";
+    if (!directory_iterator_t::is_directory(dir) &&
+        !directory_iterator_t::create_directory(dir)) {
+        std::cerr << "drcachesim unit_test_mmap_file_reader failed to create " << dir
+                  << "\n";
+        exit(1);
+    }
+    for (int tid = 1; tid <= 3; ++tid)
+        write_indexed_thread_file(dir, tid, false);
+    for (uint64_t skip : { 0, 17, 299 }) {
+        mmap_file_reader_t mapped(dir);
+        file_reader_t<std::ifstream *> streamed(dir);
+        mmap_file_reader_t mapped_end;
+        file_reader_t<std::ifstream *> streamed_end;
+        if (!mapped.init() || !streamed.init()) {
+            std::cerr << "drcachesim unit_test_mmap_file_reader failed to read\n";
+            exit(1);
+        }
+        mapped.skip_instructions(skip);
+        streamed.reader_t::skip_instructions(skip);
+        for (; streamed != streamed_end; ++streamed, ++mapped) {
+            if (mapped == mapped_end || (*mapped).instr.type != (*streamed).instr.type ||
+                (*mapped).instr.tid != (*streamed).instr.tid ||
+                (*mapped).instr.addr != (*streamed).instr.addr) {
+                std::cerr << "drcachesim unit_test_mmap_file_reader failed for skip "
+                          << skip << "\n";
+                exit(1);
+            }
+        }
+        if (mapped != mapped_end) {
+            std::cerr << "drcachesim unit_test_mmap_file_reader failed: extra records "
+                      << "for skip " << skip << "\n";
+            exit(1);
+        }
+    }
+}
+#    endif
+
+// Checks the timestamp merge of many thread files large enough to need several
+// read-ahead blocks each.  Thread i advances its timestamps at a different rate
+// and its timestamps are i mod 8, so the merged order is unambiguous.
+void
+unit_test_file_reader_merge()
+{
+    const std::string dir = "drcachesim_unit_tests_merge";
+    const int kThreads = 6;
+    const int kSegments = 400;
+    const int kInstrsPerSegment = 8;
+    if (!directory_iterator_t::is_directory(dir) &&
+        !directory_iterator_t::create_directory(dir)) {
+        std::cerr << "drcachesim unit_test_file_reader_merge failed to create " << dir
+                  << "\n";
+        exit(1);
+    }
+    for (int tid = 1; tid <= kThreads; ++tid) {
+        gzip_ostream_t out(dir + DIRSEP + "thread." + std::to_string(tid) +
+                           ".trace.gz");
+        auto write_entry = [&out](unsigned short type, unsigned short size,
+                                  addr_t addr) {
+            trace_entry_t entry;
+            entry.type = type;
+            entry.size = size;
+            entry.addr = addr;
+            out.write((char *)&entry, sizeof(entry));
+        };
+        write_entry(TRACE_TYPE_HEADER, 0, TRACE_ENTRY_VERSION);
+        write_entry(TRACE_TYPE_THREAD, 0, tid);
+        write_entry(TRACE_TYPE_PID, 0, 1);
+        for (int seg = 0; seg < kSegments; ++seg) {
+            uint64_t timestamp = (1 + seg * (tid + 2)) * 8 + tid;
+            write_entry(TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_TIMESTAMP, timestamp);
+            for (int i = 0; i < kInstrsPerSegment; ++i) {
+                write_entry(TRACE_TYPE_INSTR, 4, timestamp * 0x100 + i * 4);
+                write_entry(TRACE_TYPE_READ, 8, tid);
+            }
+        }
+        write_entry(TRACE_TYPE_THREAD_EXIT, 0, tid);
+        write_entry(TRACE_TYPE_FOOTER, 0, 0);
+    }
+    compressed_file_reader_t reader(dir);
+    compressed_file_reader_t end;
+    if (!reader.init()) {
+        std::cerr << "drcachesim unit_test_file_reader_merge failed to read\n";
+        exit(1);
+    }
+    uint64_t instr_count = 0;
+    addr_t last_pc = 0;
+    for (; reader != end; ++reader) {
+        const memref_t &memref = *reader;
+        if (memref.instr.type != TRACE_TYPE_INSTR)
+            continue;
+        memref_tid_t expect_tid = static_cast<memref_tid_t>((memref.instr.addr >> 8) % 8);
+        if (memref.instr.addr < last_pc || memref.instr.tid != expect_tid) {
+            std::cerr << "drcachesim unit_test_file_reader_merge failed: out of order"
+                      << " at instruction " << instr_count << "\n";
+            exit(1);
+        }
+        last_pc = memref.instr.addr;
+        ++instr_count;
+    }
+    if (instr_count != kThreads * kSegments * kInstrsPerSegment) {
+        std::cerr << "drcachesim unit_test_file_reader_merge failed: found "
+                  << instr_count << " instructions\n";
+        exit(1);
+    }
+}
+
+// Writes the same loop-shaped thread trace in the default and columnar formats and
+// checks that the columnar file is smaller, reads back identically, and passes the
+// trace invariants checker.  Also round-trips entries that exercise the escapes and
+// extreme deltas of the encoding, which real traces rarely reach.
+void
+unit_test_columnar_round_trip()
+{
+    const std::string dir = "drcachesim_unit_tests_columnar";
+    const int kIters = 1000;
+    if (!directory_iterator_t::is_directory(dir) &&
+        !directory_iterator_t::create_directory(dir)) {
+        std::cerr << "drcachesim unit_test_columnar_round_trip failed to create " << dir
+                  << "\n";
+        exit(1);
+    }
+    const std::string plain_path = dir + DIRSEP + "thread.1.trace.gz";
+    const std::string columnar_path = dir + DIRSEP + "thread.1." TRACE_COLUMNAR_SUFFIX;
+    {
+        gzip_ostream_t plain(plain_path);
+        columnar_ostream_t columnar(columnar_path);
+        auto write_entry = [&plain, &columnar](unsigned short type, unsigned short size,
+                                               addr_t addr) {
+            trace_entry_t entry;
+            entry.type = type;
+            entry.size = size;
+            entry.addr = addr;
+            plain.write((char *)&entry, sizeof(entry));
+            columnar.write((char *)&entry, sizeof(entry));
+        };
+        write_entry(TRACE_TYPE_HEADER, 0, TRACE_ENTRY_VERSION);
+        write_entry(TRACE_TYPE_THREAD, 0, 1);
+        write_entry(TRACE_TYPE_PID, 0, 1);
+        const addr_t loop = 0x401000;
+        for (int i = 0; i < kIters; ++i) {
+            if (i % 100 == 0) {
+                write_entry(TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_TIMESTAMP,
+                            13000000000000000ULL + i);
+                write_entry(TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_CPU_ID, i % 3);
+            }
+            for (int j = 0; j < 5; ++j) {
+                write_entry(j == 4 ? TRACE_TYPE_INSTR_CONDITIONAL_JUMP : TRACE_TYPE_INSTR,
+                            4, loop + j * 4);
+                write_entry(TRACE_TYPE_READ, 8, 0x7f0000100000ULL + i * 8);
+                if (j == 2)
+                    write_entry(TRACE_TYPE_WRITE, 8, 0x7ffffffde000ULL);
+            }
+        }
+        write_entry(TRACE_TYPE_THREAD_EXIT, 0, 1);
+        write_entry(TRACE_TYPE_FOOTER, 0, 0);
+    }
+    std::ifstream plain_file(plain_path, std::ifstream::binary | std::ifstream::ate);
+    std::ifstream columnar_file(columnar_path,
+                                std::ifstream::binary | std::ifstream::ate);
+    if (columnar_file.tellg() >= plain_file.tellg()) {
+        std::cerr << "drcachesim unit_test_columnar_round_trip failed: columnar file "
+                  << "is not smaller\n";
+        exit(1);
+    }
+    compressed_file_reader_t plain(plain_path);
+    columnar_file_reader_t columnar(columnar_path);
+    compressed_file_reader_t plain_end;
+    columnar_file_reader_t columnar_end;
+    if (!plain.init() || !columnar.init()) {
+        std::cerr << "drcachesim unit_test_columnar_round_trip failed to read\n";
+        exit(1);
+    }
+    trace_invariants_t invariants;
+    for (; plain != plain_end; ++plain, ++columnar) {
+        if (columnar == columnar_end) {
+            std::cerr << "drcachesim unit_test_columnar_round_trip failed: too few "
+                      << "records\n";
+            exit(1);
+        }
+        const memref_t &expect = *plain;
+        const memref_t &actual = *columnar;
+        // Marker fields overlap the data fields' padding, so we compare by kind.
+        if (actual.data.type != expect.data.type || actual.data.tid != expect.data.tid ||
+            (expect.marker.type == TRACE_TYPE_MARKER
+                 ? (actual.marker.marker_type != expect.marker.marker_type ||
+                    actual.marker.marker_value != expect.marker.marker_value)
+                 : (actual.data.addr != expect.data.addr ||
+                    actual.data.size != expect.data.size))) {
+            std::cerr << "drcachesim unit_test_columnar_round_trip failed: mismatch\n";
+            exit(1);
+        }
+        invariants.process_memref(*columnar);
+    }
+    if (columnar != columnar_end) {
+        std::cerr << "drcachesim unit_test_columnar_round_trip failed: extra records\n";
+        exit(1);
+    }
+
+    const trace_entry_t odd[] = {
+        { 0x1234, 0xffff, { 0 } },
+        { TRACE_TYPE_INSTR, 0xff, { ~(addr_t)0 } },
+        { TRACE_TYPE_INSTR, 1, { 0 } },
+        { TRACE_TYPE_READ, 8, { ~(addr_t)0 >> 1 } },
+        { TRACE_TYPE_WRITE, 4, { 1 } },
+        { TRACE_TYPE_MARKER, TRACE_MARKER_TYPE_TIMESTAMP, { 42 } },
+    };
+    const uint32_t count = sizeof(odd) / sizeof(odd[0]);
+    std::string block;
+    columnar_encode_block(odd, count, &block);
+    columnar_block_header_t header;
+    memcpy(&header, block.data(), sizeof(header));
+    trace_entry_t decoded[count];
+    if (!columnar_decode_block(header, block.data() + sizeof(header), decoded) ||
+        memcmp(decoded, odd, sizeof(odd)) != 0) {
+        std::cerr << "drcachesim unit_test_columnar_round_trip failed: bad block\n";
+        exit(1);
+    }
+}
+#endif
+
+#ifdef LINUX
+// Sends several threads' online trace entries through a shared-memory ring with
+// only two slots, so writers regularly wait for the reader, and checks that
+// ipc_reader_t sees each thread's entries complete and in order.
+void
+unit_test_ipc_shm_ring()
+{
+    const std::string name = "drcachesim_unit_tests_ring." + std::to_string(getpid());
+    const int kThreads = 4;
+    const int kWrites = 300;
+    const int kInstrsPerWrite = 50;
+    ipc_reader_t reader(name.c_str(), 0);
+    ipc_reader_t end;
+    shm_ring_t ring(name.c_str());
+    if (!reader || !ring.open_for_write()) {
+        std::cerr << "drcachesim unit_test_ipc_shm_ring failed to create the ring\n";
+        exit(1);
+    }
+    std::thread producer([&ring]() {
+        std::vector<std::thread> writers;
+        for (int tid = 1; tid <= kThreads; ++tid) {
+            writers.push_back(std::thread([&ring, tid]() {
+                std::vector<trace_entry_t> buf;
+                auto append = [&buf](unsigned short type, unsigned short size,
+                                     addr_t addr) {
+                    trace_entry_t entry;
+                    entry.type = type;
+                    entry.size = size;
+                    entry.addr = addr;
+                    buf.push_back(entry);
+                };
+                for (int write = 0; write < kWrites; ++write) {
+                    buf.clear();
+                    append(TRACE_TYPE_THREAD, sizeof(thread_id_t), tid);
+                    if (write == 0)
+                        append(TRACE_TYPE_PID, sizeof(process_id_t), 1);
+                    for (int i = 0; i < kInstrsPerWrite; ++i)
+                        append(TRACE_TYPE_INSTR, 4, write * kInstrsPerWrite + i);
+                    if (write == kWrites - 1)
+                        append(TRACE_TYPE_THREAD_EXIT, sizeof(thread_id_t), tid);
+                    if (!ring.write(buf.data(), buf.size() * sizeof(buf[0]))) {
+                        std::cerr << "drcachesim unit_test_ipc_shm_ring failed to "
+                                  << "write\n";
+                        exit(1);
+                    }
+                }
+            }));
+        }
+        for (std::thread &writer : writers)
+            writer.join();
+        // The reader reaches the end once every writer has closed.
+        ring.close();
+    });
+    if (!reader.init()) {
+        std::cerr << "drcachesim unit_test_ipc_shm_ring failed to read\n";
+        exit(1);
+    }
+    std::vector<addr_t> next_pc(kThreads + 1, 0);
+    int exits = 0;
+    for (; reader != end; ++reader) {
+        const memref_t &memref = *reader;
+        if (memref.exit.type == TRACE_TYPE_THREAD_EXIT) {
+            ++exits;
+            continue;
+        }
+        if (memref.instr.type != TRACE_TYPE_INSTR)
+            continue;
+        if (memref.instr.tid < 1 || memref.instr.tid > kThreads ||
+            memref.instr.addr != next_pc[memref.instr.tid]) {
+            std::cerr << "drcachesim unit_test_ipc_shm_ring failed: unexpected "
+                      << "instruction " << memref.instr.addr << " for thread "
+                      << memref.instr.tid << "\n";
+            exit(1);
+        }
+        ++next_pc[memref.instr.tid];
+    }
+    producer.join();
+    for (int tid = 1; tid <= kThreads; ++tid) {
+        if (next_pc[tid] != kWrites * kInstrsPerWrite) {
+            std::cerr << "drcachesim unit_test_ipc_shm_ring failed: thread " << tid
+                      << " is missing instructions\n";
+            exit(1);
+        }
+    }
+    if (exits != kThreads) {
+        std::cerr << "drcachesim unit_test_ipc_shm_ring failed: saw " << exits
+                  << " thread exits\n";
+        exit(1);
+    }
+}
+#endif
+
+void
+unit_test_reuse_distance_tree()
+{
+    // Compare the tree's distances against the skip list's on a skewed random
+    // stream with enough lines and accesses to force several tree compactions.
+    const uint64_t threshold = 100;
+    line_ref_list_t list(threshold, 50, false);
+    line_ref_tree_t tree(threshold);
+    std::unordered_map<addr_t, std::pair<line_ref_t *, line_ref_t *>> lines;
+    std::srand(42);
+    for (int i = 0; i < 200000; ++i) {
+        addr_t tag = std::rand() % 64;
+        if (i % 4 == 0)
+            tag = std::rand() % 4096;
+        auto it = lines.find(tag);
+        if (it == lines.end()) {
+            line_ref_t *list_ref = new line_ref_t(tag);
+            line_ref_t *tree_ref = new line_ref_t(tag);
+            list.add_to_front(list_ref);
+            tree.add_to_front(tree_ref);
+            lines[tag] = std::make_pair(list_ref, tree_ref);
+            continue;
+        }
+        int_least64_t list_dist = list.move_to_front(it->second.first);
+        int_least64_t tree_dist = tree.move_to_front(it->second.second);
+        if (list_dist != tree_dist ||
+            it->second.first->distant_refs != it->second.second->distant_refs) {
+            std::cerr << "drcachesim unit_test_reuse_distance_tree failed at access "
+                      << i << ": " << list_dist << " vs " << tree_dist << "\n";
+            exit(1);
+        }
+    }
+    if (list.cur_time != tree.cur_time || list.unique_lines != tree.unique_lines) {
+        std::cerr << "drcachesim unit_test_reuse_distance_tree failed: count mismatch\n";
+        exit(1);
+    }
+}
+
+// Exposes the results of a single-threaded reuse distance run.
+class test_reuse_distance_t : public reuse_distance_t {
+public:
+    explicit test_reuse_distance_t(const reuse_distance_knobs_t &knobs)
+        : reuse_distance_t(knobs)
+    {
+    }
+    // Returns the fraction of reuses at a distance below each of the given bounds.
+    std::vector<double>
+    fraction_below(const std::vector<int_least64_t> &bounds) const
+    {
+        const shard_data_t *shard = shard_map.begin()->second;
+        std::vector<double> below(bounds.size(), 0.);
+        int_least64_t total = 0;
+        for (const auto &dist : shard->dist_map) {
+            total += dist.second;
+            for (size_t i = 0; i < bounds.size(); ++i) {
+                if (dist.first < bounds[i])
+                    below[i] += dist.second;
+            }
+        }
+        for (double &fraction : below)
+            fraction /= total;
+        return below;
+    }
+    double
+    sample_rate() const
+    {
+        return shard_map.begin()->second->sample_rate;
+    }
+    size_t
+    tracked_lines() const
+    {
+        return shard_map.begin()->second->cache_map.size();
+    }
+};
+
+void
+unit_test_reuse_distance_sampling()
+{
+    // Compare the sampled histogram against the exact one on a stream mixing a
+    // small hot set with a large cold set, so distances span a wide range.
+    reuse_distance_knobs_t knobs;
+    knobs.distance_threshold = 64;
+    knobs.use_tree = true;
+    test_reuse_distance_t exact(knobs);
+    knobs.sample_rate = 0.1;
+    test_reuse_distance_t sampled(knobs);
+    knobs.sample_rate = 1.;
+    knobs.sample_max_lines = 8000;
+    test_reuse_distance_t bounded(knobs);
+    std::srand(42);
+    for (int i = 0; i < 1000000; ++i) {
+        memref_t ref;
+        ref.data.type = TRACE_TYPE_READ;
+        ref.data.tid = 1;
+        ref.data.size = 8;
+        if (i % 3 == 0)
+            ref.data.addr = (std::rand() % 65536) * 64;
+        else
+            ref.data.addr = (std::rand() % 4096) * 64;
+        if (!exact.process_memref(ref) || !sampled.process_memref(ref) ||
+            !bounded.process_memref(ref)) {
+            std::cerr << "drcachesim unit_test_reuse_distance_sampling failed\n";
+            exit(1);
+        }
+    }
+    if (std::abs(sampled.sample_rate() - 0.1) > 0.001) {
+        std::cerr << "drcachesim unit_test_reuse_distance_sampling failed: rate "
+                  << sampled.sample_rate() << "\n";
+        exit(1);
+    }
+    // -reuse_sample_max_lines must hold the tracked lines to the limit by
+    // lowering the rate to roughly limit/lines.
+    if (bounded.tracked_lines() > knobs.sample_max_lines ||
+        bounded.sample_rate() > 2. * knobs.sample_max_lines / 65536) {
+        std::cerr << "drcachesim unit_test_reuse_distance_sampling failed: "
+                  << bounded.tracked_lines() << " lines at rate "
+                  << bounded.sample_rate() << "\n";
+        exit(1);
+    }
+    const std::vector<int_least64_t> bounds = { 1024, 4096, 8192, 16384, 65536 };
+    std::vector<double> want = exact.fraction_below(bounds);
+    std::vector<double> got_sampled = sampled.fraction_below(bounds);
+    std::vector<double> got_bounded = bounded.fraction_below(bounds);
+    // The bounded run measured its early distances at higher rates, so we allow
+    // it more error.
+    for (size_t i = 0; i < bounds.size(); ++i) {
+        if (std::abs(got_sampled[i] - want[i]) > 0.03 ||
+            std::abs(got_bounded[i] - want[i]) > 0.08) {
+            std::cerr << "drcachesim unit_test_reuse_distance_sampling failed: "
+                      << "fraction below " << bounds[i] << " is " << want[i]
+                      << " but sampled " << got_sampled[i] << " and bounded "
+                      << got_bounded[i] << "\n";
+            exit(1);
+        }
+    }
+}
+
 int
 main(int argc, const char *argv[])
 {
     unit_test_warmup_fraction();
     unit_test_warmup_refs();
     unit_test_sim_refs();
+    unit_test_sim_threads();
+    unit_test_reuse_distance_tree();
+    unit_test_reuse_distance_sampling();
+    unit_test_checkpoint();
+    unit_test_miss_curve();
+#ifdef LINUX
+    unit_test_ipc_shm_ring();
+#endif
+#ifdef HAS_ZLIB
+    unit_test_skip_instructions_index();
+#    ifdef UNIX
+    unit_test_mmap_file_reader();
+#    endif
+    unit_test_file_reader_merge();
+    unit_test_columnar_round_trip();
+#endif
     return 0;
 }
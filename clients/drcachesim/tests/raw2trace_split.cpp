@@ -0,0 +1,176 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* This application converts a set of existing raw files with raw2trace_t once as
+ * whole files and then again split into pieces with raw2trace_t::set_chunk_size(),
+ * and checks that each split conversion produces exactly the same records.
+ */
+
+#include "droption.h"
+#include "tracer/raw2trace.h"
+#include "tracer/raw2trace_directory.h"
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+static droption_t<std::string> op_indir(DROPTION_SCOPE_FRONTEND, "indir", "",
+                                        "[Required] Directory with trace input files",
+                                        "Specifies a directory with raw files.");
+
+static droption_t<int> op_jobs(DROPTION_SCOPE_FRONTEND, "jobs", 4,
+                               "Number of conversion threads",
+                               "The worker thread count for the split conversions.");
+
+#define REPORT(msg)                    \
+    do {                               \
+        std::cerr << msg << std::endl; \
+    } while (0)
+
+// Converts dir's raw files into one string of trace_entry_t records per file.
+static bool
+convert(raw2trace_directory_t *dir, int jobs, uint64 chunk_size,
+        std::vector<std::string> *records)
+{
+    std::vector<std::ostringstream> out(dir->in_files.size());
+    std::vector<std::ostream *> out_files;
+    for (size_t i = 0; i < dir->in_files.size(); ++i) {
+        // Rewind the input after any prior conversion.
+        dir->in_files[i]->clear();
+        dir->in_files[i]->seekg(0);
+        out_files.push_back(&out[i]);
+    }
+    raw2trace_t raw2trace(dir->modfile_bytes, dir->in_files, out_files, NULL, 0, jobs);
+    if (chunk_size > 0) {
+        std::string error = raw2trace.set_chunk_size(chunk_size);
+        if (!error.empty()) {
+            REPORT("Split setup failed: " << error);
+            return false;
+        }
+    }
+    std::string error = raw2trace.do_conversion();
+    if (!error.empty()) {
+        REPORT("Conversion failed: " << error);
+        return false;
+    }
+    records->clear();
+    for (const std::ostringstream &stream : out)
+        records->push_back(stream.str());
+    return true;
+}
+
+static std::string
+entry_to_string(const trace_entry_t &entry)
+{
+    std::ostringstream ss;
+    ss << "type " << entry.type << " size " << entry.size << " addr 0x" << std::hex
+       << entry.addr;
+    return ss.str();
+}
+
+// Compares the records of one thread file, reporting the first difference.
+static bool
+compare_records(size_t file, uint64 chunk_size, const std::string &expect,
+                const std::string &actual)
+{
+    const trace_entry_t *expect_entry =
+        reinterpret_cast<const trace_entry_t *>(expect.data());
+    const trace_entry_t *actual_entry =
+        reinterpret_cast<const trace_entry_t *>(actual.data());
+    size_t expect_count = expect.size() / sizeof(trace_entry_t);
+    size_t actual_count = actual.size() / sizeof(trace_entry_t);
+    for (size_t i = 0; i < expect_count && i < actual_count; ++i) {
+        if (expect_entry[i].type != actual_entry[i].type ||
+            expect_entry[i].size != actual_entry[i].size ||
+            expect_entry[i].addr != actual_entry[i].addr) {
+            REPORT("Split size " << chunk_size << ": thread file " << file
+                                 << " record " << i << " is "
+                                 << entry_to_string(actual_entry[i]) << " instead of "
+                                 << entry_to_string(expect_entry[i]));
+            return false;
+        }
+    }
+    if (expect_count != actual_count || expect.size() != actual.size()) {
+        REPORT("Split size " << chunk_size << ": thread file " << file << " has "
+                             << actual_count << " records instead of " << expect_count);
+        return false;
+    }
+    return true;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    std::string parse_err;
+    if (!droption_parser_t::parse_argv(DROPTION_SCOPE_FRONTEND, argc, (const char **)argv,
+                                       &parse_err, NULL) ||
+        op_indir.get_value().empty()) {
+        std::cerr << "Usage error: " << parse_err << "\nUsage:\n"
+                  << droption_parser_t::usage_short(DROPTION_SCOPE_ALL);
+        return 1;
+    }
+
+    raw2trace_directory_t dir;
+    std::string dir_err = dir.initialize(op_indir.get_value(), "");
+    if (!dir_err.empty()) {
+        REPORT("Directory setup failed: " << dir_err);
+        return 1;
+    }
+
+    std::vector<std::string> expect;
+    if (!convert(&dir, 0, 0, &expect))
+        return 1;
+    REPORT("Converted the raw files whole");
+    // The smallest size splits at every buffer boundary, which is where the
+    // delayed branches and rep string state cross from one piece to the next.
+    const uint64 chunk_sizes[] = { 1, 4 * 1024, 64 * 1024 };
+    bool success = true;
+    for (uint64 chunk_size : chunk_sizes) {
+        std::vector<std::string> actual;
+        if (!convert(&dir, op_jobs.get_value(), chunk_size, &actual))
+            return 1;
+        bool match = true;
+        for (size_t i = 0; i < expect.size(); ++i) {
+            if (!compare_records(i, chunk_size, expect[i], actual[i]))
+                match = false;
+        }
+        if (match)
+            REPORT("Split size " << chunk_size << ": records match");
+        else
+            success = false;
+    }
+
+    // Leave the directory's trace as the whole-file conversion wrote it.
+    for (size_t i = 0; i < expect.size(); ++i)
+        dir.out_files[i]->write(expect[i].data(), expect[i].size());
+    return success ? 0 : 1;
+}
@@ -0,0 +1,71 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* Runs rep string loops long enough to span many trace buffers, so that buffer
+ * boundaries fall in the middle of a loop.
+ */
+
+#include "tools.h"
+#include <string.h>
+#ifdef WINDOWS
+#    include <intrin.h>
+#endif
+
+/* Each iteration records an instruction and a store, so this covers a few dozen
+ * buffers of the tracer's 4096 entries.
+ */
+#define BUF_SIZE 64 * 1024
+static char buf[BUF_SIZE];
+
+static void
+fill(char *dst, char value, size_t count)
+{
+#if defined(X86) && defined(UNIX)
+    __asm__ __volatile__("rep stosb" : "+D"(dst), "+c"(count) : "a"(value) : "memory");
+#elif defined(X86)
+    __stosb((unsigned char *)dst, value, count);
+#else
+    memset(dst, value, count);
+#endif
+}
+
+int
+main(int argc, char **argv)
+{
+    int i;
+    for (i = 0; i < 4; i++)
+        fill(buf, (char)i, BUF_SIZE);
+    if (buf[BUF_SIZE - 1] != 3)
+        print("fill failed\n");
+    print("all done\n");
+    return 0;
+}
@@ -88,24 +88,34 @@ basic_counts_t::parallel_shard_error(void *shard_data)
     return counters->error;
 }
 
-bool
-basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+inline void
+basic_counts_t::count_memref(counters_t *counters, const memref_t &memref)
 {
-    counters_t *counters = reinterpret_cast<counters_t *>(shard_data);
     if (type_is_instr(memref.instr.type)) {
         ++counters->instrs;
+        if (counters->cur_window != nullptr)
+            ++counters->cur_window->instrs;
     } else if (memref.data.type == TRACE_TYPE_INSTR_NO_FETCH) {
         ++counters->instrs_nofetch;
     } else if (type_is_prefetch(memref.data.type)) {
         ++counters->prefetches;
     } else if (memref.data.type == TRACE_TYPE_READ) {
         ++counters->loads;
+        if (counters->cur_window != nullptr)
+            ++counters->cur_window->loads;
     } else if (memref.data.type == TRACE_TYPE_WRITE) {
         ++counters->stores;
+        if (counters->cur_window != nullptr)
+            ++counters->cur_window->stores;
     } else if (memref.marker.type == TRACE_TYPE_MARKER) {
         if (memref.marker.marker_type == TRACE_MARKER_TYPE_TIMESTAMP ||
-            memref.marker.marker_type == TRACE_MARKER_TYPE_CPU_ID) {
+            memref.marker.marker_type == TRACE_MARKER_TYPE_CPU_ID ||
+            memref.marker.marker_type == TRACE_MARKER_TYPE_WINDOW_ID) {
             ++counters->sched_markers;
+            // Each buffer of a windowed trace starts with the id of the window
+            // its records belong to.
+            if (memref.marker.marker_type == TRACE_MARKER_TYPE_WINDOW_ID)
+                counters->cur_window = &counters->windows[memref.marker.marker_value];
         } else if (memref.marker.marker_type == TRACE_MARKER_TYPE_KERNEL_EVENT ||
                    memref.marker.marker_type == TRACE_MARKER_TYPE_KERNEL_XFER) {
             ++counters->xfer_markers;
@@ -121,6 +131,22 @@ basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
     } else if (memref.data.type == TRACE_TYPE_THREAD_EXIT) {
         counters->tid = memref.exit.tid;
     }
+}
+
+bool
+basic_counts_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
+{
+    count_memref(reinterpret_cast<counters_t *>(shard_data), memref);
+    return true;
+}
+
+bool
+basic_counts_t::parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                            size_t count)
+{
+    counters_t *counters = reinterpret_cast<counters_t *>(shard_data);
+    for (size_t i = 0; i < count; ++i)
+        count_memref(counters, memrefs[i]);
     return true;
 }
 
@@ -174,6 +200,12 @@ basic_counts_t::print_results()
     std::cerr << std::setw(12) << total.func_retval_markers
               << " total function return value markers\n";
     std::cerr << std::setw(12) << total.other_markers << " total other markers\n";
+    for (const auto &window : total.windows) {
+        std::cerr << "Window #" << window.first << " counts:\n";
+        std::cerr << std::setw(12) << window.second.instrs << " (fetched) instructions\n";
+        std::cerr << std::setw(12) << window.second.loads << " data loads\n";
+        std::cerr << std::setw(12) << window.second.stores << " data stores\n";
+    }
 
     // Print the threads sorted by instrs.
     std::vector<std::pair<memref_tid_t, counters_t *>> sorted(shard_map.begin(),
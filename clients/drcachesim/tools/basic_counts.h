@@ -33,6 +33,7 @@
 #ifndef _BASIC_COUNTS_H_
 #define _BASIC_COUNTS_H_ 1
 
+#include <map>
 #include <mutex>
 #include <string>
 #include <unordered_map>
@@ -55,10 +56,27 @@ public:
     parallel_shard_exit(void *shard_data) override;
     bool
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
+    bool
+    parallel_shard_memref_batch(void *shard_data, const memref_t *memrefs,
+                                size_t count) override;
     std::string
     parallel_shard_error(void *shard_data) override;
 
 protected:
+    // Counts for one TRACE_MARKER_TYPE_WINDOW_ID window of a windowed trace.
+    struct window_counts_t {
+        window_counts_t &
+        operator+=(const window_counts_t &rhs)
+        {
+            instrs += rhs.instrs;
+            loads += rhs.loads;
+            stores += rhs.stores;
+            return *this;
+        }
+        int_least64_t instrs = 0;
+        int_least64_t loads = 0;
+        int_least64_t stores = 0;
+    };
     struct counters_t {
         counters_t()
         {
@@ -78,6 +96,8 @@ protected:
             func_arg_markers += rhs.func_arg_markers;
             func_retval_markers += rhs.func_retval_markers;
             other_markers += rhs.other_markers;
+            for (const auto &window : rhs.windows)
+                windows[window.first] += window.second;
             return *this;
         }
         memref_tid_t tid = 0;
@@ -93,8 +113,17 @@ protected:
         int_least64_t func_arg_markers = 0;
         int_least64_t func_retval_markers = 0;
         int_least64_t other_markers = 0;
+        // Keyed by window id.  Only filled in for windowed traces.
+        std::map<uintptr_t, window_counts_t> windows;
+        // The entry in windows for the window we are in, if any.
+        window_counts_t *cur_window = nullptr;
         std::string error;
     };
+    // Shared by the per-entry and batched interfaces.  This is non-virtual so the
+    // batched loop can inline it.
+    void
+    count_memref(counters_t *counters, const memref_t &memref);
+
     static bool
     cmp_counters(const std::pair<memref_tid_t, counters_t *> &l,
                  const std::pair<memref_tid_t, counters_t *> &r);
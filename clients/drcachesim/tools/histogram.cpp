@@ -31,27 +31,187 @@
  */
 
 #include <algorithm>
+#include <atomic>
+#include <cmath>
 #include <iomanip>
 #include <iostream>
+#include <thread>
 #include <vector>
 #include "histogram.h"
 #include "../common/utils.h"
 
 const std::string histogram_t::TOOL_NAME = "Cache line histogram tool";
+const int histogram_t::distinct_lines_t::kIndexBits;
+const size_t histogram_t::distinct_lines_t::kRegisters;
 
 analysis_tool_t *
 histogram_tool_create(unsigned int line_size = 64, unsigned int report_top = 10,
-                      unsigned int verbose = 0)
+                      unsigned int verbose = 0, double approx_error = 0.)
 {
-    return new histogram_t(line_size, report_top, verbose);
+    return new histogram_t(line_size, report_top, verbose, approx_error);
 }
 
 histogram_t::histogram_t(unsigned int line_size, unsigned int report_top,
-                         unsigned int verbose)
+                         unsigned int verbose, double approx_error)
     : knob_line_size(line_size)
     , knob_report_top(report_top)
+    , knob_approx_error(approx_error)
+    , summary_capacity(0)
 {
     line_size_bits = compute_log2((int)line_size);
+    if (knob_approx_error > 0.) {
+        summary_capacity = static_cast<size_t>(std::ceil(1. / knob_approx_error));
+        if (summary_capacity < knob_report_top)
+            summary_capacity = knob_report_top;
+        serial_shard = shard_data_t(summary_capacity);
+    }
+}
+
+void
+histogram_t::line_summary_t::swap_counts(size_t pos1, size_t pos2)
+{
+    std::swap(heap[pos1], heap[pos2]);
+    position[heap[pos1].line] = pos1;
+    position[heap[pos2].line] = pos2;
+}
+
+void
+histogram_t::line_summary_t::sift_up(size_t pos)
+{
+    while (pos > 0) {
+        size_t parent = (pos - 1) / 2;
+        if (heap[parent].count <= heap[pos].count)
+            break;
+        swap_counts(pos, parent);
+        pos = parent;
+    }
+}
+
+void
+histogram_t::line_summary_t::sift_down(size_t pos)
+{
+    while (true) {
+        size_t smallest = pos;
+        size_t left = 2 * pos + 1;
+        size_t right = left + 1;
+        if (left < heap.size() && heap[left].count < heap[smallest].count)
+            smallest = left;
+        if (right < heap.size() && heap[right].count < heap[smallest].count)
+            smallest = right;
+        if (smallest == pos)
+            break;
+        swap_counts(pos, smallest);
+        pos = smallest;
+    }
+}
+
+void
+histogram_t::line_summary_t::add(addr_t line)
+{
+    auto it = position.find(line);
+    if (it != position.end()) {
+        ++heap[it->second].count;
+        sift_down(it->second);
+    } else if (heap.size() < capacity) {
+        position[line] = heap.size();
+        heap.push_back({ line, 1, 0 });
+        sift_up(heap.size() - 1);
+    } else if (!heap.empty()) {
+        // Replace the line with the smallest count, which stays at the root.
+        position.erase(heap[0].line);
+        position[line] = 0;
+        heap[0].error = heap[0].count;
+        heap[0].line = line;
+        ++heap[0].count;
+        sift_down(0);
+    }
+}
+
+void
+histogram_t::line_summary_t::merge(const line_summary_t &other)
+{
+    uint64_t bound = untracked_bound();
+    uint64_t other_bound = other.untracked_bound();
+    std::unordered_map<addr_t, line_count_t> combined;
+    for (const line_count_t &mine : heap) {
+        combined[mine.line] = { mine.line, mine.count + other_bound,
+                                mine.error + other_bound };
+    }
+    for (const line_count_t &theirs : other.heap) {
+        auto it = combined.find(theirs.line);
+        if (it == combined.end()) {
+            combined[theirs.line] = { theirs.line, theirs.count + bound,
+                                      theirs.error + bound };
+        } else {
+            it->second.count += theirs.count - other_bound;
+            it->second.error += theirs.error - other_bound;
+        }
+    }
+    heap.clear();
+    for (const auto &keyval : combined)
+        heap.push_back(keyval.second);
+    // Keep the largest counts.  Every dropped count is at most the smallest kept
+    // one, which is then the bound for untracked lines.
+    if (heap.size() > capacity) {
+        std::nth_element(heap.begin(), heap.begin() + capacity, heap.end(),
+                         [](const line_count_t &l, const line_count_t &r) {
+                             return l.count > r.count;
+                         });
+        heap.resize(capacity);
+    }
+    position.clear();
+    for (size_t i = 0; i < heap.size(); ++i)
+        position[heap[i].line] = i;
+    for (size_t i = heap.size() / 2; i > 0; --i)
+        sift_down(i - 1);
+}
+
+void
+histogram_t::distinct_lines_t::add(addr_t line)
+{
+    // A 64-bit finalizer from MurmurHash3 spreads nearby lines across registers.
+    uint64_t hash = static_cast<uint64_t>(line);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    size_t index = static_cast<size_t>(hash >> (64 - kIndexBits));
+    uint64_t rest = hash << kIndexBits;
+    uint8_t rank = 1;
+    while (rank <= 64 - kIndexBits && (rest & (1ULL << 63)) == 0) {
+        rest <<= 1;
+        ++rank;
+    }
+    if (rank > registers[index])
+        registers[index] = rank;
+}
+
+void
+histogram_t::distinct_lines_t::merge(const distinct_lines_t &other)
+{
+    for (size_t i = 0; i < kRegisters; ++i) {
+        if (other.registers[i] > registers[i])
+            registers[i] = other.registers[i];
+    }
+}
+
+uint64_t
+histogram_t::distinct_lines_t::estimate() const
+{
+    const double m = static_cast<double>(kRegisters);
+    double sum = 0.;
+    size_t zeros = 0;
+    for (uint8_t reg : registers) {
+        sum += std::ldexp(1., -reg);
+        if (reg == 0)
+            ++zeros;
+    }
+    double estimate = 0.7213 / (1. + 1.079 / m) * m * m / sum;
+    // Small cardinalities are more accurate from the count of empty registers.
+    if (estimate <= 2.5 * m && zeros > 0)
+        estimate = m * std::log(m / zeros);
+    return static_cast<uint64_t>(estimate + 0.5);
 }
 
 histogram_t::~histogram_t()
@@ -82,7 +242,7 @@ histogram_t::parallel_worker_exit(void *worker_data)
 void *
 histogram_t::parallel_shard_init(int shard_index, void *worker_data)
 {
-    auto shard = new shard_data_t;
+    auto shard = new shard_data_t(summary_capacity);
     std::lock_guard<std::mutex> guard(shard_map_mutex);
     shard_map[shard_index] = shard;
     return reinterpret_cast<void *>(shard);
@@ -100,14 +260,27 @@ histogram_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
 {
     shard_data_t *shard = reinterpret_cast<shard_data_t *>(shard_data);
     if (type_is_instr(memref.instr.type) ||
-        memref.instr.type == TRACE_TYPE_PREFETCH_INSTR)
-        ++shard->icache_map[memref.instr.addr >> line_size_bits];
-    else if (memref.data.type == TRACE_TYPE_READ ||
-             memref.data.type == TRACE_TYPE_WRITE ||
-             // We may potentially handle prefetches differently.
-             // TRACE_TYPE_PREFETCH_INSTR is handled above.
-             type_is_prefetch(memref.data.type))
-        ++shard->dcache_map[memref.data.addr >> line_size_bits];
+        memref.instr.type == TRACE_TYPE_PREFETCH_INSTR) {
+        addr_t line = memref.instr.addr >> line_size_bits;
+        if (summary_capacity == 0)
+            ++shard->icache_map[line];
+        else {
+            shard->icache_summary.add(line);
+            shard->icache_lines.add(line);
+        }
+    } else if (memref.data.type == TRACE_TYPE_READ ||
+               memref.data.type == TRACE_TYPE_WRITE ||
+               // We may potentially handle prefetches differently.
+               // TRACE_TYPE_PREFETCH_INSTR is handled above.
+               type_is_prefetch(memref.data.type)) {
+        addr_t line = memref.data.addr >> line_size_bits;
+        if (summary_capacity == 0)
+            ++shard->dcache_map[line];
+        else {
+            shard->dcache_summary.add(line);
+            shard->dcache_lines.add(line);
+        }
+    }
     return true;
 }
 
@@ -128,49 +301,113 @@ histogram_t::process_memref(const memref_t &memref)
     return true;
 }
 
+void
+histogram_t::merge_shard(shard_data_t *dst, shard_data_t *src)
+{
+    if (summary_capacity == 0) {
+        for (const auto &keyvals : src->icache_map)
+            dst->icache_map[keyvals.first] += keyvals.second;
+        for (const auto &keyvals : src->dcache_map)
+            dst->dcache_map[keyvals.first] += keyvals.second;
+        // Free the memory as we go.
+        std::unordered_map<addr_t, uint64_t>().swap(src->icache_map);
+        std::unordered_map<addr_t, uint64_t>().swap(src->dcache_map);
+    } else {
+        dst->icache_summary.merge(src->icache_summary);
+        dst->dcache_summary.merge(src->dcache_summary);
+        dst->icache_lines.merge(src->icache_lines);
+        dst->dcache_lines.merge(src->dcache_lines);
+    }
+}
+
+// Merges all the shards into the first one as a binary tree: each round merges
+// disjoint pairs of partial results in parallel, so there are only a logarithmic
+// number of rounds, rather than one thread folding in every shard in turn.
+void
+histogram_t::merge_shards(std::vector<shard_data_t *> &shards)
+{
+    size_t max_threads = std::thread::hardware_concurrency();
+    if (max_threads == 0)
+        max_threads = 1;
+    for (size_t stride = 1; stride < shards.size(); stride *= 2) {
+        std::vector<std::pair<shard_data_t *, shard_data_t *>> pairs;
+        for (size_t i = 0; i + stride < shards.size(); i += 2 * stride)
+            pairs.push_back(std::make_pair(shards[i], shards[i + stride]));
+        std::atomic<size_t> next_pair(0);
+        auto merge_pairs = [this, &pairs, &next_pair]() {
+            for (size_t i = next_pair++; i < pairs.size(); i = next_pair++)
+                merge_shard(pairs[i].first, pairs[i].second);
+        };
+        std::vector<std::thread> threads;
+        for (size_t i = 1; i < std::min(max_threads, pairs.size()); ++i)
+            threads.push_back(std::thread(merge_pairs));
+        merge_pairs();
+        for (std::thread &thread : threads)
+            thread.join();
+    }
+}
+
 bool
 cmp(const std::pair<addr_t, uint64_t> &l, const std::pair<addr_t, uint64_t> &r)
 {
     return l.second > r.second;
 }
 
+void
+histogram_t::print_top(const std::string &name,
+                       const std::unordered_map<addr_t, uint64_t> &exact_counts,
+                       const line_summary_t &summary)
+{
+    std::vector<line_count_t> top(knob_report_top);
+    auto more = [](const line_count_t &l, const line_count_t &r) {
+        return l.count > r.count;
+    };
+    if (summary_capacity == 0) {
+        std::vector<std::pair<addr_t, uint64_t>> top_exact(knob_report_top);
+        std::partial_sort_copy(exact_counts.begin(), exact_counts.end(),
+                               top_exact.begin(), top_exact.end(), cmp);
+        for (size_t i = 0; i < top.size(); ++i)
+            top[i] = { top_exact[i].first, top_exact[i].second, 0 };
+    } else {
+        std::partial_sort_copy(summary.counts().begin(), summary.counts().end(),
+                               top.begin(), top.end(), more);
+    }
+    std::cerr << name << " top " << top.size() << "\n";
+    for (const line_count_t &entry : top) {
+        std::cerr << std::setw(18) << std::hex << std::showbase
+                  << (entry.line << line_size_bits) << ": " << std::dec << entry.count;
+        if (summary_capacity != 0)
+            std::cerr << " (overcount <= " << entry.error << ")";
+        std::cerr << "\n";
+    }
+}
+
 bool
 histogram_t::print_results()
 {
-    shard_data_t total;
-    if (shard_map.empty()) {
-        total = serial_shard;
-    } else {
-        for (const auto &shard : shard_map) {
-            for (const auto &keyvals : shard.second->icache_map) {
-                total.icache_map[keyvals.first] += keyvals.second;
-            }
-            for (const auto &keyvals : shard.second->dcache_map) {
-                total.dcache_map[keyvals.first] += keyvals.second;
-            }
-        }
+    shard_data_t *total = &serial_shard;
+    if (!shard_map.empty()) {
+        // Merge in shard order so the approximate results are reproducible.
+        std::vector<std::pair<memref_tid_t, shard_data_t *>> ordered(shard_map.begin(),
+                                                                      shard_map.end());
+        std::sort(ordered.begin(), ordered.end());
+        std::vector<shard_data_t *> shards;
+        for (const auto &shard : ordered)
+            shards.push_back(shard.second);
+        merge_shards(shards);
+        total = shards[0];
     }
     std::cerr << TOOL_NAME << " results:\n";
-    std::cerr << "icache: " << total.icache_map.size() << " unique cache lines\n";
-    std::cerr << "dcache: " << total.dcache_map.size() << " unique cache lines\n";
-    std::vector<std::pair<addr_t, uint64_t>> top(knob_report_top);
-    std::partial_sort_copy(total.icache_map.begin(), total.icache_map.end(), top.begin(),
-                           top.end(), cmp);
-    std::cerr << "icache top " << top.size() << "\n";
-    for (std::vector<std::pair<addr_t, uint64_t>>::iterator it = top.begin();
-         it != top.end(); ++it) {
-        std::cerr << std::setw(18) << std::hex << std::showbase << (it->first << 6)
-                  << ": " << std::dec << it->second << "\n";
-    }
-    top.clear();
-    top.resize(knob_report_top);
-    std::partial_sort_copy(total.dcache_map.begin(), total.dcache_map.end(), top.begin(),
-                           top.end(), cmp);
-    std::cerr << "dcache top " << top.size() << "\n";
-    for (std::vector<std::pair<addr_t, uint64_t>>::iterator it = top.begin();
-         it != top.end(); ++it) {
-        std::cerr << std::setw(18) << std::hex << std::showbase << (it->first << 6)
-                  << ": " << std::dec << it->second << "\n";
+    if (summary_capacity == 0) {
+        std::cerr << "icache: " << total->icache_map.size() << " unique cache lines\n";
+        std::cerr << "dcache: " << total->dcache_map.size() << " unique cache lines\n";
+    } else {
+        std::cerr << "icache: ~" << total->icache_lines.estimate()
+                  << " unique cache lines (estimated)\n";
+        std::cerr << "dcache: ~" << total->dcache_lines.estimate()
+                  << " unique cache lines (estimated)\n";
     }
+    print_top("icache", total->icache_map, total->icache_summary);
+    print_top("dcache", total->dcache_map, total->dcache_summary);
     return true;
 }
@@ -37,15 +37,18 @@
 #define _HISTOGRAM_H_ 1
 
 #include <mutex>
+#include <stdint.h>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "analysis_tool.h"
 #include "memref.h"
 
 class histogram_t : public analysis_tool_t {
 public:
-    histogram_t(unsigned int line_size, unsigned int report_top, unsigned int verbose);
+    histogram_t(unsigned int line_size, unsigned int report_top, unsigned int verbose,
+                double approx_error = 0.);
     virtual ~histogram_t();
     bool
     process_memref(const memref_t &memref) override;
@@ -67,15 +70,113 @@ public:
     parallel_shard_error(void *shard_data) override;
 
 protected:
+    struct line_count_t {
+        addr_t line;
+        uint64_t count;
+        // How much count may exceed the true count.  Always 0 for exact counts.
+        uint64_t error;
+    };
+
+    // Tracks the most-referenced cache lines in bounded memory with the space-saving
+    // algorithm.  At most "capacity" lines are tracked: a line arriving when the
+    // summary is full replaces the line with the smallest count and inherits that
+    // count as its possible overcount.  Each count is thus at least the true count,
+    // and the overcount never exceeds the references seen divided by the capacity.
+    class line_summary_t {
+    public:
+        explicit line_summary_t(size_t capacity = 0)
+            : capacity(capacity)
+        {
+        }
+        void
+        add(addr_t line);
+        // Folds in another summary of the same capacity.  A line tracked by only
+        // one side is charged the other side's smallest count, which bounds that
+        // side's count for every line it does not track.
+        void
+        merge(const line_summary_t &other);
+        const std::vector<line_count_t> &
+        counts() const
+        {
+            return heap;
+        }
+
+    private:
+        uint64_t
+        untracked_bound() const
+        {
+            return heap.size() < capacity || heap.empty() ? 0 : heap[0].count;
+        }
+        void
+        sift_up(size_t pos);
+        void
+        sift_down(size_t pos);
+        void
+        swap_counts(size_t pos1, size_t pos2);
+
+        size_t capacity;
+        // A min-heap on count, with each line's heap position in "position".
+        std::vector<line_count_t> heap;
+        std::unordered_map<addr_t, size_t> position;
+    };
+
+    // Estimates the number of distinct cache lines with HyperLogLog: each line's
+    // hash selects a register that keeps the longest run of leading zeros seen in
+    // the rest of the hashes sent to it.  With 4096 registers the standard error is
+    // about 1.6%.
+    class distinct_lines_t {
+    public:
+        distinct_lines_t()
+            : registers(kRegisters, 0)
+        {
+        }
+        void
+        add(addr_t line);
+        void
+        merge(const distinct_lines_t &other);
+        uint64_t
+        estimate() const;
+
+    private:
+        static const int kIndexBits = 12;
+        static const size_t kRegisters = 1 << kIndexBits;
+        std::vector<uint8_t> registers;
+    };
+
     struct shard_data_t {
+        explicit shard_data_t(size_t summary_capacity = 0)
+            : icache_summary(summary_capacity)
+            , dcache_summary(summary_capacity)
+        {
+        }
+        // Exact counts, used when approx_error is 0.
         std::unordered_map<addr_t, uint64_t> icache_map;
         std::unordered_map<addr_t, uint64_t> dcache_map;
+        // Bounded-memory estimates, used when approx_error is set.
+        line_summary_t icache_summary;
+        line_summary_t dcache_summary;
+        distinct_lines_t icache_lines;
+        distinct_lines_t dcache_lines;
         std::string error;
     };
 
+    void
+    merge_shard(shard_data_t *dst, shard_data_t *src);
+    void
+    merge_shards(std::vector<shard_data_t *> &shards);
+    void
+    print_top(const std::string &name,
+              const std::unordered_map<addr_t, uint64_t> &exact_counts,
+              const line_summary_t &summary);
+
     unsigned int knob_line_size;
     unsigned int knob_report_top; /* most accessed lines */
+    // The bound on each approximate count's error as a fraction of the references,
+    // or 0 for exact counts.
+    double knob_approx_error;
     size_t line_size_bits;
+    // The number of lines tracked by each shard's summaries when approximating.
+    size_t summary_capacity;
     static const std::string TOOL_NAME;
     std::unordered_map<memref_tid_t, shard_data_t *> shard_map;
     // This mutex is only needed in parallel_shard_init.  In all other accesses to
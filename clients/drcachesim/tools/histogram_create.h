@@ -45,10 +45,13 @@
 /**
  * Creates an analysis tool which computes the most-referenced cache lines.
  * The options are currently documented in \ref sec_drcachesim_ops.
+ * A non-zero \p approx_error bounds the tool's memory by estimating the counts,
+ * each of which then exceeds the true count by at most that fraction of the
+ * references.
  */
 // These options are currently documented in ../common/options.cpp.
 analysis_tool_t *
 histogram_tool_create(unsigned int line_size = 64, unsigned int report_top = 10,
-                      unsigned int verbose = 0);
+                      unsigned int verbose = 0, double approx_error = 0.);
 
 #endif /* _HISTOGRAM_CREATE_H_ */
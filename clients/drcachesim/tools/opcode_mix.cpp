@@ -157,9 +157,10 @@ opcode_mix_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
             trace_pc - (mapped_pc - shard->last_mapped_module_start);
     }
     int opcode;
-    auto cached_opcode = shard->worker->opcode_cache.find(mapped_pc);
-    if (cached_opcode != shard->worker->opcode_cache.end()) {
-        opcode = cached_opcode->second;
+    const int *cached_opcode =
+        opcode_cache.lookup(mapped_pc, &shard->worker->opcode_front);
+    if (cached_opcode != nullptr) {
+        opcode = *cached_opcode;
     } else {
         instr_t instr;
         instr_init(dcontext, &instr);
@@ -170,7 +171,7 @@ opcode_mix_t::parallel_shard_memref(void *shard_data, const memref_t &memref)
             return false;
         }
         opcode = instr_get_opcode(&instr);
-        shard->worker->opcode_cache[mapped_pc] = opcode;
+        opcode_cache.add(mapped_pc, new int(opcode), &shard->worker->opcode_front);
         instr_free(dcontext, &instr);
     }
     ++shard->opcode_counts[opcode];
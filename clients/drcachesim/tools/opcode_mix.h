@@ -38,6 +38,7 @@
 #include <unordered_map>
 
 #include "analysis_tool.h"
+#include "decode_cache.h"
 #include "raw2trace.h"
 #include "raw2trace_directory.h"
 
@@ -68,7 +69,8 @@ public:
 
 protected:
     struct worker_data_t {
-        std::unordered_map<app_pc, int> opcode_cache;
+        // Lets most lookups in the shared opcode_cache skip its locks.
+        decode_cache_t<int>::front_cache_t opcode_front;
     };
 
     struct shard_data_t {
@@ -119,6 +121,9 @@ protected:
     // This mutex is only needed in parallel_shard_init.  In all other accesses to
     // shard_map (process_memref, print_results) we are single-threaded.
     std::mutex shard_map_mutex;
+    // Opcodes by mapped pc, shared by all workers so each instruction is decoded
+    // once no matter how many shards execute it.
+    decode_cache_t<int> opcode_cache;
     unsigned int knob_verbose;
     static const std::string TOOL_NAME;
     // For serial operation.
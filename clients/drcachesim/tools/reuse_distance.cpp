@@ -51,11 +51,16 @@ reuse_distance_tool_create(const reuse_distance_knobs_t &knobs)
 reuse_distance_t::reuse_distance_t(const reuse_distance_knobs_t &knobs_)
     : knobs(knobs_)
     , line_size_bits(compute_log2((int)knobs.line_size))
+    , sampling(knobs.sample_rate < 1. || knobs.sample_max_lines > 0)
 {
     if (DEBUG_VERBOSE(2)) {
         std::cerr << "cache line size " << knobs.line_size << ", "
                   << "reuse distance threshold " << knobs.distance_threshold << std::endl;
     }
+    if (knobs.sample_rate <= 0. || knobs.sample_rate > 1.) {
+        error_string = "Invalid sample rate: must be in (0, 1]";
+        success = false;
+    }
 }
 
 reuse_distance_t::~reuse_distance_t()
@@ -66,10 +71,71 @@ reuse_distance_t::~reuse_distance_t()
 }
 
 reuse_distance_t::shard_data_t::shard_data_t(uint64_t reuse_threshold, uint64_t skip_dist,
-                                             bool verify)
+                                             bool verify, bool use_tree, double rate)
+    : sample_threshold(static_cast<uint64_t>(rate * SAMPLE_SPACE))
+    , sample_rate(rate)
+{
+    if (use_tree) {
+        // With sampling we only see a fraction of the lines between two accesses,
+        // so we scale the threshold down to match.
+        ref_list = std::unique_ptr<line_ref_list_t>(
+            new line_ref_tree_t(static_cast<uint64_t>(reuse_threshold * rate)));
+    } else {
+        ref_list = std::unique_ptr<line_ref_list_t>(
+            new line_ref_list_t(reuse_threshold, skip_dist, verify));
+    }
+}
+
+reuse_distance_t::shard_data_t *
+reuse_distance_t::create_shard_data()
+{
+    // Sampling needs to remove lines, which only the tree supports.
+    return new shard_data_t(knobs.distance_threshold, knobs.skip_list_distance,
+                            knobs.verify_skip, knobs.use_tree || sampling,
+                            knobs.sample_rate);
+}
+
+// Spatial sampling as in SHARDS (Waldspurger et al., FAST'15): a line is tracked
+// iff a hash of its tag falls below a threshold, which selects the same subset of
+// lines for the whole trace.  Distances among the tracked lines are then scaled
+// up by the inverse of the sampling rate.
+static inline uint64_t
+sample_hash(addr_t tag)
+{
+    // The MurmurHash3 64-bit finalizer.
+    uint64_t hash = static_cast<uint64_t>(tag);
+    hash ^= hash >> 33;
+    hash *= 0xff51afd7ed558ccdULL;
+    hash ^= hash >> 33;
+    hash *= 0xc4ceb9fe1a85ec53ULL;
+    hash ^= hash >> 33;
+    return hash;
+}
+
+// Stops tracking the lines with the largest hashes until we are back under
+// -reuse_sample_max_lines, lowering the sampling rate to match.
+void
+reuse_distance_t::lower_sample_rate(shard_data_t *shard)
 {
-    ref_list = std::unique_ptr<line_ref_list_t>(
-        new line_ref_list_t(reuse_threshold, skip_dist, verify));
+    line_ref_tree_t *tree = static_cast<line_ref_tree_t *>(shard->ref_list.get());
+    while (shard->cache_map.size() > knobs.sample_max_lines) {
+        shard->sample_threshold = shard->sample_heap.top().first;
+        while (!shard->sample_heap.empty() &&
+               shard->sample_heap.top().first >= shard->sample_threshold) {
+            auto it = shard->cache_map.find(shard->sample_heap.top().second);
+            assert(it != shard->cache_map.end());
+            tree->remove(it->second);
+            shard->cache_map.erase(it);
+            shard->sample_heap.pop();
+        }
+    }
+    shard->sample_rate = static_cast<double>(shard->sample_threshold) / SAMPLE_SPACE;
+    tree->threshold =
+        static_cast<uint64_t>(knobs.distance_threshold * shard->sample_rate);
+    if (DEBUG_VERBOSE(2)) {
+        std::cerr << "Lowered sample rate to " << shard->sample_rate << " for shard "
+                  << shard->tid << "\n";
+    }
 }
 
 bool
@@ -81,8 +147,7 @@ reuse_distance_t::parallel_shard_supported()
 void *
 reuse_distance_t::parallel_shard_init(int shard_index, void *worker_data)
 {
-    auto shard = new shard_data_t(knobs.distance_threshold, knobs.skip_list_distance,
-                                  knobs.verify_skip);
+    auto shard = create_shard_data();
     std::lock_guard<std::mutex> guard(shard_map_mutex);
     shard_map[shard_index] = shard;
     return reinterpret_cast<void *>(shard);
@@ -128,6 +193,12 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
         type_is_prefetch(memref.data.type)) {
         ++shard->total_refs;
         addr_t tag = memref.data.addr >> line_size_bits;
+        uint64_t hash = 0;
+        if (sampling) {
+            hash = sample_hash(tag) & (SAMPLE_SPACE - 1);
+            if (hash >= shard->sample_threshold)
+                return true;
+        }
         std::unordered_map<addr_t, line_ref_t *>::iterator it =
             shard->cache_map.find(tag);
         if (it == shard->cache_map.end()) {
@@ -136,8 +207,17 @@ reuse_distance_t::parallel_shard_memref(void *shard_data, const memref_t &memref
             shard->cache_map.insert(std::pair<addr_t, line_ref_t *>(tag, ref));
             // insert into the list
             shard->ref_list->add_to_front(ref);
+            if (knobs.sample_max_lines > 0) {
+                shard->sample_heap.push(std::make_pair(hash, tag));
+                if (shard->cache_map.size() > knobs.sample_max_lines)
+                    lower_sample_rate(shard);
+            }
         } else {
             int_least64_t dist = shard->ref_list->move_to_front(it->second);
+            if (sampling) {
+                dist = static_cast<int_least64_t>(
+                    std::round(static_cast<double>(dist) / shard->sample_rate));
+            }
             std::unordered_map<int_least64_t, int_least64_t>::iterator dist_it =
                 shard->dist_map.find(dist);
             if (dist_it == shard->dist_map.end())
@@ -159,8 +239,7 @@ reuse_distance_t::process_memref(const memref_t &memref)
     shard_data_t *shard;
     const auto &lookup = shard_map.find(memref.data.tid);
     if (lookup == shard_map.end()) {
-        shard = new shard_data_t(knobs.distance_threshold, knobs.skip_list_distance,
-                                 knobs.verify_skip);
+        shard = create_shard_data();
         shard_map[memref.data.tid] = shard;
     } else
         shard = lookup->second;
@@ -171,6 +250,109 @@ reuse_distance_t::process_memref(const memref_t &memref)
     return true;
 }
 
+// The lines of each shard are written from least to most recently used, so that
+// loading can rebuild the list, its skip list, and its gate (or the tree) simply by
+// adding them to the front in order.  Both structures order the lines by
+// time_stamp.
+bool
+reuse_distance_t::save_checkpoint(std::ostream &out)
+{
+    out << "reuse_distance 1\n"
+        << knobs.line_size << " " << knobs.distance_threshold << " " << shard_map.size()
+        << "\n";
+    for (const auto &shard_it : shard_map) {
+        const shard_data_t *shard = shard_it.second;
+        out << shard_it.first << " " << shard->tid << " " << shard->total_refs << " "
+            << shard->ref_list->cur_time << " " << shard->sample_threshold << " "
+            << std::setprecision(17) << shard->sample_rate << " "
+            << shard->dist_map.size() << " " << shard->cache_map.size() << "\n";
+        for (const auto &dist_it : shard->dist_map)
+            out << dist_it.first << " " << dist_it.second << "\n";
+        std::vector<const line_ref_t *> lines;
+        lines.reserve(shard->cache_map.size());
+        for (const auto &line_it : shard->cache_map)
+            lines.push_back(line_it.second);
+        std::sort(lines.begin(), lines.end(),
+                  [](const line_ref_t *l, const line_ref_t *r) {
+                      return l->time_stamp < r->time_stamp;
+                  });
+        for (const line_ref_t *ref : lines) {
+            out << ref->tag << " " << ref->total_refs << " " << ref->distant_refs
+                << "\n";
+        }
+    }
+    return !!out;
+}
+
+bool
+reuse_distance_t::load_checkpoint(std::istream &in)
+{
+    std::string magic;
+    int version;
+    unsigned int line_size;
+    uint64_t threshold;
+    size_t num_shards;
+    if (!(in >> magic >> version) || magic != "reuse_distance" || version != 1) {
+        error_string = "Checkpoint was not written by this reuse distance version";
+        return false;
+    }
+    if (!(in >> line_size >> threshold >> num_shards) ||
+        line_size != knobs.line_size || threshold != knobs.distance_threshold) {
+        error_string = "Checkpoint line size or distance threshold does not match";
+        return false;
+    }
+    for (auto &shard : shard_map)
+        delete shard.second;
+    shard_map.clear();
+    for (size_t i = 0; i < num_shards; ++i) {
+        memref_tid_t key;
+        uint64_t cur_time;
+        size_t num_dists, num_lines;
+        shard_data_t *shard = create_shard_data();
+        if (!(in >> key >> shard->tid >> shard->total_refs >> cur_time >>
+              shard->sample_threshold >> shard->sample_rate >> num_dists >>
+              num_lines)) {
+            delete shard;
+            error_string = "Checkpoint reuse distance shard is truncated";
+            return false;
+        }
+        shard_map[key] = shard;
+        if (sampling) {
+            shard->ref_list->threshold =
+                static_cast<uint64_t>(knobs.distance_threshold * shard->sample_rate);
+        }
+        for (size_t j = 0; j < num_dists; ++j) {
+            int_least64_t dist, count;
+            if (!(in >> dist >> count)) {
+                error_string = "Checkpoint reuse distance shard is truncated";
+                return false;
+            }
+            shard->dist_map[dist] = count;
+        }
+        for (size_t j = 0; j < num_lines; ++j) {
+            addr_t tag;
+            uint64_t total_refs, distant_refs;
+            if (!(in >> tag >> total_refs >> distant_refs)) {
+                error_string = "Checkpoint reuse distance shard is truncated";
+                return false;
+            }
+            line_ref_t *ref = new line_ref_t(tag);
+            shard->cache_map.insert(std::pair<addr_t, line_ref_t *>(tag, ref));
+            shard->ref_list->add_to_front(ref);
+            ref->total_refs = total_refs;
+            ref->distant_refs = distant_refs;
+            if (knobs.sample_max_lines > 0) {
+                shard->sample_heap.push(
+                    std::make_pair(sample_hash(tag) & (SAMPLE_SPACE - 1), tag));
+            }
+        }
+        // Replaying the lines numbered them from 0, which preserves their order;
+        // the access count continues from the saved one.
+        shard->ref_list->cur_time = cur_time;
+    }
+    return true;
+}
+
 static bool
 cmp_dist_key(const std::pair<int_least64_t, int_least64_t> &l,
              const std::pair<int_least64_t, int_least64_t> &r)
@@ -214,11 +396,16 @@ reuse_distance_t::print_shard_results(const shard_data_t *shard)
     std::cerr << "Total accesses: " << shard->total_refs << "\n";
     std::cerr << "Unique accesses: " << shard->ref_list->cur_time << "\n";
     std::cerr << "Unique cache lines accessed: " << shard->cache_map.size() << "\n";
-    std::cerr << "\n";
 
     std::cerr.precision(2);
     std::cerr.setf(std::ios::fixed);
 
+    if (sampling) {
+        std::cerr << "Cache lines sampled at rate: " << shard->sample_rate * 100.
+                  << "%\n";
+    }
+    std::cerr << "\n";
+
     double sum = 0.0;
     int_least64_t count = 0;
     for (const auto &it : shard->dist_map) {
@@ -307,10 +494,12 @@ bool
 reuse_distance_t::print_results()
 {
     // First, aggregate the per-shard data into whole-trace data.
-    auto aggregate = std::unique_ptr<shard_data_t>(new shard_data_t(
-        knobs.distance_threshold, knobs.skip_list_distance, knobs.verify_skip));
+    auto aggregate = std::unique_ptr<shard_data_t>(create_shard_data());
     for (const auto &shard : shard_map) {
         aggregate->total_refs += shard.second->total_refs;
+        // We report the lowest rate as the aggregate's.
+        aggregate->sample_rate =
+            std::min(aggregate->sample_rate, shard.second->sample_rate);
         // We simply sum the unique accesses.
         // If the user wants the unique accesses over the merged trace they
         // can create a single shard and invoke the parallel operations.
@@ -346,8 +535,12 @@ reuse_distance_t::print_results()
     if (shard_map.size() > 1) {
         using keyval_t = std::pair<memref_tid_t, shard_data_t *>;
         std::vector<keyval_t> sorted(shard_map.begin(), shard_map.end());
+        // We break ties by key so that the order does not depend on the hash
+        // table's, which differs for a run resumed from a checkpoint.
         std::sort(sorted.begin(), sorted.end(), [](const keyval_t &l, const keyval_t &r) {
-            return l.second->total_refs > r.second->total_refs;
+            if (l.second->total_refs != r.second->total_refs)
+                return l.second->total_refs > r.second->total_refs;
+            return l.first < r.first;
         });
         for (const auto &shard : sorted) {
             std::cerr << "\n==================================================\n"
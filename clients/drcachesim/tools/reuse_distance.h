@@ -37,9 +37,12 @@
 #define _REUSE_DISTANCE_H_ 1
 
 #include <memory>
+#include <algorithm>
 #include <mutex>
+#include <queue>
 #include <unordered_map>
 #include <string>
+#include <vector>
 #include <assert.h>
 #include <iostream>
 #include "analysis_tool.h"
@@ -77,6 +80,10 @@ public:
     parallel_shard_memref(void *shard_data, const memref_t &memref) override;
     std::string
     parallel_shard_error(void *shard_data) override;
+    bool
+    save_checkpoint(std::ostream &out) override;
+    bool
+    load_checkpoint(std::istream &in) override;
 
     // Global value for use in non-member code.
     static unsigned int knob_verbose;
@@ -88,7 +95,8 @@ protected:
     // the shards we're given.  This is for simplicity and to give the user a method
     // for computing over different units if for some reason that was desired.
     struct shard_data_t {
-        shard_data_t(uint64_t reuse_threshold, uint64_t skip_dist, bool verify);
+        shard_data_t(uint64_t reuse_threshold, uint64_t skip_dist, bool verify,
+                     bool use_tree, double sample_rate);
         std::unordered_map<addr_t, line_ref_t *> cache_map;
         // This is our reuse distance histogram.
         std::unordered_map<int_least64_t, int_least64_t> dist_map;
@@ -96,16 +104,30 @@ protected:
         int_least64_t total_refs = 0;
         // Ideally the shard index would be the tid when shard==thread but that's
         // not the case today so we store the tid.
-        memref_tid_t tid;
+        memref_tid_t tid = 0;
         std::string error;
+        // For sampling, only lines whose hash is below this are tracked.
+        uint64_t sample_threshold;
+        // The fraction of lines currently being tracked.
+        double sample_rate;
+        // The tracked lines and their hashes, largest hash on top, for lowering
+        // sample_threshold when -reuse_sample_max_lines is exceeded.
+        std::priority_queue<std::pair<uint64_t, addr_t>> sample_heap;
     };
 
     void
     print_shard_results(const shard_data_t *shard);
+    shard_data_t *
+    create_shard_data();
+    void
+    lower_sample_rate(shard_data_t *shard);
 
     const reuse_distance_knobs_t knobs;
     const size_t line_size_bits;
+    const bool sampling;
     static const std::string TOOL_NAME;
+    // Line hashes used for sampling fall in [0, SAMPLE_SPACE).
+    static const uint64_t SAMPLE_SPACE = 1 << 24;
     // In parallel operation the keys are "shard indices": just ints.
     std::unordered_map<memref_tid_t, shard_data_t *> shard_map;
     // This mutex is only needed in parallel_shard_init.  In all other accesses to
@@ -233,7 +255,7 @@ struct line_ref_list_t {
     // We may need to move gate forward if there are more cache lines
     // than the threshold so that the gate points to the earliest
     // referenced cache line within the threshold.
-    void
+    virtual void
     add_to_front(line_ref_t *ref)
     {
         if (DEBUG_VERBOSE(3))
@@ -283,7 +305,7 @@ struct line_ref_list_t {
     // We need to move the gate pointer forward if the referenced cache
     // line is the gate cache line or any cache line after.
     // Returns the reuse distance of ref.
-    int_least64_t
+    virtual int_least64_t
     move_to_front(line_ref_t *ref)
     {
         if (DEBUG_VERBOSE(3))
@@ -360,4 +382,141 @@ struct line_ref_list_t {
     }
 };
 
+// An alternative to the skip list which computes exact reuse distances in
+// O(log n) time no matter how long the distance is.  Each cache line occupies
+// the slot of its most recent access in a Fenwick (binary indexed) tree which
+// holds a 1 for every occupied slot, so a line's reuse distance is the number of
+// occupied slots after its own.  Slots are handed out in increasing order and
+// are renumbered densely once they run out, which keeps the size of the tree
+// proportional to the number of lines rather than to the length of the trace.
+// The time_stamp field of each line holds its slot, and unlike the list the
+// tree supports removing lines, which we need for sampling.
+struct line_ref_tree_t : public line_ref_list_t {
+    std::vector<line_ref_t *> slot_ref; // the line occupying each slot, or NULL
+    std::vector<int_least64_t> tree;    // 1-based Fenwick tree over the slots
+    uint64_t next_slot;                 // the slot for the next access
+
+    explicit line_ref_tree_t(uint64_t reuse_threshold)
+        : line_ref_list_t(reuse_threshold, 0, false)
+        , next_slot(0)
+    {
+        slot_ref.resize(INITIAL_SLOTS, NULL);
+        tree.resize(INITIAL_SLOTS + 1, 0);
+    }
+
+    ~line_ref_tree_t() override
+    {
+        for (line_ref_t *ref : slot_ref)
+            delete ref;
+        // The base class walks the list from head, which we do not maintain.
+        head = NULL;
+    }
+
+    void
+    update(uint64_t slot, int_least64_t delta)
+    {
+        for (uint64_t i = slot + 1; i < tree.size(); i += i & (~i + 1))
+            tree[i] += delta;
+    }
+
+    // Returns the number of occupied slots in [0, slot].
+    int_least64_t
+    prefix_count(uint64_t slot)
+    {
+        int_least64_t count = 0;
+        for (uint64_t i = slot + 1; i > 0; i -= i & (~i + 1))
+            count += tree[i];
+        return count;
+    }
+
+    // Renumbers the occupied slots to be contiguous from 0 and leaves at least
+    // as many free slots, so this linear-time pass is amortized across as many
+    // accesses as there are lines.
+    void
+    compact()
+    {
+        uint64_t count = 0;
+        for (uint64_t i = 0; i < next_slot; ++i) {
+            if (slot_ref[i] == NULL)
+                continue;
+            slot_ref[count] = slot_ref[i];
+            slot_ref[count]->time_stamp = count;
+            ++count;
+        }
+        assert(count <= unique_lines);
+        uint64_t size = 2 * count;
+        if (size < INITIAL_SLOTS)
+            size = INITIAL_SLOTS;
+        slot_ref.resize(size);
+        for (uint64_t i = count; i < size; ++i)
+            slot_ref[i] = NULL;
+        // Build the tree in linear time.
+        tree.assign(size + 1, 0);
+        for (uint64_t i = 1; i <= size; ++i) {
+            if (i <= count)
+                ++tree[i];
+            uint64_t parent = i + (i & (~i + 1));
+            if (parent <= size)
+                tree[parent] += tree[i];
+        }
+        next_slot = count;
+    }
+
+    void
+    occupy_next_slot(line_ref_t *ref)
+    {
+        if (next_slot == slot_ref.size())
+            compact();
+        ref->time_stamp = next_slot;
+        slot_ref[next_slot] = ref;
+        update(next_slot, 1);
+        ++next_slot;
+        head = ref;
+        ++cur_time;
+    }
+
+    void
+    add_to_front(line_ref_t *ref) override
+    {
+        if (DEBUG_VERBOSE(3))
+            std::cerr << "Add tag 0x" << std::hex << ref->tag << "\n";
+        occupy_next_slot(ref);
+        ++unique_lines;
+    }
+
+    int_least64_t
+    move_to_front(line_ref_t *ref) override
+    {
+        if (DEBUG_VERBOSE(3))
+            std::cerr << "Move tag 0x" << std::hex << ref->tag << " to front\n";
+        ref->total_refs++;
+        if (ref == head)
+            return 0;
+        int_least64_t dist = unique_lines - prefix_count(ref->time_stamp);
+        // This matches the list's gate: the gate line is at distance threshold.
+        if (static_cast<uint64_t>(dist) > threshold)
+            ref->distant_refs++;
+        slot_ref[ref->time_stamp] = NULL;
+        update(ref->time_stamp, -1);
+        occupy_next_slot(ref);
+        return dist;
+    }
+
+    // Removes ref from the tree and deletes it.
+    void
+    remove(line_ref_t *ref)
+    {
+        if (DEBUG_VERBOSE(3))
+            std::cerr << "Remove tag 0x" << std::hex << ref->tag << "\n";
+        slot_ref[ref->time_stamp] = NULL;
+        update(ref->time_stamp, -1);
+        --unique_lines;
+        if (ref == head)
+            head = NULL;
+        delete ref;
+    }
+
+    static const uint64_t INITIAL_SLOTS = 1024;
+};
+
 #endif /* _REUSE_DISTANCE_H_ */
@@ -56,6 +56,9 @@ struct reuse_distance_knobs_t {
         , skip_list_distance(500)
         , verify_skip(false)
         , verbose(0)
+        , use_tree(false)
+        , sample_rate(1.)
+        , sample_max_lines(0)
     {
     }
     unsigned int line_size;
@@ -65,6 +68,9 @@ struct reuse_distance_knobs_t {
     unsigned int skip_list_distance;
     bool verify_skip;
     unsigned int verbose;
+    bool use_tree;
+    double sample_rate;
+    unsigned int sample_max_lines;
 };
 
 /** Creates an analysis tool which computes reuse distance. */
@@ -0,0 +1,200 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+/* decode_cache.h: a decoded-instruction cache shared by concurrent workers.
+ */
+
+#ifndef _DECODE_CACHE_H_
+#define _DECODE_CACHE_H_ 1
+
+/**
+ * @file drmemtrace/decode_cache.h
+ * @brief DrMemtrace shared cache of decoded instructions.
+ */
+
+#include <mutex>
+#include <vector>
+#include "dr_api.h"
+#include "hashtable.h"
+
+/**
+ * decode_cache_t caches per-instruction decode results of type T, keyed by the
+ * address of the instruction in the mapped copy of its module.  Because a
+ * module_mapper_t maps each module exactly once, that address stands for a
+ * (module, offset) pair for the lifetime of the mapper, so a single cache can be
+ * shared by every worker thread decoding that trace.
+ *
+ * The table is split into stripes, each with its own lock.  Hot lookups should pass
+ * a per-thread front_cache_t, which answers repeated lookups without taking any
+ * lock.  Entries are never replaced or removed once added, so a payload returned
+ * by lookup() or add() remains valid until the cache is destroyed, and a front
+ * cache can never hold a stale one.  The cache owns its payloads and deletes them
+ * on destruction.
+ */
+template <typename T> class decode_cache_t {
+public:
+    /**
+     * A direct-mapped cache of recent results, private to one thread, to be passed
+     * to lookup() and add().
+     */
+    class front_cache_t {
+    public:
+        front_cache_t()
+            : entries(kFrontEntries)
+        {
+        }
+
+    private:
+        friend class decode_cache_t;
+        struct entry_t {
+            app_pc pc = nullptr;
+            T *payload = nullptr;
+        };
+        entry_t &
+        entry_for(app_pc pc)
+        {
+            ptr_uint_t bits = reinterpret_cast<ptr_uint_t>(pc);
+            return entries[(bits ^ (bits >> kFrontBits)) & (kFrontEntries - 1)];
+        }
+        std::vector<entry_t> entries;
+    };
+
+    decode_cache_t()
+    {
+        for (int i = 0; i < kStripes; ++i) {
+            // We do not want the built-in mutex: we lock each stripe ourselves.
+            hashtable_init_ex(&stripes[i].table, kInitialBits, HASH_INTPTR, false,
+                              false, free_payload, nullptr, nullptr);
+            // We pay a little memory to get a lower load factor.
+            hashtable_config_t config = { sizeof(config), true, 40U };
+            hashtable_configure(&stripes[i].table, &config);
+        }
+    }
+    ~decode_cache_t()
+    {
+        for (int i = 0; i < kStripes; ++i)
+            hashtable_delete(&stripes[i].table);
+    }
+
+    /** Returns the cached payload for \p pc, or nullptr if there is none. */
+    T *
+    lookup(app_pc pc)
+    {
+        stripe_t &stripe = stripe_for(pc);
+        std::lock_guard<std::mutex> guard(stripe.lock);
+        return static_cast<T *>(hashtable_lookup(&stripe.table, pc));
+    }
+
+    /**
+     * Returns the cached payload for \p pc, or nullptr if there is none, consulting
+     * and filling \p front first.
+     */
+    T *
+    lookup(app_pc pc, front_cache_t *front)
+    {
+        typename front_cache_t::entry_t &entry = front->entry_for(pc);
+        if (entry.pc == pc)
+            return entry.payload;
+        T *payload = lookup(pc);
+        if (payload != nullptr) {
+            entry.pc = pc;
+            entry.payload = payload;
+        }
+        return payload;
+    }
+
+    /**
+     * Adds \p payload, which must have been allocated with new, for \p pc and takes
+     * ownership of it.  If another thread added an entry for \p pc first, \p payload
+     * is deleted and that entry is returned instead; otherwise \p payload is returned.
+     */
+    T *
+    add(app_pc pc, T *payload)
+    {
+        stripe_t &stripe = stripe_for(pc);
+        std::lock_guard<std::mutex> guard(stripe.lock);
+        if (hashtable_add(&stripe.table, pc, payload))
+            return payload;
+        delete payload;
+        return static_cast<T *>(hashtable_lookup(&stripe.table, pc));
+    }
+
+    /** Like add() but also fills \p front with the result. */
+    T *
+    add(app_pc pc, T *payload, front_cache_t *front)
+    {
+        T *ret = add(pc, payload);
+        typename front_cache_t::entry_t &entry = front->entry_for(pc);
+        entry.pc = pc;
+        entry.payload = ret;
+        return ret;
+    }
+
+private:
+    struct stripe_t {
+        std::mutex lock;
+        hashtable_t table;
+    };
+
+    static void
+    free_payload(void *payload)
+    {
+        delete static_cast<T *>(payload);
+    }
+
+    stripe_t &
+    stripe_for(app_pc pc)
+    {
+        // Fold in the higher bits so that code laid out at a fixed stride does not
+        // all land in one stripe.
+        ptr_uint_t bits = reinterpret_cast<ptr_uint_t>(pc);
+        return stripes[(bits ^ (bits >> kStripeBits)) & (kStripes - 1)];
+    }
+
+    decode_cache_t(const decode_cache_t &) = delete;
+    decode_cache_t &
+    operator=(const decode_cache_t &) = delete;
+
+    // The stripe count is a power of two so we can mask instead of dividing.
+    static const int kStripeBits = 6;
+    static const int kStripes = 1 << kStripeBits;
+    // Together the stripes start out at the capacity of the single table we
+    // used to use per worker.
+    static const uint kInitialBits = 10;
+    // Each front cache is 64KB on 64-bit, which holds the hot code of most threads.
+    static const int kFrontBits = 12;
+    static const int kFrontEntries = 1 << kFrontBits;
+
+    stripe_t stripes[kStripes];
+};
+
+#endif /* _DECODE_CACHE_H_ */
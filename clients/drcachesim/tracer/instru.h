@@ -79,6 +79,9 @@ public:
     get_entry_addr(byte *buf_ptr) const = 0;
     virtual void
     set_entry_addr(byte *buf_ptr, addr_t addr) = 0;
+    // Returns the number of instruction executions recorded in [start, end).
+    virtual uint64
+    get_instr_count(byte *start, byte *end) const = 0;
 
     // All of these return how many bytes to advance the buffer pointer.
 
@@ -94,9 +97,10 @@ public:
     append_iflush(byte *buf_ptr, addr_t start, size_t size) = 0;
     virtual int
     append_thread_header(byte *buf_ptr, thread_id_t tid) = 0;
-    // This is a per-buffer-writeout header.
+    // This is a per-buffer-writeout header.  If window is non-negative, a
+    // TRACE_MARKER_TYPE_WINDOW_ID marker with that value is included.
     virtual int
-    append_unit_header(byte *buf_ptr, thread_id_t tid) = 0;
+    append_unit_header(byte *buf_ptr, thread_id_t tid, intptr_t window) = 0;
 
     // These insert inlined code to add an entry into the trace buffer.
     virtual int
@@ -161,6 +165,8 @@ public:
     get_entry_addr(byte *buf_ptr) const;
     virtual void
     set_entry_addr(byte *buf_ptr, addr_t addr);
+    virtual uint64
+    get_instr_count(byte *start, byte *end) const;
 
     virtual int
     append_pid(byte *buf_ptr, process_id_t pid);
@@ -175,7 +181,7 @@ public:
     virtual int
     append_thread_header(byte *buf_ptr, thread_id_t tid);
     virtual int
-    append_unit_header(byte *buf_ptr, thread_id_t tid);
+    append_unit_header(byte *buf_ptr, thread_id_t tid, intptr_t window);
 
     virtual int
     instrument_memref(void *drcontext, instrlist_t *ilist, instr_t *where,
@@ -222,6 +228,8 @@ public:
     get_entry_addr(byte *buf_ptr) const;
     virtual void
     set_entry_addr(byte *buf_ptr, addr_t addr);
+    virtual uint64
+    get_instr_count(byte *start, byte *end) const;
 
     virtual int
     append_pid(byte *buf_ptr, process_id_t pid);
@@ -236,7 +244,7 @@ public:
     virtual int
     append_thread_header(byte *buf_ptr, thread_id_t tid);
     virtual int
-    append_unit_header(byte *buf_ptr, thread_id_t tid);
+    append_unit_header(byte *buf_ptr, thread_id_t tid, intptr_t window);
 
     virtual int
     instrument_memref(void *drcontext, instrlist_t *ilist, instr_t *where,
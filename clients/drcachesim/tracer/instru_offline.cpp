@@ -207,6 +207,18 @@ offline_instru_t::set_entry_addr(byte *buf_ptr, addr_t addr)
     entry->addr.addr = addr;
 }
 
+uint64
+offline_instru_t::get_instr_count(byte *start, byte *end) const
+{
+    uint64 count = 0;
+    offline_entry_t *entry_end = (offline_entry_t *)end;
+    for (offline_entry_t *entry = (offline_entry_t *)start; entry < entry_end; ++entry) {
+        if (entry->pc.type == OFFLINE_TYPE_PC)
+            count += entry->pc.instr_count;
+    }
+    return count;
+}
+
 int
 offline_instru_t::append_pid(byte *buf_ptr, process_id_t pid)
 {
@@ -277,7 +289,7 @@ offline_instru_t::append_thread_header(byte *buf_ptr, thread_id_t tid)
 }
 
 int
-offline_instru_t::append_unit_header(byte *buf_ptr, thread_id_t tid)
+offline_instru_t::append_unit_header(byte *buf_ptr, thread_id_t tid, intptr_t window)
 {
     byte *new_buf = buf_ptr;
     offline_entry_t *entry = (offline_entry_t *)new_buf;
@@ -285,6 +297,8 @@ offline_instru_t::append_unit_header(byte *buf_ptr, thread_id_t tid)
     entry->timestamp.usec = instru_t::get_timestamp();
     new_buf += sizeof(*entry);
     new_buf += append_marker(new_buf, TRACE_MARKER_TYPE_CPU_ID, instru_t::get_cpu_id());
+    if (window >= 0)
+        new_buf += append_marker(new_buf, TRACE_MARKER_TYPE_WINDOW_ID, (uintptr_t)window);
     return (int)(new_buf - buf_ptr);
 }
 
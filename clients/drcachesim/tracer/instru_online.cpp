@@ -80,6 +80,12 @@ online_instru_t::set_entry_addr(byte *buf_ptr, addr_t addr)
     entry->addr = addr;
 }
 
+uint64
+online_instru_t::get_instr_count(byte *start, byte *end) const
+{
+    return trace_entry_instr_count((trace_entry_t *)start, (trace_entry_t *)end);
+}
+
 int
 online_instru_t::append_pid(byte *buf_ptr, process_id_t pid)
 {
@@ -147,7 +153,7 @@ online_instru_t::append_thread_header(byte *buf_ptr, thread_id_t tid)
 }
 
 int
-online_instru_t::append_unit_header(byte *buf_ptr, thread_id_t tid)
+online_instru_t::append_unit_header(byte *buf_ptr, thread_id_t tid, intptr_t window)
 {
     byte *new_buf = buf_ptr;
     new_buf += append_tid(new_buf, tid);
@@ -155,6 +161,8 @@ online_instru_t::append_unit_header(byte *buf_ptr, thread_id_t tid)
                              // Truncated to 32 bits for 32-bit: we live with it.
                              (uintptr_t)instru_t::get_timestamp());
     new_buf += append_marker(new_buf, TRACE_MARKER_TYPE_CPU_ID, instru_t::get_cpu_id());
+    if (window >= 0)
+        new_buf += append_marker(new_buf, TRACE_MARKER_TYPE_WINDOW_ID, (uintptr_t)window);
     return (int)(new_buf - buf_ptr);
 }
 
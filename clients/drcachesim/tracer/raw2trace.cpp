@@ -462,6 +462,34 @@ raw2trace_t::process_header(raw2trace_thread_data_t *tdata)
     return "";
 }
 
+// Starts a new chunk if one is due, recording it in the index.  The caller must
+// call this just before writing the chunk's initial timestamp.
+std::string
+raw2trace_t::maybe_start_index_chunk(raw2trace_thread_data_t *tdata, uint64 timestamp)
+{
+    if (tdata->index_file == nullptr ||
+        (tdata->chunk_count > 0 &&
+         tdata->instr_count - tdata->chunk_instr_count < index_interval))
+        return "";
+    // For gzip_ostream_t, flushing ends the gzip member so the new chunk can be
+    // decompressed without the prior data.
+    if (!tdata->out_file->flush())
+        return "Failed to flush output file";
+    std::streampos offset = tdata->out_file->tellp();
+    if (offset < 0)
+        return "Output file does not support indexing";
+    trace_index_entry_t chunk = { static_cast<uint64_t>(offset), tdata->instr_count,
+                                  timestamp };
+    if (!tdata->index_file->write((char *)&chunk, sizeof(chunk)))
+        return "Failed to write to index file";
+    VPRINT(3, "Thread %u chunk %" UINT64_FORMAT_CODE " at offset %" UINT64_FORMAT_CODE
+              " after %" UINT64_FORMAT_CODE " instrs\n",
+           (uint)tdata->tid, tdata->chunk_count, chunk.file_offset, chunk.instr_count);
+    ++tdata->chunk_count;
+    tdata->chunk_instr_count = tdata->instr_count;
+    return "";
+}
+
 std::string
 raw2trace_t::process_next_thread_buffer(raw2trace_thread_data_t *tdata,
                                         OUT bool *end_of_record)
@@ -493,6 +521,9 @@ raw2trace_t::process_next_thread_buffer(raw2trace_thread_data_t *tdata,
         if (entry.timestamp.type == OFFLINE_TYPE_TIMESTAMP) {
             VPRINT(2, "Thread %u timestamp 0x" ZHEX64_FORMAT_STRING "\n",
                    (uint)tdata->tid, (uint64)entry.timestamp.usec);
+            tdata->error = maybe_start_index_chunk(tdata, entry.timestamp.usec);
+            if (!tdata->error.empty())
+                return tdata->error;
             byte *buf = buf_base +
                 trace_metadata_writer_t::write_timestamp(buf_base,
                                                          (uintptr_t)entry.timestamp.usec);
@@ -603,6 +634,10 @@ raw2trace_t::do_conversion()
             if (!error.empty())
                 return error;
         }
+    } else if (chunk_size > 0) {
+        error = do_chunked_conversion();
+        if (!error.empty())
+            return error;
     } else {
         // The files can be converted concurrently.
         std::vector<std::thread> threads;
@@ -623,6 +658,259 @@ raw2trace_t::do_conversion()
     return "";
 }
 
+/***************************************************************************
+ * Conversion of pieces of thread files for set_chunk_size().
+ *
+ * The tracer's buffers are self-contained but for two pieces of conversion state:
+ * a branch at the end of a buffer is delayed to the start of the thread's next
+ * buffer, and the fetch of a rep string instruction is omitted for subsequent
+ * iterations.  We split only before a buffer's initial timestamp, convert the
+ * pieces independently, and then reconcile that state when concatenating in order:
+ * each piece records where a prior piece's delayed branch should be inserted, and
+ * a piece whose output depends on the prior piece ending in a rep string, which we
+ * speculate it does not, is converted again in the rare case that it did.
+ */
+
+// Reads the next piece of file into chunk, extending past chunk_size to the next
+// buffer boundary.  We hold the boundary's timestamp in pre_read for the next piece.
+std::string
+raw2trace_t::read_chunk(raw2trace_thread_data_t *file, OUT raw2trace_chunk_t *chunk)
+{
+    std::string raw;
+    chunk->file = file;
+    chunk->is_first = !file->saw_header;
+    for (const offline_entry_t &entry : file->pre_read)
+        raw.append(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    file->pre_read.clear();
+    size_t have = raw.size();
+    if (have < chunk_size) {
+        raw.resize(static_cast<size_t>(chunk_size));
+        file->thread_file->read(&raw[have], chunk_size - have);
+        raw.resize(have + static_cast<size_t>(file->thread_file->gcount()));
+    }
+    offline_entry_t entry;
+    while (file->thread_file->read((char *)&entry, sizeof(entry))) {
+        if (entry.timestamp.type == OFFLINE_TYPE_TIMESTAMP) {
+            file->pre_read.push_back(entry);
+            break;
+        }
+        raw.append(reinterpret_cast<const char *>(&entry), sizeof(entry));
+    }
+    chunk->is_last = file->pre_read.empty();
+    if (chunk->is_first) {
+        // Later pieces may be converted before this one has parsed the header, so
+        // we find the thread id ourselves.
+        const offline_entry_t *entries =
+            reinterpret_cast<const offline_entry_t *>(raw.data());
+        size_t count = raw.size() / sizeof(offline_entry_t);
+        for (size_t i = 0; i < count && i < 3; ++i) {
+            if (entries[i].tid.type == OFFLINE_TYPE_THREAD)
+                file->tid = entries[i].tid.tid;
+        }
+        CHECK(file->tid != 0, "Failed to find thread id in header");
+        file->saw_header = true;
+    }
+    chunk->in.str(raw);
+    init_chunk(chunk, false);
+    return "";
+}
+
+void
+raw2trace_t::init_chunk(raw2trace_chunk_t *chunk, bool prev_instr_was_rep_string)
+{
+    raw2trace_thread_data_t *tdata = &chunk->tdata;
+    chunk->in.clear();
+    chunk->in.seekg(0);
+    chunk->out.str("");
+    tdata->index = chunk->file->index;
+    tdata->tid = chunk->file->tid;
+    tdata->thread_file = &chunk->in;
+    tdata->out_file = &chunk->out;
+    tdata->error = "";
+    tdata->pre_read.clear();
+    tdata->delayed_branch.clear();
+    tdata->saw_header = !chunk->is_first;
+    tdata->prev_instr_was_rep_string = prev_instr_was_rep_string;
+    tdata->last_decode_pc = nullptr;
+    tdata->last_summary = nullptr;
+    tdata->is_chunk = true;
+    tdata->chunk_branch_offset = -1;
+    tdata->rep_string_set = false;
+    tdata->rep_string_speculated = false;
+}
+
+std::string
+raw2trace_t::convert_chunk(raw2trace_chunk_t *chunk)
+{
+    raw2trace_thread_data_t *tdata = &chunk->tdata;
+    VPRINT(4, "Worker %d converting piece of thread #%d==%d\n", tdata->worker,
+           tdata->index, (uint)tdata->tid);
+    // Each piece is read from memory in a single call.
+    bool end_of_file = false;
+    tdata->error = process_next_thread_buffer(tdata, &end_of_file);
+    if (!tdata->error.empty() && !(chunk->is_last && thread_file_at_eof(tdata))) {
+        std::stringstream ss;
+        ss << "Failed to process file for thread " << (uint)tdata->tid << ": "
+           << tdata->error;
+        tdata->error = ss.str();
+        return tdata->error;
+    }
+    if (end_of_file && !chunk->is_last) {
+        tdata->error = "Footer is not the final entry";
+        return tdata->error;
+    }
+    if (chunk->is_last && !end_of_file) {
+        // As in process_thread_file(), we provide partial results.
+        WARN("Input file for thread %d is truncated", (uint)tdata->tid);
+        offline_entry_t entry;
+        entry.extended.type = OFFLINE_TYPE_EXTENDED;
+        entry.extended.ext = OFFLINE_EXT_TYPE_FOOTER;
+        bool last_bb_handled = true;
+        tdata->error = process_offline_entry(tdata, &entry, tdata->tid, &end_of_file,
+                                             &last_bb_handled);
+        CHECK(end_of_file, "Synthetic footer failed");
+        if (!tdata->error.empty())
+            return tdata->error;
+    }
+    tdata->error = "";
+    return "";
+}
+
+void
+raw2trace_t::process_chunks(std::vector<std::unique_ptr<raw2trace_chunk_t>> *chunks,
+                            std::atomic<size_t> *next_chunk, int worker)
+{
+    for (size_t i = (*next_chunk)++; i < chunks->size(); i = (*next_chunk)++) {
+        raw2trace_chunk_t *chunk = (*chunks)[i].get();
+        chunk->tdata.worker = worker;
+        std::string error = convert_chunk(chunk);
+        if (!error.empty()) {
+            VPRINT(1, "Worker %d hit error %s on trace thread %d\n", worker,
+                   error.c_str(), chunk->tdata.index);
+        }
+    }
+}
+
+// Writes a converted piece to its file's output, reconciling the conversion state
+// with that of the prior piece.  Pieces must be appended in order.
+std::string
+raw2trace_t::append_chunk(raw2trace_chunk_t *chunk)
+{
+    raw2trace_thread_data_t *file = chunk->file;
+    raw2trace_thread_data_t *tdata = &chunk->tdata;
+    if (tdata->error.empty() && tdata->rep_string_speculated &&
+        file->prev_instr_was_rep_string) {
+        VPRINT(2, "Re-converting piece of thread #%d after a rep string\n",
+               tdata->index);
+        init_chunk(chunk, true);
+        convert_chunk(chunk);
+    }
+    if (!tdata->error.empty())
+        return tdata->error;
+    const std::string &out = chunk->out.str();
+    // If this piece never reached the point for a delayed branch, it stays pending.
+    bool insert_branch = !file->delayed_branch.empty() && tdata->chunk_branch_offset >= 0;
+    size_t split =
+        insert_branch ? static_cast<size_t>(tdata->chunk_branch_offset) : out.size();
+    if (!file->out_file->write(out.data(), split))
+        return "Failed to write to output file";
+    if (insert_branch) {
+        std::string error = append_delayed_branch(file);
+        if (!error.empty())
+            return error;
+        if (!file->out_file->write(out.data() + split, out.size() - split))
+            return "Failed to write to output file";
+    }
+    if (!tdata->delayed_branch.empty()) {
+        CHECK(file->delayed_branch.empty(), "Failed to flush delayed branch");
+        file->delayed_branch.swap(tdata->delayed_branch);
+    }
+    if (tdata->rep_string_set)
+        file->prev_instr_was_rep_string = tdata->prev_instr_was_rep_string;
+    return "";
+}
+
+std::string
+raw2trace_t::do_chunked_conversion()
+{
+    VPRINT(1, "Converting pieces of %" UINT64_FORMAT_CODE " bytes with %d workers\n",
+           chunk_size, worker_count);
+    std::vector<std::unique_ptr<raw2trace_chunk_t>> batch;
+    const size_t batch_max = static_cast<size_t>(worker_count);
+    std::vector<bool> done(thread_data.size(), false);
+    size_t remaining = thread_data.size();
+    while (remaining > 0) {
+        // Gather a piece per worker, taking one from each unfinished file in turn so
+        // that both many small files and a few large ones keep the workers busy.
+        // The pieces of each file are in order within the batch.
+        batch.clear();
+        bool progress = true;
+        while (batch.size() < batch_max && progress) {
+            progress = false;
+            for (size_t i = 0; i < thread_data.size() && batch.size() < batch_max; ++i) {
+                if (done[i])
+                    continue;
+                std::unique_ptr<raw2trace_chunk_t> chunk(new raw2trace_chunk_t);
+                std::string error = read_chunk(&thread_data[i], chunk.get());
+                if (!error.empty())
+                    return error;
+                if (chunk->is_last) {
+                    done[i] = true;
+                    --remaining;
+                }
+                batch.push_back(std::move(chunk));
+                progress = true;
+            }
+        }
+        std::atomic<size_t> next_chunk(0);
+        std::vector<std::thread> threads;
+        int thread_count = std::min(worker_count, static_cast<int>(batch.size()));
+        threads.reserve(thread_count);
+        for (int i = 0; i < thread_count; ++i) {
+            threads.push_back(std::thread(&raw2trace_t::process_chunks, this, &batch,
+                                          &next_chunk, i));
+        }
+        for (std::thread &thread : threads)
+            thread.join();
+        for (auto &chunk : batch) {
+            // Any re-conversion happens on this thread, which uses the first cache.
+            chunk->tdata.worker = 0;
+            std::string error = append_chunk(chunk.get());
+            if (!error.empty())
+                return error;
+        }
+    }
+    return "";
+}
+
+std::string
+raw2trace_t::set_chunk_size(uint64 chunk_size_in)
+{
+    if (index_interval > 0)
+        return "Splitting thread files is not supported with an index";
+    // We only split between whole entries.
+    chunk_size = ALIGN_FORWARD(chunk_size_in, sizeof(offline_entry_t));
+    return "";
+}
+
+std::string
+raw2trace_t::set_index_files(const std::vector<std::ostream *> &index_files,
+                             uint64 interval)
+{
+    if (chunk_size > 0)
+        return "An index is not supported when splitting thread files";
+    if (index_files.size() != thread_data.size())
+        return "Index file count does not match thread file count";
+    index_interval = interval;
+    trace_index_header_t header = { TRACE_INDEX_VERSION, interval };
+    for (size_t i = 0; i < thread_data.size(); ++i) {
+        thread_data[i].index_file = index_files[i];
+        if (!index_files[i]->write((char *)&header, sizeof(header)))
+            return "Failed to write index file header";
+    }
+    return "";
+}
+
 const instr_summary_t *
 raw2trace_t::get_instr_summary(void *tls, uint64 modidx, uint64 modoffs, INOUT app_pc *pc,
                                app_pc orig)
@@ -632,8 +920,8 @@ raw2trace_t::get_instr_summary(void *tls, uint64 modidx, uint64 modoffs, INOUT a
     // For rep string loops we expect the same PC many times in a row.
     if (decode_pc == tdata->last_decode_pc)
         return tdata->last_summary;
-    const instr_summary_t *ret = static_cast<const instr_summary_t *>(
-        hashtable_lookup(&decode_cache[tdata->worker], decode_pc));
+    decode_cache_t<instr_summary_t>::front_cache_t *front = &decode_front[tdata->worker];
+    const instr_summary_t *ret = decode_cache.lookup(decode_pc, front);
     if (ret == nullptr) {
         instr_summary_t *desc = new instr_summary_t();
         if (!instr_summary_t::construct(dcontext, pc, orig, desc, verbosity)) {
@@ -642,8 +930,9 @@ raw2trace_t::get_instr_summary(void *tls, uint64 modidx, uint64 modoffs, INOUT a
             delete desc;
             return nullptr;
         }
-        hashtable_add(&decode_cache[tdata->worker], decode_pc, desc);
-        ret = desc;
+        // Another worker may have decoded the same instruction meanwhile, in which
+        // case we use its copy.
+        ret = decode_cache.add(decode_pc, desc, front);
     } else {
         /* XXX i#3129: Log some rendering of the instruction summary that will be
          * returned.
@@ -761,11 +1050,21 @@ std::string
 raw2trace_t::append_delayed_branch(void *tls)
 {
     auto tdata = reinterpret_cast<raw2trace_thread_data_t *>(tls);
+    if (tdata->is_chunk && tdata->chunk_branch_offset < 0) {
+        // This is where a delayed branch from the prior piece belongs.
+        tdata->chunk_branch_offset = tdata->out_file->tellp();
+    }
     if (tdata->delayed_branch.empty())
         return "";
     VPRINT(4, "Appending delayed branch for thread %d\n", tdata->index);
     if (!tdata->out_file->write(&tdata->delayed_branch[0], tdata->delayed_branch.size()))
         return "Failed to write to output file";
+    if (tdata->index_file != nullptr) {
+        const trace_entry_t *branch =
+            reinterpret_cast<const trace_entry_t *>(tdata->delayed_branch.data());
+        tdata->instr_count += trace_entry_instr_count(
+            branch, branch + tdata->delayed_branch.size() / sizeof(trace_entry_t));
+    }
     tdata->delayed_branch.clear();
     return "";
 }
@@ -781,6 +1080,8 @@ bool
 raw2trace_t::write(void *tls, const trace_entry_t *start, const trace_entry_t *end)
 {
     auto tdata = reinterpret_cast<raw2trace_thread_data_t *>(tls);
+    if (tdata->index_file != nullptr)
+        tdata->instr_count += trace_entry_instr_count(start, end);
     return !!tdata->out_file->write(reinterpret_cast<const char *>(start),
                                     reinterpret_cast<const char *>(end) -
                                         reinterpret_cast<const char *>(start));
@@ -817,6 +1118,11 @@ raw2trace_t::on_thread_end(void *tls)
     auto tdata = reinterpret_cast<raw2trace_thread_data_t *>(tls);
     if (get_next_entry(tdata) != nullptr || !thread_file_at_eof(tdata))
         return "Footer is not the final entry";
+    if (tdata->index_file != nullptr) {
+        trace_index_entry_t end = { 0, tdata->instr_count, TRACE_INDEX_END_TIMESTAMP };
+        if (!tdata->index_file->write((char *)&end, sizeof(end)))
+            return "Failed to write to index file";
+    }
     return write_footer(tdata);
 }
 
@@ -837,12 +1143,15 @@ raw2trace_t::set_prev_instr_rep_string(void *tls, bool value)
 {
     auto tdata = reinterpret_cast<raw2trace_thread_data_t *>(tls);
     tdata->prev_instr_was_rep_string = value;
+    tdata->rep_string_set = true;
 }
 
 bool
 raw2trace_t::was_prev_instr_rep_string(void *tls)
 {
     auto tdata = reinterpret_cast<raw2trace_thread_data_t *>(tls);
+    if (!tdata->rep_string_set)
+        tdata->rep_string_speculated = true;
     return tdata->prev_instr_was_rep_string;
 }
 
@@ -879,7 +1188,7 @@ raw2trace_t::raw2trace_t(const char *module_map_in,
         if (worker_count > kDefaultJobMax)
             worker_count = kDefaultJobMax;
     }
-    int cache_count = worker_count;
+    decode_front.resize(worker_count > 0 ? worker_count : 1);
     if (worker_count > 0) {
         worker_tasks.resize(worker_count);
         int worker = 0;
@@ -889,37 +1198,12 @@ raw2trace_t::raw2trace_t(const char *module_map_in,
             thread_data[i].worker = worker;
             worker = (worker + 1) % worker_count;
         }
-    } else
-        cache_count = 1;
-    decode_cache.resize(cache_count);
-    for (int i = 0; i < cache_count; ++i) {
-        // We go ahead and start with a reasonably large capacity.
-        // We do not want the built-in mutex: this is per-worker so it can be lockless.
-        hashtable_init_ex(&decode_cache[i], 16, HASH_INTPTR, false, false, NULL, NULL,
-                          NULL);
-        // We pay a little memory to get a lower load factor, unless we have
-        // many duplicated tables.
-        hashtable_config_t config = { sizeof(config), true,
-                                      worker_count <= 8
-                                          ? 40U
-                                          : (worker_count <= 16 ? 50U : 60U) };
-        hashtable_configure(&decode_cache[i], &config);
     }
 }
 
 raw2trace_t::~raw2trace_t()
 {
     module_mapper.reset();
-    for (size_t i = 0; i < decode_cache.size(); ++i) {
-        // XXX: We can't use a free-payload function b/c we can't get the dcontext there,
-        // so we have to explicitly free the payloads.
-        for (uint j = 0; j < HASHTABLE_SIZE(decode_cache[i].table_bits); j++) {
-            for (hash_entry_t *e = decode_cache[i].table[j]; e != NULL; e = e->next) {
-                delete (static_cast<instr_summary_t *>(e->payload));
-            }
-        }
-        hashtable_delete(&decode_cache[i]);
-    }
 }
 
 bool
@@ -50,9 +50,12 @@
 #include "trace_entry.h"
 #include <fstream>
 #include "hashtable.h"
+#include "decode_cache.h"
+#include <sstream>
 #include <vector>
 
 #define OUTFILE_SUFFIX "raw"
+#define OUTFILE_SUFFIX_GZ "raw.gz"
 #define OUTFILE_SUBDIR "raw"
 #define TRACE_SUBDIR "trace"
 #ifdef HAS_ZLIB
@@ -928,6 +931,34 @@ public:
     virtual std::string
     do_conversion();
 
+    /**
+     * Requests that an index be written for each output file to the stream at the
+     * same position in \p index_files, which are owned by the caller.  Each output
+     * file is divided into chunks which start at the first timestamp after at least
+     * \p interval instructions since the prior chunk.  At each chunk boundary the
+     * output stream is flushed and its tellp() is recorded as the chunk's offset, so
+     * the output streams must support reading back from such offsets, as
+     * std::ofstream and gzip_ostream_t do.  Must be called before do_conversion().
+     * Returns a non-empty error message on failure.
+     */
+    std::string
+    set_index_files(const std::vector<std::ostream *> &index_files, uint64 interval);
+
+    /**
+     * Requests that each thread file be split into pieces of roughly \p chunk_size
+     * bytes of raw data, at the boundaries between the tracer's buffers, which are
+     * then converted concurrently by the worker threads and concatenated in order.
+     * This parallelizes conversion of a trace dominated by a few threads, at the cost
+     * of holding up to one piece and its output per worker in memory.  The state
+     * that crosses a boundary is reconciled when the pieces are concatenated, so the
+     * output is identical to converting each file as a whole.  Has no effect if the
+     * worker count is 0, and is not supported together with set_index_files().
+     * Must be called before do_conversion().
+     * Returns a non-empty error message on failure.
+     */
+    std::string
+    set_chunk_size(uint64 chunk_size);
+
     static std::string
     check_thread_file(std::istream *f);
 
@@ -952,10 +983,18 @@ protected:
             , worker(0)
             , thread_file(nullptr)
             , out_file(nullptr)
+            , index_file(nullptr)
+            , instr_count(0)
+            , chunk_count(0)
+            , chunk_instr_count(0)
             , saw_header(false)
             , prev_instr_was_rep_string(false)
             , last_decode_pc(nullptr)
             , last_summary(nullptr)
+            , is_chunk(false)
+            , chunk_branch_offset(-1)
+            , rep_string_set(false)
+            , rep_string_speculated(false)
         {
         }
 
@@ -964,12 +1003,18 @@ protected:
         int worker;
         std::istream *thread_file;
         std::ostream *out_file;
+        std::ostream *index_file;
         std::string error;
         std::vector<offline_entry_t> pre_read;
 
         // Used to delay a thread-buffer-final branch to keep it next to its target.
         std::vector<char> delayed_branch;
 
+        // For set_index_files().
+        uint64 instr_count;
+        uint64 chunk_count;
+        uint64 chunk_instr_count;
+
         // Current trace conversion state.
         bool saw_header;
         offline_entry_t last_entry;
@@ -977,6 +1022,16 @@ protected:
         bool prev_instr_was_rep_string;
         app_pc last_decode_pc;
         const instr_summary_t *last_summary;
+
+        // For set_chunk_size(): whether this holds a piece of a thread file, and if
+        // so the output offset where the prior piece's delayed branch belongs (or -1
+        // if not yet reached), whether prev_instr_was_rep_string has been set, and
+        // whether it was read before that, i.e., whether the output depends on the
+        // prior piece's final value, for which we speculate false.
+        bool is_chunk;
+        std::streamoff chunk_branch_offset;
+        bool rep_string_set;
+        bool rep_string_speculated;
     };
 
     std::string
@@ -1026,6 +1081,8 @@ private:
     thread_file_at_eof(void *tls);
     std::string
     process_header(raw2trace_thread_data_t *tdata);
+    std::string
+    maybe_start_index_chunk(raw2trace_thread_data_t *tdata, uint64 timestamp);
 
     std::string
     process_thread_file(raw2trace_thread_data_t *tdata);
@@ -1033,6 +1090,30 @@ private:
     void
     process_tasks(std::vector<raw2trace_thread_data_t *> *tasks);
 
+    // A piece of a thread file for set_chunk_size().
+    struct raw2trace_chunk_t {
+        raw2trace_thread_data_t *file; // The thread file this piece belongs to.
+        bool is_first;
+        bool is_last;
+        std::istringstream in;
+        std::ostringstream out;
+        raw2trace_thread_data_t tdata;
+    };
+
+    std::string
+    do_chunked_conversion();
+    std::string
+    read_chunk(raw2trace_thread_data_t *file, OUT raw2trace_chunk_t *chunk);
+    void
+    init_chunk(raw2trace_chunk_t *chunk, bool prev_instr_was_rep_string);
+    std::string
+    convert_chunk(raw2trace_chunk_t *chunk);
+    std::string
+    append_chunk(raw2trace_chunk_t *chunk);
+    void
+    process_chunks(std::vector<std::unique_ptr<raw2trace_chunk_t>> *chunks,
+                   std::atomic<size_t> *next_chunk, int worker);
+
     std::vector<raw2trace_thread_data_t> thread_data;
 
     int worker_count;
@@ -1042,8 +1123,11 @@ private:
     // hashtable_t to std::map.find, std::map.lower_bound, std::tr1::unordered_map,
     // and c++11 std::unordered_map (including tuning its load factor, initial size,
     // and hash function), and hashtable_t outperformed the others (i#2056).
-    // We use a per-worker cache to avoid locks.
-    std::vector<hashtable_t> decode_cache;
+    // All workers share one striped cache so that each instruction is decoded once
+    // and memory does not grow with the worker count.  Each worker looks up through
+    // its own front cache, indexed by worker, so most lookups take no lock.
+    decode_cache_t<instr_summary_t> decode_cache;
+    std::vector<decode_cache_t<instr_summary_t>::front_cache_t> decode_front;
 
     // Store optional parameters for the module_mapper_t until we need to construct it.
     const char *(*user_parse)(const char *src, OUT void **data) = nullptr;
@@ -1057,8 +1141,13 @@ private:
 
     unsigned int verbosity = 0;
 
-    // Our decode_cache duplication will not scale forever on very large code
-    // footprint traces, so we set a cap for the default.
+    uint64 index_interval = 0;
+
+    uint64 chunk_size = 0;
+
+    // We have not measured how conversion scales beyond this many workers, where
+    // output writes and the shared decode cache may start to contend, so we set a
+    // cap for the default.
     static const int kDefaultJobMax = 16;
 };
 
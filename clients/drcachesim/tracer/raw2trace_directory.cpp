@@ -49,11 +49,14 @@
 #    include <windows.h>
 #endif
 #ifdef HAS_ZLIB
+#    include "common/gzip_istream.h"
 #    include "common/gzip_ostream.h"
+#    include "common/columnar_ostream.h"
 #endif
 
 #include "dr_api.h"
 #include "dr_frontend.h"
+#include "columnar_trace.h"
 #include "raw2trace.h"
 #include "raw2trace_directory.h"
 #include "directory_iterator.h"
@@ -104,17 +107,35 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
     if (strcmp(basename, DRMEMTRACE_MODULE_LIST_FILENAME) == 0)
         return "";
     // Skip any non-.raw in case someone put some other file in there.
+    // Files compressed by the tracer's -raw_compress end in .raw.gz.
+    bool compressed = false;
     const char *basename_pre_suffix = strrchr(basename, '.');
+    const size_t basename_len = strlen(basename);
+    const size_t gz_suffix_len = strlen("." OUTFILE_SUFFIX_GZ);
+    if (basename_len > gz_suffix_len &&
+        strcmp(basename + basename_len - gz_suffix_len, "." OUTFILE_SUFFIX_GZ) == 0) {
+        compressed = true;
+        basename_pre_suffix = basename + basename_len - gz_suffix_len;
+    }
     if (basename_pre_suffix != nullptr)
         basename_pre_suffix = strstr(basename_pre_suffix, OUTFILE_SUFFIX);
     if (basename_pre_suffix == nullptr)
         return "";
+#ifndef HAS_ZLIB
+    if (compressed)
+        return "Reading compressed file " + std::string(basename) + " requires zlib";
+#endif
     if (dr_snprintf(path, BUFFER_SIZE_ELEMENTS(path), "%s%s%s", indir.c_str(), DIRSEP,
                     basename) <= 0) {
         return "Failed to get full path of file " + std::string(basename);
     }
     NULL_TERMINATE_BUFFER(path);
-    in_files.push_back(new std::ifstream(path, std::ifstream::binary));
+#ifdef HAS_ZLIB
+    if (compressed)
+        in_files.push_back(new gzip_istream_t(path));
+    else
+#endif
+        in_files.push_back(new std::ifstream(path, std::ifstream::binary));
     if (!(*in_files.back()))
         return "Failed to open thread log file " + std::string(path);
     std::string error = raw2trace_t::check_thread_file(in_files.back());
@@ -131,12 +152,15 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
         return "Failed to compute output name for file " + std::string(basename);
     }
     if (dr_snprintf(path, BUFFER_SIZE_ELEMENTS(path), "%s%s%s.%s", outdir.c_str(), DIRSEP,
-                    outname, TRACE_SUFFIX) <= 0) {
+                    outname, columnar ? TRACE_COLUMNAR_SUFFIX : TRACE_SUFFIX) <= 0) {
         return "Failed to compute full path of output file for " + std::string(basename);
     }
     std::ostream *ofile;
 #ifdef HAS_ZLIB
-    ofile = new gzip_ostream_t(path);
+    if (columnar)
+        ofile = new columnar_ostream_t(path);
+    else
+        ofile = new gzip_ostream_t(path);
 #else
     ofile = new std::ofstream(path, std::ofstream::binary);
 #endif
@@ -144,6 +168,17 @@ raw2trace_directory_t::open_thread_log_file(const char *basename)
     if (!(*out_files.back()))
         return "Failed to open output file " + std::string(path);
     VPRINT(1, "Opened output file %s\n", path);
+    if (write_index) {
+        if (dr_snprintf(path, BUFFER_SIZE_ELEMENTS(path), "%s%s%s.%s.%s", outdir.c_str(),
+                        DIRSEP, outname, TRACE_SUFFIX, TRACE_INDEX_SUFFIX) <= 0) {
+            return "Failed to compute full path of index file for " +
+                std::string(basename);
+        }
+        index_files.push_back(new std::ofstream(path, std::ofstream::binary));
+        if (!(*index_files.back()))
+            return "Failed to open index file " + std::string(path);
+        VPRINT(1, "Opened index file %s\n", path);
+    }
     return "";
 }
 
@@ -202,10 +237,19 @@ raw2trace_directory_t::tracedir_from_rawdir(const std::string &rawdir_in)
 
 std::string
 raw2trace_directory_t::initialize(const std::string &indir_in,
-                                  const std::string &outdir_in)
+                                  const std::string &outdir_in, bool write_index_in,
+                                  bool columnar_in)
 {
     indir = indir_in;
     outdir = outdir_in;
+    write_index = write_index_in;
+    columnar = columnar_in;
+#ifndef HAS_ZLIB
+    if (columnar)
+        return "The columnar trace format requires zlib";
+#endif
+    if (columnar && write_index)
+        return "An index is not supported for the columnar trace format";
 #ifdef WINDOWS
     // Canonicalize.
     std::replace(indir.begin(), indir.end(), ALT_DIRSEP[0], DIRSEP[0]);
@@ -257,4 +301,8 @@ raw2trace_directory_t::~raw2trace_directory_t()
          fo != out_files.end(); ++fo) {
         delete *fo;
     }
+    for (std::vector<std::ostream *>::iterator fo = index_files.begin();
+         fo != index_files.end(); ++fo) {
+        delete *fo;
+    }
 }
@@ -47,14 +47,21 @@ public:
         , indir("")
         , outdir("")
         , verbosity(verbosity_in)
+        , write_index(false)
+        , columnar(false)
     {
     }
     ~raw2trace_directory_t();
 
     // If outdir.empty() then a peer of indir's OUTFILE_SUBDIR named TRACE_SUBDIR
-    // is used by default.  Returns "" on success or an error message on failure.
+    // is used by default.  If write_index is true, an index file is opened next to
+    // each output file in index_files, for raw2trace_t::set_index_files().
+    // If columnar is true, the output files use the columnar format of
+    // columnar_trace.h, which does not support an index.
+    // Returns "" on success or an error message on failure.
     std::string
-    initialize(const std::string &indir, const std::string &outdir);
+    initialize(const std::string &indir, const std::string &outdir,
+               bool write_index = false, bool columnar = false);
     // Use this instead of initialize() to only fill in modfile_bytes, for
     // constructing a module_mapper_t.  Returns "" on success or an error message on
     // failure.
@@ -67,6 +74,7 @@ public:
     char *modfile_bytes;
     std::vector<std::istream *> in_files;
     std::vector<std::ostream *> out_files;
+    std::vector<std::ostream *> index_files;
 
 private:
     std::string
@@ -79,6 +87,8 @@ private:
     std::string indir;
     std::string outdir;
     unsigned int verbosity;
+    bool write_index;
+    bool columnar;
 };
 
 #endif /* _RAW2TRACE_DIRECTORY_H_ */
@@ -65,6 +65,31 @@ static droption_t<int>
             "disables concurrency and uses  single thread to perform all operations.  A "
             "negative value sets the job count to the number of hardware threads.");
 
+static droption_t<bytesize_t> op_index_interval(
+    DROPTION_SCOPE_FRONTEND, "index_interval", 0, "Instructions between index points",
+    "If non-zero, an index file is written next to each output file, dividing the "
+    "trace into chunks of roughly this many instructions that can each be "
+    "decompressed on their own.  Readers use the index to seek into the trace.");
+
+static droption_t<bytesize_t> op_raw_split_size(
+    DROPTION_SCOPE_FRONTEND, "raw_split_size", 0,
+    "Bytes per piece when converting raw files in parallel",
+    "If non-zero, post-processing of offline raw trace files splits each raw file "
+    "into pieces of roughly this many bytes, at the boundaries between the tracer's "
+    "buffers, and converts the pieces in parallel.  By default each raw file is "
+    "converted by a single job, so a trace dominated by one or two threads is "
+    "converted almost serially.  The output is identical either way.  Up to one piece "
+    "per job is held in memory along with its output.  This is not supported with "
+    "-index_interval.");
+
+static droption_t<bool> op_columnar(
+    DROPTION_SCOPE_FRONTEND, "columnar", false, "Write traces in the columnar format",
+    "If true, post-processing of offline raw trace files writes each trace file in a "
+    "columnar format that stores entry types, sizes, and addresses separately, with "
+    "addresses as small differences from predicted values.  The files are typically "
+    "half the size of the default format and are read by the same tools.  This "
+    "requires zlib and is not supported with -index_interval.");
+
 #define FATAL_ERROR(msg, ...)                               \
     do {                                                    \
         fprintf(stderr, "ERROR: " msg "\n", ##__VA_ARGS__); \
@@ -90,11 +115,24 @@ _tmain(int argc, const TCHAR *targv[])
     }
 
     raw2trace_directory_t dir(op_verbose.get_value());
-    std::string dir_err = dir.initialize(op_indir.get_value(), op_outdir.get_value());
+    std::string dir_err =
+        dir.initialize(op_indir.get_value(), op_outdir.get_value(),
+                       op_index_interval.get_value() > 0, op_columnar.get_value());
     if (!dir_err.empty())
         FATAL_ERROR("Directory parsing failed: %s", dir_err.c_str());
     raw2trace_t raw2trace(dir.modfile_bytes, dir.in_files, dir.out_files, NULL,
                           op_verbose.get_value(), op_jobs.get_value());
+    if (op_index_interval.get_value() > 0) {
+        std::string error =
+            raw2trace.set_index_files(dir.index_files, op_index_interval.get_value());
+        if (!error.empty())
+            FATAL_ERROR("Index setup failed: %s", error.c_str());
+    }
+    if (op_raw_split_size.get_value() > 0) {
+        std::string error = raw2trace.set_chunk_size(op_raw_split_size.get_value());
+        if (!error.empty())
+            FATAL_ERROR("Split setup failed: %s", error.c_str());
+    }
     std::string error = raw2trace.do_conversion();
     if (!error.empty())
         FATAL_ERROR("Conversion failed: %s", error.c_str());
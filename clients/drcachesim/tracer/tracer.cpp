@@ -56,8 +56,14 @@
 #include "func_trace.h"
 #include "../common/trace_entry.h"
 #include "../common/named_pipe.h"
+#ifdef LINUX
+#    include "../common/shm_ring.h"
+#endif
 #include "../common/options.h"
 #include "../common/utils.h"
+#ifdef HAS_ZLIB
+#    include <zlib.h>
+#endif
 
 #ifdef ARM
 #    include "../../../core/unix/include/syscall_linux_arm.h" // for SYS_cacheflush
@@ -88,7 +94,7 @@ DR_DISALLOW_UNSAFE_STATIC
     do {                                 \
         dr_fprintf(STDERR, __VA_ARGS__); \
         if (!op_offline.get_value())     \
-            ipc_pipe.close();            \
+            ipc_close();                 \
         dr_abort();                      \
     } while (0)
 
@@ -124,6 +130,11 @@ typedef struct {
     /* For file_ops_func.handoff_buf */
     uint num_buffers;
     byte *reserve_buf;
+    /* For -writer_threads */
+    uint writer_index;
+    volatile int pending_writes;
+    /* For -raw_compress */
+    struct _raw_compressor_t *compressor;
     /* For level 0 filters */
     byte *l0_dcache;
     byte *l0_icache;
@@ -144,6 +155,48 @@ typedef struct {
 
 /* For online simulation, we write to a single global pipe */
 static named_pipe_t ipc_pipe;
+#ifdef LINUX
+/* ...or for -ipc_shm_size, to a ring buffer in memory shared with the simulator. */
+static shm_ring_t ipc_ring;
+static byte *ipc_ring_base;
+static size_t ipc_ring_size;
+#endif
+
+/* Returns the largest write that the simulator is guaranteed to receive whole. */
+static inline ssize_t
+ipc_atomic_write_size()
+{
+#ifdef LINUX
+    if (op_ipc_shm_size.get_value() > 0)
+        return ipc_ring.get_atomic_write_size();
+#endif
+    return ipc_pipe.get_atomic_write_size();
+}
+
+static bool
+ipc_write(byte *start, ssize_t size)
+{
+#ifdef LINUX
+    if (op_ipc_shm_size.get_value() > 0)
+        return ipc_ring.write(start, size);
+#endif
+    return ipc_pipe.write((void *)start, size) >= size;
+}
+
+static void
+ipc_close()
+{
+#ifdef LINUX
+    if (op_ipc_shm_size.get_value() > 0) {
+        ipc_ring.close();
+        if (ipc_ring_base != NULL)
+            dr_unmap_file(ipc_ring_base, ipc_ring_size);
+        ipc_ring_base = NULL;
+        return;
+    }
+#endif
+    ipc_pipe.close();
+}
 
 #define MAX_INSTRU_SIZE 64 /* the max obj size of instr_t or its children */
 static instru_t *instru;
@@ -154,6 +207,23 @@ static uint64 num_refs;      /* keep a global memory reference count */
 static uint64 num_refs_racy; /* racy global memory reference count */
 static volatile bool exited_process;
 
+/* For -trace_for_instrs: the ordinal of the current (or, while counting between
+ * windows, the most recent) tracing window, and a racy count of the instructions
+ * traced in it.
+ */
+static volatile int tracing_window = -1;
+static uint64 traced_instrs_racy;
+
+/* Returns the id of the current window, or -1 if we are not tracing in windows. */
+static inline intptr_t
+get_window_id()
+{
+    if (op_trace_for_instrs.get_value() == 0)
+        return -1;
+    // Anything written before the first window starts is grouped with it.
+    return tracing_window < 0 ? 0 : tracing_window;
+}
+
 /* virtual to physical translation */
 static bool have_phys;
 static physaddr_t physaddr;
@@ -174,6 +244,8 @@ enum {
     /* XXX: we could make these dynamic to save slots when there's no -L0_filter. */
     MEMTRACE_TLS_OFFS_DCACHE,
     MEMTRACE_TLS_OFFS_ICACHE,
+    /* The window that the contents of the thread's buffer belong to. */
+    MEMTRACE_TLS_OFFS_WINDOW,
     MEMTRACE_TLS_COUNT, /* total number of TLS slots allocated */
 };
 static reg_id_t tls_seg;
@@ -182,6 +254,7 @@ static int tls_idx;
 #define TLS_SLOT(tls_base, enum_val) \
     (((void **)((byte *)(tls_base) + tls_offs)) + (enum_val))
 #define BUF_PTR(tls_base) *(byte **)TLS_SLOT(tls_base, MEMTRACE_TLS_OFFS_BUF_PTR)
+#define BUF_WINDOW(tls_base) *(intptr_t *)TLS_SLOT(tls_base, MEMTRACE_TLS_OFFS_WINDOW)
 /* We leave slot(s) at the start so we can easily insert a header entry */
 static size_t buf_hdr_slots_size;
 
@@ -345,18 +418,123 @@ static inline byte *
 atomic_pipe_write(void *drcontext, byte *pipe_start, byte *pipe_end)
 {
     ssize_t towrite = pipe_end - pipe_start;
-    DR_ASSERT(towrite <= ipc_pipe.get_atomic_write_size() && towrite > 0);
-    if (ipc_pipe.write((void *)pipe_start, towrite) < (ssize_t)towrite) {
+    DR_ASSERT(towrite <= ipc_atomic_write_size() && towrite > 0);
+    if (!ipc_write(pipe_start, towrite)) {
         FATAL("Fatal error: failed to write to pipe\n");
     }
     // Re-emit buffer unit header to handle split pipe writes.
     if (pipe_end - buf_hdr_slots_size > pipe_start) {
         pipe_start = pipe_end - buf_hdr_slots_size;
-        instru->append_unit_header(pipe_start, dr_get_thread_id(drcontext));
+        per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
+        instru->append_unit_header(pipe_start, dr_get_thread_id(drcontext),
+                                   BUF_WINDOW(data->seg_base));
     }
     return pipe_start;
 }
 
+/***************************************************************************
+ * Compression of offline raw files for -raw_compress.
+ *
+ * Each thread file is a single gzip stream which we feed one buffer at a time.
+ * The stream state is only ever used by the thread currently writing that
+ * thread's buffers: either the owning thread or, with -writer_threads, its
+ * writer thread, which handles that file's buffers in order.
+ */
+
+/* Size of the staging buffer for compressed output. */
+#define RAW_COMPRESS_OUT_SIZE (64 * 1024)
+
+typedef struct _raw_compressor_t {
+#ifdef HAS_ZLIB
+    z_stream zstream;
+    byte out[RAW_COMPRESS_OUT_SIZE];
+#endif
+} raw_compressor_t;
+
+#ifdef HAS_ZLIB
+/* We route zlib's allocations through DR's heap to keep them isolated from
+ * the application.  We prepend the size as dr_global_free() requires it.
+ */
+static voidpf
+raw_compress_alloc(voidpf opaque, uInt items, uInt size)
+{
+    size_t alloc_size = (size_t)items * size + sizeof(size_t);
+    size_t *alloc = (size_t *)dr_global_alloc(alloc_size);
+    *alloc = alloc_size;
+    return alloc + 1;
+}
+
+static void
+raw_compress_free(voidpf opaque, voidpf address)
+{
+    size_t *alloc = (size_t *)address - 1;
+    dr_global_free(alloc, *alloc);
+}
+#endif
+
+static raw_compressor_t *
+raw_compressor_create(void)
+{
+#ifdef HAS_ZLIB
+    raw_compressor_t *comp = (raw_compressor_t *)dr_global_alloc(sizeof(*comp));
+    memset(&comp->zstream, 0, sizeof(comp->zstream));
+    comp->zstream.zalloc = raw_compress_alloc;
+    comp->zstream.zfree = raw_compress_free;
+    /* Adding 16 to the window bits selects a gzip header and trailer. */
+    if (deflateInit2(&comp->zstream, Z_BEST_SPEED, Z_DEFLATED, MAX_WBITS + 16, 8,
+                     Z_DEFAULT_STRATEGY) != Z_OK)
+        FATAL("Fatal error: failed to initialize trace compression\n");
+    return comp;
+#else
+    return NULL;
+#endif
+}
+
+/* Compresses [buf, buf + size) and writes out whatever compressed data is
+ * ready.  If finish is set, the stream is terminated and all remaining data
+ * is written.
+ */
+static bool
+raw_compressor_write(raw_compressor_t *comp, file_t file, byte *buf, size_t size,
+                     bool finish)
+{
+#ifdef HAS_ZLIB
+    comp->zstream.next_in = (Bytef *)buf;
+    comp->zstream.avail_in = (uInt)size;
+    do {
+        comp->zstream.next_out = (Bytef *)comp->out;
+        comp->zstream.avail_out = sizeof(comp->out);
+        if (deflate(&comp->zstream, finish ? Z_FINISH : Z_NO_FLUSH) == Z_STREAM_ERROR)
+            return false;
+        ssize_t out_size = sizeof(comp->out) - comp->zstream.avail_out;
+        if (out_size > 0 &&
+            file_ops_func.write_file(file, comp->out, out_size) < out_size)
+            return false;
+    } while (comp->zstream.avail_out == 0);
+    return true;
+#else
+    return false;
+#endif
+}
+
+static void
+raw_compressor_destroy(raw_compressor_t *comp)
+{
+#ifdef HAS_ZLIB
+    deflateEnd(&comp->zstream);
+    dr_global_free(comp, sizeof(*comp));
+#endif
+}
+
+/* Writes one buffer of raw data to an offline thread file. */
+static bool
+write_raw_file(file_t file, raw_compressor_t *comp, byte *buf, size_t size)
+{
+    if (comp != NULL)
+        return raw_compressor_write(comp, file, buf, size, false);
+    return file_ops_func.write_file(file, buf, size) >= (ssize_t)size;
+}
+
 static inline byte *
 write_trace_data(void *drcontext, byte *towrite_start, byte *towrite_end)
 {
@@ -368,7 +546,7 @@ write_trace_data(void *drcontext, byte *towrite_start, byte *towrite_end)
                                            max_buf_size)) {
                 FATAL("Fatal error: failed to hand off trace\n");
             }
-        } else if (file_ops_func.write_file(data->file, towrite_start, size) < size) {
+        } else if (!write_raw_file(data->file, data->compressor, towrite_start, size)) {
             FATAL("Fatal error: failed to write trace\n");
         }
         return towrite_start;
@@ -376,6 +554,191 @@ write_trace_data(void *drcontext, byte *towrite_start, byte *towrite_end)
         return atomic_pipe_write(drcontext, towrite_start, towrite_end);
 }
 
+/***************************************************************************
+ * Asynchronous buffer writing for -writer_threads.
+ *
+ * Full offline buffers are queued to a background writer thread and the
+ * application thread continues with a fresh buffer.  Each traced thread is
+ * statically assigned to one writer, whose queue is FIFO, so the buffers of any
+ * one thread file are written in order.  The number of outstanding buffers per
+ * traced thread is capped at -writer_max_pending: once reached, the
+ * application thread writes its queued buffers itself.
+ *
+ * A writer holds its write_lock from taking a request off its queue until it has
+ * written it and decremented the owning thread's pending_writes, which is its
+ * last access to that thread's data.  DR never considers a client thread that
+ * holds a client lock to be at a safe point for synchall, so a writer cannot be
+ * suspended with a request in flight.  It can be suspended while waiting for
+ * work or between requests, though, and it is suspended for good at process
+ * exit.  A traced thread must thus never wait for its writer to drain its
+ * queue: when it needs its earlier buffers on disk, at thread exit or when it
+ * has too many outstanding, it takes its own requests back off the queue under
+ * write_lock and writes them itself.
+ */
+
+typedef struct _write_request_t {
+    file_t file;
+    raw_compressor_t *compressor;
+    byte *buf;
+    size_t size;
+    volatile int *pending;
+    struct _write_request_t *next;
+} write_request_t;
+
+typedef struct {
+    void *lock;       /* Protects the queue. */
+    void *write_lock; /* Held while a request is off the queue but not written. */
+    void *work_event;
+    write_request_t *head;
+    write_request_t *tail;
+} writer_t;
+
+static writer_t *writers;
+static uint num_writers;
+static volatile int next_writer;
+
+/* Writes out req and frees it along with its buffer. */
+static void
+write_request(write_request_t *req)
+{
+    if (!write_raw_file(req->file, req->compressor, req->buf, req->size))
+        FATAL("Fatal error: failed to write trace\n");
+    dr_raw_mem_free(req->buf, max_buf_size);
+    volatile int *pending = req->pending;
+    dr_global_free(req, sizeof(*req));
+    dr_atomic_add32_return_sum(pending, -1);
+}
+
+static void
+writer_thread_main(void *arg)
+{
+    writer_t *writer = (writer_t *)arg;
+    while (true) {
+        dr_event_wait(writer->work_event);
+        while (true) {
+            dr_mutex_lock(writer->write_lock);
+            dr_mutex_lock(writer->lock);
+            write_request_t *req = writer->head;
+            if (req != NULL) {
+                writer->head = req->next;
+                if (writer->head == NULL)
+                    writer->tail = NULL;
+            }
+            dr_mutex_unlock(writer->lock);
+            if (req != NULL)
+                write_request(req);
+            dr_mutex_unlock(writer->write_lock);
+            if (req == NULL)
+                break;
+        }
+    }
+}
+
+static void
+writers_init(void)
+{
+    num_writers = op_writer_threads.get_value();
+    writers = (writer_t *)dr_global_alloc(num_writers * sizeof(*writers));
+    for (uint i = 0; i < num_writers; ++i) {
+        writers[i].lock = dr_mutex_create();
+        writers[i].write_lock = dr_mutex_create();
+        writers[i].work_event = dr_event_create();
+        writers[i].head = NULL;
+        writers[i].tail = NULL;
+        if (!dr_create_client_thread(writer_thread_main, &writers[i]))
+            FATAL("Fatal error: failed to create trace writer thread\n");
+    }
+}
+
+static void
+writers_exit(void)
+{
+    /* Every traced thread has written its own leftover requests at thread exit,
+     * and the writer threads are gone or suspended for good at this point.
+     */
+    for (uint i = 0; i < num_writers; ++i) {
+        DR_ASSERT(writers[i].head == NULL);
+        dr_mutex_destroy(writers[i].lock);
+        dr_mutex_destroy(writers[i].write_lock);
+        dr_event_destroy(writers[i].work_event);
+    }
+    dr_global_free(writers, num_writers * sizeof(*writers));
+    writers = NULL;
+    num_writers = 0;
+}
+
+/* Takes the buffers this thread handed off that its writer has not started on
+ * back off the writer's queue and writes them, in order.  Returns once every
+ * buffer handed off by this thread has been written, without depending on the
+ * writer thread running.
+ */
+static void
+writer_reclaim(per_thread_t *data)
+{
+    writer_t *writer = &writers[data->writer_index];
+    write_request_t *mine = NULL, **mine_tail = &mine;
+    dr_mutex_lock(writer->write_lock);
+    dr_mutex_lock(writer->lock);
+    write_request_t *prev = NULL;
+    for (write_request_t *req = writer->head, *next; req != NULL; req = next) {
+        next = req->next;
+        if (req->pending != &data->pending_writes) {
+            prev = req;
+            continue;
+        }
+        if (prev == NULL)
+            writer->head = next;
+        else
+            prev->next = next;
+        if (writer->tail == req)
+            writer->tail = prev;
+        req->next = NULL;
+        *mine_tail = req;
+        mine_tail = &req->next;
+    }
+    dr_mutex_unlock(writer->lock);
+    /* Any request of ours the writer had started on is written by now, and it
+     * will not find any more on its queue.
+     */
+    dr_mutex_unlock(writer->write_lock);
+    while (mine != NULL) {
+        write_request_t *next = mine->next;
+        write_request(mine);
+        mine = next;
+    }
+    DR_ASSERT(data->pending_writes == 0);
+}
+
+/* Hands the buffer [start, end) to the thread's writer.  The caller gives up
+ * ownership of the whole buffer and must obtain a new one.
+ */
+static void
+writer_enqueue(per_thread_t *data, byte *start, byte *end)
+{
+    /* Bound the memory held in queued buffers.  We write them ourselves rather
+     * than wait, as the writer may be suspended by a synchall.
+     */
+    if (data->pending_writes >= (int)op_writer_max_pending.get_value())
+        writer_reclaim(data);
+    write_request_t *req = (write_request_t *)dr_global_alloc(sizeof(*req));
+    req->file = data->file;
+    req->compressor = data->compressor;
+    req->buf = start;
+    req->size = end - start;
+    req->pending = &data->pending_writes;
+    req->next = NULL;
+    dr_atomic_add32_return_sum(&data->pending_writes, 1);
+    writer_t *writer = &writers[data->writer_index];
+    dr_mutex_lock(writer->lock);
+    if (writer->tail == NULL)
+        writer->head = req;
+    else
+        writer->tail->next = req;
+    writer->tail = req;
+    dr_mutex_unlock(writer->lock);
+    dr_event_signal(writer->work_event);
+}
+
 static bool
 is_ok_to_split_before(trace_type_t type)
 {
@@ -390,6 +753,7 @@ memtrace(void *drcontext, bool skip_size_cap)
     byte *mem_ref, *buf_ptr;
     byte *pipe_start, *pipe_end, *redzone;
     bool do_write = true;
+    bool handed_off = false;
     size_t header_size = 0;
     uint current_num_refs = 0;
 
@@ -402,8 +766,16 @@ memtrace(void *drcontext, bool skip_size_cap)
     if (buf_ptr == data->buf_base + header_size + buf_hdr_slots_size)
         return;
     // The initial slots are left empty for the header, which we add here.
-    header_size += instru->append_unit_header(data->buf_base + header_size,
-                                              dr_get_thread_id(drcontext));
+    header_size += instru->append_unit_header(
+        data->buf_base + header_size, dr_get_thread_id(drcontext),
+        BUF_WINDOW(data->seg_base));
+    // This must be counted before the online path below re-uses buffer slots for
+    // split pipe write headers.
+    if (op_trace_for_instrs.get_value() > 0 &&
+        BUF_WINDOW(data->seg_base) == get_window_id()) {
+        traced_instrs_racy +=
+            instru->get_instr_count(data->buf_base + header_size, buf_ptr);
+    }
     pipe_start = data->buf_base;
     pipe_end = pipe_start;
     if (!skip_size_cap && op_max_trace_size.get_value() > 0 &&
@@ -456,7 +828,7 @@ memtrace(void *drcontext, bool skip_size_cap)
                     // avoid splitting an instr from its subsequent bundle entry.
                     // An alternative is to have the reader use per-thread state.
                     if ((mem_ref + (1 + MAX_NUM_DELAY_ENTRIES) * instru->sizeof_entry() -
-                         pipe_start) > ipc_pipe.get_atomic_write_size()) {
+                         pipe_start) > ipc_atomic_write_size()) {
                         DR_ASSERT(is_ok_to_split_before(
                             instru->get_entry_type(pipe_start + header_size)));
                         pipe_start = atomic_pipe_write(drcontext, pipe_start, pipe_end);
@@ -469,7 +841,7 @@ memtrace(void *drcontext, bool skip_size_cap)
             // XXX i#2638: if we want to support branch target analysis in online
             // traces we'll need to not split after a branch by carrying a write-final
             // branch forward to the next buffer.
-            if ((buf_ptr - pipe_start) > ipc_pipe.get_atomic_write_size()) {
+            if ((buf_ptr - pipe_start) > ipc_atomic_write_size()) {
                 DR_ASSERT(is_ok_to_split_before(
                     instru->get_entry_type(pipe_start + header_size)));
                 pipe_start = atomic_pipe_write(drcontext, pipe_start, pipe_end);
@@ -479,6 +851,12 @@ memtrace(void *drcontext, bool skip_size_cap)
                     instru->get_entry_type(pipe_start + header_size)));
                 atomic_pipe_write(drcontext, pipe_start, buf_ptr);
             }
+        } else if (num_writers > 0 && !skip_size_cap) {
+            // The final buffer at thread exit (the only caller passing
+            // skip_size_cap) is written synchronously so the file is complete
+            // before it is closed.
+            writer_enqueue(data, pipe_start, buf_ptr);
+            handed_off = true;
         } else {
             write_trace_data(drcontext, pipe_start, buf_ptr);
         }
@@ -488,8 +866,9 @@ memtrace(void *drcontext, bool skip_size_cap)
         data->num_refs += current_num_refs;
     }
 
-    if (do_write && file_ops_func.handoff_buf != NULL) {
-        // The owner of the handoff callback now owns the buffer, and we get a new one.
+    if ((do_write && file_ops_func.handoff_buf != NULL) || handed_off) {
+        // The owner of the handoff callback (or our writer thread) now owns the
+        // buffer, and we get a new one.
         create_buffer(data);
     } else {
         // Our instrumentation reads from buffer and skips the clean call if the
@@ -521,12 +900,42 @@ memtrace(void *drcontext, bool skip_size_cap)
     }
 }
 
+static void
+reached_traced_instrs_threshold();
+
 /* clean_call sends the memory reference info to the simulator */
 static void
 clean_call(void)
 {
     void *drcontext = dr_get_current_drcontext();
     memtrace(drcontext, false);
+    // We only end a -trace_for_instrs window from here, where we know we are in a
+    // tracing code cache fragment and no other event is in progress.
+    if (op_trace_for_instrs.get_value() > 0 &&
+        traced_instrs_racy > op_trace_for_instrs.get_value())
+        reached_traced_instrs_threshold();
+}
+
+/* Writes out what the thread recorded in a prior -retrace_every_instrs window,
+ * under that window's id, before it records anything in the current one.
+ */
+static void
+start_buffer_window(void *drcontext, per_thread_t *data)
+{
+    intptr_t window = get_window_id();
+    if (BUF_WINDOW(data->seg_base) == window)
+        return;
+    if (BUF_PTR(data->seg_base) != NULL)
+        memtrace(drcontext, false);
+    BUF_WINDOW(data->seg_base) = window;
+}
+
+static void
+new_window_clean_call(void)
+{
+    void *drcontext = dr_get_current_drcontext();
+    start_buffer_window(drcontext,
+                        (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx));
 }
 
 /***************************************************************************
@@ -539,6 +948,8 @@ append_marker_seg_base(void *drcontext, func_trace_entry_vector_t *vec)
     per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
     if (data->seg_base == NULL)
         return; /* This thread was filtered out. */
+    if (op_retrace_every_instrs.get_value() > 0)
+        start_buffer_window(drcontext, data);
     for (int i = 0; i < vec->size; i++) {
         BUF_PTR(data->seg_base) +=
             instru->append_marker(BUF_PTR(data->seg_base), vec->entries[i].marker_type,
@@ -570,6 +981,58 @@ insert_update_buf_ptr(void *drcontext, instrlist_t *ilist, instr_t *where,
     instrlist_set_auto_predicate(ilist, DR_PRED_NONE);
 }
 
+/* Inserts a check for whether the thread's buffer holds records from a prior
+ * -retrace_every_instrs window, in which case we write them out first so that
+ * no buffer spans two windows.
+ */
+static void
+insert_window_check(void *drcontext, instrlist_t *ilist, instr_t *where)
+{
+    // Tracing instrumentation is flushed and rebuilt for each window, so the
+    // window of the code being built is a constant.
+    intptr_t window = get_window_id();
+    instr_t *skip_call = INSTR_CREATE_label(drcontext);
+    reg_id_t reg_window = DR_REG_NULL, reg_cur = DR_REG_NULL;
+    if (drreg_reserve_aflags(drcontext, ilist, where) != DRREG_SUCCESS)
+        FATAL("Fatal error: failed to reserve aflags\n");
+#ifdef X86
+    // We compare just the bottom 32 bits, which is plenty of windows.
+    MINSERT(ilist, where,
+            XINST_CREATE_cmp(drcontext,
+                             opnd_create_far_base_disp(
+                                 tls_seg, DR_REG_NULL, DR_REG_NULL, 0,
+                                 tls_offs + sizeof(void *) * MEMTRACE_TLS_OFFS_WINDOW,
+                                 OPSZ_4),
+                             OPND_CREATE_INT32((int)window)));
+#else
+    if (drreg_reserve_register(drcontext, ilist, where, NULL, &reg_window) !=
+            DRREG_SUCCESS ||
+        drreg_reserve_register(drcontext, ilist, where, NULL, &reg_cur) !=
+            DRREG_SUCCESS)
+        FATAL("Fatal error: failed to reserve scratch registers\n");
+    dr_insert_read_raw_tls(drcontext, ilist, where, tls_seg,
+                           tls_offs + sizeof(void *) * MEMTRACE_TLS_OFFS_WINDOW,
+                           reg_window);
+    instrlist_insert_mov_immed_ptrsz(drcontext, window, opnd_create_reg(reg_cur), ilist,
+                                     where, NULL, NULL);
+    MINSERT(ilist, where,
+            XINST_CREATE_cmp(drcontext, opnd_create_reg(reg_window),
+                             opnd_create_reg(reg_cur)));
+#endif
+    MINSERT(ilist, where,
+            XINST_CREATE_jump_cond(drcontext, DR_PRED_EQ, opnd_create_instr(skip_call)));
+    dr_insert_clean_call(drcontext, ilist, where, (void *)new_window_clean_call,
+                         false /*fpstate */, 0);
+    MINSERT(ilist, where, skip_call);
+    if (reg_window != DR_REG_NULL &&
+        (drreg_unreserve_register(drcontext, ilist, where, reg_window) !=
+             DRREG_SUCCESS ||
+         drreg_unreserve_register(drcontext, ilist, where, reg_cur) != DRREG_SUCCESS))
+        DR_ASSERT(false);
+    if (drreg_unreserve_aflags(drcontext, ilist, where) != DRREG_SUCCESS)
+        DR_ASSERT(false);
+}
+
 static int
 instrument_delay_instrs(void *drcontext, void *tag, instrlist_t *ilist, user_data_t *ud,
                         instr_t *where, reg_id_t reg_ptr, int adjust)
@@ -983,6 +1446,9 @@ event_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t *inst
             FATAL("Fatal error: failed to reserve aflags\n");
     }
 
+    if (op_retrace_every_instrs.get_value() > 0 && drmgr_is_first_instr(drcontext, instr))
+        insert_window_check(drcontext, bb, instr);
+
     if ((!instr_is_app(instr) ||
          /* Skip identical app pc, which happens with rep str expansion.
           * XXX: the expansion means our instr fetch trace is not perfect,
@@ -1201,6 +1667,8 @@ event_pre_syscall(void *drcontext, int sysnum)
     per_thread_t *data = (per_thread_t *)drmgr_get_tls_field(drcontext, tls_idx);
     if (BUF_PTR(data->seg_base) == NULL)
         return true; /* This thread was filtered out. */
+    if (op_retrace_every_instrs.get_value() > 0)
+        start_buffer_window(drcontext, data);
 #ifdef ARM
     // On Linux ARM, cacheflush syscall takes 3 params: start, end, and 0.
     if (sysnum == SYS_cacheflush) {
@@ -1224,6 +1692,8 @@ event_kernel_xfer(void *drcontext, const dr_kernel_xfer_info_t *info)
     trace_marker_type_t marker_type;
     if (BUF_PTR(data->seg_base) == NULL)
         return; /* This thread was filtered out. */
+    if (op_retrace_every_instrs.get_value() > 0)
+        start_buffer_window(drcontext, data);
     switch (info->type) {
     case DR_XFER_APC_DISPATCHER:
         /* Do not bother with a marker for the thread init routine. */
@@ -1249,11 +1719,15 @@ event_kernel_xfer(void *drcontext, const dr_kernel_xfer_info_t *info)
 }
 
 /***************************************************************************
- * Delayed tracing feature.
+ * Delayed tracing feature, which also counts the gaps between -trace_for_instrs
+ * windows.
  */
 
 static uint64 instr_count;
+/* The instruction count at which the current counting phase ends. */
+static uint64 delay_instrs;
 static volatile bool tracing_enabled;
+static bool delay_enabled;
 static void *enable_tracing_lock;
 
 #ifdef X86_64
@@ -1271,18 +1745,26 @@ event_delay_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t
                             bool for_trace, bool translating, void *user_data);
 
 static void
-enable_delay_instrumentation()
+init_delay_instrumentation()
 {
 #ifdef DELAYED_CHECK_INLINED
     drx_init();
 #endif
-    /* We first have a phase where we count instructions.  Only then do we switch
+    enable_tracing_lock = dr_mutex_create();
+}
+
+static void
+enable_delay_instrumentation(uint64 num_instrs)
+{
+    /* We have a phase where we count instructions.  Only then do we switch
      * to tracing instrumentation.
      */
+    instr_count = 0;
+    delay_instrs = num_instrs;
     if (!drmgr_register_bb_instrumentation_event(
             event_delay_bb_analysis, event_delay_app_instruction, &memtrace_pri))
         DR_ASSERT(false);
-    enable_tracing_lock = dr_mutex_create();
+    delay_enabled = true;
 }
 
 static void
@@ -1290,6 +1772,7 @@ disable_delay_instrumentation()
 {
     if (!drmgr_unregister_bb_instrumentation_event(event_delay_bb_analysis))
         DR_ASSERT(false);
+    delay_enabled = false;
 }
 
 static void
@@ -1312,9 +1795,24 @@ enable_tracing_instrumentation()
             event_bb_instru2instru, &memtrace_pri))
         DR_ASSERT(false);
     dr_register_filter_syscall_event(event_filter_syscall);
+    traced_instrs_racy = 0;
+    ++tracing_window;
     tracing_enabled = true;
 }
 
+static void
+disable_tracing_instrumentation()
+{
+    dr_unregister_filter_syscall_event(event_filter_syscall);
+    if (!drmgr_unregister_pre_syscall_event(event_pre_syscall) ||
+        !drmgr_unregister_kernel_xfer_event(event_kernel_xfer) ||
+        !drmgr_unregister_bb_instrumentation_ex_event(
+            event_bb_app2app, event_bb_analysis, event_app_instruction,
+            event_bb_instru2instru))
+        DR_ASSERT(false);
+    tracing_enabled = false;
+}
+
 static void
 hit_instr_count_threshold()
 {
@@ -1331,12 +1829,37 @@ hit_instr_count_threshold()
         DR_ASSERT(false);
 }
 
+/* Ends the current -trace_for_instrs window.  Threads' partially filled buffers
+ * are not forced out here: each thread writes out its own, labeled with this
+ * window, when it first records in the next window (see insert_window_check())
+ * or at thread exit.
+ */
+static void
+reached_traced_instrs_threshold()
+{
+    bool do_flush = false;
+    dr_mutex_lock(enable_tracing_lock);
+    if (tracing_enabled) { // Already came here?
+        disable_tracing_instrumentation();
+        if (op_retrace_every_instrs.get_value() > 0) {
+            NOTIFY(0, "Hit trace window %d end: counting instructions.\n",
+                   tracing_window);
+            enable_delay_instrumentation(op_retrace_every_instrs.get_value());
+        } else
+            NOTIFY(0, "Hit trace window end: disabling tracing.\n");
+        do_flush = true;
+    }
+    dr_mutex_unlock(enable_tracing_lock);
+    if (do_flush && !dr_unlink_flush_region(NULL, ~0UL))
+        DR_ASSERT(false);
+}
+
 #ifndef DELAYED_CHECK_INLINED
 static void
 check_instr_count_threshold(uint incby)
 {
     instr_count += incby;
-    if (instr_count > op_trace_after_instrs.get_value())
+    if (instr_count > delay_instrs)
         hit_instr_count_threshold();
 }
 #endif
@@ -1372,14 +1895,14 @@ event_delay_app_instruction(void *drcontext, void *tag, instrlist_t *bb, instr_t
         DR_ASSERT(false);
     instr_t *skip_call = INSTR_CREATE_label(drcontext);
     reg_id_t scratch = DR_REG_NULL;
-    if (op_trace_after_instrs.get_value() < INT_MAX) {
+    if (delay_instrs < INT_MAX) {
         MINSERT(bb, instr,
                 XINST_CREATE_cmp(drcontext, OPND_CREATE_ABSMEM(&instr_count, OPSZ_8),
-                                 OPND_CREATE_INT32(op_trace_after_instrs.get_value())));
+                                 OPND_CREATE_INT32(delay_instrs)));
     } else {
         if (drreg_reserve_register(drcontext, bb, instr, NULL, &scratch) != DRREG_SUCCESS)
             FATAL("Fatal error: failed to reserve scratch register");
-        instrlist_insert_mov_immed_ptrsz(drcontext, op_trace_after_instrs.get_value(),
+        instrlist_insert_mov_immed_ptrsz(drcontext, delay_instrs,
                                          opnd_create_reg(scratch), bb, instr, NULL, NULL);
         MINSERT(bb, instr,
                 XINST_CREATE_cmp(drcontext, OPND_CREATE_ABSMEM(&instr_count, OPSZ_8),
@@ -1427,14 +1950,22 @@ init_thread_in_process(void *drcontext)
         const int NUM_OF_TRIES = 10000;
         uint flags = IF_UNIX(DR_FILE_CLOSE_ON_FORK |) DR_FILE_ALLOW_LARGE |
             DR_FILE_WRITE_REQUIRE_NEW;
+        /* After a fork, any stream we have belongs to the parent's file. */
+        if (data->compressor != NULL)
+            raw_compressor_destroy(data->compressor);
+        if (op_raw_compress.get_value() == "gzip" && file_ops_func.handoff_buf == NULL)
+            data->compressor = raw_compressor_create();
         /* We use drx_open_unique_appid_file with DRX_FILE_SKIP_OPEN to get a
          * file name for creation.  Retry if the same name file already exists.
          * Abort if we fail too many times.
          */
         for (i = 0; i < NUM_OF_TRIES; i++) {
             drx_open_unique_appid_file(logsubdir, dr_get_thread_id(drcontext),
-                                       subdir_prefix, OUTFILE_SUFFIX, DRX_FILE_SKIP_OPEN,
-                                       buf, BUFFER_SIZE_ELEMENTS(buf));
+                                       subdir_prefix,
+                                       data->compressor != NULL ? OUTFILE_SUFFIX_GZ
+                                                                : OUTFILE_SUFFIX,
+                                       DRX_FILE_SKIP_OPEN, buf,
+                                       BUFFER_SIZE_ELEMENTS(buf));
             NULL_TERMINATE_BUFFER(buf);
             data->file = file_ops_func.open_file(buf, flags);
             if (data->file != INVALID_FILE)
@@ -1497,12 +2028,17 @@ event_thread_init(void *drcontext)
      */
     data->seg_base = (byte *)dr_get_dr_segment_base(tls_seg);
     DR_ASSERT(data->seg_base != NULL);
+    BUF_WINDOW(data->seg_base) = get_window_id();
 
     if (should_trace_thread_cb != NULL &&
         !(*should_trace_thread_cb)(dr_get_thread_id(drcontext),
                                    trace_thread_cb_user_data))
         BUF_PTR(data->seg_base) = NULL;
     else {
+        if (num_writers > 0) {
+            data->writer_index =
+                (uint)dr_atomic_add32_return_sum(&next_writer, 1) % num_writers;
+        }
         create_buffer(data);
         init_thread_in_process(drcontext);
         // XXX i#1729: gather and store an initial callstack for the thread.
@@ -1525,10 +2061,19 @@ event_thread_exit(void *drcontext)
         BUF_PTR(data->seg_base) += instru->append_thread_exit(
             BUF_PTR(data->seg_base), dr_get_thread_id(drcontext));
 
+        // Our final buffer must land after any still queued to a writer.
+        if (num_writers > 0)
+            writer_reclaim(data);
         memtrace(drcontext, true);
 
-        if (op_offline.get_value())
+        if (op_offline.get_value()) {
+            if (data->compressor != NULL) {
+                if (!raw_compressor_write(data->compressor, data->file, NULL, 0, true))
+                    FATAL("Fatal error: failed to write trace\n");
+                raw_compressor_destroy(data->compressor);
+            }
             file_ops_func.close_file(data->file);
+        }
 
         if (op_L0_filter.get_value()) {
             if (op_L0D_size.get_value() > 0) {
@@ -1569,7 +2114,10 @@ event_exit(void)
     if (op_offline.get_value())
         file_ops_func.close_file(module_file);
     else
-        ipc_pipe.close();
+        ipc_close();
+
+    if (num_writers > 0)
+        writers_exit();
 
     if (file_ops_func.exit_cb != NULL)
         (*file_ops_func.exit_cb)(file_ops_func.exit_arg);
@@ -1579,17 +2127,10 @@ event_exit(void)
 
     drvector_delete(&scratch_reserve_vec);
 
-    if (tracing_enabled) {
-        dr_unregister_filter_syscall_event(event_filter_syscall);
-        if (!drmgr_unregister_pre_syscall_event(event_pre_syscall) ||
-            !drmgr_unregister_kernel_xfer_event(event_kernel_xfer) ||
-            !drmgr_unregister_bb_instrumentation_ex_event(
-                event_bb_app2app, event_bb_analysis, event_app_instruction,
-                event_bb_instru2instru))
-            DR_ASSERT(false);
-    } else {
+    if (tracing_enabled)
+        disable_tracing_instrumentation();
+    else if (delay_enabled)
         disable_delay_instrumentation();
-    }
     if (!drmgr_unregister_tls_field(tls_idx) ||
         !drmgr_unregister_thread_init_event(event_thread_init) ||
         !drmgr_unregister_thread_exit_event(event_thread_exit) ||
@@ -1604,10 +2145,11 @@ event_exit(void)
     should_trace_thread_cb = nullptr;
     trace_thread_cb_user_data = nullptr;
     thread_filtering_enabled = false;
+    tracing_window = -1;
 
     dr_mutex_destroy(mutex);
     drutil_exit();
-    if (op_trace_after_instrs.get_value() > 0)
+    if (op_trace_after_instrs.get_value() > 0 || op_trace_for_instrs.get_value() > 0)
         exit_delay_instrumentation();
     drmgr_exit();
     func_trace_exit();
@@ -1683,10 +2225,83 @@ fork_init(void *drcontext)
             FATAL("Failed to create a subdir in %s\n", op_outdir.get_value().c_str());
         }
     }
+#    ifdef LINUX
+    if (!op_offline.get_value() && op_ipc_shm_size.get_value() > 0) {
+        /* The ring mapping came with us but the simulator must know to wait for us. */
+        if (!ipc_ring.register_writer(dr_get_process_id()))
+            FATAL("Fatal error: failed to register with the shared-memory ring\n");
+    }
+#    endif
+    if (num_writers > 0) {
+        /* The writer threads did not come with us and their locks may have been
+         * held at the fork, so start over.  Any requests still queued belong to
+         * the parent.  We deliberately leak the parent's writer state.
+         */
+        data->pending_writes = 0;
+        writers_init();
+        data->writer_index = 0;
+    }
     init_thread_in_process(drcontext);
 }
 #endif
 
+static void
+init_ipc_pipe()
+{
+    if (!ipc_pipe.set_name(op_ipc_name.get_value().c_str()))
+        DR_ASSERT(false);
+#ifdef UNIX
+    /* we want an isolated fd so we don't use ipc_pipe.open_for_write() */
+    int fd = dr_open_file(ipc_pipe.get_pipe_path().c_str(), DR_FILE_WRITE_ONLY);
+    DR_ASSERT(fd != INVALID_FILE);
+    if (!ipc_pipe.set_fd(fd))
+        DR_ASSERT(false);
+#else
+    if (!ipc_pipe.open_for_write()) {
+        if (GetLastError() == ERROR_PIPE_BUSY) {
+            // FIXME i#1727: add multi-process support to Windows named_pipe_t.
+            FATAL("Fatal error: multi-process applications not yet supported "
+                  "for drcachesim on Windows\n");
+        } else {
+            FATAL("Fatal error: Failed to open pipe %s.\n",
+                  op_ipc_name.get_value().c_str());
+        }
+    }
+#endif
+    if (!ipc_pipe.maximize_buffer())
+        NOTIFY(1, "Failed to maximize pipe buffer: performance may suffer.\n");
+}
+
+static void
+init_ipc_ring()
+{
+#ifdef LINUX
+    if (!ipc_ring.set_name(op_ipc_name.get_value().c_str()))
+        DR_ASSERT(false);
+    /* Like the pipe fd, we want an isolated mapping, so we map the file ourselves
+     * rather than using ipc_ring.open_for_write().
+     */
+    file_t file =
+        dr_open_file(ipc_ring.get_name().c_str(), DR_FILE_READ | DR_FILE_WRITE_APPEND);
+    uint64 file_size;
+    if (file == INVALID_FILE || !dr_file_size(file, &file_size)) {
+        FATAL("Fatal error: Failed to open shared-memory ring %s.\n",
+              ipc_ring.get_name().c_str());
+    }
+    ipc_ring_size = (size_t)file_size;
+    ipc_ring_base = (byte *)dr_map_file(file, &ipc_ring_size, 0, NULL,
+                                        DR_MEMPROT_READ | DR_MEMPROT_WRITE, 0);
+    dr_close_file(file);
+    if (ipc_ring_base == NULL || !ipc_ring.set_region(ipc_ring_base, ipc_ring_size) ||
+        !ipc_ring.register_writer(dr_get_process_id())) {
+        FATAL("Fatal error: Failed to map shared-memory ring %s.\n",
+              ipc_ring.get_name().c_str());
+    }
+#else
+    FATAL("Fatal error: -ipc_shm_size is only supported on Linux.\n");
+#endif
+}
+
 /* We export drmemtrace_client_main so that a global dr_client_main can initialize
  * drmemtrace client by calling drmemtrace_client_main in a statically linked
  * multi-client executable.
@@ -1718,6 +2333,21 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
          (!IS_POWER_OF_2(op_L0D_size.get_value()) && op_L0D_size.get_value() != 0))) {
         FATAL("Usage error: L0I_size and L0D_size must be 0 or powers of 2.");
     }
+    if (op_writer_threads.get_value() > 0 && !op_offline.get_value()) {
+        FATAL("Usage error: -writer_threads requires -offline.");
+    }
+    if (op_raw_compress.get_value() != "none") {
+#ifdef HAS_ZLIB
+        if (op_raw_compress.get_value() != "gzip")
+            FATAL("Usage error: -raw_compress must be \"none\" or \"gzip\".");
+        if (!op_offline.get_value())
+            FATAL("Usage error: -raw_compress requires -offline.");
+#else
+        FATAL("Usage error: -raw_compress requires a build with zlib.");
+#endif
+    }
+    if (op_retrace_every_instrs.get_value() > 0 && op_trace_for_instrs.get_value() == 0)
+        FATAL("Usage error: -retrace_every_instrs requires -trace_for_instrs.");
 
     if (!func_trace_init(append_marker_seg_base))
         DR_ASSERT(false);
@@ -1748,28 +2378,10 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
         buf = dr_global_alloc(MAX_INSTRU_SIZE);
         instru = new (buf) online_instru_t(insert_load_buf_ptr, op_L0_filter.get_value(),
                                            &scratch_reserve_vec);
-        if (!ipc_pipe.set_name(op_ipc_name.get_value().c_str()))
-            DR_ASSERT(false);
-#ifdef UNIX
-        /* we want an isolated fd so we don't use ipc_pipe.open_for_write() */
-        int fd = dr_open_file(ipc_pipe.get_pipe_path().c_str(), DR_FILE_WRITE_ONLY);
-        DR_ASSERT(fd != INVALID_FILE);
-        if (!ipc_pipe.set_fd(fd))
-            DR_ASSERT(false);
-#else
-        if (!ipc_pipe.open_for_write()) {
-            if (GetLastError() == ERROR_PIPE_BUSY) {
-                // FIXME i#1727: add multi-process support to Windows named_pipe_t.
-                FATAL("Fatal error: multi-process applications not yet supported "
-                      "for drcachesim on Windows\n");
-            } else {
-                FATAL("Fatal error: Failed to open pipe %s.\n",
-                      op_ipc_name.get_value().c_str());
-            }
-        }
-#endif
-        if (!ipc_pipe.maximize_buffer())
-            NOTIFY(1, "Failed to maximize pipe buffer: performance may suffer.\n");
+        if (op_ipc_shm_size.get_value() > 0)
+            init_ipc_ring();
+        else
+            init_ipc_pipe();
     }
 
     /* We need an extra for -L0_filter. */
@@ -1788,8 +2400,10 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
         !drmgr_register_thread_exit_event(event_thread_exit))
         DR_ASSERT(false);
 
+    if (op_trace_after_instrs.get_value() > 0 || op_trace_for_instrs.get_value() > 0)
+        init_delay_instrumentation();
     if (op_trace_after_instrs.get_value() > 0)
-        enable_delay_instrumentation();
+        enable_delay_instrumentation(op_trace_after_instrs.get_value());
     else
         enable_tracing_instrumentation();
 
@@ -1814,12 +2428,18 @@ drmemtrace_client_main(client_id_t id, int argc, const char *argv[])
     /* Mark any padding as redzone as well */
     redzone_size = max_buf_size - trace_buf_size;
     /* Append a throwaway header to get its size. */
-    buf_hdr_slots_size = instru->append_unit_header(buf, 0 /*doesn't matter*/);
+    buf_hdr_slots_size =
+        instru->append_unit_header(buf, 0 /*doesn't matter*/, get_window_id());
     DR_ASSERT(BUFFER_SIZE_BYTES(buf) >= buf_hdr_slots_size);
 
     client_id = id;
     mutex = dr_mutex_create();
 
+    // A handoff callback takes over buffer ownership itself, so writer threads
+    // have nothing to do there.
+    if (op_writer_threads.get_value() > 0 && file_ops_func.handoff_buf == NULL)
+        writers_init();
+
     tls_idx = drmgr_register_tls_field();
     DR_ASSERT(tls_idx != -1);
     /* The TLS field provided by DR cannot be directly accessed from the code cache.
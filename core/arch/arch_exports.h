@@ -1011,6 +1011,31 @@ atomic_add_exchange_int64(volatile int64 *var, int64 value)
 #    define ATOMIC_ADDR_WRITE ATOMIC_4BYTE_WRITE
 #endif
 
+/* Pointer-sized load and store for publishing a value to lock-free readers: no
+ * access after the acquire load can be reordered before it, and no access before
+ * the release store can be reordered after it.  MSVC gives volatile accesses these
+ * semantics on x86.
+ */
+static inline ptr_uint_t
+atomic_aligned_read_ptr_acquire(volatile ptr_uint_t *var)
+{
+#ifdef UNIX
+    return __atomic_load_n(var, __ATOMIC_ACQUIRE);
+#else
+    return *var;
+#endif
+}
+
+static inline void
+atomic_aligned_write_ptr_release(volatile ptr_uint_t *var, ptr_uint_t val)
+{
+#ifdef UNIX
+    __atomic_store_n(var, val, __ATOMIC_RELEASE);
+#else
+    *var = val;
+#endif
+}
+
 #define ATOMIC_MAX_int(type, maxvar, curvar)                                        \
     do {                                                                            \
         type atomic_max__maxval;                                                    \
@@ -844,6 +844,7 @@ dynamorio_fork_init(dcontext_t *dcontext)
      * on a fork -- probably everyone who makes a log file on init.
      */
     fragment_fork_init(dcontext);
+    monitor_fork_init(dcontext);
     /* this must be called after dynamo_other_thread_exit() above */
     signal_fork_init(dcontext);
 
@@ -1422,7 +1423,7 @@ dynamo_process_exit(void)
      * Note that windows prof_pcs duplicates the thread walk in d_r_os_exit()
      * FIXME: should combine that thread walk with this one
      */
-    each_thread = TRACEDUMP_ENABLED();
+    each_thread = TRACEDUMP_ENABLED() || DYNAMO_OPTION(trace_profile);
 #    ifdef UNIX
     each_thread = each_thread || INTERNAL_OPTION(profile_pcs);
 #    endif
@@ -1471,6 +1472,8 @@ dynamo_process_exit(void)
                  */
                 fragment_thread_exit(threads[i]->dcontext);
             }
+            if (DYNAMO_OPTION(trace_profile))
+                monitor_thread_profile_exit(threads[i]->dcontext);
 #    ifdef UNIX
             if (INTERNAL_OPTION(profile_pcs))
                 pcprofile_thread_exit(threads[i]->dcontext);
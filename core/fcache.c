@@ -527,6 +527,9 @@ typedef struct _fcache {
 typedef struct _fcache_thread_units_t {
     fcache_t *bb;    /* basic block fcache */
     fcache_t *trace; /* trace fcache */
+    /* -hot_trace_cache trace fcache, and whether new traces go there */
+    fcache_t *hot_trace;
+    bool place_hot;
     /* we delay unmapping units, but only one at a time: */
     cache_pc pending_unmap_pc;
     size_t pending_unmap_size;
@@ -586,6 +589,10 @@ DECLARE_CXTSWPROT_VAR(static mutex_t unit_flush_lock, INIT_LOCK_FREE(unit_flush_
 
 static fcache_t *shared_cache_bb;
 static fcache_t *shared_cache_trace;
+/* For -hot_trace_cache, keeps the traces of the hottest heads packed together,
+ * away from the bulk of the trace cache.
+ */
+static fcache_t *shared_cache_hot_trace;
 
 /* To locate the fcache_unit_t corresponding to a fragment or empty slot
  * we use an interval data structure rather than waste space with a
@@ -851,6 +858,12 @@ fcache_reset_init(void)
         ASSERT(shared_cache_trace != NULL);
         LOG(GLOBAL, LOG_CACHE, 1, "Initial shared trace cache is %d KB\n",
             shared_cache_trace->init_unit_size / 1024);
+        if (DYNAMO_OPTION(hot_trace_cache)) {
+            shared_cache_hot_trace =
+                fcache_cache_init(GLOBAL_DCONTEXT, FRAG_SHARED | FRAG_IS_TRACE, true);
+            ASSERT(shared_cache_hot_trace != NULL);
+            DODEBUG({ shared_cache_hot_trace->name = "Hot trace (shared)"; });
+        }
     }
 }
 
@@ -1002,6 +1015,13 @@ fcache_stats_exit()
             fcache_cache_stats(GLOBAL_DCONTEXT, cache);
             PROTECT_CACHE(cache, unlock);
         }
+        cache = shared_cache_hot_trace;
+        if (cache != NULL) {
+            ASSERT_DO_NOT_OWN_MUTEX(cache->is_shared, &cache->lock);
+            PROTECT_CACHE(cache, lock);
+            fcache_cache_stats(GLOBAL_DCONTEXT, cache);
+            PROTECT_CACHE(cache, unlock);
+        }
     }
 }
 #endif
@@ -1035,6 +1055,10 @@ fcache_reset_free(void)
     if (DYNAMO_OPTION(shared_traces)) {
         fcache_cache_free(GLOBAL_DCONTEXT, shared_cache_trace, true);
         shared_cache_trace = NULL;
+        if (shared_cache_hot_trace != NULL) {
+            fcache_cache_free(GLOBAL_DCONTEXT, shared_cache_hot_trace, true);
+            shared_cache_hot_trace = NULL;
+        }
     }
 
     /* there may be units stranded on the to-flush list.
@@ -2127,6 +2151,8 @@ fcache_thread_init(dcontext_t *dcontext)
      * idle threads that never do much
      */
     tu->trace = NULL;
+    tu->hot_trace = NULL;
+    tu->place_hot = false;
     /* in fact, let's delay both, cost is single conditional in fcache_add_fragment,
      * once we have that conditional for traces it's no extra cost for bbs
      */
@@ -2185,6 +2211,8 @@ fcache_thread_exit_stats(dcontext_t *dcontext)
             fcache_cache_stats(dcontext, tu->bb);
         if (tu->trace != NULL)
             fcache_cache_stats(dcontext, tu->trace);
+        if (tu->hot_trace != NULL)
+            fcache_cache_stats(dcontext, tu->hot_trace);
     });
 }
 #endif
@@ -2212,6 +2240,10 @@ fcache_thread_reset_free(dcontext_t *dcontext)
         fcache_cache_free(dcontext, tu->trace, true);
         tu->trace = NULL;
     }
+    if (tu->hot_trace != NULL) {
+        fcache_cache_free(dcontext, tu->hot_trace, true);
+        tu->hot_trace = NULL;
+    }
 }
 
 void
@@ -3610,14 +3642,26 @@ get_cache_for_new_fragment(dcontext_t *dcontext, fragment_t *f)
             ASSERT(((fcache_t *)info->cache)->coarse_info == info);
             return (fcache_t *)info->cache;
         } else {
-            if (IN_TRACE_CACHE(f->flags))
+            if (IN_TRACE_CACHE(f->flags)) {
+                if (tu->place_hot && shared_cache_hot_trace != NULL &&
+                    TEST(FRAG_IS_TRACE, f->flags))
+                    return shared_cache_hot_trace;
                 return shared_cache_trace;
+            }
             else
                 return shared_cache_bb;
         }
     } else {
         /* thread-private caches are delayed */
         if (IN_TRACE_CACHE(f->flags)) {
+            if (tu->place_hot && TEST(FRAG_IS_TRACE, f->flags)) {
+                if (tu->hot_trace == NULL) {
+                    tu->hot_trace = fcache_cache_init(dcontext, FRAG_IS_TRACE, true);
+                    ASSERT(tu->hot_trace != NULL);
+                    DODEBUG({ tu->hot_trace->name = "Hot trace (private)"; });
+                }
+                return tu->hot_trace;
+            }
             if (tu->trace == NULL) {
                 tu->trace = fcache_cache_init(dcontext, FRAG_IS_TRACE, true);
                 ASSERT(tu->trace != NULL);
@@ -3691,6 +3735,14 @@ fcache_add_fragment(dcontext_t *dcontext, fragment_t *f)
     PROTECT_CACHE(cache, unlock);
 }
 
+void
+fcache_set_hot_placement(dcontext_t *dcontext, bool hot)
+{
+    fcache_thread_units_t *tu = (fcache_thread_units_t *)dcontext->fcache_field;
+    ASSERT(!hot || DYNAMO_OPTION(hot_trace_cache));
+    tu->place_hot = hot;
+}
+
 void
 fcache_remove_fragment(dcontext_t *dcontext, fragment_t *f)
 {
@@ -4110,6 +4162,8 @@ fcache_flush_all_caches()
     }
     if (DYNAMO_OPTION(shared_traces)) {
         fcache_mark_units_for_free(dcontext, shared_cache_trace);
+        if (shared_cache_hot_trace != NULL)
+            fcache_mark_units_for_free(dcontext, shared_cache_hot_trace);
     }
     /* FIXME: for thread-private units, should use a trigger in
      * vm_area_flush_fragments() to call a routine here that frees all but
@@ -4514,6 +4568,8 @@ fcache_low_on_memory()
         fcache_reset_cache(dcontext, tu->bb);
     if (tu->trace != NULL)
         fcache_reset_cache(dcontext, tu->trace);
+    if (tu->hot_trace != NULL)
+        fcache_reset_cache(dcontext, tu->hot_trace);
 #endif
 
     /* now free the entire dead list (including thread units just moved here) */
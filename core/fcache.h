@@ -117,6 +117,11 @@ fcache_thread_exit(dcontext_t *dcontext);
 
 void
 fcache_add_fragment(dcontext_t *dcontext, fragment_t *f);
+/* For -hot_trace_cache: while hot is set, traces added by this thread go to the
+ * dedicated hot trace cache.
+ */
+void
+fcache_set_hot_placement(dcontext_t *dcontext, bool hot);
 void
 fcache_shift_start_pc(dcontext_t *dcontext, fragment_t *f, uint space);
 void
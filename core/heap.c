@@ -1182,6 +1182,22 @@ vmcode_get_end(void)
     return NULL;
 }
 
+/* Returns the percentage of the code cache reservation that is in use, or 0
+ * if there is no reservation.  Reads without the vmh lock: only meant for
+ * heuristics.
+ */
+uint
+vmcode_percent_used(void)
+{
+    vm_heap_t *vmh = &heapmgt->vmcode;
+    if (vmh->start_addr == NULL)
+        vmh = &heapmgt->vmheap;
+    if (vmh->num_blocks == 0)
+        return 0;
+    return (uint)(100 * (uint64)(vmh->num_blocks - vmh->num_free_blocks) /
+                  vmh->num_blocks);
+}
+
 static vm_heap_t *
 vmheap_for_which(which_vmm_t which)
 {
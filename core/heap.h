@@ -139,6 +139,8 @@ byte *
 vmcode_get_start();
 byte *
 vmcode_get_end();
+uint
+vmcode_percent_used(void);
 void
 iterate_vmm_regions(void (*cb)(byte *region_start, byte *region_end, void *user_data),
                     void *user_data);
@@ -7702,6 +7702,22 @@ dr_get_stats(dr_stats_t *drstats)
  * PERSISTENCE
  */
 
+/* Returns a hash of the paths of the clients in use, in priority order, for
+ * inclusion in persisted cache file names.  Returns 0 if there are no clients.
+ */
+uint
+instrument_persist_client_hash(void)
+{
+    uint hash = 0;
+    size_t i;
+    for (i = 0; i < num_client_libs; i++) {
+        /* rotate so that the order matters */
+        hash = ((hash << 7) | (hash >> 25)) ^
+            d_r_crc32(client_libs[i].path, (uint)strlen(client_libs[i].path));
+    }
+    return hash;
+}
+
 /* Up to caller to synchronize. */
 uint
 instrument_persist_ro_size(dcontext_t *dcontext, void *perscxt, size_t file_offs)
@@ -7719,10 +7735,9 @@ instrument_persist_ro_size(dcontext_t *dcontext, void *perscxt, size_t file_offs
      * XXX: we could go further and store client library checksum, etc. hashes,
      * but that precludes clients from doing their own proper versioning.
      *
-     * XXX: we could also put the set of clients into the pcache namespace to allow
-     * simultaneous use of pcaches with different sets of clients (empty set
-     * vs under tool, in particular): but doesn't really seem useful enough
-     * for the trouble
+     * The set of clients is also part of the pcache namespace (see
+     * instrument_persist_client_hash()) to allow simultaneous use of pcaches
+     * with different sets of clients (empty set vs under tool, in particular).
      */
     for (i = 0; i < num_client_libs; i++) {
         sz += strlen(client_libs[i].path) + 1 /*NULL*/;
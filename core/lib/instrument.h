@@ -188,6 +188,8 @@ hide_tag_from_client(app_pc tag);
 bool
 should_track_where_am_i(void);
 
+uint
+instrument_persist_client_hash(void);
 uint
 instrument_persist_ro_size(dcontext_t *dcontext, void *perscxt, size_t file_offs);
 bool
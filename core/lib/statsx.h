@@ -412,6 +412,9 @@ STATS_DEF("Trace head too large to be a trace", num_huge_fragments)
 STATS_DEF("Shared trace links shifted back to trace head", links_shared_trace_to_head)
 STATS_DEF("Shadowed trace head deleted", shadowed_trace_head_deleted)
 STATS_DEF("Trace head counters reset on trace deletion", th_counter_reset)
+STATS_DEF("Region trace thresholds lowered", trace_threshold_lowered)
+STATS_DEF("Region trace thresholds raised", trace_threshold_raised)
+STATS_DEF("Traces emitted into the hot trace cache", num_hot_traces)
 STATS_DEF("Trace heads re-marked", trace_head_remark)
 STATS_DEF("Future fragments generated", num_future_fragments)
 STATS_DEF("Shared fragments generated", num_shared_fragments)
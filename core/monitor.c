@@ -96,6 +96,18 @@ mangle_trace(dcontext_t *dcontext, instrlist_t *ilist, monitor_data_t *md);
          ? global_unprotected_heap_free(p, __VA_ARGS__) \
          : heap_free(dc, p, __VA_ARGS__))
 
+/* -adaptive_trace_threshold and -trace_profile group trace heads into aligned
+ * regions of this size.
+ */
+#define TRACE_REGION_SIZE (64 * 1024)
+/* A head that becomes hot within HOT_FACTOR times the threshold trace head hits
+ * of its thread dominates execution; one that needs more than COLD_FACTOR times
+ * the threshold is competing with many others.  -hot_trace_cache uses the same
+ * HOT_FACTOR test to pick its traces.
+ */
+#define TRACE_REGION_HOT_FACTOR 2
+#define TRACE_REGION_COLD_FACTOR 16
+
 static void
 reset_trace_state(dcontext_t *dcontext, bool grab_link_lock);
 
@@ -105,7 +117,10 @@ DECLARE_CXTSWPROT_VAR(mutex_t trace_building_lock, INIT_LOCK_FREE(trace_building
 /* For clearing counters on trace deletion we follow a lazy strategy
  * using a sentinel value to determine whether we've built a trace or not
  */
-#define TH_COUNTER_CREATED_TRACE_VALUE() (INTERNAL_OPTION(trace_threshold) + 1U)
+#define TH_COUNTER_CREATED_TRACE_VALUE()                                            \
+    ((DYNAMO_OPTION(adaptive_trace_threshold) ? DYNAMO_OPTION(trace_threshold_max)  \
+                                              : INTERNAL_OPTION(trace_threshold)) + \
+     1U)
 
 static void
 delete_private_copy(dcontext_t *dcontext)
@@ -344,6 +359,18 @@ thcounter_free(dcontext_t *dcontext, void *p)
     COUNTER_FREE(dcontext, p, sizeof(trace_head_counter_t) HEAPACCT(ACCT_THCOUNTER));
 }
 
+static void
+tregion_free(dcontext_t *dcontext, void *p)
+{
+    COUNTER_FREE(dcontext, p, sizeof(trace_region_t) HEAPACCT(ACCT_THCOUNTER));
+}
+
+static void
+tprofile_free(dcontext_t *dcontext, void *p)
+{
+    COUNTER_FREE(dcontext, p, sizeof(trace_profile_t) HEAPACCT(ACCT_THCOUNTER));
+}
+
 void
 monitor_thread_init(dcontext_t *dcontext)
 {
@@ -370,6 +397,92 @@ monitor_thread_init(dcontext_t *dcontext)
          */
         HASHTABLE_PERSISTENT, thcounter_free _IF_DEBUG("trace heads"));
     md->thead_table->hash_func = HASH_FUNCTION_MULTIPLY_PHI;
+
+    if (DYNAMO_OPTION(adaptive_trace_threshold) || DYNAMO_OPTION(trace_profile)) {
+        md->region_table = generic_hash_create(
+            dcontext, INIT_COUNTER_TABLE_SIZE, COUNTER_TABLE_LOAD, HASHTABLE_PERSISTENT,
+            tregion_free _IF_DEBUG("trace regions"));
+    }
+    if (DYNAMO_OPTION(trace_profile)) {
+        md->tprof_file = open_log_file("traceprof", NULL, 0);
+        md->tprof_table = generic_hash_create(
+            dcontext, INIT_COUNTER_TABLE_SIZE, COUNTER_TABLE_LOAD, HASHTABLE_PERSISTENT,
+            tprofile_free _IF_DEBUG("trace profiles"));
+    }
+}
+
+#ifdef UNIX
+void
+monitor_fork_init(dcontext_t *dcontext)
+{
+    monitor_data_t *md = (monitor_data_t *)dcontext->monitor_field;
+    trace_region_t *region;
+    int iter;
+    if (md->tprof_table == NULL)
+        return;
+    /* The parent reports what it ran: start over with a new log file, keeping
+     * only the region thresholds.
+     */
+    md->tprof_file = open_log_file("traceprof", NULL, 0);
+    generic_hash_clear(dcontext, md->tprof_table);
+    for (iter = 0; (iter = generic_hash_iterate_next(dcontext, md->region_table, iter,
+                                                     NULL, (void **)&region)) >= 0;) {
+        region->num_heads = 0;
+        region->num_traces = 0;
+        region->head_hits = 0;
+    }
+}
+#endif
+
+/* Writes out the -trace_profile data of dcontext's thread.  Only trace exits to
+ * DR are counted, as linked exits never leave the cache: a trace whose exits are
+ * mostly taken here is not paying for itself.
+ */
+void
+monitor_thread_profile_exit(dcontext_t *dcontext)
+{
+    monitor_data_t *md = (monitor_data_t *)dcontext->monitor_field;
+    trace_region_t *region;
+    trace_profile_t *tp;
+    uint64 head_hits = 0, exits = 0;
+    uint heads = 0, traces = 0;
+    int iter;
+    if (md == NULL || md->tprof_table == NULL)
+        return;
+    for (iter = 0; (iter = generic_hash_iterate_next(dcontext, md->region_table, iter,
+                                                     NULL, (void **)&region)) >= 0;) {
+        head_hits += region->head_hits;
+        heads += region->num_heads;
+        traces += region->num_traces;
+    }
+    for (iter = 0; (iter = generic_hash_iterate_next(dcontext, md->tprof_table, iter,
+                                                     NULL, (void **)&tp)) >= 0;)
+        exits += tp->num_exits;
+    print_file(md->tprof_file, "Trace selection profile for thread " TIDFMT "\n",
+               dcontext->owning_thread);
+    print_file(md->tprof_file,
+               "%u trace heads, " UINT64_FORMAT_STRING " head hits, %u traces started, "
+               UINT64_FORMAT_STRING " trace exits to DR\n",
+               heads, head_hits, traces, exits);
+    print_file(md->tprof_file, "\nRegions:\n%18s %9s %9s %12s %9s\n", "start",
+               "threshold", "heads", "head hits", "traces");
+    for (iter = 0; (iter = generic_hash_iterate_next(dcontext, md->region_table, iter,
+                                                     NULL, (void **)&region)) >= 0;) {
+        print_file(md->tprof_file, PFX " %9u %9u %12" UINT64_FORMAT_CODE " %9u\n",
+                   region->start, region->threshold, region->num_heads,
+                   region->head_hits, region->num_traces);
+    }
+    print_file(md->tprof_file, "\nTraces:\n%18s %6s %7s %6s %12s\n", "tag", "bbs",
+               "size", "builds", "exits to DR");
+    for (iter = 0; (iter = generic_hash_iterate_next(dcontext, md->tprof_table, iter,
+                                                     NULL, (void **)&tp)) >= 0;) {
+        print_file(md->tprof_file, PFX " %6u %7u %6u %12" UINT64_FORMAT_CODE "\n",
+                   tp->tag, tp->num_bbs, tp->size, tp->num_builds, tp->num_exits);
+    }
+    close_log_file(md->tprof_file);
+    md->tprof_file = INVALID_FILE;
+    generic_hash_destroy(dcontext, md->tprof_table);
+    md->tprof_table = NULL;
 }
 
 /* atexit cleanup */
@@ -385,6 +498,7 @@ monitor_thread_exit(dcontext_t *dcontext)
      * can never be built from that particular trace head.
      */
     trace_abort(dcontext);
+    monitor_thread_profile_exit(dcontext);
 #ifdef DEBUG
     if (md->trace_buf != NULL) {
         heap_reachable_free(dcontext, md->trace_buf,
@@ -396,6 +510,8 @@ monitor_thread_exit(dcontext_t *dcontext)
     }
     if (md->thead_table != NULL)
         generic_hash_destroy(dcontext, md->thead_table);
+    if (md->region_table != NULL)
+        generic_hash_destroy(dcontext, md->region_table);
     heap_free(dcontext, md, sizeof(monitor_data_t) HEAPACCT(ACCT_TRACE));
 #endif
 }
@@ -408,6 +524,23 @@ thcounter_lookup(dcontext_t *dcontext, app_pc tag)
                                                        (ptr_uint_t)tag);
 }
 
+static trace_region_t *
+trace_region_lookup_add(dcontext_t *dcontext, app_pc tag)
+{
+    monitor_data_t *md = (monitor_data_t *)dcontext->monitor_field;
+    app_pc start = (app_pc)ALIGN_BACKWARD(tag, TRACE_REGION_SIZE);
+    trace_region_t *r = (trace_region_t *)generic_hash_lookup(
+        dcontext, md->region_table, (ptr_uint_t)start);
+    if (r == NULL) {
+        r = COUNTER_ALLOC(dcontext, sizeof(trace_region_t) HEAPACCT(ACCT_THCOUNTER));
+        memset(r, 0, sizeof(*r));
+        r->start = start;
+        r->threshold = INTERNAL_OPTION(trace_threshold);
+        generic_hash_add(dcontext, md->region_table, (ptr_uint_t)start, r);
+    }
+    return r;
+}
+
 static trace_head_counter_t *
 thcounter_add(dcontext_t *dcontext, app_pc tag)
 {
@@ -418,11 +551,70 @@ thcounter_add(dcontext_t *dcontext, app_pc tag)
                           sizeof(trace_head_counter_t) HEAPACCT(ACCT_THCOUNTER));
         e->tag = tag;
         e->counter = 0;
+        e->start_clock = md->thead_clock;
         generic_hash_add(dcontext, md->thead_table, (ptr_uint_t)tag, e);
+        if (md->region_table != NULL)
+            trace_region_lookup_add(dcontext, tag)->num_heads++;
     }
     return e;
 }
 
+/* Called when a trace head in region becomes hot.  The trace head hits in this
+ * thread since the head started counting tell how much of the execution the head
+ * accounts for: one that collected its hits in a short window is in a hot loop,
+ * so we lower the region's threshold to build its traces sooner, while one that
+ * took long to warm up is in code too lukewarm to be worth traces, so we raise it.
+ * Under code cache pressure we only raise.
+ */
+static void
+trace_region_adapt(dcontext_t *dcontext, trace_region_t *region,
+                   trace_head_counter_t *ctr)
+{
+    monitor_data_t *md = (monitor_data_t *)dcontext->monitor_field;
+    uint elapsed = md->thead_clock - ctr->start_clock;
+    uint old_threshold = region->threshold;
+    region->num_traces++;
+    if (!DYNAMO_OPTION(adaptive_trace_threshold))
+        return;
+    if (vmcode_percent_used() >= DYNAMO_OPTION(adaptive_trace_pressure) ||
+        elapsed > TRACE_REGION_COLD_FACTOR * old_threshold) {
+        region->threshold = MIN(2 * old_threshold, DYNAMO_OPTION(trace_threshold_max));
+    } else if (elapsed <= TRACE_REGION_HOT_FACTOR * old_threshold) {
+        region->threshold = MAX(old_threshold / 2, DYNAMO_OPTION(trace_threshold_min));
+    }
+    if (region->threshold != old_threshold) {
+        LOG(THREAD, LOG_MONITOR, 2,
+            "Trace threshold for region " PFX " %s from %d to %d (head hot after "
+            "%d head hits)\n",
+            region->start, region->threshold > old_threshold ? "raised" : "lowered",
+            old_threshold, region->threshold, elapsed);
+        DOSTATS({
+            if (region->threshold > old_threshold)
+                STATS_INC(trace_threshold_raised);
+            else
+                STATS_INC(trace_threshold_lowered);
+        });
+    }
+}
+
+static trace_profile_t *
+trace_profile_lookup_add(dcontext_t *dcontext, fragment_t *f)
+{
+    monitor_data_t *md = (monitor_data_t *)dcontext->monitor_field;
+    trace_profile_t *tp = (trace_profile_t *)generic_hash_lookup(
+        dcontext, md->tprof_table, (ptr_uint_t)f->tag);
+    if (tp == NULL) {
+        tp = COUNTER_ALLOC(dcontext, sizeof(trace_profile_t) HEAPACCT(ACCT_THCOUNTER));
+        memset(tp, 0, sizeof(*tp));
+        tp->tag = f->tag;
+        generic_hash_add(dcontext, md->tprof_table, (ptr_uint_t)f->tag, tp);
+    }
+    /* A rebuilt trace, or one built by another thread, may differ. */
+    tp->num_bbs = TRACE_FIELDS(f)->num_bbs;
+    tp->size = f->size;
+    return tp;
+}
+
 /* Deletes all trace head entries in [start,end) */
 void
 thcounter_range_remove(dcontext_t *dcontext, app_pc start, app_pc end)
@@ -531,6 +723,7 @@ reset_trace_state(dcontext_t *dcontext, bool grab_link_lock)
     md->trace_tag = NULL; /* indicate return to search mode */
     md->trace_flags = 0;
     md->emitted_size = 0;
+    md->trace_hot = false;
     /* flags may not match, e.g., if frag was marked as trace head */
     ASSERT(md->last_fragment == NULL ||
            (md->last_fragment_flags & (FRAG_CANNOT_DELETE | FRAG_LINKED_OUTGOING)) ==
@@ -1486,6 +1679,8 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
     ASSERT(md->trace_tag == tag);
 
     /* emit trace fragment into fcache with tag value */
+    if (md->trace_hot)
+        fcache_set_hot_placement(dcontext, true);
     if (replace_trace_head) {
 #ifndef CUSTOM_TRACES
         ASSERT(TEST(FRAG_SHARED, md->trace_flags));
@@ -1497,6 +1692,10 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
                                 true /*link*/);
     }
     ASSERT(trace_f != NULL);
+    if (md->trace_hot) {
+        fcache_set_hot_placement(dcontext, false);
+        STATS_INC(num_hot_traces);
+    }
     /* our estimate should be conservative
      * if externally mangled, all bets are off for now --
      * FIXME: would be nice to gracefully handle opt or client
@@ -1519,6 +1718,8 @@ end_and_emit_trace(dcontext_t *dcontext, fragment_t *cur_f)
         md->num_blks * sizeof(trace_bb_info_t) HEAPACCT(ACCT_TRACE));
     for (i = 0; i < md->num_blks; i++)
         trace_tr->bbs[i] = md->blk_info[i].info;
+    if (md->tprof_table != NULL)
+        trace_profile_lookup_add(dcontext, trace_f)->num_builds++;
 
     if (TEST(FRAG_SHARED, md->trace_flags))
         d_r_mutex_unlock(&trace_building_lock);
@@ -1848,6 +2049,9 @@ monitor_cache_exit(dcontext_t *dcontext)
             (TEST(FRAG_IS_TRACE, dcontext->last_fragment->flags) &&
              TEST(LINK_NI_SYSCALL, dcontext->last_exit->flags));
     }
+    if (md->tprof_table != NULL && TEST(FRAG_IS_TRACE, dcontext->last_fragment->flags) &&
+        !TEST(FRAG_FAKE, dcontext->last_fragment->flags))
+        trace_profile_lookup_add(dcontext, dcontext->last_fragment)->num_exits++;
     dcontext->whereami = DR_WHERE_DISPATCH;
 }
 
@@ -1895,6 +2099,8 @@ monitor_cache_enter(dcontext_t *dcontext, fragment_t *f)
     dr_custom_trace_action_t client = CUSTOM_TRACE_DR_DECIDES;
 #endif
     trace_head_counter_t *ctr;
+    trace_region_t *region = NULL;
+    uint threshold = INTERNAL_OPTION(trace_threshold);
     uint add_size = 0, prev_mangle_size = 0; /* NOTE these aren't set if end_trace */
 
     if (DYNAMO_OPTION(disable_traces) || f == NULL) {
@@ -2170,6 +2376,12 @@ monitor_cache_enter(dcontext_t *dcontext, fragment_t *f)
     if (ctr == NULL)
         ctr = thcounter_add(dcontext, f->tag);
     ASSERT(ctr != NULL);
+    md->thead_clock++;
+    if (md->region_table != NULL) {
+        region = trace_region_lookup_add(dcontext, f->tag);
+        region->head_hits++;
+        threshold = region->threshold;
+    }
 
     if (ctr->counter == TH_COUNTER_CREATED_TRACE_VALUE()) {
         /* trace_t head counter values are persistent, so we do not remove them on
@@ -2181,12 +2393,15 @@ monitor_cache_enter(dcontext_t *dcontext, fragment_t *f)
          * sentinel value.
          */
         ctr->counter = INTERNAL_OPTION(trace_counter_on_delete);
+        ctr->start_clock = md->thead_clock;
         STATS_INC(th_counter_reset);
     }
 
     ctr->counter++;
-    /* Should never be > here (assert is down below) but we check just in case */
-    if (ctr->counter >= INTERNAL_OPTION(trace_threshold)) {
+    /* Should never be > here (assert is down below) unless an adaptive
+     * threshold was lowered, but we check just in case
+     */
+    if (ctr->counter >= threshold) {
         /* if cannot delete fragment, do not start trace -- wait until
          * can delete it (w/ exceptions, deletion status changes). */
         if (!TEST(FRAG_CANNOT_DELETE, f->flags)) {
@@ -2214,13 +2429,12 @@ monitor_cache_enter(dcontext_t *dcontext, fragment_t *f)
             }
         }
         if (!start_trace) {
-            /* Back up the counter by one. This ensures that the
-             * counter will be == trace_threshold if this thread is later
+            /* Back up the counter to just below the threshold. This ensures
+             * that the counter will be == threshold if this thread is later
              * able to start building a trace w/this tag and ensures
              * that our one-up sentinel works for lazy clearing.
              */
-            ctr->counter--;
-            ASSERT(ctr->counter < INTERNAL_OPTION(trace_threshold));
+            ctr->counter = threshold - 1;
         }
     }
 
@@ -2259,8 +2473,15 @@ monitor_cache_enter(dcontext_t *dcontext, fragment_t *f)
     if (start_trace) {
         KSTART(trace_building);
         /* ensure our sentinel counter value for counter clearing will work */
-        ASSERT(ctr->counter == INTERNAL_OPTION(trace_threshold));
+        ASSERT(ctr->counter == threshold ||
+               (DYNAMO_OPTION(adaptive_trace_threshold) && ctr->counter > threshold));
         ctr->counter = TH_COUNTER_CREATED_TRACE_VALUE();
+        if (region != NULL)
+            trace_region_adapt(dcontext, region, ctr);
+        if (DYNAMO_OPTION(hot_trace_cache)) {
+            md->trace_hot = (md->thead_clock - ctr->start_clock <=
+                             TRACE_REGION_HOT_FACTOR * threshold);
+        }
         /* Found a hot trace head.  Switch this thread into trace
            selection mode, and initialize the instrlist_t for the new
            trace fragment with this block fragment.  Leave the
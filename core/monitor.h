@@ -55,6 +55,10 @@ void
 monitor_thread_init(dcontext_t *dcontext);
 void
 monitor_thread_exit(dcontext_t *dcontext);
+#ifdef UNIX
+void
+monitor_fork_init(dcontext_t *dcontext);
+#endif
 
 /* re-initializes non-persistent memory */
 void
@@ -124,6 +128,10 @@ thcounter_range_remove(dcontext_t *dcontext, app_pc start, app_pc end);
 bool
 mangle_trace_at_end(void);
 
+/* Writes out and frees the -trace_profile data of a thread. */
+void
+monitor_thread_profile_exit(dcontext_t *dcontext);
+
 /* trace head counters are thread-private and must be kept in a
  * separate table and not in the fragment_t structure.
  * FIXME: may want to do this for non-shared-cache, since persistent counters
@@ -135,8 +143,32 @@ mangle_trace_at_end(void);
 typedef struct _trace_head_counter_t {
     app_pc tag;
     uint counter;
+    /* monitor_data_t.thead_clock when counter last started from 0 or from
+     * -trace_counter_on_delete, for -adaptive_trace_threshold
+     */
+    uint start_clock;
 } trace_head_counter_t;
 
+/* Trace selection state for an aligned region of app code, kept per thread for
+ * -adaptive_trace_threshold and -trace_profile.
+ */
+typedef struct _trace_region_t {
+    app_pc start;
+    uint threshold;  /* current trace head threshold for the region */
+    uint num_heads;  /* trace heads counted in the region */
+    uint num_traces; /* traces started from heads in the region */
+    uint64 head_hits;
+} trace_region_t;
+
+/* Per-trace counts for -trace_profile. */
+typedef struct _trace_profile_t {
+    app_pc tag;
+    uint num_bbs;
+    uint size;
+    uint num_builds; /* > 1 means the trace was deleted and rebuilt */
+    uint64 num_exits; /* exits to DR, i.e., unlinked exits and ibl misses */
+} trace_profile_t;
+
 typedef struct _trace_bb_build_t {
     trace_bb_info_t info;
     /* PR 299808: we need to check bb bounds at emit time.  Also used
@@ -167,6 +199,7 @@ typedef struct _monitor_data_t {
     trace_bb_build_t *blk_info; /* info for all basic blocks making up trace */
     uint blk_info_length;       /* length of blk_info array */
     uint emitted_size;          /* calculated final trace size once emitted */
+    bool trace_hot;             /* emit into the -hot_trace_cache cache */
 
     /* private copy of shared bb for trace building only
      * equals the previous last_fragment that was shared
@@ -179,6 +212,13 @@ typedef struct _monitor_data_t {
      * separate table and not in the fragment_t structure.
      */
     generic_table_t *thead_table;
+    /* Counts trace head hits, as a clock for -adaptive_trace_threshold. */
+    uint thead_clock;
+    /* trace_region_t entries, for -adaptive_trace_threshold or -trace_profile */
+    generic_table_t *region_table;
+    /* trace_profile_t entries, for -trace_profile */
+    generic_table_t *tprof_table;
+    file_t tprof_file;
 
 #ifdef CLIENT_INTERFACE
     /* PR 299808: we re-build each bb and pass to the client */
@@ -1188,6 +1188,22 @@ check_option_compatibility_helper(int recurse_count)
         SET_DEFAULT_VALUE(trace_counter_on_delete);
         changed_options = true;
     }
+    if (DYNAMO_OPTION(adaptive_trace_threshold) && !DYNAMO_OPTION(disable_traces) &&
+        (DYNAMO_OPTION(trace_threshold_min) == 0 ||
+         DYNAMO_OPTION(trace_threshold_min) > INTERNAL_OPTION(trace_threshold) ||
+         DYNAMO_OPTION(trace_threshold_max) < INTERNAL_OPTION(trace_threshold) ||
+         DYNAMO_OPTION(trace_threshold_max) > USHRT_MAX)) {
+        USAGE_ERROR("-trace_threshold_min and -trace_threshold_max must bracket "
+                    "trace_threshold within [1, USHRT_MAX], setting to defaults");
+        SET_DEFAULT_VALUE(trace_threshold_min);
+        SET_DEFAULT_VALUE(trace_threshold_max);
+        /* The defaults may not bracket a non-default trace_threshold. */
+        if (DYNAMO_OPTION(trace_threshold_min) > INTERNAL_OPTION(trace_threshold))
+            dynamo_options.trace_threshold_min = INTERNAL_OPTION(trace_threshold);
+        if (DYNAMO_OPTION(trace_threshold_max) < INTERNAL_OPTION(trace_threshold))
+            dynamo_options.trace_threshold_max = INTERNAL_OPTION(trace_threshold);
+        changed_options = true;
+    }
     if (INTERNAL_OPTION(alt_hash_func) >= HASH_FUNCTION_ENUM_MAX) {
         USAGE_ERROR("Invalid selection (%d) for shared cache hash func, must be < %d",
                     INTERNAL_OPTION(alt_hash_func), HASH_FUNCTION_ENUM_MAX);
@@ -787,6 +787,25 @@ DYNAMIC_OPTION(bool, pause_via_loop,
      }, "enable trace creation", STATIC, OP_PCACHE_GLOBAL)
     OPTION_DEFAULT_INTERNAL(uint, trace_counter_on_delete, 0U,
         "trace head counter will be reset to this value upon trace deletion")
+    /* Per-region trace head thresholds, starting from -trace_threshold and moved
+     * within [-trace_threshold_min, -trace_threshold_max] as heads become hot.
+     */
+    OPTION_DEFAULT(bool, adaptive_trace_threshold, false,
+        "tune the trace head threshold per code region from observed hotness")
+    OPTION_DEFAULT(uint, trace_threshold_min, 8U,
+        "lowest trace head threshold used by -adaptive_trace_threshold")
+    OPTION_DEFAULT(uint, trace_threshold_max, 1024U,
+        "highest trace head threshold used by -adaptive_trace_threshold")
+    OPTION_DEFAULT(uint, adaptive_trace_pressure, 50U,
+        "percent of the code reservation in use above which "
+        "-adaptive_trace_threshold only raises thresholds")
+    OPTION_DEFAULT(bool, trace_profile, false,
+        "write per-thread trace head, trace size, and trace exit counts to the log dir")
+    /* Traces whose heads dominate their thread's trace head hits are emitted into
+     * a separate cache, so the hottest code shares as few pages as possible.
+     */
+    OPTION_DEFAULT(bool, hot_trace_cache, false,
+        "emit traces of the hottest trace heads into a dedicated code cache")
 
     OPTION_DEFAULT(uint, max_elide_jmp,  16,
         "maximum direct jumps to elide in a basic block")
@@ -2836,9 +2855,9 @@ OPTION_DEFAULT(bool, pad_jmps_mark_no_trace, false,
      /* for stress testing can use 1 */
     OPTION_DEFAULT_INTERNAL(uint, vmarea_initial_size, 100,
         "initial vmarea vector size")
-    /* FIXME: case 4471 should start smaller and double instead */
+    /* case 4471: vectors grow by the larger of this and half their length */
     OPTION_DEFAULT_INTERNAL(uint, vmarea_increment_size, 100,
-        "incremental vmarea vector size")
+        "minimum incremental vmarea vector size")
     OPTION_INTERNAL(uint_addr, stress_fake_userva,
         "pretend system address space starts at this address (case 9022)")
 
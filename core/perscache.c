@@ -2315,13 +2315,19 @@ get_persist_filename(char *filename /*OUT*/, uint filename_max /* max #chars */,
     /* should we go to a 64-bit hash? */
     IF_X64(ASSERT(CHECK_TRUNCATE_TYPE_uint(size)));
     hash = checksum ^ timestamp ^ (uint)size;
-    /* case 9799: make options part of namespace */
+    /* case 9799: make options part of namespace.  A crc rather than a
+     * position-folded xor so that reordered or repeated options do not cancel out.
+     */
     if (option_string != NULL) {
-        uint i;
         ASSERT(DYNAMO_OPTION(persist_check_options));
-        for (i = 0; i < strlen(option_string); i++)
-            hash ^= option_string[i] << ((i % 4) * 8);
+        hash ^= d_r_crc32(option_string, (uint)strlen(option_string));
     }
+#ifdef CLIENT_INTERFACE
+    /* Make the set of clients part of the namespace too, so the caches of
+     * different tools for the same module do not clobber each other.
+     */
+    hash ^= instrument_persist_client_hash();
+#endif
     LOG(GLOBAL, LOG_CACHE, 2, "\thash = 0x%08x^0x%08x^" PFX " ^ %s = " PFX "\n", checksum,
         timestamp, size, option_string == NULL ? "" : option_string, hash);
     ASSERT_CURIOSITY(hash != 0);
@@ -4059,7 +4065,10 @@ coarse_unit_load(dcontext_t *dcontext, app_pc start, app_pc end, bool for_execut
     info->frozen = true;
     info->persisted = true;
     info->has_persist_info = true;
-    info->persist_base = pers->modinfo.base;
+    /* The unit need not start at the module base: record where base_pc was at
+     * persist time so the tags we shift cover the whole unit.
+     */
+    info->persist_base = pers->modinfo.base + pers->start_offs;
     info->mod_shift = (pers->modinfo.base - modbase);
     info->mmap_pc = map;
     if (map2 != NULL) {
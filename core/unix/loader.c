@@ -1075,6 +1075,24 @@ privload_early_relocate_os_privmod_data(os_privmod_data_t *opd, byte *mod_base)
 static void
 privload_relocate_os_privmod_data(os_privmod_data_t *opd, byte *mod_base)
 {
+    if (opd->relr != NULL) {
+        ELF_ADDR *r = opd->relr, *end = (ELF_ADDR *)((byte *)opd->relr + opd->relrsz);
+        ELF_ADDR *where = NULL;
+        for (; r < end; r++) {
+            ELF_ADDR entry = *r;
+            if ((entry & 1) == 0) {
+                where = (ELF_ADDR *)((byte *)entry + opd->load_delta);
+                *where++ += opd->load_delta;
+            } else {
+                int i;
+                for (i = 0; (entry >>= 1) != 0; i++) {
+                    if ((entry & 1) != 0)
+                        where[i] += opd->load_delta;
+                }
+                where += 8 * sizeof(ELF_ADDR) - 1;
+            }
+        }
+    }
     if (opd->rel != NULL) {
         module_relocate_rel(mod_base, opd, opd->rel, opd->rel + opd->relsz / opd->relent);
     }
@@ -194,8 +194,14 @@ os_module_area_init(module_area_t *ma, app_pc base, size_t view_size, bool at_ma
      */
     if (ma->os_data.checksum == 0 &&
         (DYNAMO_OPTION(coarse_enable_freeze) || DYNAMO_OPTION(use_persisted))) {
-        /* Use something so we have usable pcache names */
-        ma->os_data.checksum = d_r_crc32((const char *)ma->start, PAGE_SIZE);
+        /* Use something so we have usable pcache names.  The build ID identifies
+         * the module's contents, so we prefer it to a checksum of the headers.
+         */
+#    ifdef LINUX
+        ma->os_data.checksum = module_build_id_checksum(base, view_size);
+#    endif
+        if (ma->os_data.checksum == 0)
+            ma->os_data.checksum = d_r_crc32((const char *)ma->start, PAGE_SIZE);
     }
     /* Timestamp we just leave as 0 */
 
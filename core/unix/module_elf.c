@@ -924,6 +924,8 @@ module_init_os_privmod_data_from_dyn(os_privmod_data_t *opd, ELF_DYNAMIC_ENTRY_T
         case DT_RELENT: opd->relent = (size_t)dyn->d_un.d_val; break;
         case DT_RELA: opd->rela = (ELF_RELA_TYPE *)(dyn->d_un.d_ptr + load_delta); break;
         case DT_RELASZ: opd->relasz = (size_t)dyn->d_un.d_val; break;
+        case 36: opd->relr = (ELF_ADDR *)(dyn->d_un.d_ptr + load_delta); break;
+        case 35: opd->relrsz = (size_t)dyn->d_un.d_val; break;
         case DT_RELAENT: opd->relaent = (size_t)dyn->d_un.d_val; break;
         case DT_VERNEED: opd->verneed = (app_pc)(dyn->d_un.d_ptr + load_delta); break;
         case DT_VERNEEDNUM: opd->verneednum = dyn->d_un.d_val; break;
@@ -1032,6 +1034,53 @@ module_find_phdr(app_pc base, uint phdr_type)
     return NULL;
 }
 
+/* Returns a 32-bit digest of the GNU build ID note of the module mapped at base, or
+ * 0 if it has no such note within the first view_size bytes.  The linker computes
+ * the build ID over the module's contents, so unlike a checksum of the headers it
+ * changes whenever the code does.
+ */
+uint
+module_build_id_checksum(app_pc base, size_t view_size)
+{
+    ELF_HEADER_TYPE *elf_hdr = (ELF_HEADER_TYPE *)base;
+    ptr_int_t load_delta;
+    uint i;
+    if (elf_hdr->e_phoff == 0 ||
+        elf_hdr->e_phoff + elf_hdr->e_phnum * elf_hdr->e_phentsize > view_size)
+        return 0;
+    load_delta = base -
+        module_vaddr_from_prog_header(base + elf_hdr->e_phoff, elf_hdr->e_phnum, NULL,
+                                      NULL);
+    for (i = 0; i < elf_hdr->e_phnum; i++) {
+        ELF_PROGRAM_HEADER_TYPE *prog_hdr = (ELF_PROGRAM_HEADER_TYPE *)(
+            base + elf_hdr->e_phoff + i * elf_hdr->e_phentsize);
+        app_pc note, notes_end;
+        /* Notes in a segment aligned to 8 are padded to 8, else to 4. */
+        size_t align = (prog_hdr->p_align == 8) ? 8 : 4;
+        if (prog_hdr->p_type != PT_NOTE)
+            continue;
+        note = (app_pc)prog_hdr->p_vaddr + load_delta;
+        notes_end = note + prog_hdr->p_filesz;
+        /* With at_map we may only see the first segment. */
+        if (note < base || notes_end > base + view_size || notes_end < note)
+            continue;
+        while (note + sizeof(ELF_NOTE_TYPE) <= notes_end) {
+            ELF_NOTE_TYPE *nhdr = (ELF_NOTE_TYPE *)note;
+            const char *name = (const char *)(note + sizeof(*nhdr));
+            app_pc desc = note + ALIGN_FORWARD(sizeof(*nhdr) + nhdr->n_namesz, align);
+            app_pc next = desc + ALIGN_FORWARD(nhdr->n_descsz, align);
+            if (next > notes_end || next <= note)
+                break;
+            if (nhdr->n_type == NT_GNU_BUILD_ID && nhdr->n_descsz > 0 &&
+                nhdr->n_namesz == sizeof(ELF_NOTE_GNU) &&
+                strncmp(name, ELF_NOTE_GNU, sizeof(ELF_NOTE_GNU)) == 0)
+                return d_r_crc32((const char *)desc, nhdr->n_descsz);
+            note = next;
+        }
+    }
+    return 0;
+}
+
 bool
 module_get_relro(app_pc base, OUT app_pc *relro_base, OUT size_t *relro_size)
 {
@@ -47,6 +47,7 @@
 #    define ELF_PROGRAM_HEADER_TYPE Elf64_Phdr
 #    define ELF_SECTION_HEADER_TYPE Elf64_Shdr
 #    define ELF_DYNAMIC_ENTRY_TYPE Elf64_Dyn
+#    define ELF_NOTE_TYPE Elf64_Nhdr
 #    define ELF_ADDR Elf64_Addr
 #    define ELF_WORD Elf64_Xword
 #    define ELF_SWORD Elf64_Sxword
@@ -68,6 +69,7 @@
 #    define ELF_PROGRAM_HEADER_TYPE Elf32_Phdr
 #    define ELF_SECTION_HEADER_TYPE Elf32_Shdr
 #    define ELF_DYNAMIC_ENTRY_TYPE Elf32_Dyn
+#    define ELF_NOTE_TYPE Elf32_Nhdr
 #    define ELF_ADDR Elf32_Addr
 #    define ELF_WORD Elf32_Word
 #    define ELF_SWORD Elf32_Sword
@@ -225,6 +227,9 @@ module_relocate_rela(app_pc modbase, os_privmod_data_t *pd, ELF_RELA_TYPE *start
 bool
 module_get_relro(app_pc base, OUT app_pc *relro_base, OUT size_t *relro_size);
 
+uint
+module_build_id_checksum(app_pc base, size_t view_size);
+
 bool
 module_read_os_data(app_pc base, bool dyn_reloc, OUT ptr_int_t *delta,
                     OUT os_module_data_t *os_data, OUT char **soname);
@@ -211,6 +211,17 @@ typedef struct vm_area_t {
     } custom;
 } vm_area_t;
 
+/* A thread-private copy of the bounds of an area found in a shared vector, used to
+ * answer repeated lookups without touching the vector's lock.  The copy is valid
+ * only while the vector's generation matches.  Flags are not copied as they are
+ * updated in place without bumping the generation.
+ */
+typedef struct _vm_area_cache_t {
+    app_pc start;
+    app_pc end;
+    ptr_uint_t generation; /* 0 means invalid */
+} vm_area_cache_t;
+
 /* for each thread we record all executable areas, to make it faster
  * to decide whether we need to flush any fragments on an munmap
  */
@@ -228,6 +239,11 @@ typedef struct thread_data_t {
      * in thread-private structures, not in shared structures like shared_data */
     app_pc last_decode_area_page_pc;
     bool last_decode_area_valid; /* since no sentinel exists */
+    /* copies of the last areas this thread found in executable_areas and
+     * dynamo_areas, for lock-free repeated lookups
+     */
+    volatile vm_area_cache_t last_exec_hit;
+    volatile vm_area_cache_t last_dynamo_hit;
 #ifdef PROGRAM_SHEPHERDING
     uint thrown_exceptions; /* number of responses to execution violations */
 #endif
@@ -839,6 +855,28 @@ writelock_if_not_already(vm_area_vector_t *v)
     return false;
 }
 
+/* Returns the index of the first area in v whose end is >= pc, or v->length if
+ * there is none.  No area before that index can overlap or be adjacent to a
+ * region starting at pc, so add_vm_area() and remove_vm_area() start their scans
+ * there rather than walking the whole vector.
+ * Assumes caller holds v->lock, if necessary.
+ */
+static int
+vm_area_first_reaching(vm_area_vector_t *v, app_pc pc)
+{
+    /* areas are sorted and disjoint, so their ends are sorted as well */
+    int min = 0;
+    int max = v->length;
+    while (min < max) {
+        int i = (min + max) / 2;
+        if (v->buf[i].end < pc)
+            min = i + 1;
+        else
+            max = i;
+    }
+    return min;
+}
+
 static void
 vm_area_vector_check_size(vm_area_vector_t *v)
 {
@@ -851,8 +889,11 @@ vm_area_vector_check_size(vm_area_vector_t *v)
             v->buf = (vm_area_t *)global_heap_alloc(
                 v->size * sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
         } else {
-            /* FIXME: case 4471 we should be doubling size here */
-            int new_size = (INTERNAL_OPTION(vmarea_increment_size) + v->length);
+            /* case 4471: grow geometrically so that a vector with many areas
+             * (e.g., executable_areas for a JIT) is not resized on every few adds
+             */
+            int new_size = v->length +
+                MAX((int)INTERNAL_OPTION(vmarea_increment_size), v->length / 2);
             STATS_INC(num_vmareas_resized);
             v->buf = global_heap_realloc(v->buf, v->size, new_size,
                                          sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
@@ -888,6 +929,16 @@ vm_area_merge_fraglists(vm_area_t *dst, vm_area_t *src)
     }
 }
 
+/* Makes a completed change to v visible to lookup_addr_cached(): the release
+ * store orders all of the writer's updates to v before the new generation.
+ * Caller must hold v->lock for write.
+ */
+static inline void
+vmvector_publish_change(vm_area_vector_t *v)
+{
+    atomic_aligned_write_ptr_release(&v->generation, v->generation + 1);
+}
+
 /* Assumes caller holds v->lock, if necessary.
  * Does not return the area added since it may be merged or split depending
  * on existing areas->
@@ -929,7 +980,7 @@ add_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, uint vm_flags, uint f
                                       : (v == dynamo_areas ? " dynamo_areas" : ""))),
         start, end, comment);
     /* N.B.: new area could span multiple existing areas! */
-    for (i = 0; i < v->length; i++) {
+    for (i = vm_area_first_reaching(v, start); i < v->length; i++) {
         /* look for overlap, or adjacency of same type (including all flags, and never
          * merge adjacent if keeping write counts)
          */
@@ -1266,6 +1317,7 @@ add_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, uint vm_flags, uint f
             vm_area_clean_fraglist(dcontext, &v->buf[i]);
         }
     }
+    vmvector_publish_change(v);
     DOLOG(5, LOG_VMAREAS, { print_vm_areas(v, GLOBAL); });
 }
 
@@ -1332,7 +1384,7 @@ remove_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, bool restore_prot)
     ASSERT_VMAREA_VECTOR_PROTECTED(v, WRITE);
     LOG(GLOBAL, LOG_VMAREAS, 4, "in remove_vm_area " PFX " " PFX "\n", start, end);
     /* N.B.: removed area could span multiple areas! */
-    for (i = 0; i < v->length; i++) {
+    for (i = vm_area_first_reaching(v, start); i < v->length; i++) {
         /* look for overlap */
         if (start < v->buf[i].end && end > v->buf[i].start) {
             if (overlap_start == -1)
@@ -1481,6 +1533,7 @@ remove_vm_area(vm_area_vector_t *v, app_pc start, app_pc end, bool restore_prot)
                     new_area.frag_flags,
                     new_area.custom.client _IF_DEBUG(new_area.comment));
     }
+    vmvector_publish_change(v);
     DOLOG(5, LOG_VMAREAS, { print_vm_areas(v, GLOBAL); });
     return true;
 }
@@ -1565,6 +1618,61 @@ lookup_addr(vm_area_vector_t *v, app_pc addr, vm_area_t **area)
     return binary_search(v, addr, addr + 1 /*open end*/, area, NULL, false);
 }
 
+/* Returns the calling thread's vmareas data for use with the lock-free lookup
+ * caches, or NULL if the thread has none (yet).
+ */
+static thread_data_t *
+lookup_cache_thread_data(void)
+{
+    dcontext_t *dcontext;
+    /* lookups can come from contexts where protected local heap is read-only */
+    if (TEST(SELFPROT_LOCAL, DYNAMO_OPTION(protect_mask)))
+        return NULL;
+    dcontext = get_thread_private_dcontext();
+    if (dcontext == NULL || dcontext == GLOBAL_DCONTEXT)
+        return NULL;
+    return (thread_data_t *)dcontext->vm_areas_field;
+}
+
+/* Returns whether addr lies in the area copied from v into cache.
+ * Takes no lock and performs no writes to shared memory: a stale copy is detected
+ * by its generation no longer matching v's.  Writers publish a new generation only
+ * once their change is complete, so a hit means the area was in v as of the last
+ * published change.  This is weaker than holding the read lock: a writer may be
+ * part-way through removing the area, and a lookup under the lock would wait for it
+ * and miss.  Callers must tolerate answering as of just before such a writer, which
+ * they already do as the lock is dropped before the answer is used.
+ * Both generations are re-read after the bounds so that a hit is never reported
+ * from bounds read across a refill of cache (by a signal handler on this thread)
+ * or across a newly published change to v.
+ */
+static inline bool
+lookup_addr_cached(vm_area_vector_t *v, volatile vm_area_cache_t *cache, app_pc addr)
+{
+    ptr_uint_t generation = atomic_aligned_read_ptr_acquire(&v->generation);
+    bool hit;
+    if (cache->generation == 0 || cache->generation != generation)
+        return false;
+    hit = addr >= cache->start && addr < cache->end;
+    return hit && cache->generation == generation &&
+        atomic_aligned_read_ptr_acquire(&v->generation) == generation;
+}
+
+/* Records the bounds of area, which was found in v, in cache.
+ * Caller must hold v->lock for read or write so the generation is stable.
+ */
+static inline void
+lookup_cache_fill(vm_area_vector_t *v, volatile vm_area_cache_t *cache,
+                  vm_area_t *area)
+{
+    ASSERT_VMAREA_VECTOR_PROTECTED(v, READWRITE);
+    /* invalidate first in case a signal handler looks at cache mid-update */
+    cache->generation = 0;
+    cache->start = area->start;
+    cache->end = area->end;
+    cache->generation = v->generation;
+}
+
 /* returns true if the passed in area overlaps any known executable areas
  * Assumes caller holds v->lock, if necessary
  */
@@ -1875,6 +1983,8 @@ vm_areas_thread_exit(dcontext_t *dcontext)
     HEAP_TYPE_FREE(dcontext, dcontext->vm_areas_field, thread_data_t, ACCT_OTHER,
                    PROTECTED);
 #endif
+    /* later lookups by this thread must not use its lookup caches */
+    dcontext->vm_areas_field = NULL;
 }
 
 /****************************************************************************
@@ -2163,6 +2273,7 @@ vmvector_reset_vector(dcontext_t *dcontext, vm_area_vector_t *v)
         v->size = 0;
         v->length = 0;
         v->buf = NULL;
+        vmvector_publish_change(v);
     } else
         ASSERT(v->size == 0 && v->length == 0);
 }
@@ -2487,6 +2598,7 @@ add_executable_vm_area_check_IAT(app_pc *start /*IN/OUT*/, app_pc *end /*IN/OUT*
                 ASSERT(*start == IAT_end); /* set up above */
                 *end = area->end;
                 area->start = *start;
+                vmvector_publish_change(executable_areas);
                 *existing_area = area;
                 STATS_INC(coarse_merge_IAT);
                 /* If info was loaded prior to rebinding just use it.
@@ -2985,8 +3097,14 @@ bool
 is_executable_address(app_pc addr)
 {
     bool found;
+    vm_area_t *area;
+    thread_data_t *data = lookup_cache_thread_data();
+    if (data != NULL && lookup_addr_cached(executable_areas, &data->last_exec_hit, addr))
+        return true;
     d_r_read_lock(&executable_areas->lock);
-    found = lookup_addr(executable_areas, addr, NULL);
+    found = lookup_addr(executable_areas, addr, &area);
+    if (found && data != NULL)
+        lookup_cache_fill(executable_areas, &data->last_exec_hit, area);
     d_r_read_unlock(&executable_areas->lock);
     return found;
 }
@@ -3758,11 +3876,20 @@ bool
 is_dynamo_address(app_pc addr)
 {
     bool found;
+    vm_area_t *area;
+    thread_data_t *data;
     /* case 3045: areas inside the vmheap reservation are not added to the list */
     if (is_vmm_reserved_address(addr, 1, NULL, NULL))
         return true;
+    /* a stale dynamo_areas may be about to drop the cached area */
+    data = lookup_cache_thread_data();
+    if (data != NULL && dynamo_areas_uptodate &&
+        lookup_addr_cached(dynamo_areas, &data->last_dynamo_hit, addr))
+        return true;
     dynamo_vm_areas_start_reading();
-    found = lookup_addr(dynamo_areas, addr, NULL);
+    found = lookup_addr(dynamo_areas, addr, &area);
+    if (found && data != NULL)
+        lookup_cache_fill(dynamo_areas, &data->last_dynamo_hit, area);
     dynamo_vm_areas_done_reading();
     return found;
 }
@@ -11694,6 +11821,112 @@ vmvector_tests()
     vmvector_print(&v, STDERR);
 }
 
+/* Checks that a lookup cache copy is invalidated by changes to its vector. */
+static void
+vmvector_lookup_cache_test(void)
+{
+    vm_area_vector_t v = { 0, 0, 0, false };
+    vm_area_cache_t cache = { 0 };
+    vm_area_t *area;
+    ASSIGN_INIT_READWRITE_LOCK_FREE(v.lock, thread_vm_areas);
+    print_file(STDERR, "\nvm_area_vector_t lookup cache test\n");
+    EXPECT(lookup_addr_cached(&v, &cache, INT_TO_PC(0x101)), false);
+    add_vm_area(&v, INT_TO_PC(0x100), INT_TO_PC(0x200), 0, 0, NULL _IF_DEBUG("A"));
+    EXPECT(lookup_addr(&v, INT_TO_PC(0x101), &area), true);
+    lookup_cache_fill(&v, &cache, area);
+    EXPECT(lookup_addr_cached(&v, &cache, INT_TO_PC(0x101)), true);
+    EXPECT(lookup_addr_cached(&v, &cache, INT_TO_PC(0x200)), false);
+
+    /* even an add elsewhere invalidates the copy */
+    add_vm_area(&v, INT_TO_PC(0x300), INT_TO_PC(0x400), 0, 0, NULL _IF_DEBUG("B"));
+    EXPECT(lookup_addr_cached(&v, &cache, INT_TO_PC(0x101)), false);
+
+    /* a bounds change must invalidate it */
+    EXPECT(lookup_addr(&v, INT_TO_PC(0x101), &area), true);
+    lookup_cache_fill(&v, &cache, area);
+    remove_vm_area(&v, INT_TO_PC(0x180), INT_TO_PC(0x200), false);
+    EXPECT(lookup_addr_cached(&v, &cache, INT_TO_PC(0x190)), false);
+    EXPECT(lookup_addr(&v, INT_TO_PC(0x190), NULL), false);
+
+    /* a removal that finds nothing changes nothing */
+    EXPECT(lookup_addr(&v, INT_TO_PC(0x101), &area), true);
+    lookup_cache_fill(&v, &cache, area);
+    EXPECT(remove_vm_area(&v, INT_TO_PC(0x500), INT_TO_PC(0x600), false), false);
+    EXPECT(lookup_addr_cached(&v, &cache, INT_TO_PC(0x101)), true);
+
+    remove_vm_area(&v, INT_TO_PC(0), UNIVERSAL_REGION_END, false);
+    EXPECT(lookup_addr_cached(&v, &cache, INT_TO_PC(0x101)), false);
+    global_heap_free(v.buf, v.size * sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
+    DELETE_READWRITE_LOCK(v.lock);
+}
+
+/* Microbenchmark modeled on a JIT that maps, reprotects, and unmaps thousands of
+ * small code regions: fills a vector in scattered address order, then randomly
+ * removes and re-adds regions interleaved with lookups, checking the vector
+ * against a shadow array and reporting the elapsed time.
+ */
+#    define CHURN_REGIONS 4096 /* power of 2 */
+#    define CHURN_OPS (256 * 1024)
+#    define CHURN_REGION_SIZE 0x1000
+static bool churn_present[CHURN_REGIONS];
+
+static app_pc
+churn_region_base(uint slot)
+{
+    /* Leave a gap after each region so neighbors never merge. */
+    return INT_TO_PC(0x10000000 + slot * 2 * CHURN_REGION_SIZE);
+}
+
+static void
+vmvector_churn_test(void)
+{
+    vm_area_vector_t v = { 0, 0, 0, false };
+    uint64 start_time, elapsed;
+    uint seed = 42, slot;
+    int i, count = 0;
+    ASSIGN_INIT_READWRITE_LOCK_FREE(v.lock, thread_vm_areas);
+    print_file(STDERR, "\nvm_area_vector_t churn test\n");
+    start_time = query_time_millis();
+    for (i = 0; i < CHURN_REGIONS; i++) {
+        /* An odd multiplier permutes the slots. */
+        slot = (i * 1031) & (CHURN_REGIONS - 1);
+        add_vm_area(&v, churn_region_base(slot),
+                    churn_region_base(slot) + CHURN_REGION_SIZE, 0, 0,
+                    NULL _IF_DEBUG("churn"));
+        churn_present[slot] = true;
+        count++;
+    }
+    for (i = 0; i < CHURN_OPS; i++) {
+        vm_area_t *area = NULL;
+        bool found;
+        seed = seed * 1103515245 + 12345;
+        slot = (seed >> 8) & (CHURN_REGIONS - 1);
+        found = lookup_addr(&v, churn_region_base(slot) + CHURN_REGION_SIZE / 2, &area);
+        EXPECT(found, churn_present[slot]);
+        if (churn_present[slot]) {
+            remove_vm_area(&v, churn_region_base(slot),
+                           churn_region_base(slot) + CHURN_REGION_SIZE, false);
+            count--;
+        } else {
+            add_vm_area(&v, churn_region_base(slot),
+                        churn_region_base(slot) + CHURN_REGION_SIZE, 0, 0,
+                        NULL _IF_DEBUG("churn"));
+            count++;
+        }
+        churn_present[slot] = !churn_present[slot];
+    }
+    elapsed = query_time_millis() - start_time;
+    EXPECT(v.length, count);
+    for (i = 1; i < v.length; i++)
+        EXPECT_RELATION(v.buf[i - 1].end, <, (ptr_uint_t)v.buf[i].start);
+    print_file(STDERR, "%d operations on %d regions took " UINT64_FORMAT_STRING " ms\n",
+               CHURN_REGIONS + CHURN_OPS, CHURN_REGIONS, elapsed);
+    remove_vm_area(&v, INT_TO_PC(0), UNIVERSAL_REGION_END, false);
+    EXPECT(v.length, 0);
+    global_heap_free(v.buf, v.size * sizeof(struct vm_area_t) HEAPACCT(ACCT_VMAREAS));
+    DELETE_READWRITE_LOCK(v.lock);
+}
+
 /* initial vector tests
  * FIXME: should add a lot more, esp. wrt other flags -- these only
  * test no flags or interactions w/ selfmod flag
@@ -11820,5 +12053,7 @@ unit_test_vmareas(void)
     check_vec(&v, 2, INT_TO_PC(3), INT_TO_PC(4), 0, 0, NULL);
 
     vmvector_tests();
+    vmvector_lookup_cache_test();
+    vmvector_churn_test();
 }
 #endif /* STANDALONE_UNIT_TEST */
@@ -111,6 +111,10 @@ struct vm_area_vector_t {
      * If non-NULL, the free_payload_func will NOT be called.
      */
     void *(*merge_payload_func)(void *dst, void *src);
+    /* Bumped whenever an area is added, removed, or has its bounds changed, so
+     * that lock-free readers can validate thread-private copies of areas.
+     */
+    volatile ptr_uint_t generation;
 }; /* typedef-ed in globals.h */
 
 /* vm_area_vectors should NOT be declared statically if their locks need to be
@@ -0,0 +1,93 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Loads a library and runs code in it, so that its code is persisted on the first
+ * run at exit.  When passed "shift", the app then unloads the library, reserves the
+ * address it was loaded at, and loads it again, so that the second run is guaranteed
+ * to use the persisted code at a different base than the one it was persisted at,
+ * with or without ASLR.
+ */
+
+#include "tools.h"
+
+#include <dlfcn.h>
+#include <string.h>
+#include <sys/mman.h>
+
+typedef int (*work_func_t)(int);
+
+static void *
+load_and_run(const char *path, work_func_t *func OUT)
+{
+    void *lib = dlopen(path, RTLD_NOW);
+    if (lib == NULL) {
+        print("failed to load %s: %s\n", path, dlerror());
+        exit(1);
+    }
+    *func = (work_func_t)dlsym(lib, "pcache_shift_work");
+    if (*func == NULL) {
+        print("failed to find pcache_shift_work\n");
+        exit(1);
+    }
+    print("work result is %d\n", (**func)(1000));
+    return lib;
+}
+
+int
+main(int argc, const char *argv[])
+{
+    work_func_t func, moved_func;
+    void *lib;
+    if (argc < 2) {
+        print("usage: %s <library> [shift]\n", argv[0]);
+        return 1;
+    }
+    lib = load_and_run(argv[1], &func);
+    if (argc > 2 && strcmp(argv[2], "shift") == 0) {
+        void *page_start, *reserve;
+        dlclose(lib);
+        /* Occupy the page the code was at so the loader must pick another base. */
+        page_start = (void *)ALIGN_BACKWARD(func, PAGE_SIZE);
+        reserve = mmap(page_start, PAGE_SIZE, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS,
+                       -1, 0);
+        if (reserve != page_start) {
+            print("failed to reserve the library's old address\n");
+            return 1;
+        }
+        lib = load_and_run(argv[1], &moved_func);
+        if (moved_func != func)
+            print("library moved\n");
+    }
+    /* The library is left loaded: its code is persisted at exit. */
+    return 0;
+}
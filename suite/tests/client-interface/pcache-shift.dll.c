@@ -0,0 +1,129 @@
+/* **********************************************************
+ * Copyright (c) 2019 Google, Inc.  All rights reserved.
+ * **********************************************************/
+
+/*
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions are met:
+ *
+ * * Redistributions of source code must retain the above copyright notice,
+ *   this list of conditions and the following disclaimer.
+ *
+ * * Redistributions in binary form must reproduce the above copyright notice,
+ *   this list of conditions and the following disclaimer in the documentation
+ *   and/or other materials provided with the distribution.
+ *
+ * * Neither the name of Google, Inc. nor the names of its contributors may be
+ *   used to endorse or promote products derived from this software without
+ *   specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+ * AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED. IN NO EVENT SHALL GOOGLE, INC. OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+ * SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+ * CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+ * DAMAGE.
+ */
+
+
+/* Instruments every block with a clean call and persists the client's base with
+ * each pcache, then reports whether the library of client.pcache-shift was
+ * resurrected at a different base than the one it was persisted at.
+ */
+
+#include "dr_api.h"
+#include <string.h>
+
+typedef struct _persist_data_t {
+    byte *client_base;
+    app_pc start;
+} persist_data_t;
+
+static byte *mybase;
+static uint bb_execs;
+static uint shifted_resurrects;
+
+static void
+at_bb(app_pc bb_addr)
+{
+#ifdef X64
+    /* An inlined rip-relative reference would be stale once the cache moves. */
+#else
+    /* global reference => won't work w/o same base or relocation */
+    bb_execs++;
+#endif
+}
+
+static bool
+in_shift_library(app_pc pc)
+{
+    bool res = false;
+    module_data_t *data = dr_lookup_module(pc);
+    if (data != NULL) {
+        const char *name = dr_module_preferred_name(data);
+        res = name != NULL && strstr(name, "pcache-shift.appdll") != NULL;
+        dr_free_module_data(data);
+    }
+    return res;
+}
+
+static size_t
+event_persist_ro_size(void *drcontext, void *perscxt, size_t file_offs,
+                      void **user_data OUT)
+{
+    return sizeof(persist_data_t);
+}
+
+static bool
+event_persist_ro(void *drcontext, void *perscxt, file_t fd, void *user_data)
+{
+    persist_data_t data = { mybase, dr_persist_start(perscxt) };
+    return dr_write_file(fd, &data, sizeof(data)) == (ssize_t)sizeof(data);
+}
+
+static bool
+event_resurrect_ro(void *drcontext, void *perscxt, byte **map INOUT)
+{
+    persist_data_t data;
+    app_pc start = dr_persist_start(perscxt);
+    memcpy(&data, *map, sizeof(data));
+    *map += sizeof(data);
+    /* Our clean calls hardcode the client's address. */
+    if (data.client_base != mybase)
+        return false;
+    if (data.start != start && in_shift_library(start))
+        shifted_resurrects++;
+    return true;
+}
+
+static dr_emit_flags_t
+event_bb(void *drcontext, void *tag, instrlist_t *bb, bool for_trace, bool translating)
+{
+    dr_insert_clean_call(drcontext, bb, instrlist_first(bb), at_bb, false, 1,
+                         OPND_CREATE_INTPTR((ptr_uint_t)dr_fragment_app_pc(tag)));
+    return DR_EMIT_DEFAULT | DR_EMIT_PERSISTABLE;
+}
+
+static void
+event_exit(void)
+{
+    if (shifted_resurrects > 0)
+        dr_fprintf(STDERR, "resurrected a pcache at a different base\n");
+}
+
+DR_EXPORT
+void
+dr_init(client_id_t id)
+{
+    mybase = dr_get_client_base(id);
+    dr_register_exit_event(event_exit);
+    dr_register_bb_event(event_bb);
+    if (!dr_register_persist_ro(event_persist_ro_size, event_persist_ro,
+                                event_resurrect_ro))
+        dr_fprintf(STDERR, "failed to register ro");
+}
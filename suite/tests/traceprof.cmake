@@ -0,0 +1,103 @@
+# **********************************************************
+# Copyright (c) 2019 Google, Inc.    All rights reserved.
+# **********************************************************
+
+# Redistribution and use in source and binary forms, with or without
+# modification, are permitted provided that the following conditions are met:
+#
+# * Redistributions of source code must retain the above copyright notice,
+#   this list of conditions and the following disclaimer.
+#
+# * Redistributions in binary form must reproduce the above copyright notice,
+#   this list of conditions and the following disclaimer in the documentation
+#   and/or other materials provided with the distribution.
+#
+# * Neither the name of Google, Inc. nor the names of its contributors may be
+#   used to endorse or promote products derived from this software without
+#   specific prior written permission.
+#
+# THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+# AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+# IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+# ARE DISCLAIMED. IN NO EVENT SHALL VMWARE, INC. OR CONTRIBUTORS BE LIABLE
+# FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+# DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS OR
+# SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION) HOWEVER
+# CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+# LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+# OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF SUCH
+# DAMAGE.
+
+# Checks the per-thread files written by -trace_profile.
+# input:
+# * dir = the -logdir the profiled app was run with
+#
+# Each file's header must name the thread in the file name, and the totals line
+# must equal the sums of the region and trace tables.  Prints the number of
+# files checked.
+
+set(num_re "([0-9]+)")
+set(totals_re "^${num_re} trace heads, ${num_re} head hits, ${num_re} traces started, ")
+set(totals_re "${totals_re}${num_re} trace exits to DR$")
+file(GLOB profiles "${dir}/*/traceprof.*.html")
+list(LENGTH profiles count)
+if (count EQUAL 0)
+  message(FATAL_ERROR "no traceprof files found in ${dir}")
+endif ()
+
+foreach (prof ${profiles})
+  get_filename_component(name "${prof}" NAME)
+  string(REGEX REPLACE "^traceprof\\.[0-9]+\\.([0-9]+)\\.html$" "\\1" tid "${name}")
+  file(STRINGS "${prof}" lines)
+  unset(totals)
+  set(heads 0)
+  set(hits 0)
+  set(traces 0)
+  set(exits 0)
+  set(section "header line")
+  foreach (line ${lines})
+    if ("${section}" STREQUAL "header line")
+      if (NOT "${line}" STREQUAL "Trace selection profile for thread ${tid}")
+        message(FATAL_ERROR "${prof} has a bad header: |${line}|")
+      endif ()
+      set(section "totals line")
+    elseif ("${section}" STREQUAL "totals line")
+      if (NOT "${line}" MATCHES "${totals_re}")
+        message(FATAL_ERROR "${prof} has bad totals: |${line}|")
+      endif ()
+      set(totals "${line}")
+      set(want_heads ${CMAKE_MATCH_1})
+      set(want_hits ${CMAKE_MATCH_2})
+      set(want_traces ${CMAKE_MATCH_3})
+      set(want_exits ${CMAKE_MATCH_4})
+      set(section "")
+    elseif ("${line}" STREQUAL "Regions:" OR "${line}" STREQUAL "Traces:")
+      set(section "${line}")
+      set(want_columns ON)
+    elseif (want_columns)
+      # The column names.
+      set(want_columns OFF)
+    elseif ("${section}" STREQUAL "Regions:" AND "${line}" MATCHES
+        "^0x[0-9a-f]+ +${num_re} +${num_re} +${num_re} +${num_re}$")
+      math(EXPR heads "${heads} + ${CMAKE_MATCH_2}")
+      math(EXPR hits "${hits} + ${CMAKE_MATCH_3}")
+      math(EXPR traces "${traces} + ${CMAKE_MATCH_4}")
+    elseif ("${section}" STREQUAL "Traces:" AND "${line}" MATCHES
+        "^0x[0-9a-f]+ +${num_re} +${num_re} +${num_re} +${num_re}$")
+      math(EXPR exits "${exits} + ${CMAKE_MATCH_4}")
+    elseif (NOT "${line}" STREQUAL "")
+      message(FATAL_ERROR "${prof} has an unexpected line: |${line}|")
+    endif ()
+  endforeach ()
+  if (NOT DEFINED totals)
+    message(FATAL_ERROR "${prof} is truncated")
+  endif ()
+
+  if (NOT heads EQUAL want_heads OR NOT hits EQUAL want_hits OR
+      NOT traces EQUAL want_traces OR NOT exits EQUAL want_exits)
+    message(FATAL_ERROR "${prof} totals |${totals}| do not match its tables: "
+      "${heads} heads, ${hits} hits, ${traces} traces, ${exits} exits")
+  endif ()
+endforeach ()
+
+message("${count} well-formed trace profiles")